@@ -24,6 +24,7 @@ class ErrorCode(object):
     SE_MONGODB_ERROR = 4
     SE_REDIS_ERROR = 5
     SE_THRIFT_HANDLER_ERROR = 6
+    SE_SERVER_OVERLOADED = 7
 
     _VALUES_TO_NAMES = {
         0: "SE_THRIFT_CONNPOOL_TIMEOUT",
@@ -33,6 +34,7 @@ class ErrorCode(object):
         4: "SE_MONGODB_ERROR",
         5: "SE_REDIS_ERROR",
         6: "SE_THRIFT_HANDLER_ERROR",
+        7: "SE_SERVER_OVERLOADED",
     }
 
     _NAMES_TO_VALUES = {
@@ -43,6 +45,7 @@ class ErrorCode(object):
         "SE_MONGODB_ERROR": 4,
         "SE_REDIS_ERROR": 5,
         "SE_THRIFT_HANDLER_ERROR": 6,
+        "SE_SERVER_OVERLOADED": 7,
     }
 
 
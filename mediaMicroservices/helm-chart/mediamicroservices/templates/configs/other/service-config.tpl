@@ -3,11 +3,25 @@
   "secret": "secret",
   "unique-id-service": {
     "addr": "unique-id-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "movie-id-service": {
     "addr": "movie-id-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "movie-id-mongodb": {
     "addr": "movie-id-mongodb",
@@ -27,11 +41,25 @@
   },
   "text-service": {
     "addr": "text-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "rating-service": {
     "addr": "rating-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "rating-redis": {
     "addr": "rating-redis",
@@ -39,11 +67,25 @@
   },
   "user-service": {
     "addr": "user-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "compose-review-service": {
     "addr": "compose-review-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "compose-review-memcached": {
     "addr": "compose-review-memcached",
@@ -51,7 +93,14 @@
   },
   "review-storage-service": {
     "addr": "review-storage-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "review-storage-mongodb": {
     "addr": "review-storage-mongodb",
@@ -63,7 +112,14 @@
   },
   "user-review-service": {
     "addr": "user-review-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "user-review-mongodb": {
     "addr": "user-review-mongodb",
@@ -75,7 +131,14 @@
   },
   "movie-review-service": {
     "addr": "movie-review-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "movie-review-mongodb": {
     "addr": "movie-review-mongodb",
@@ -87,7 +150,14 @@
   },
   "cast-info-service": {
     "addr": "cast-info-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "cast-info-mongodb": {
     "addr": "cast-info-mongodb",
@@ -99,7 +169,14 @@
   },
   "plot-service": {
     "addr": "plot-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "plot-mongodb": {
     "addr": "plot-mongodb",
@@ -111,7 +188,14 @@
   },
   "movie-info-service": {
     "addr": "movie-info-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   },
   "movie-info-mongodb": {
     "addr": "movie-info-mongodb",
@@ -123,7 +207,14 @@
   },
   "page-service": {
     "addr": "page-service",
-    "port": 9090
+    "port": 9090,
+    "metrics_port": 9091,
+    "server_mode": "threaded",
+    "server_io_threads": 4,
+    "server_worker_threads": 64,
+    "concurrency_limit_initial": 128,
+    "concurrency_limit_min": 16,
+    "concurrency_limit_max": 0
   }
 }
 {{- end }}
\ No newline at end of file
@@ -28,7 +28,8 @@ enum ErrorCode {
   SE_MEMCACHED_ERROR,
   SE_MONGODB_ERROR,
   SE_REDIS_ERROR,
-  SE_THRIFT_HANDLER_ERROR
+  SE_THRIFT_HANDLER_ERROR,
+  SE_SERVER_OVERLOADED
 }
 
 struct CastInfo {
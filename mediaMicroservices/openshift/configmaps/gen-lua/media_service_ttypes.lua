@@ -18,7 +18,8 @@ local ErrorCode = {
   SE_MEMCACHED_ERROR = 3,
   SE_MONGODB_ERROR = 4,
   SE_REDIS_ERROR = 5,
-  SE_THRIFT_HANDLER_ERROR = 6
+  SE_THRIFT_HANDLER_ERROR = 6,
+  SE_SERVER_OVERLOADED = 7
 }
 
 local User = __TObject:new{
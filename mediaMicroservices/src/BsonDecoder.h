@@ -0,0 +1,221 @@
+#ifndef MEDIA_MICROSERVICES_BSONDECODER_H
+#define MEDIA_MICROSERVICES_BSONDECODER_H
+
+#include <bson/bson.h>
+
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../gen-cpp/media_service_types.h"
+
+namespace media_service {
+
+// Decodes MongoDB documents straight into Thrift structs with the bson_iter
+// API, rather than printing them with bson_as_json and parsing the text
+// back. A struct is decodable once it has a DecodeBson(bson_iter_t *, T *)
+// overload, usually a single call to DecodeBsonFields naming its fields.
+// Decoding never throws: it returns false when a field is missing or holds
+// an unexpected BSON type, and the caller turns that into its own error.
+
+// Key of a document and the struct member it is decoded into.
+template <class T, class M>
+struct BsonField {
+  const char *key;
+  M T::*member;
+};
+
+template <class T, class M>
+BsonField<T, M> Field(const char *key, M T::*member) {
+  return BsonField<T, M>{key, member};
+}
+
+bool BsonRead(const bson_iter_t *iter, int64_t *value);
+bool BsonRead(const bson_iter_t *iter, int32_t *value);
+bool BsonRead(const bson_iter_t *iter, double *value);
+bool BsonRead(const bson_iter_t *iter, bool *value);
+bool BsonRead(const bson_iter_t *iter, std::string *value);
+
+template <class E>
+typename std::enable_if<std::is_enum<E>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, E *value);
+
+template <class T>
+bool BsonRead(const bson_iter_t *iter, std::vector<T> *value);
+
+template <class T>
+typename std::enable_if<std::is_class<T>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, T *value);
+
+// Decodes the keys of the document at iter that name a field into value.
+// Other keys are skipped. Returns whether every field was found and read.
+template <class T, class... M>
+bool DecodeBsonFields(bson_iter_t *iter, T *value,
+                      const BsonField<T, M> &... fields);
+
+// Decodes a whole document, e.g. one returned by a MongoDB cursor.
+template <class T>
+bool DecodeBson(const bson_t *doc, T *value);
+
+bool BsonRead(const bson_iter_t *iter, int64_t *value) {
+  switch (bson_iter_type(iter)) {
+    case BSON_TYPE_INT64:
+    case BSON_TYPE_INT32:
+    case BSON_TYPE_DOUBLE:
+      *value = bson_iter_as_int64(iter);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool BsonRead(const bson_iter_t *iter, int32_t *value) {
+  int64_t value_64;
+  if (!BsonRead(iter, &value_64)) {
+    return false;
+  }
+  *value = static_cast<int32_t>(value_64);
+  return true;
+}
+
+bool BsonRead(const bson_iter_t *iter, double *value) {
+  if (!BSON_ITER_HOLDS_NUMBER(iter)) {
+    return false;
+  }
+  *value = bson_iter_as_double(iter);
+  return true;
+}
+
+bool BsonRead(const bson_iter_t *iter, bool *value) {
+  if (!BSON_ITER_HOLDS_BOOL(iter) && !BSON_ITER_HOLDS_NUMBER(iter)) {
+    return false;
+  }
+  *value = bson_iter_as_bool(iter);
+  return true;
+}
+
+bool BsonRead(const bson_iter_t *iter, std::string *value) {
+  if (!BSON_ITER_HOLDS_UTF8(iter)) {
+    return false;
+  }
+  uint32_t length;
+  const char *str = bson_iter_utf8(iter, &length);
+  value->assign(str, length);
+  return true;
+}
+
+template <class E>
+typename std::enable_if<std::is_enum<E>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, E *value) {
+  int32_t value_32;
+  if (!BsonRead(iter, &value_32)) {
+    return false;
+  }
+  *value = static_cast<E>(value_32);
+  return true;
+}
+
+template <class T>
+bool BsonRead(const bson_iter_t *iter, std::vector<T> *value) {
+  bson_iter_t child;
+  if (!BSON_ITER_HOLDS_ARRAY(iter) || !bson_iter_recurse(iter, &child)) {
+    return false;
+  }
+  value->clear();
+  while (bson_iter_next(&child)) {
+    value->emplace_back();
+    if (!BsonRead(&child, &value->back())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class T>
+typename std::enable_if<std::is_class<T>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, T *value) {
+  bson_iter_t child;
+  if (!BSON_ITER_HOLDS_DOCUMENT(iter) || !bson_iter_recurse(iter, &child)) {
+    return false;
+  }
+  return DecodeBson(&child, value);
+}
+
+template <class T, class M>
+void DecodeBsonField(const bson_iter_t *iter, const char *key, T *value,
+                     const BsonField<T, M> &field, bool *found,
+                     bool *failed) {
+  if (!*found && std::strcmp(key, field.key) == 0) {
+    *found = true;
+    *failed |= !BsonRead(iter, &(value->*field.member));
+  }
+}
+
+template <class T, class... M>
+bool DecodeBsonFields(bson_iter_t *iter, T *value,
+                      const BsonField<T, M> &... fields) {
+  bool found[sizeof...(M)] = {};
+  bool failed = false;
+  while (bson_iter_next(iter) && !failed) {
+    const char *key = bson_iter_key(iter);
+    size_t idx = 0;
+    (void)std::initializer_list<int>{
+        (DecodeBsonField(iter, key, value, fields, &found[idx++], &failed),
+         0)...};
+  }
+  for (bool field_found : found) {
+    failed |= !field_found;
+  }
+  return !failed;
+}
+
+template <class T>
+bool DecodeBson(const bson_t *doc, T *value) {
+  bson_iter_t iter;
+  return bson_iter_init(&iter, doc) && DecodeBson(&iter, value);
+}
+
+bool DecodeBson(bson_iter_t *iter, Review *review) {
+  return DecodeBsonFields(iter, review,
+                          Field("review_id", &Review::review_id),
+                          Field("user_id", &Review::user_id),
+                          Field("req_id", &Review::req_id),
+                          Field("text", &Review::text),
+                          Field("movie_id", &Review::movie_id),
+                          Field("rating", &Review::rating),
+                          Field("timestamp", &Review::timestamp));
+}
+
+bool DecodeBson(bson_iter_t *iter, CastInfo *cast_info) {
+  return DecodeBsonFields(iter, cast_info,
+                          Field("cast_info_id", &CastInfo::cast_info_id),
+                          Field("name", &CastInfo::name),
+                          Field("gender", &CastInfo::gender),
+                          Field("intro", &CastInfo::intro));
+}
+
+bool DecodeBson(bson_iter_t *iter, Cast *cast) {
+  return DecodeBsonFields(iter, cast,
+                          Field("cast_id", &Cast::cast_id),
+                          Field("character", &Cast::character),
+                          Field("cast_info_id", &Cast::cast_info_id));
+}
+
+bool DecodeBson(bson_iter_t *iter, MovieInfo *movie_info) {
+  return DecodeBsonFields(iter, movie_info,
+                          Field("movie_id", &MovieInfo::movie_id),
+                          Field("title", &MovieInfo::title),
+                          Field("casts", &MovieInfo::casts),
+                          Field("plot_id", &MovieInfo::plot_id),
+                          Field("thumbnail_ids", &MovieInfo::thumbnail_ids),
+                          Field("photo_ids", &MovieInfo::photo_ids),
+                          Field("video_ids", &MovieInfo::video_ids),
+                          Field("avg_rating", &MovieInfo::avg_rating),
+                          Field("num_rating", &MovieInfo::num_rating));
+}
+
+} // namespace media_service
+
+#endif //MEDIA_MICROSERVICES_BSONDECODER_H
@@ -11,9 +11,13 @@
 #include <bson/bson.h>
 
 #include "../../gen-cpp/CastInfoService.h"
+#include "../BsonDecoder.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
+#include "../SingleFlight.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -37,7 +41,15 @@ class CastInfoHandler : public CastInfoServiceIf {
  private:
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
+  SingleFlight<int64_t, CastInfo> _cast_info_flight{"cast-info"};
   int _extra_latency_ms;
+
+  // Reads cast-info from MongoDB and caches them in Memcached. The
+  // cast-info not found are left out.
+  SingleFlight<int64_t, CastInfo>::Results _FetchCastInfo(
+      int64_t req_id, const std::vector<int64_t> &cast_info_ids,
+      const opentracing::SpanContext &span_context);
 };
 
 CastInfoHandler::CastInfoHandler(
@@ -45,6 +57,8 @@ CastInfoHandler::CastInfoHandler(
     mongoc_client_pool_t *mongodb_client_pool) {
   _memcached_client_pool = memcached_client_pool;
   _mongodb_client_pool = mongodb_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("cast-info-memcached");
   _extra_latency_ms = ParseExtraLatency();
 }
 void CastInfoHandler::WriteCastInfo(
@@ -116,6 +130,128 @@ void CastInfoHandler::WriteCastInfo(
   span->Finish();
 }
 
+SingleFlight<int64_t, CastInfo>::Results CastInfoHandler::_FetchCastInfo(
+    int64_t req_id, const std::vector<int64_t> &cast_info_ids,
+    const opentracing::SpanContext &span_context) {
+  SingleFlight<int64_t, CastInfo>::Results cast_infos;
+  std::vector<ExecutorFuture<void>> set_futures;
+  std::map<int64_t, std::string> cast_info_json_map;
+
+  bson_t *query = bson_new();
+  bson_t query_child;
+  bson_t query_cast_info_id_list;
+  const char *key;
+  int idx = 0;
+  char buf[16];
+  BSON_APPEND_DOCUMENT_BEGIN(query, "cast_info_id", &query_child);
+  BSON_APPEND_ARRAY_BEGIN(&query_child, "$in", &query_cast_info_id_list);
+  for (auto &item : cast_info_ids) {
+    bson_uint32_to_string(idx, &key, buf, sizeof buf);
+    BSON_APPEND_INT64(&query_cast_info_id_list, key, item);
+    idx++;
+  }
+  bson_append_array_end(&query_child, &query_cast_info_id_list);
+  bson_append_document_end(query, &query_child);
+
+  mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
+      _mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+  auto collection = mongoc_client_get_collection(
+      mongodb_client, "cast-info", "cast-info");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection user from DB user";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+
+  mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
+      collection, query, nullptr, nullptr);
+  const bson_t *doc;
+
+  auto find_span = opentracing::Tracer::Global()->StartSpan(
+      "MongoFindCastInfo", {opentracing::ChildOf(&span_context)});
+
+  while (true) {
+    bool found = mongoc_cursor_next(cursor, &doc);
+    if (!found) {
+      break;
+    }
+    CastInfo new_cast_info;
+    if (!DecodeBson(doc, &new_cast_info)) {
+      LOG(error) << "Request " << req_id
+                 << " reads a cast-info that is malformed in MongoDB";
+      continue;
+    }
+    // Memcached keeps the JSON text of the document.
+    char *cast_info_json_char = bson_as_json(doc, nullptr);
+    cast_info_json_map.insert({
+      new_cast_info.cast_info_id, std::string(cast_info_json_char)});
+    cast_infos.insert({new_cast_info.cast_info_id,
+                       std::make_shared<const CastInfo>(new_cast_info)});
+    bson_free(cast_info_json_char);
+  }
+  find_span->Finish();
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor, &error)) {
+    LOG(warning) << error.message;
+    bson_destroy(query);
+    mongoc_cursor_destroy(cursor);
+    mongoc_collection_destroy(collection);
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = error.message;
+    throw se;
+  }
+  bson_destroy(query);
+  mongoc_cursor_destroy(cursor);
+  mongoc_collection_destroy(collection);
+  mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+
+  // Upload cast-info to memcached
+  set_futures.emplace_back(Executor::GetInstance()->Submit([&]() {
+    memcached_return_t _rc;
+    auto _memcached_client = memcached_pool_pop(
+        _memcached_client_pool, true, &_rc);
+    if (!_memcached_client) {
+      LOG(error) << "Failed to pop a client from memcached pool";
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
+      se.message = "Failed to pop a client from memcached pool";
+      throw se;
+    }
+    auto set_span = opentracing::Tracer::Global()->StartSpan(
+        "MmcSetCastInfo", {opentracing::ChildOf(&span_context)});
+    for (auto & it : cast_info_json_map) {
+      std::string id_str = std::to_string(it.first);
+      _rc = memcached_set(
+          _memcached_client,
+          id_str.c_str(),
+          id_str.length(),
+          it.second.c_str(),
+          it.second.length(),
+          static_cast<time_t>(0),
+          static_cast<uint32_t>(0));
+    }
+    memcached_pool_push(_memcached_client_pool, _memcached_client);
+    set_span->Finish();
+  }));
+
+  try {
+    for (auto &it : set_futures) { it.get(); }
+  } catch (...) {
+    LOG(warning) << "Failed to set cast-info to memcached";
+  }
+  return cast_infos;
+}
+
 void CastInfoHandler::ReadCastInfo(
     std::vector<CastInfo> &_return,
     int64_t req_id,
@@ -218,130 +354,26 @@ void CastInfoHandler::ReadCastInfo(
   get_span->Finish();
   memcached_quit(memcached_client);
   memcached_pool_push(_memcached_client_pool, memcached_client);
+  *_cache_metrics.hits += return_map.size();
+  *_cache_metrics.misses += cast_info_ids_not_cached.size();
   for (int i = 0; i < cast_info_ids.size(); ++i) {
     delete keys[i];
   }
   delete[] keys;
   delete[] key_sizes;
 
-  std::vector<std::future<void>> set_futures;
-  std::map<int64_t, std::string> cast_info_json_map;
-
-  // Find the rest in MongoDB
+  // Find the rest in MongoDB. Concurrent misses of a cast-info share one read.
   if (!cast_info_ids_not_cached.empty()) {
-    bson_t *query = bson_new();
-    bson_t query_child;
-    bson_t query_cast_info_id_list;
-    const char *key;
-    idx = 0;
-    char buf[16];
-    BSON_APPEND_DOCUMENT_BEGIN(query, "cast_info_id", &query_child);
-    BSON_APPEND_ARRAY_BEGIN(&query_child, "$in", &query_cast_info_id_list);
-    for (auto &item : cast_info_ids_not_cached) {
-      bson_uint32_to_string(idx, &key, buf, sizeof buf);
-      BSON_APPEND_INT64(&query_cast_info_id_list, key, item);
-      idx++;
-    }
-    bson_append_array_end(&query_child, &query_cast_info_id_list);
-    bson_append_document_end(query, &query_child);
-
-    mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
-        _mongodb_client_pool);
-    if (!mongodb_client) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to pop a client from MongoDB pool";
-      throw se;
-    }
-    auto collection = mongoc_client_get_collection(
-        mongodb_client, "cast-info", "cast-info");
-    if (!collection) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to create collection user from DB user";
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      throw se;
-    }
-
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        collection, query, nullptr, nullptr);
-    const bson_t *doc;
-
-    auto find_span = opentracing::Tracer::Global()->StartSpan(
-        "MongoFindCastInfo", {opentracing::ChildOf(&span->context())});
-
-    while (true) {
-      bool found = mongoc_cursor_next(cursor, &doc);
-      if (!found) {
-        break;
-      }
-      bson_iter_t iter;
-      CastInfo new_cast_info;
-      char *cast_info_json_char = bson_as_json(doc, nullptr);
-      json cast_info_json = json::parse(cast_info_json_char);
-      new_cast_info.cast_info_id = cast_info_json["cast_info_id"];
-      new_cast_info.gender = cast_info_json["gender"];
-      new_cast_info.name = cast_info_json["name"];
-      new_cast_info.intro = cast_info_json["intro"];
-      cast_info_json_map.insert({
-        new_cast_info.cast_info_id, std::string(cast_info_json_char)});
-      return_map.insert({new_cast_info.cast_info_id, new_cast_info});
-      bson_free(cast_info_json_char);
+    auto fetched = _cast_info_flight.DoMany(
+        cast_info_ids_not_cached, [&](const std::vector<int64_t> &fetch_ids) {
+          return _FetchCastInfo(req_id, fetch_ids, span->context());
+        });
+    for (auto &it : fetched) {
+      return_map.emplace(it.first, *it.second);
     }
-    find_span->Finish();
-    bson_error_t error;
-    if (mongoc_cursor_error(cursor, &error)) {
-      LOG(warning) << error.message;
-      bson_destroy(query);
-      mongoc_cursor_destroy(cursor);
-      mongoc_collection_destroy(collection);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = error.message;
-      throw se;
-    }
-    bson_destroy(query);
-    mongoc_cursor_destroy(cursor);
-    mongoc_collection_destroy(collection);
-    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-
-    // Upload cast-info to memcached
-    set_futures.emplace_back(std::async(std::launch::async, [&]() {
-      memcached_return_t _rc;
-      auto _memcached_client = memcached_pool_pop(
-          _memcached_client_pool, true, &_rc);
-      if (!_memcached_client) {
-        LOG(error) << "Failed to pop a client from memcached pool";
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
-        se.message = "Failed to pop a client from memcached pool";
-        throw se;
-      }
-      auto set_span = opentracing::Tracer::Global()->StartSpan(
-          "MmcSetCastInfo", {opentracing::ChildOf(&span->context())});
-      for (auto & it : cast_info_json_map) {
-        std::string id_str = std::to_string(it.first);
-        _rc = memcached_set(
-            _memcached_client,
-            id_str.c_str(),
-            id_str.length(),
-            it.second.c_str(),
-            it.second.length(),
-            static_cast<time_t>(0),
-            static_cast<uint32_t>(0));
-      }
-      memcached_pool_push(_memcached_client_pool, _memcached_client);
-      set_span->Finish();
-    }));
   }
 
   if (return_map.size() != cast_info_ids.size()) {
-    try {
-      for (auto &it : set_futures) { it.get(); }
-    } catch (...) {
-      LOG(warning) << "Failed to set cast-info to memcached";
-    }
     LOG(error) << "cast-info-service return set incomplete";
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
@@ -352,12 +384,6 @@ void CastInfoHandler::ReadCastInfo(
   for (auto &cast_info_id : cast_info_ids) {
     _return.emplace_back(return_map[cast_info_id]);
   }
-
-  try {
-    for (auto &it : set_futures) { it.get(); }
-  } catch (...) {
-    LOG(warning) << "Failed to set cast-info to memcached";
-  }
 }
 
 } // namespace media_service
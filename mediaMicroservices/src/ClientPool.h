@@ -1,22 +1,34 @@
 #ifndef MEDIA_MICROSERVICES_CLIENTPOOL_H
 #define MEDIA_MICROSERVICES_CLIENTPOOL_H
 
+#include <sched.h>
+
+#include <atomic>
 #include <vector>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
 #include <chrono>
 #include <string>
+#include <thread>
 
 #include "logger.h"
+#include "Metrics.h"
 
 namespace media_service {
 
+// When the pool is split into several shards, a waiter re-scans the other
+// shards at this interval in case a client was pushed to a shard it is not
+// sleeping on.
+#define CLIENT_POOL_STEAL_INTERVAL_MS 5
+
 template<class TClient>
 class ClientPool {
  public:
   ClientPool(const std::string &client_type, const std::string &addr,
-      int port, int min_size, int max_size, int timeout_ms);
+      int port, int min_size, int max_size, int timeout_ms,
+      int num_shards = 1);
   ~ClientPool();
 
   ClientPool(const ClientPool&) = delete;
@@ -30,120 +42,227 @@ class ClientPool {
   void Remove(TClient *);
 
  private:
-  std::deque<TClient *> _pool;
+  // Each shard owns a free list guarded by its own lock, so threads running
+  // on different cores do not contend on a single mutex.
+  struct Shard {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<TClient *> pool;
+    std::atomic<int> waiters{0};
+  };
+
+  size_t _HomeShard() const;
+  size_t _WaitingShard(size_t home_idx) const;
+  TClient * _TryPop(size_t shard_idx, bool blocking);
+  bool _TryGrow();
+  void _PushToShard(TClient *);
+
+  std::vector<std::unique_ptr<Shard>> _shards;
   std::string _addr;
   std::string _client_type;
   int _port;
   int _min_pool_size{};
   int _max_pool_size{};
-  int _curr_pool_size{};
+  std::atomic<int> _curr_pool_size{};
   int _timeout_ms;
-  std::mutex _mtx;
-  std::condition_variable _cv;
 
+  Histogram *_wait_us;
+  std::atomic<long> *_timeouts;
 };
 
 template<class TClient>
 ClientPool<TClient>::ClientPool(const std::string &client_type,
     const std::string &addr, int port, int min_pool_size,
-    int max_pool_size, int timeout_ms) {
+    int max_pool_size, int timeout_ms, int num_shards) {
   _addr = addr;
   _port = port;
   _min_pool_size = min_pool_size;
   _max_pool_size = max_pool_size;
   _timeout_ms = timeout_ms;
   _client_type = client_type;
+  _wait_us = Metrics::GetInstance()->GetHistogram(
+      "client_pool_wait_us", MetricLabel("pool", client_type));
+  _timeouts = Metrics::GetInstance()->GetCounter(
+      "client_pool_timeouts_total", MetricLabel("pool", client_type));
+
+  if (num_shards < 1) {
+    num_shards = 1;
+  }
+  for (int i = 0; i < num_shards; ++i) {
+    _shards.emplace_back(new Shard());
+  }
 
   for (int i = 0; i < min_pool_size; ++i) {
     TClient *client = new TClient(addr, port);
-    _pool.emplace_back(client);
+    _shards[i % num_shards]->pool.emplace_back(client);
   }
   _curr_pool_size = min_pool_size;
 }
 
 template<class TClient>
 ClientPool<TClient>::~ClientPool() {
-  while (!_pool.empty()) {
-    delete _pool.front();
-    _pool.pop_front();
+  for (auto &shard : _shards) {
+    while (!shard->pool.empty()) {
+      delete shard->pool.front();
+      shard->pool.pop_front();
+    }
+  }
+}
+
+template<class TClient>
+size_t ClientPool<TClient>::_HomeShard() const {
+  if (_shards.size() == 1) {
+    return 0;
   }
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return static_cast<size_t>(cpu) % _shards.size();
+  }
+  return std::hash<std::thread::id>()(std::this_thread::get_id()) %
+      _shards.size();
+}
+
+template<class TClient>
+size_t ClientPool<TClient>::_WaitingShard(size_t home_idx) const {
+  for (size_t i = 0; i < _shards.size(); ++i) {
+    size_t idx = (home_idx + i) % _shards.size();
+    if (_shards[idx]->waiters.load() > 0) {
+      return idx;
+    }
+  }
+  return home_idx;
+}
+
+template<class TClient>
+TClient * ClientPool<TClient>::_TryPop(size_t shard_idx, bool blocking) {
+  Shard &shard = *_shards[shard_idx];
+  std::unique_lock<std::mutex> lock(shard.mtx, std::defer_lock);
+  if (blocking) {
+    lock.lock();
+  } else if (!lock.try_lock()) {
+    return nullptr;
+  }
+  if (shard.pool.empty()) {
+    return nullptr;
+  }
+  TClient *client = shard.pool.front();
+  shard.pool.pop_front();
+  return client;
+}
+
+template<class TClient>
+bool ClientPool<TClient>::_TryGrow() {
+  int curr = _curr_pool_size.load();
+  while (curr < _max_pool_size) {
+    if (_curr_pool_size.compare_exchange_weak(curr, curr + 1)) {
+      return true;
+    }
+  }
+  return false;
 }
 
 template<class TClient>
 TClient * ClientPool<TClient>::Pop() {
   TClient * client = nullptr;
-  std::unique_lock<std::mutex> cv_lock(_mtx); {
-    while (_pool.size() == 0) {
-      // Create a new a client if current pool size is less than
-      // the max pool size.
-      if (_curr_pool_size < _max_pool_size) {
-        try {
-          client = new TClient(_addr, _port);
-          _curr_pool_size++;
-          break;
-        } catch (...) {
-          cv_lock.unlock();
-          return nullptr;
-        }
-      } else {
-        auto wait_time = std::chrono::system_clock::now() +
-            std::chrono::milliseconds(_timeout_ms);
-        bool wait_success = _cv.wait_until(cv_lock, wait_time,
-            [this] { return _pool.size() > 0; });
-        if (!wait_success) {
-          LOG(warning) << "ClientPool pop timeout";
-          cv_lock.unlock();
-          return nullptr;
-        }
-      }
+  size_t home_idx = _HomeShard();
+  size_t num_shards = _shards.size();
+  auto start = std::chrono::steady_clock::now();
+  auto deadline = std::chrono::system_clock::now() +
+      std::chrono::milliseconds(_timeout_ms);
+
+  while (!client) {
+    // Take an idle client from the home shard first, then steal from others.
+    client = _TryPop(home_idx, true);
+    for (size_t i = 1; !client && i < num_shards; ++i) {
+      client = _TryPop((home_idx + i) % num_shards, false);
     }
-    if (!client){
-      client = _pool.front();
-      _pool.pop_front();
+    if (client) {
+      break;
     }
 
-  } // cv_lock(_mtx)
-  cv_lock.unlock();
+    // Create a new a client if current pool size is less than
+    // the max pool size.
+    if (_TryGrow()) {
+      try {
+        client = new TClient(_addr, _port);
+      } catch (...) {
+        _curr_pool_size--;
+        return nullptr;
+      }
+      break;
+    }
+
+    Shard &home = *_shards[home_idx];
+    std::unique_lock<std::mutex> cv_lock(home.mtx);
+    auto wait_time = deadline;
+    if (num_shards > 1) {
+      wait_time = std::min(deadline, std::chrono::system_clock::now() +
+          std::chrono::milliseconds(CLIENT_POOL_STEAL_INTERVAL_MS));
+    }
+    home.waiters++;
+    bool wait_success = home.cv.wait_until(cv_lock, wait_time,
+        [&] { return home.pool.size() > 0 ||
+            _curr_pool_size.load() < _max_pool_size; });
+    home.waiters--;
+    if (!wait_success && std::chrono::system_clock::now() >= deadline) {
+      (*_timeouts)++;
+      LOG(warning) << "ClientPool pop timeout";
+      return nullptr;
+    }
+    if (home.pool.size() > 0) {
+      client = home.pool.front();
+      home.pool.pop_front();
+    }
+  }
+  _wait_us->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
 
   if (client) {
     try {
       client->Connect();
     } catch (...) {
       LOG(error) << "Failed to connect " + _client_type;
-      _pool.push_back(client);
+      _PushToShard(client);
       throw;
-    }    
+    }
   }
   return client;
 }
 
+template<class TClient>
+void ClientPool<TClient>::_PushToShard(TClient *client) {
+  // Hand the client to a shard that has a waiter, falling back to the
+  // caller's home shard.
+  Shard &shard = *_shards[_WaitingShard(_HomeShard())];
+  std::unique_lock<std::mutex> cv_lock(shard.mtx);
+  shard.pool.push_back(client);
+  cv_lock.unlock();
+  shard.cv.notify_one();
+}
+
 template<class TClient>
 void ClientPool<TClient>::Push(TClient *client) {
-  std::unique_lock<std::mutex> cv_lock(_mtx);
   client->KeepAlive();
-  _pool.push_back(client);
-  cv_lock.unlock();
-  _cv.notify_one();
+  _PushToShard(client);
 }
 
 template<class TClient>
 void ClientPool<TClient>::Push(TClient *client, int timeout_ms) {
-  std::unique_lock<std::mutex> cv_lock(_mtx);
   client->KeepAlive(timeout_ms);
-  _pool.push_back(client);
-  cv_lock.unlock();
-  _cv.notify_one();
+  _PushToShard(client);
 }
 
 template<class TClient>
 void ClientPool<TClient>::Remove(TClient *client) {
-  std::unique_lock<std::mutex> lock(_mtx);
   delete client;
   _curr_pool_size--;
-  lock.unlock();
+  Shard &shard = *_shards[_WaitingShard(_HomeShard())];
+  std::unique_lock<std::mutex> cv_lock(shard.mtx);
+  cv_lock.unlock();
+  shard.cv.notify_one();
 }
 
 } // namespace media_service
 
 
-#endif //MEDIA_MICROSERVICES_CLIENTPOOL_H
\ No newline at end of file
+#endif //MEDIA_MICROSERVICES_CLIENTPOOL_H
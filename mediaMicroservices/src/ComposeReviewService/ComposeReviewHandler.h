@@ -15,6 +15,7 @@
 #include "../../gen-cpp/UserReviewService.h"
 #include "../../gen-cpp/MovieReviewService.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
 #include "../tracing.h"
@@ -185,11 +186,11 @@ void ComposeReviewHandler::_ComposeAndUpload(
       system_clock::now().time_since_epoch()).count();
   new_review.req_id = req_id;
 
-  std::future<void> review_future;
-  std::future<void> user_review_future;
-  std::future<void> movie_review_future;
+  ExecutorFuture<void> review_future;
+  ExecutorFuture<void> user_review_future;
+  ExecutorFuture<void> movie_review_future;
   
-  review_future = std::async(std::launch::async, [&](){
+  review_future = Executor::GetInstance()->Submit([&](){
     auto review_storage_client_wrapper = _review_storage_client_pool->Pop();
     if (!review_storage_client_wrapper) {
       ServiceException se;
@@ -208,7 +209,7 @@ void ComposeReviewHandler::_ComposeAndUpload(
     _review_storage_client_pool->Push(review_storage_client_wrapper);
   });
 
-  user_review_future = std::async(std::launch::async, [&](){
+  user_review_future = Executor::GetInstance()->Submit([&](){
     auto user_review_client_wrapper = _user_review_client_pool->Pop();
     if (!user_review_client_wrapper) {
       ServiceException se;
@@ -228,7 +229,7 @@ void ComposeReviewHandler::_ComposeAndUpload(
     _user_review_client_pool->Push(user_review_client_wrapper);
   });
 
-  movie_review_future = std::async(std::launch::async, [&](){
+  movie_review_future = Executor::GetInstance()->Submit([&](){
     auto movie_review_client_wrapper = _movie_review_client_pool->Pop();
     if (!movie_review_client_wrapper) {
       ServiceException se;
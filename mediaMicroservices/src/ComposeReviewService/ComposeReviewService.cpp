@@ -1,18 +1,11 @@
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
 #include <signal.h>
 
 #include "ComposeReviewHandler.h"
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "../utils_memcached.h"
 
 using json = nlohmann::json;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 void sigintHandler(int sig) {
@@ -60,19 +53,17 @@ int main(int argc, char *argv[]) {
   auto memcached_client_pool = memcached_pool_create(
       memcached_client, MEMCACHED_POOL_MIN_SIZE, MEMCACHED_POOL_MAX_SIZE);
 
-  TThreadedServer server(
+  std::shared_ptr<ComposeReviewServiceProcessor> processor =
       std::make_shared<ComposeReviewServiceProcessor>(
           std::make_shared<ComposeReviewHandler>(
               memcached_client_pool,
               &compose_client_pool,
               &user_client_pool,
-              &movie_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &movie_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "compose-review-service", processor, "0.0.0.0", port);
   std::cout << "Starting the compose-review-service server ..." << std::endl;
-  server.serve();
+  server->serve();
 }
 
 
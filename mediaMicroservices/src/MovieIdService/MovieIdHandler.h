@@ -14,8 +14,10 @@
 #include "../../gen-cpp/ComposeReviewService.h"
 #include "../../gen-cpp/RatingService.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -38,6 +40,7 @@ class MovieIdHandler : public MovieIdServiceIf {
  private:
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
   ClientPool<ThriftClient<ComposeReviewServiceClient>> *_compose_client_pool;
   ClientPool<ThriftClient<RatingServiceClient>> *_rating_client_pool;
   int _extra_latency_ms;
@@ -50,6 +53,8 @@ MovieIdHandler::MovieIdHandler(
     ClientPool<ThriftClient<RatingServiceClient>> *rating_client_pool) {
   _memcached_client_pool = memcached_client_pool;
   _mongodb_client_pool = mongodb_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("movie-id-memcached");
   _compose_client_pool = compose_client_pool;
   _rating_client_pool = rating_client_pool;
   _extra_latency_ms = ParseExtraLatency();
@@ -111,6 +116,7 @@ void MovieIdHandler::UploadMovieId(
 
   // If cached in memcached
   if (movie_id_mmc) {
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Get movie_id " << movie_id_mmc
         << " cache hit from Memcached";
     movie_id_str = std::string(movie_id_mmc);
@@ -119,6 +125,7 @@ void MovieIdHandler::UploadMovieId(
 
     // If not cached in memcached
   else {
+    (*_cache_metrics.misses)++;
     mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
         _mongodb_client_pool);
     if (!mongodb_client) {
@@ -186,10 +193,10 @@ void MovieIdHandler::UploadMovieId(
     mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
   }
   
-  std::future<void> set_future;
-  std::future<void> movie_id_future;
-  std::future<void> rating_future;
-  set_future = std::async(std::launch::async, [&]() {
+  ExecutorFuture<void> set_future;
+  ExecutorFuture<void> movie_id_future;
+  ExecutorFuture<void> rating_future;
+  set_future = Executor::GetInstance()->Submit([&]() {
     memcached_client = memcached_pool_pop(
         _memcached_client_pool, true, &memcached_rc);
     auto set_span = opentracing::Tracer::Global()->StartSpan(
@@ -212,7 +219,7 @@ void MovieIdHandler::UploadMovieId(
     memcached_pool_push(_memcached_client_pool, memcached_client);    
   });
 
-  movie_id_future = std::async(std::launch::async, [&]() {
+  movie_id_future = Executor::GetInstance()->Submit([&]() {
     auto compose_client_wrapper = _compose_client_pool->Pop();
     if (!compose_client_wrapper) {
       ServiceException se;
@@ -231,7 +238,7 @@ void MovieIdHandler::UploadMovieId(
     _compose_client_pool->Push(compose_client_wrapper);
   });
 
-  rating_future = std::async(std::launch::async, [&]() {
+  rating_future = Executor::GetInstance()->Submit([&]() {
     auto rating_client_wrapper = _rating_client_pool->Pop();
     if (!rating_client_wrapper) {
       ServiceException se;
@@ -1,19 +1,12 @@
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
 #include <signal.h>
 
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "../utils_memcached.h"
 #include "../utils_mongodb.h"
 #include "MovieIdHandler.h"
 
 using json = nlohmann::json;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 void sigintHandler(int sig) {
@@ -67,17 +60,15 @@ int main(int argc, char *argv[]) {
   }
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
 
-  TThreadedServer server(
+  std::shared_ptr<MovieIdServiceProcessor> processor =
       std::make_shared<MovieIdServiceProcessor>(
       std::make_shared<MovieIdHandler>(
               memcached_client_pool, mongodb_client_pool,
-              &compose_client_pool, &rating_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &compose_client_pool, &rating_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "movie-id-service", processor, "0.0.0.0", port);
   std::cout << "Starting the movie-id-service server ..." << std::endl;
-  server.serve();
+  server->serve();
 }
 
 
@@ -11,7 +11,10 @@
 #include <nlohmann/json.hpp>
 
 #include "../../gen-cpp/MovieInfoService.h"
+#include "../BsonDecoder.h"
 #include "../logger.h"
+#include "../Metrics.h"
+#include "../SingleFlight.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -42,7 +45,14 @@ class MovieInfoHandler : public MovieInfoServiceIf {
  private:
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
+  SingleFlight<std::string, MovieInfo> _movie_info_flight{"movie-info"};
   int _extra_latency_ms;
+
+  // Reads the movie-info from MongoDB and caches it in Memcached.
+  std::shared_ptr<const MovieInfo> _FetchMovieInfo(
+      const std::string &movie_id,
+      const opentracing::SpanContext &span_context);
 };
 
 MovieInfoHandler::MovieInfoHandler(
@@ -50,6 +60,8 @@ MovieInfoHandler::MovieInfoHandler(
     mongoc_client_pool_t *mongodb_client_pool) {
   _memcached_client_pool = memcached_client_pool;
   _mongodb_client_pool = mongodb_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("movie-info-memcached");
   _extra_latency_ms = ParseExtraLatency();
 }
 
@@ -174,6 +186,112 @@ void MovieInfoHandler::WriteMovieInfo(
   span->Finish();
 }
 
+std::shared_ptr<const MovieInfo> MovieInfoHandler::_FetchMovieInfo(
+    const std::string &movie_id,
+    const opentracing::SpanContext &span_context) {
+  mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
+      _mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+
+  auto collection = mongoc_client_get_collection(
+      mongodb_client, "movie-info", "movie-info");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection user from DB user";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+  bson_t *query = bson_new();
+  BSON_APPEND_UTF8(query, "movie_id", movie_id.c_str());
+  auto find_span = opentracing::Tracer::Global()->StartSpan(
+      "MongoFindMovieInfo", { opentracing::ChildOf(&span_context) });
+  mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
+      collection, query, nullptr, nullptr);
+  const bson_t *doc;
+  bool found = mongoc_cursor_next(cursor, &doc);
+  find_span->Finish();
+  if (!found) {
+    bson_error_t error;
+    if (mongoc_cursor_error (cursor, &error)) {
+      LOG(warning) << error.message;
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+      se.message = error.message;
+      throw se;
+    } else {
+      LOG(warning) << "Movie_id: " << movie_id << " doesn't exist in MongoDB";
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
+      se.message = "Movie_id: " + movie_id + " doesn't exist in MongoDB";
+      throw se;
+    }
+  } else {
+    LOG(debug) << "Movie_id: " << movie_id << " found in MongoDB";
+    auto movie_info = std::make_shared<MovieInfo>();
+    if (!DecodeBson(doc, movie_info.get())) {
+      LOG(error) << "Movie_id: " << movie_id << " is malformed in MongoDB";
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+      se.message = "Attribute of MongoDB item is not complete";
+      throw se;
+    }
+    // Memcached keeps the JSON text of the document.
+    auto movie_info_json_char = bson_as_json(doc, nullptr);
+    bson_destroy(query);
+    mongoc_cursor_destroy(cursor);
+    mongoc_collection_destroy(collection);
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+
+    // upload movie-info to memcached
+    memcached_return_t memcached_rc;
+    memcached_st *memcached_client = memcached_pool_pop(
+        _memcached_client_pool, true, &memcached_rc);
+    if (!memcached_client) {
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
+      se.message = "Failed to pop a client from memcached pool";
+      throw se;
+    }
+    auto set_span = opentracing::Tracer::Global()->StartSpan(
+        "MmcSetMovieInfo", { opentracing::ChildOf(&span_context) });
+
+    memcached_rc = memcached_set(
+        memcached_client,
+        movie_id.c_str(),
+        movie_id.length(),
+        movie_info_json_char,
+        std::strlen(movie_info_json_char),
+        static_cast<time_t>(0),
+        static_cast<uint32_t>(0));
+    if (memcached_rc != MEMCACHED_SUCCESS) {
+      LOG(warning) << "Failed to set movie_info to Memcached: "
+                   << memcached_strerror(memcached_client, memcached_rc);
+    }
+    set_span->Finish();
+    bson_free(movie_info_json_char);
+    memcached_pool_push(_memcached_client_pool, memcached_client);
+    return movie_info;
+  }
+}
+
 void MovieInfoHandler::ReadMovieInfo(
     MovieInfo &_return,
     int64_t req_id,
@@ -225,6 +343,7 @@ void MovieInfoHandler::ReadMovieInfo(
   get_span->Finish();
 
   if (movie_info_mmc) {
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Get movie-info " << movie_id << " cache hit from Memcached";
     json movie_info_json = json::parse(std::string(
         movie_info_mmc, movie_info_mmc + movie_info_mmc_size));
@@ -251,115 +370,11 @@ void MovieInfoHandler::ReadMovieInfo(
     }
     free(movie_info_mmc);
   } else {
-    // If not cached in memcached
-    mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
-        _mongodb_client_pool);
-    if (!mongodb_client) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to pop a client from MongoDB pool";
-      throw se;
-    }
-
-    auto collection = mongoc_client_get_collection(
-        mongodb_client, "movie-info", "movie-info");
-    if (!collection) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to create collection user from DB user";
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      throw se;
-    }
-    bson_t *query = bson_new();
-    BSON_APPEND_UTF8(query, "movie_id", movie_id.c_str());
-    auto find_span = opentracing::Tracer::Global()->StartSpan(
-        "MongoFindMovieInfo", { opentracing::ChildOf(&span->context()) });
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        collection, query, nullptr, nullptr);
-    const bson_t *doc;
-    bool found = mongoc_cursor_next(cursor, &doc);
-    find_span->Finish();
-    if (!found) {
-      bson_error_t error;
-      if (mongoc_cursor_error (cursor, &error)) {
-        LOG(warning) << error.message;
-        bson_destroy(query);
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-        se.message = error.message;
-        throw se;
-      } else {
-        LOG(warning) << "Movie_id: " << movie_id << " doesn't exist in MongoDB";
-        bson_destroy(query);
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
-        se.message = "Movie_id: " + movie_id + " doesn't exist in MongoDB";
-        throw se;
-      }
-    } else {
-      LOG(debug) << "Movie_id: " << movie_id << " found in MongoDB";
-      auto movie_info_json_char = bson_as_json(doc, nullptr);
-      json movie_info_json = json::parse(movie_info_json_char);
-      _return.movie_id = movie_info_json["movie_id"];
-      _return.title = movie_info_json["title"];
-      _return.avg_rating = movie_info_json["avg_rating"];
-      _return.num_rating = movie_info_json["num_rating"];
-      _return.plot_id = movie_info_json["plot_id"];
-      for (auto &item : movie_info_json["photo_ids"]) {
-        _return.photo_ids.emplace_back(item);
-      }
-      for (auto &item : movie_info_json["video_ids"]) {
-        _return.video_ids.emplace_back(item);
-      }
-      for (auto &item : movie_info_json["thumbnail_ids"]) {
-        _return.thumbnail_ids.emplace_back(item);
-      }
-      for (auto &item : movie_info_json["casts"]) {
-        Cast new_cast;
-        new_cast.cast_id = item["cast_id"];
-        new_cast.cast_info_id = item["cast_info_id"];
-        new_cast.character = item["character"];
-        _return.casts.emplace_back(new_cast);
-      }
-      bson_destroy(query);
-      mongoc_cursor_destroy(cursor);
-      mongoc_collection_destroy(collection);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-
-      // upload movie-info to memcached
-      memcached_client = memcached_pool_pop(
-          _memcached_client_pool, true, &memcached_rc);
-      if (!memcached_client) {
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
-        se.message = "Failed to pop a client from memcached pool";
-        throw se;
-      }
-      auto set_span = opentracing::Tracer::Global()->StartSpan(
-          "MmcSetMovieInfo", { opentracing::ChildOf(&span->context()) });
-
-      memcached_rc = memcached_set(
-          memcached_client,
-          movie_id.c_str(),
-          movie_id.length(),
-          movie_info_json_char,
-          std::strlen(movie_info_json_char),
-          static_cast<time_t>(0),
-          static_cast<uint32_t>(0));
-      if (memcached_rc != MEMCACHED_SUCCESS) {
-        LOG(warning) << "Failed to set movie_info to Memcached: "
-                     << memcached_strerror(memcached_client, memcached_rc);
-      }
-      set_span->Finish();
-      bson_free(movie_info_json_char);
-      memcached_pool_push(_memcached_client_pool, memcached_client);
-    }
+    (*_cache_metrics.misses)++;
+    // Concurrent misses of the movie-info share one read from MongoDB.
+    _return = *_movie_info_flight.Do(movie_id, [&]() {
+      return _FetchMovieInfo(movie_id, span->context());
+    });
   }
   span->Finish();
 }
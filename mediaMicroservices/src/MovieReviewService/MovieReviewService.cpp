@@ -1,17 +1,10 @@
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
 #include <signal.h>
 
 #include "MovieReviewHandler.h"
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "../utils_mongodb.h"
 
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using media_service::MovieReviewHandler;
 using namespace media_service;
 
@@ -65,17 +58,15 @@ int main(int argc, char *argv[]) {
   }
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
 
-  TThreadedServer server(
+  std::shared_ptr<MovieReviewServiceProcessor> processor =
       std::make_shared<MovieReviewServiceProcessor>(
           std::make_shared<MovieReviewHandler>(
               &redis_client_pool,
               mongodb_client_pool,
-              &review_storage_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &review_storage_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "movie-review-service", processor, "0.0.0.0", port);
   std::cout << "Starting the movie-review-service server ..." << std::endl;
-  server.serve();
+  server->serve();
 
 }
\ No newline at end of file
@@ -13,6 +13,7 @@
 #include "../logger.h"
 #include "../tracing.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
 #include "../ThriftClient.h"
 #include "../utils.h"
 
@@ -71,12 +72,12 @@ void PageHandler::ReadPage(
       { opentracing::ChildOf(parent_span->get()) });
   opentracing::Tracer::Global()->Inject(span->context(), writer);
 
-  std::future<std::vector<Review>> movie_review_future;
-  std::future<MovieInfo> movie_info_future;
-  std::future<std::vector<CastInfo>> cast_info_future;
-  std::future<std::string> plot_future;
+  ExecutorFuture<std::vector<Review>> movie_review_future;
+  ExecutorFuture<MovieInfo> movie_info_future;
+  ExecutorFuture<std::vector<CastInfo>> cast_info_future;
+  ExecutorFuture<std::string> plot_future;
 
-  movie_info_future = std::async(std::launch::async, [&](){
+  movie_info_future = Executor::GetInstance()->Submit([&](){
     MovieInfo _reture_movie_info;
     auto movie_info_client_wrapper = _movie_info_client_pool->Pop();
     if (!movie_info_client_wrapper) {
@@ -98,7 +99,7 @@ void PageHandler::ReadPage(
     return _reture_movie_info;
   });
 
-  movie_review_future = std::async(std::launch::async, [&](){
+  movie_review_future = Executor::GetInstance()->Submit([&](){
     std::vector<Review> _return_movie_reviews;
     auto movie_review_client_wrapper = _movie_review_client_pool->Pop();
     if (!movie_review_client_wrapper) {
@@ -131,7 +132,7 @@ void PageHandler::ReadPage(
     cast_info_ids.emplace_back(cast.cast_info_id);
   }
 
-  cast_info_future = std::async(std::launch::async, [&](){
+  cast_info_future = Executor::GetInstance()->Submit([&](){
     std::vector<CastInfo> _return_cast_infos;
     auto cast_info_client_wrapper = _cast_info_client_pool->Pop();
     if (!cast_info_client_wrapper) {
@@ -153,7 +154,7 @@ void PageHandler::ReadPage(
     return _return_cast_infos;
   });
 
-  plot_future = std::async(std::launch::async, [&](){
+  plot_future = Executor::GetInstance()->Submit([&](){
     std::string _return_plot;
     auto plot_client_wrapper = _plot_client_pool->Pop();
     if (!plot_client_wrapper) {
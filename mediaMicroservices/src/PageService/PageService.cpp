@@ -1,17 +1,10 @@
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
 #include <signal.h>
 
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "PageHandler.h"
 
 using json = nlohmann::json;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 void sigintHandler(int sig) {
@@ -51,17 +44,15 @@ int main(int argc, char *argv[]) {
   ClientPool<ThriftClient<PlotServiceClient>>
       plot_client_pool("plot-client", plot_addr, plot_port, 0, 128, 1000);
 
-  TThreadedServer server(
+  std::shared_ptr<PageServiceProcessor> processor =
       std::make_shared<PageServiceProcessor>(
           std::make_shared<PageHandler>(
               &movie_review_client_pool,
               &movie_info_client_pool,
               &cast_info_client_pool,
-              &plot_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &plot_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "page-service", processor, "0.0.0.0", port);
   std::cout << "Starting the page-service server ..." << std::endl;
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
@@ -11,6 +11,8 @@
 
 #include "../../gen-cpp/PlotService.h"
 #include "../logger.h"
+#include "../Metrics.h"
+#include "../SingleFlight.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -31,7 +33,13 @@ class PlotHandler : public PlotServiceIf {
  private:
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
+  SingleFlight<int64_t, std::string> _plot_flight{"plot"};
   int _extra_latency_ms;
+
+  // Reads the plot from MongoDB and caches it in Memcached.
+  std::shared_ptr<const std::string> _FetchPlot(
+      int64_t plot_id, const opentracing::SpanContext &span_context);
 };
 
 PlotHandler::PlotHandler(
@@ -39,9 +47,103 @@ PlotHandler::PlotHandler(
     mongoc_client_pool_t *mongodb_client_pool) {
   _memcached_client_pool = memcached_client_pool;
   _mongodb_client_pool = mongodb_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("plot-memcached");
   _extra_latency_ms = ParseExtraLatency();
 }
 
+std::shared_ptr<const std::string> PlotHandler::_FetchPlot(
+    int64_t plot_id, const opentracing::SpanContext &span_context) {
+  auto plot_id_str = std::to_string(plot_id);
+  mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
+      _mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+  auto collection = mongoc_client_get_collection(
+      mongodb_client, "plot", "plot");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection plot from DB plot";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+
+  bson_t *query = bson_new();
+  BSON_APPEND_INT64(query, "plot_id", plot_id);
+
+  auto find_span = opentracing::Tracer::Global()->StartSpan(
+      "MongoFindPlot", { opentracing::ChildOf(&span_context) });
+  mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
+      collection, query, nullptr, nullptr);
+  const bson_t *doc;
+  bool found = mongoc_cursor_next(cursor, &doc);
+  find_span->Finish();
+
+  if (found) {
+    bson_iter_t iter;
+    if (bson_iter_init_find(&iter, doc, "plot")) {
+      char *plot_mongo_char = bson_iter_value(&iter)->value.v_utf8.str;
+      size_t plot_mongo_len = bson_iter_value(&iter)->value.v_utf8.len;
+      LOG(debug) << "Find plot " << plot_id << " cache miss";
+      auto plot = std::make_shared<const std::string>(
+          plot_mongo_char, plot_mongo_char + plot_mongo_len);
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      memcached_return_t memcached_rc;
+      memcached_st *memcached_client = memcached_pool_pop(
+          _memcached_client_pool, true, &memcached_rc);
+
+      // Upload the plot to memcached
+      auto set_span = opentracing::Tracer::Global()->StartSpan(
+          "MmcSetPlot", { opentracing::ChildOf(&span_context) });
+      memcached_rc = memcached_set(
+          memcached_client,
+          plot_id_str.c_str(),
+          plot_id_str.length(),
+          plot->c_str(),
+          plot->length(),
+          static_cast<time_t>(0),
+          static_cast<uint32_t>(0)
+      );
+      set_span->Finish();
+
+      if (memcached_rc != MEMCACHED_SUCCESS) {
+        LOG(warning) << "Failed to set plot to Memcached: "
+            << memcached_strerror(memcached_client, memcached_rc);
+      }
+      memcached_pool_push(_memcached_client_pool, memcached_client);
+      return plot;
+    } else {
+      LOG(error) << "Attribute plot is not find in MongoDB";
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
+      se.message = "Attribute plot is not find in MongoDB";
+      throw se;
+    }
+  } else {
+    LOG(error) << "Plot_id " << plot_id << " is not found in MongoDB";
+    bson_destroy(query);
+    mongoc_cursor_destroy(cursor);
+    mongoc_collection_destroy(collection);
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
+    se.message = "Plot_id " + plot_id_str + " is not found in MongoDB";
+    throw se;
+  }
+}
+
 void PlotHandler::ReadPlot(
     std::string &_return,
     int64_t req_id,
@@ -98,100 +200,17 @@ void PlotHandler::ReadPlot(
 
   // If cached in memcached
   if (plot_mmc) {
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Get plot " << plot_mmc
         << " cache hit from Memcached";
     _return = std::string(plot_mmc);
     free(plot_mmc);
   } else {
-    // If not cached in memcached
-    mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
-        _mongodb_client_pool);
-    if (!mongodb_client) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to pop a client from MongoDB pool";
-      free(plot_mmc);
-      throw se;
-    }
-    auto collection = mongoc_client_get_collection(
-        mongodb_client, "plot", "plot");
-    if (!collection) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to create collection plot from DB plot";
-      free(plot_mmc);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      throw se;
-    }
-
-    bson_t *query = bson_new();
-    BSON_APPEND_INT64(query, "plot_id", plot_id);
-
-    auto find_span = opentracing::Tracer::Global()->StartSpan(
-        "MongoFindPlot", { opentracing::ChildOf(&span->context()) });
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        collection, query, nullptr, nullptr);
-    const bson_t *doc;
-    bool found = mongoc_cursor_next(cursor, &doc);
-    find_span->Finish();
-
-    if (found) {
-      bson_iter_t iter;
-      if (bson_iter_init_find(&iter, doc, "plot")) {
-        char *plot_mongo_char = bson_iter_value(&iter)->value.v_utf8.str;
-        size_t plot_mongo_len = bson_iter_value(&iter)->value.v_utf8.len;
-        LOG(debug) << "Find plot " << plot_id << " cache miss";
-        _return = std::string(plot_mongo_char, plot_mongo_char + plot_mongo_len);
-        bson_destroy(query);
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-        memcached_client = memcached_pool_pop(
-            _memcached_client_pool, true, &memcached_rc);
-
-        // Upload the plot to memcached
-        auto set_span = opentracing::Tracer::Global()->StartSpan(
-            "MmcSetPlot", { opentracing::ChildOf(&span->context()) });
-        memcached_rc = memcached_set(
-            memcached_client,
-            plot_id_str.c_str(),
-            plot_id_str.length(),
-            _return.c_str(),
-            _return.length(),
-            static_cast<time_t>(0),
-            static_cast<uint32_t>(0)
-        );
-        set_span->Finish();
-
-        if (memcached_rc != MEMCACHED_SUCCESS) {
-          LOG(warning) << "Failed to set plot to Memcached: "
-              << memcached_strerror(memcached_client, memcached_rc);
-        }
-        memcached_pool_push(_memcached_client_pool, memcached_client);
-      } else {
-        LOG(error) << "Attribute plot is not find in MongoDB";
-        bson_destroy(query);
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
-        se.message = "Attribute plot is not find in MongoDB";
-        free(plot_mmc);
-        throw se;
-      }
-    } else {
-      LOG(error) << "Plot_id " << plot_id << " is not found in MongoDB";
-      bson_destroy(query);
-      mongoc_cursor_destroy(cursor);
-      mongoc_collection_destroy(collection);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
-      se.message = "Plot_id " + plot_id_str + " is not found in MongoDB";
-      free(plot_mmc);
-      throw se;
-    }
+    (*_cache_metrics.misses)++;
+    // Concurrent misses of the plot share one read from MongoDB.
+    _return = *_plot_flight.Do(plot_id, [&]() {
+      return _FetchPlot(plot_id, span->context());
+    });
   }
   span->Finish();
 }
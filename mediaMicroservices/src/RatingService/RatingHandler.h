@@ -9,6 +9,7 @@
 #include "../../gen-cpp/RatingService.h"
 #include "../../gen-cpp/ComposeReviewService.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
 #include "../ThriftClient.h"
 #include "../RedisClient.h"
 #include "../logger.h"
@@ -58,10 +59,10 @@ void RatingHandler::UploadRating(
       { opentracing::ChildOf(parent_span->get()) });
   opentracing::Tracer::Global()->Inject(span->context(), writer);
 
-  std::future<void> upload_future;
-  std::future<void> redis_future;
+  ExecutorFuture<void> upload_future;
+  ExecutorFuture<void> redis_future;
 
-  upload_future = std::async(std::launch::async, [&](){
+  upload_future = Executor::GetInstance()->Submit([&](){
     auto compose_client_wrapper = _compose_client_pool->Pop();
     if (!compose_client_wrapper) {
       ServiceException se;
@@ -80,7 +81,7 @@ void RatingHandler::UploadRating(
     _compose_client_pool->Push(compose_client_wrapper);
   });
 
-  redis_future = std::async(std::launch::async, [&](){
+  redis_future = Executor::GetInstance()->Submit([&](){
     auto redis_client_wrapper = _redis_client_pool->Pop();
     if (!redis_client_wrapper) {
       ServiceException se;
@@ -1,17 +1,9 @@
 #include <signal.h>
 
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
-
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "RatingHandler.h"
 
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 void sigintHandler(int sig) {
@@ -42,16 +34,14 @@ int main(int argc, char *argv[]) {
   ClientPool<RedisClient> redis_client_pool("rating-redis",
       redis_addr, redis_port, 0, 128, 1000);
 
-  TThreadedServer server (
+  std::shared_ptr<RatingServiceProcessor> processor =
       std::make_shared<RatingServiceProcessor>(
           std::make_shared<RatingHandler>(
               &compose_client_pool, 
-              &redis_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &redis_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "rating-service", processor, "0.0.0.0", port);
 
   std::cout << "Starting the rating-service server..." << std::endl;
-  server.serve();
+  server->serve();
 }
@@ -11,7 +11,11 @@
 #include <bson/bson.h>
 
 #include "../../gen-cpp/ReviewStorageService.h"
+#include "../BsonDecoder.h"
+#include "../Executor.h"
+#include "../SingleFlight.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -29,7 +33,15 @@ class ReviewStorageHandler : public ReviewStorageServiceIf{
  private:
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
+  SingleFlight<int64_t, Review> _review_flight{"review-storage"};
   int _extra_latency_ms;
+
+  // Reads reviews from MongoDB and caches them in Memcached. The reviews
+  // not found are left out.
+  SingleFlight<int64_t, Review>::Results _FetchReviews(
+      int64_t req_id, const std::vector<int64_t> &review_ids,
+      const opentracing::SpanContext &span_context);
 };
 
 ReviewStorageHandler::ReviewStorageHandler(
@@ -37,6 +49,8 @@ ReviewStorageHandler::ReviewStorageHandler(
     mongoc_client_pool_t *mongodb_pool) {
   _memcached_client_pool = memcached_pool;
   _mongodb_client_pool = mongodb_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("review-storage-memcached");
   _extra_latency_ms = ParseExtraLatency();
 }
 
@@ -111,6 +125,124 @@ void ReviewStorageHandler::StoreReview(
 
   span->Finish();
 }
+
+SingleFlight<int64_t, Review>::Results ReviewStorageHandler::_FetchReviews(
+    int64_t req_id, const std::vector<int64_t> &review_ids,
+    const opentracing::SpanContext &span_context) {
+  SingleFlight<int64_t, Review>::Results reviews;
+  std::vector<ExecutorFuture<void>> set_futures;
+  std::map<int64_t, std::string> review_json_map;
+
+  mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
+      _mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+  auto collection = mongoc_client_get_collection(
+      mongodb_client, "review", "review");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection user from DB user";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+  bson_t *query = bson_new();
+  bson_t query_child;
+  bson_t query_review_id_list;
+  const char *key;
+  int idx = 0;
+  char buf[16];
+  BSON_APPEND_DOCUMENT_BEGIN(query, "review_id", &query_child);
+  BSON_APPEND_ARRAY_BEGIN(&query_child, "$in", &query_review_id_list);
+  for (auto &item : review_ids) {
+    bson_uint32_to_string(idx, &key, buf, sizeof buf);
+    BSON_APPEND_INT64(&query_review_id_list, key, item);
+    idx++;
+  }
+  bson_append_array_end(&query_child, &query_review_id_list);
+  bson_append_document_end(query, &query_child);
+  mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
+      collection, query, nullptr, nullptr);
+  const bson_t *doc;
+  auto find_span = opentracing::Tracer::Global()->StartSpan(
+      "MongoFindPosts", {opentracing::ChildOf(&span_context)});
+  while (true) {
+    bool found = mongoc_cursor_next(cursor, &doc);
+    if (!found) {
+      break;
+    }
+    Review new_review;
+    if (!DecodeBson(doc, &new_review)) {
+      LOG(error) << "Request " << req_id
+                 << " reads a review that is malformed in MongoDB";
+      continue;
+    }
+    // Memcached keeps the JSON text of the document.
+    char *review_json_char = bson_as_json(doc, nullptr);
+    review_json_map.insert({new_review.review_id, std::string(review_json_char)});
+    reviews.insert(
+        {new_review.review_id, std::make_shared<const Review>(new_review)});
+    bson_free(review_json_char);
+  }
+  find_span->Finish();
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor, &error)) {
+    LOG(warning) << error.message;
+    bson_destroy(query);
+    mongoc_cursor_destroy(cursor);
+    mongoc_collection_destroy(collection);
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = error.message;
+    throw se;
+  }
+  bson_destroy(query);
+  mongoc_cursor_destroy(cursor);
+  mongoc_collection_destroy(collection);
+  mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+
+  // upload reviews to memcached
+  set_futures.emplace_back(Executor::GetInstance()->Submit([&]() {
+    memcached_return_t _rc;
+    auto _memcached_client = memcached_pool_pop(
+        _memcached_client_pool, true, &_rc);
+    if (!_memcached_client) {
+      LOG(error) << "Failed to pop a client from memcached pool";
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
+      se.message = "Failed to pop a client from memcached pool";
+      throw se;
+    }
+    auto set_span = opentracing::Tracer::Global()->StartSpan(
+        "MmcSetPost", {opentracing::ChildOf(&span_context)});
+    for (auto & it : review_json_map) {
+      std::string id_str = std::to_string(it.first);
+      _rc = memcached_set(
+          _memcached_client,
+          id_str.c_str(),
+          id_str.length(),
+          it.second.c_str(),
+          it.second.length(),
+          static_cast<time_t>(0),
+          static_cast<uint32_t>(0));
+    }
+    memcached_pool_push(_memcached_client_pool, _memcached_client);
+    set_span->Finish();
+  }));
+
+  try {
+    for (auto &it : set_futures) { it.get(); }
+  } catch (...) {
+    LOG(warning) << "Failed to set reviews to memcached";
+  }
+  return reviews;
+}
+
 void ReviewStorageHandler::ReadReviews(
     std::vector<Review> & _return,
     int64_t req_id,
@@ -220,127 +352,26 @@ void ReviewStorageHandler::ReadReviews(
   get_span->Finish();
   memcached_quit(memcached_client);
   memcached_pool_push(_memcached_client_pool, memcached_client);
+  *_cache_metrics.hits += return_map.size();
+  *_cache_metrics.misses += review_ids_not_cached.size();
   for (int i = 0; i < review_ids.size(); ++i) {
     delete keys[i];
   }
   delete[] keys;
   delete[] key_sizes;
 
-  std::vector<std::future<void>> set_futures;
-  std::map<int64_t, std::string> review_json_map;
-  
-  // Find the rest in MongoDB
+  // Find the rest in MongoDB. Concurrent misses of a review share one read.
   if (!review_ids_not_cached.empty()) {
-    mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
-        _mongodb_client_pool);
-    if (!mongodb_client) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to pop a client from MongoDB pool";
-      throw se;
+    auto fetched = _review_flight.DoMany(
+        review_ids_not_cached, [&](const std::vector<int64_t> &fetch_ids) {
+          return _FetchReviews(req_id, fetch_ids, span->context());
+        });
+    for (auto &it : fetched) {
+      return_map.emplace(it.first, *it.second);
     }
-    auto collection = mongoc_client_get_collection(
-        mongodb_client, "review", "review");
-    if (!collection) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to create collection user from DB user";
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      throw se;
-    }
-    bson_t *query = bson_new();
-    bson_t query_child;
-    bson_t query_review_id_list;
-    const char *key;
-    idx = 0;
-    char buf[16];
-    BSON_APPEND_DOCUMENT_BEGIN(query, "review_id", &query_child);
-    BSON_APPEND_ARRAY_BEGIN(&query_child, "$in", &query_review_id_list);
-    for (auto &item : review_ids_not_cached) {
-      bson_uint32_to_string(idx, &key, buf, sizeof buf);
-      BSON_APPEND_INT64(&query_review_id_list, key, item);
-      idx++;
-    }
-    bson_append_array_end(&query_child, &query_review_id_list);
-    bson_append_document_end(query, &query_child);
-    mongoc_cursor_t *cursor = mongoc_collection_find_with_opts(
-        collection, query, nullptr, nullptr);
-    const bson_t *doc;
-    auto find_span = opentracing::Tracer::Global()->StartSpan(
-        "MongoFindPosts", {opentracing::ChildOf(&span->context())});
-    while (true) {
-      bool found = mongoc_cursor_next(cursor, &doc);
-      if (!found) {
-        break;
-      }
-      Review new_review;
-      char *review_json_char = bson_as_json(doc, nullptr);
-      json review_json = json::parse(review_json_char);
-      new_review.req_id = review_json["req_id"];
-      new_review.user_id = review_json["user_id"];
-      new_review.movie_id = review_json["movie_id"];
-      new_review.text = review_json["text"];
-      new_review.rating = review_json["rating"];
-      new_review.timestamp = review_json["timestamp"];
-      new_review.review_id = review_json["review_id"];
-      review_json_map.insert({new_review.review_id, std::string(review_json_char)});
-      return_map.insert({new_review.review_id, new_review});
-      bson_free(review_json_char);
-    }
-    find_span->Finish();
-    bson_error_t error;
-    if (mongoc_cursor_error(cursor, &error)) {
-      LOG(warning) << error.message;
-      bson_destroy(query);
-      mongoc_cursor_destroy(cursor);
-      mongoc_collection_destroy(collection);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = error.message;
-      throw se;
-    }
-    bson_destroy(query);
-    mongoc_cursor_destroy(cursor);
-    mongoc_collection_destroy(collection);
-    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-
-    // upload reviews to memcached
-    set_futures.emplace_back(std::async(std::launch::async, [&]() {
-      memcached_return_t _rc;
-      auto _memcached_client = memcached_pool_pop(
-          _memcached_client_pool, true, &_rc);
-      if (!_memcached_client) {
-        LOG(error) << "Failed to pop a client from memcached pool";
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
-        se.message = "Failed to pop a client from memcached pool";
-        throw se;
-      }
-      auto set_span = opentracing::Tracer::Global()->StartSpan(
-          "MmcSetPost", {opentracing::ChildOf(&span->context())});
-      for (auto & it : review_json_map) {
-        std::string id_str = std::to_string(it.first);
-        _rc = memcached_set(
-            _memcached_client,
-            id_str.c_str(),
-            id_str.length(),
-            it.second.c_str(),
-            it.second.length(),
-            static_cast<time_t>(0),
-            static_cast<uint32_t>(0));
-      }
-      memcached_pool_push(_memcached_client_pool, _memcached_client);
-      set_span->Finish();
-    }));
   }
 
   if (return_map.size() != review_ids.size()) {
-    try {
-      for (auto &it : set_futures) { it.get(); }
-    } catch (...) {
-      LOG(warning) << "Failed to set reviews to memcached";
-    }
     LOG(error) << "review storage service: return set incomplete";
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
@@ -351,12 +382,6 @@ void ReviewStorageHandler::ReadReviews(
   for (auto &review_id : review_ids) {
     _return.emplace_back(return_map[review_id]);
   }
-
-  try {
-    for (auto &it : set_futures) { it.get(); }
-  } catch (...) {
-    LOG(warning) << "Failed to set reviews to memcached";
-  }
   
 }
 
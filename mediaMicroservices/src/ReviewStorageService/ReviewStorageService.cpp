@@ -1,19 +1,12 @@
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
 #include "nlohmann/json.hpp"
 #include <signal.h>
 
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "../utils_mongodb.h"
 #include "../utils_memcached.h"
 #include "ReviewStorageHandler.h"
 
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 static memcached_pool_st* memcached_client_pool;
@@ -53,15 +46,13 @@ int main(int argc, char *argv[]) {
     return EXIT_FAILURE;
   }
 
-  TThreadedServer server (
+  std::shared_ptr<ReviewStorageServiceProcessor> processor =
       std::make_shared<ReviewStorageServiceProcessor>(
           std::make_shared<ReviewStorageHandler>(
-              memcached_client_pool, mongodb_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              memcached_client_pool, mongodb_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "review-storage-service", processor, "0.0.0.0", port);
 
   std::cout << "Starting the review-storage-service server..." << std::endl;
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
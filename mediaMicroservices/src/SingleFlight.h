@@ -0,0 +1,148 @@
+#ifndef MEDIA_MICROSERVICES_SINGLEFLIGHT_H
+#define MEDIA_MICROSERVICES_SINGLEFLIGHT_H
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Metrics.h"
+
+namespace media_service {
+
+// Coalesces concurrent fetches of the same keys from a backend. While a key
+// is fetched, other callers of the key wait for that fetch instead of
+// fetching it again, so a hot key that misses the cache reaches the backend
+// once rather than once per caller. Results are shared and immutable, a null
+// result is a key that was not found. A fetch that throws fails its waiters
+// with the same exception. Nothing is kept once a fetch completes: caching
+// the results is up to the fetch.
+template <class K, class V>
+class SingleFlight {
+ public:
+  using Result = std::shared_ptr<const V>;
+  using Results = std::map<K, Result>;
+
+  // name labels the single_flight_shared_total counter of the callers that
+  // waited for the fetch of another.
+  explicit SingleFlight(const std::string &name);
+
+  SingleFlight(const SingleFlight &) = delete;
+  SingleFlight &operator=(const SingleFlight &) = delete;
+
+  Result Do(const K &key, const std::function<Result()> &fetch);
+
+  // Fetches the keys not in flight with one call of fetch, which gets those
+  // keys and returns the results of the ones it found, and waits for the
+  // others. Returns the results of the keys found.
+  Results DoMany(const std::set<K> &keys,
+                 const std::function<Results(const std::vector<K> &)> &fetch);
+
+ private:
+  // Ends the fetches of keys, whose results are in results unless the fetch
+  // threw error.
+  void _Complete(const std::vector<K> &keys,
+                 std::vector<std::promise<Result>> *promises,
+                 const Results &results, std::exception_ptr error);
+
+  std::mutex _mtx;
+  std::unordered_map<K, std::shared_future<Result>> _calls;
+  std::atomic<long> *_shared;
+};
+
+template <class K, class V>
+SingleFlight<K, V>::SingleFlight(const std::string &name) {
+  _shared = Metrics::GetInstance()->GetCounter(
+      "single_flight_shared_total", MetricLabel("flight", name));
+}
+
+template <class K, class V>
+typename SingleFlight<K, V>::Result SingleFlight<K, V>::Do(
+    const K &key, const std::function<Result()> &fetch) {
+  auto results = DoMany({key}, [&](const std::vector<K> &) {
+    Results fetched;
+    fetched.emplace(key, fetch());
+    return fetched;
+  });
+  auto it = results.find(key);
+  return it == results.end() ? nullptr : it->second;
+}
+
+template <class K, class V>
+typename SingleFlight<K, V>::Results SingleFlight<K, V>::DoMany(
+    const std::set<K> &keys,
+    const std::function<Results(const std::vector<K> &)> &fetch) {
+  std::vector<K> led_keys;
+  std::vector<std::promise<Result>> promises;
+  std::vector<std::pair<K, std::shared_future<Result>>> joined;
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    for (auto &key : keys) {
+      auto it = _calls.find(key);
+      if (it != _calls.end()) {
+        joined.emplace_back(key, it->second);
+      } else {
+        promises.emplace_back();
+        _calls.emplace(key, promises.back().get_future().share());
+        led_keys.emplace_back(key);
+      }
+    }
+  }
+  *_shared += joined.size();
+
+  // The keys led are fetched before the others are waited for, so two
+  // callers waiting for each other's keys never block each other.
+  Results results;
+  if (!led_keys.empty()) {
+    try {
+      results = fetch(led_keys);
+    } catch (...) {
+      _Complete(led_keys, &promises, results, std::current_exception());
+      throw;
+    }
+    _Complete(led_keys, &promises, results, nullptr);
+  }
+
+  for (auto &it : joined) {
+    auto result = it.second.get();
+    if (result) {
+      results[it.first] = result;
+    }
+  }
+  for (auto it = results.begin(); it != results.end();) {
+    it = it->second ? std::next(it) : results.erase(it);
+  }
+  return results;
+}
+
+template <class K, class V>
+void SingleFlight<K, V>::_Complete(const std::vector<K> &keys,
+                                   std::vector<std::promise<Result>> *promises,
+                                   const Results &results,
+                                   std::exception_ptr error) {
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    for (auto &key : keys) {
+      _calls.erase(key);
+    }
+  }
+  for (size_t i = 0; i < keys.size(); ++i) {
+    if (error) {
+      (*promises)[i].set_exception(error);
+    } else {
+      auto it = results.find(keys[i]);
+      (*promises)[i].set_value(it == results.end() ? nullptr : it->second);
+    }
+  }
+}
+
+} // namespace media_service
+
+#endif //MEDIA_MICROSERVICES_SINGLEFLIGHT_H
@@ -1,17 +1,9 @@
 #include <signal.h>
 
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
-
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "TextHandler.h"
 
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 void sigintHandler(int sig) {
@@ -34,16 +26,14 @@ int main(int argc, char *argv[]) {
     ClientPool<ThriftClient<ComposeReviewServiceClient>> compose_client_pool(
         "compose-review-client", compose_addr, compose_port, 0, 128, 1000);
 
-    TThreadedServer server(
+    std::shared_ptr<TextServiceProcessor> processor =
         std::make_shared<TextServiceProcessor>(
-            std::make_shared<TextHandler>(&compose_client_pool)),
-        std::make_shared<TServerSocket>("0.0.0.0", port),
-        std::make_shared<TFramedTransportFactory>(),
-        std::make_shared<TBinaryProtocolFactory>()
-    );
+            std::make_shared<TextHandler>(&compose_client_pool));
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "text-service", processor, "0.0.0.0", port);
 
     std::cout << "Starting the text-service server..." << std::endl;
-    server.serve();
+    server->serve();
   } else exit(EXIT_FAILURE);
 }
 
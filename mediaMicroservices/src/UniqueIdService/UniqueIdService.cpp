@@ -13,18 +13,10 @@
 
 #include <signal.h>
 
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
-
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "UniqueIdHandler.h"
 
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using namespace media_service;
 
 void sigintHandler(int sig) {
@@ -58,15 +50,13 @@ int main(int argc, char *argv[]) {
   ClientPool<ThriftClient<ComposeReviewServiceClient>> compose_client_pool(
       "compose-review-client", compose_addr, compose_port, 0, 128, 1000);
 
-  TThreadedServer server (
+  std::shared_ptr<UniqueIdServiceProcessor> processor =
       std::make_shared<UniqueIdServiceProcessor>(
           std::make_shared<UniqueIdHandler>(
-              &thread_lock, machine_id, &compose_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &thread_lock, machine_id, &compose_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "unique-id-service", processor, "0.0.0.0", port);
 
   std::cout << "Starting the unique-id-service server ..." << std::endl;
-  server.serve();
+  server->serve();
 }
@@ -12,6 +12,7 @@
 #include "../logger.h"
 #include "../tracing.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
 #include "../RedisClient.h"
 #include "../ThriftClient.h"
 #include "../utils.h"
@@ -311,8 +312,7 @@ void UserReviewHandler::ReadUserReviews(
     mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
   }
 
-  std::future<std::vector<Review>> review_future = std::async(
-      std::launch::async, [&]() {
+  ExecutorFuture<std::vector<Review>> review_future = Executor::GetInstance()->Submit([&]() {
         auto review_client_wrapper = _review_client_pool->Pop();
         if (!review_client_wrapper) {
           ServiceException se;
@@ -24,6 +24,7 @@
 #include "../../gen-cpp/ComposeReviewService.h"
 #include "../../third_party/PicoSHA2/picosha2.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../utils.h"
 
 // Custom Epoch (January 1, 2018 Midnight GMT = 2018-01-01T00:00:00Z)
@@ -111,6 +112,7 @@ class UserHandler : public UserServiceIf {
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
   ClientPool<ThriftClient<ComposeReviewServiceClient>> *_compose_client_pool;
+  CacheMetrics _cache_metrics;
   int _extra_latency_ms;
 };
 
@@ -128,6 +130,7 @@ UserHandler::UserHandler(
   _mongodb_client_pool = mongodb_client_pool;
   _compose_client_pool = compose_client_pool;
   _secret = secret;
+  _cache_metrics = Metrics::GetInstance()->GetCacheMetrics("user-memcached");
   _extra_latency_ms = ParseExtraLatency();
 }
 
@@ -424,12 +427,14 @@ void UserHandler::UploadUserWithUsername(
   int64_t user_id = 0;
 
   if (user_id_mmc) {
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Found password, salt and ID are cached in Memcached";
     user_id = std::stoul(user_id_mmc);
   }
 
   // If not cached in memcached
   else {
+    (*_cache_metrics.misses)++;
     LOG(debug) << "User_id not cached in Memcached";
     mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
         _mongodb_client_pool);
@@ -707,6 +712,7 @@ void UserHandler::Login(
   const char *password_str = nullptr;
 
   if (password_mmc && salt_mmc && user_id_mmc) {
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Found password, salt and ID are cached in Memcached";
     user_id = std::stoul(user_id_mmc);
     password_str = password_mmc;
@@ -715,6 +721,7 @@ void UserHandler::Login(
 
     // If not cached in memcached
   else {
+    (*_cache_metrics.misses)++;
     LOG(debug) << "Password or salt or ID not cached in Memcached";
     mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
         _mongodb_client_pool);
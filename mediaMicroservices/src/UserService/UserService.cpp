@@ -1,19 +1,11 @@
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TServerSocket.h>
-#include <thrift/transport/TBufferTransports.h>
 #include <signal.h>
 
-
 #include "../utils.h"
+#include "../utils_thrift.h"
 #include "../utils_memcached.h"
 #include "../utils_mongodb.h"
 #include "UserHandler.h"
 
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TServerSocket;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::protocol::TBinaryProtocolFactory;
 using media_service::UserHandler;
 using namespace media_service;
 
@@ -57,7 +49,7 @@ int main(int argc, char *argv[]) {
   ClientPool<ThriftClient<ComposeReviewServiceClient>> compose_client_pool(
       "compose-review-client", compose_addr, compose_port, 0, 128, 1000);
 
-  TThreadedServer server(
+  std::shared_ptr<UserServiceProcessor> processor =
       std::make_shared<UserServiceProcessor>(
           std::make_shared<UserHandler>(
               &thread_lock,
@@ -65,11 +57,9 @@ int main(int argc, char *argv[]) {
               secret,
               memcached_client_pool,
               mongodb_client_pool,
-              &compose_client_pool)),
-      std::make_shared<TServerSocket>("0.0.0.0", port),
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>()
-  );
+              &compose_client_pool));
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "user-service", processor, "0.0.0.0", port);
   std::cout << "Starting the user-service server ..." << std::endl;
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
@@ -1,37 +1,79 @@
 #include "../src/ClientPool.h"
-#include "../src/ThriftClient.h"
-#include "../src/ComposeReviewHandler.h"
 #include "../src/logger.h"
 
+#include <atomic>
 #include <chrono>
+#include <iostream>
+#include <string>
 #include <thread>
 #include <vector>
 
 
 using namespace media_service;
 
-void getClient(
-    ClientPool<ThriftClient<ComposeReviewServiceClient>> *client_pool,
-    int sleep_time) {
-  while (true) {
+// A client that never touches the network, so that the benchmark measures
+// only the cost of the pool itself.
+class DummyClient {
+ public:
+  DummyClient(const std::string &addr, int port) {}
+  void Connect() {}
+  void KeepAlive() {}
+  void KeepAlive(int timeout_ms) {}
+};
+
+void getClient(ClientPool<DummyClient> *client_pool, int iterations,
+               std::atomic<long> *failures) {
+  for (int i = 0; i < iterations; i++) {
     auto client = client_pool->Pop();
-    LOG(debug) << "Pop client " << client->getId();
-    client_pool->Push(client->getId());
-    LOG(debug) << "Push client " << client->getId();
+    if (!client) {
+      (*failures)++;
+      continue;
+    }
+    client_pool->Push(client);
   }
 }
 
-int main(int argc, char *argv[]) {
-  init_logger();
-  ClientPool<ThriftClient<ComposeReviewServiceClient>> client_pool(
-      0, 16, "compose-review-service", 9090);
-  bool done = false;
+void runBenchmark(int num_threads, int max_size, int num_shards,
+                  int iterations) {
+  ClientPool<DummyClient> client_pool(
+      "dummy-client", "localhost", 9090, 0, max_size, 10000, num_shards);
+  std::atomic<long> failures{0};
   std::vector<std::thread> threads;
-  for (int i = 0; i < 10; i++) {
-    threads.emplace_back(std::thread(getClient, &client_pool, 20));
+
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_threads; i++) {
+    threads.emplace_back(std::thread(getClient, &client_pool, iterations,
+                                     &failures));
   }
-  for (int i = 0; i < 10; i++) {
-    threads[i].join();
+  for (auto &thread : threads) {
+    thread.join();
   }
+  auto elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  long ops = static_cast<long>(num_threads) * iterations;
+  std::cout << "threads=" << num_threads << " max_size=" << max_size
+            << " shards=" << num_shards << " ops=" << ops
+            << " failures=" << failures.load()
+            << " elapsed_ms=" << elapsed_us / 1000
+            << " ns/op=" << elapsed_us * 1000 / ops << std::endl;
 }
 
+int main(int argc, char *argv[]) {
+  init_logger();
+  int num_threads = argc > 1 ? std::stoi(argv[1]) : 64;
+  int iterations = argc > 2 ? std::stoi(argv[2]) : 100000;
+  int max_shards = argc > 3 ? std::stoi(argv[3]) :
+      static_cast<int>(std::thread::hardware_concurrency());
+  if (max_shards < 1) {
+    max_shards = 1;
+  }
+
+  // Uncontended (max_size >= threads) and contended (max_size < threads)
+  // pools, once with a single lock and once sharded per core.
+  for (int max_size : {512, num_threads / 4 > 0 ? num_threads / 4 : 1}) {
+    for (int num_shards : {1, max_shards}) {
+      runBenchmark(num_threads, max_size, num_shards, iterations);
+    }
+  }
+}
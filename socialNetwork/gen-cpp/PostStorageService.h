@@ -24,6 +24,7 @@ class PostStorageServiceIf {
   virtual void StorePost(const int64_t req_id, const Post& post, const std::map<std::string, std::string> & carrier) = 0;
   virtual void ReadPost(Post& _return, const int64_t req_id, const int64_t post_id, const std::map<std::string, std::string> & carrier) = 0;
   virtual void ReadPosts(std::vector<Post> & _return, const int64_t req_id, const std::vector<int64_t> & post_ids, const std::map<std::string, std::string> & carrier) = 0;
+  virtual void StorePosts(const int64_t req_id, const std::vector<Post> & posts, const std::map<std::string, std::string> & carrier) = 0;
 };
 
 class PostStorageServiceIfFactory {
@@ -62,6 +63,9 @@ class PostStorageServiceNull : virtual public PostStorageServiceIf {
   void ReadPosts(std::vector<Post> & /* _return */, const int64_t /* req_id */, const std::vector<int64_t> & /* post_ids */, const std::map<std::string, std::string> & /* carrier */) {
     return;
   }
+  void StorePosts(const int64_t /* req_id */, const std::vector<Post> & /* posts */, const std::map<std::string, std::string> & /* carrier */) {
+    return;
+  }
 };
 
 typedef struct _PostStorageService_StorePost_args__isset {
@@ -434,6 +438,124 @@ class PostStorageService_ReadPosts_presult {
 
 };
 
+typedef struct _PostStorageService_StorePosts_args__isset {
+  _PostStorageService_StorePosts_args__isset() : req_id(false), posts(false), carrier(false) {}
+  bool req_id :1;
+  bool posts :1;
+  bool carrier :1;
+} _PostStorageService_StorePosts_args__isset;
+
+class PostStorageService_StorePosts_args {
+ public:
+
+  PostStorageService_StorePosts_args(const PostStorageService_StorePosts_args&);
+  PostStorageService_StorePosts_args& operator=(const PostStorageService_StorePosts_args&);
+  PostStorageService_StorePosts_args() : req_id(0) {
+  }
+
+  virtual ~PostStorageService_StorePosts_args() throw();
+  int64_t req_id;
+  std::vector<Post>  posts;
+  std::map<std::string, std::string>  carrier;
+
+  _PostStorageService_StorePosts_args__isset __isset;
+
+  void __set_req_id(const int64_t val);
+
+  void __set_posts(const std::vector<Post> & val);
+
+  void __set_carrier(const std::map<std::string, std::string> & val);
+
+  bool operator == (const PostStorageService_StorePosts_args & rhs) const
+  {
+    if (!(req_id == rhs.req_id))
+      return false;
+    if (!(posts == rhs.posts))
+      return false;
+    if (!(carrier == rhs.carrier))
+      return false;
+    return true;
+  }
+  bool operator != (const PostStorageService_StorePosts_args &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const PostStorageService_StorePosts_args & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+
+class PostStorageService_StorePosts_pargs {
+ public:
+
+
+  virtual ~PostStorageService_StorePosts_pargs() throw();
+  const int64_t* req_id;
+  const std::vector<Post> * posts;
+  const std::map<std::string, std::string> * carrier;
+
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _PostStorageService_StorePosts_result__isset {
+  _PostStorageService_StorePosts_result__isset() : se(false) {}
+  bool se :1;
+} _PostStorageService_StorePosts_result__isset;
+
+class PostStorageService_StorePosts_result {
+ public:
+
+  PostStorageService_StorePosts_result(const PostStorageService_StorePosts_result&);
+  PostStorageService_StorePosts_result& operator=(const PostStorageService_StorePosts_result&);
+  PostStorageService_StorePosts_result() {
+  }
+
+  virtual ~PostStorageService_StorePosts_result() throw();
+  ServiceException se;
+
+  _PostStorageService_StorePosts_result__isset __isset;
+
+  void __set_se(const ServiceException& val);
+
+  bool operator == (const PostStorageService_StorePosts_result & rhs) const
+  {
+    if (!(se == rhs.se))
+      return false;
+    return true;
+  }
+  bool operator != (const PostStorageService_StorePosts_result &rhs) const {
+    return !(*this == rhs);
+  }
+
+  bool operator < (const PostStorageService_StorePosts_result & ) const;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+  uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;
+
+};
+
+typedef struct _PostStorageService_StorePosts_presult__isset {
+  _PostStorageService_StorePosts_presult__isset() : se(false) {}
+  bool se :1;
+} _PostStorageService_StorePosts_presult__isset;
+
+class PostStorageService_StorePosts_presult {
+ public:
+
+
+  virtual ~PostStorageService_StorePosts_presult() throw();
+  ServiceException se;
+
+  _PostStorageService_StorePosts_presult__isset __isset;
+
+  uint32_t read(::apache::thrift::protocol::TProtocol* iprot);
+
+};
+
 class PostStorageServiceClient : virtual public PostStorageServiceIf {
  public:
   PostStorageServiceClient(apache::thrift::stdcxx::shared_ptr< ::apache::thrift::protocol::TProtocol> prot) {
@@ -468,6 +590,9 @@ class PostStorageServiceClient : virtual public PostStorageServiceIf {
   void ReadPosts(std::vector<Post> & _return, const int64_t req_id, const std::vector<int64_t> & post_ids, const std::map<std::string, std::string> & carrier);
   void send_ReadPosts(const int64_t req_id, const std::vector<int64_t> & post_ids, const std::map<std::string, std::string> & carrier);
   void recv_ReadPosts(std::vector<Post> & _return);
+  void StorePosts(const int64_t req_id, const std::vector<Post> & posts, const std::map<std::string, std::string> & carrier);
+  void send_StorePosts(const int64_t req_id, const std::vector<Post> & posts, const std::map<std::string, std::string> & carrier);
+  void recv_StorePosts();
  protected:
   apache::thrift::stdcxx::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot_;
   apache::thrift::stdcxx::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot_;
@@ -486,12 +611,14 @@ class PostStorageServiceProcessor : public ::apache::thrift::TDispatchProcessor
   void process_StorePost(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
   void process_ReadPost(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
   void process_ReadPosts(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
+  void process_StorePosts(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, void* callContext);
  public:
   PostStorageServiceProcessor(::apache::thrift::stdcxx::shared_ptr<PostStorageServiceIf> iface) :
     iface_(iface) {
     processMap_["StorePost"] = &PostStorageServiceProcessor::process_StorePost;
     processMap_["ReadPost"] = &PostStorageServiceProcessor::process_ReadPost;
     processMap_["ReadPosts"] = &PostStorageServiceProcessor::process_ReadPosts;
+    processMap_["StorePosts"] = &PostStorageServiceProcessor::process_StorePosts;
   }
 
   virtual ~PostStorageServiceProcessor() {}
@@ -549,6 +676,15 @@ class PostStorageServiceMultiface : virtual public PostStorageServiceIf {
     return;
   }
 
+  void StorePosts(const int64_t req_id, const std::vector<Post> & posts, const std::map<std::string, std::string> & carrier) {
+    size_t sz = ifaces_.size();
+    size_t i = 0;
+    for (; i < (sz - 1); ++i) {
+      ifaces_[i]->StorePosts(req_id, posts, carrier);
+    }
+    ifaces_[i]->StorePosts(req_id, posts, carrier);
+  }
+
 };
 
 // The 'concurrent' client is a thread safe client that correctly handles
@@ -588,6 +724,9 @@ class PostStorageServiceConcurrentClient : virtual public PostStorageServiceIf {
   void ReadPosts(std::vector<Post> & _return, const int64_t req_id, const std::vector<int64_t> & post_ids, const std::map<std::string, std::string> & carrier);
   int32_t send_ReadPosts(const int64_t req_id, const std::vector<int64_t> & post_ids, const std::map<std::string, std::string> & carrier);
   void recv_ReadPosts(std::vector<Post> & _return, const int32_t seqid);
+  void StorePosts(const int64_t req_id, const std::vector<Post> & posts, const std::map<std::string, std::string> & carrier);
+  int32_t send_StorePosts(const int64_t req_id, const std::vector<Post> & posts, const std::map<std::string, std::string> & carrier);
+  void recv_StorePosts(const int32_t seqid);
  protected:
   apache::thrift::stdcxx::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot_;
   apache::thrift::stdcxx::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot_;
@@ -25,6 +25,7 @@ class ErrorCode(object):
     SE_REDIS_ERROR = 5
     SE_THRIFT_HANDLER_ERROR = 6
     SE_RABBITMQ_CONN_ERROR = 7
+    SE_SERVER_OVERLOADED = 8
 
     _VALUES_TO_NAMES = {
         0: "SE_CONNPOOL_TIMEOUT",
@@ -35,6 +36,7 @@ class ErrorCode(object):
         5: "SE_REDIS_ERROR",
         6: "SE_THRIFT_HANDLER_ERROR",
         7: "SE_RABBITMQ_CONN_ERROR",
+        8: "SE_SERVER_OVERLOADED",
     }
 
     _NAMES_TO_VALUES = {
@@ -46,6 +48,7 @@ class ErrorCode(object):
         "SE_REDIS_ERROR": 5,
         "SE_THRIFT_HANDLER_ERROR": 6,
         "SE_RABBITMQ_CONN_ERROR": 7,
+        "SE_SERVER_OVERLOADED": 8,
     }
 
 
@@ -16,6 +16,7 @@ events {
 }
 
 env fqdn_suffix;
+env deadline_ms;
 
 http {
   # Load a vendor tracer
@@ -8,4 +8,10 @@ reporter:
 sampler:
   type: "{{ .Values.global.jaeger.samplerType }}"
   param: {{ .Values.global.jaeger.samplerParam }}
+sampling:
+  type: "{{ .Values.global.jaeger.samplingType }}"
+  param: {{ .Values.global.jaeger.samplingParam }}
+  tail_param: {{ .Values.global.jaeger.samplingTailParam }}
+  latency_threshold_ms: {{ int .Values.global.jaeger.samplingLatencyThresholdMs }}
+  boost_ms: {{ int .Values.global.jaeger.samplingBoostMs }}
 {{- end }}
\ No newline at end of file
@@ -18,7 +18,27 @@
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "executor_threads": 64,
+      "executor_queue_size": 4096,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000,
+      "hedge_percentile": 0,
+      "hedge_budget": 0.05
     },
     "social-graph-mongodb": {
       "addr": {{ ternary (include "mongodb-sharded.connection" . | trim) "social-graph-mongodb" .Values.global.mongodb.sharding.enabled | quote}},
@@ -42,7 +62,19 @@
       "workers": 32,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000,
+      "prefetch_count": 128,
+      "batch_size": 64,
+      "batch_linger_ms": 5
     },
     "write-home-timeline-rabbitmq": {
       "addr": "write-home-timeline-rabbitmq",
@@ -65,7 +97,27 @@
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_clients": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "executor_threads": 64,
+      "executor_queue_size": 4096,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000,
+      "home_timeline_fanout": "rpc"
     },
     "compose-post-redis": {
       "addr": {{ ternary (include "redis-cluster.connection" . | trim) "compose-post-redis" .Values.global.redis.cluster.enabled | quote}},
@@ -81,7 +133,27 @@
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "executor_threads": 64,
+      "executor_queue_size": 4096,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000,
+      "timeline_encoding": "decimal"
     },
     "user-timeline-mongodb": {
       "addr": {{ ternary (include "mongodb-sharded.connection" . | trim) "user-timeline-mongodb" .Values.global.mongodb.sharding.enabled | quote}},
@@ -104,7 +176,33 @@
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "executor_threads": 64,
+      "executor_queue_size": 4096,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000,
+      "hedge_percentile": 0,
+      "hedge_budget": 0.05,
+      "local_cache_capacity": 10000,
+      "local_cache_ttl_ms": 60000,
+      "local_cache_shards": 16,
+      "store_batch_size": 64,
+      "store_batch_linger_ms": 0
     },
     "post-storage-mongodb": {
       "addr": {{ ternary (include "mongodb-sharded.connection" . | trim) "post-storage-mongodb" .Values.global.mongodb.sharding.enabled | quote}},
@@ -127,14 +225,48 @@
       "connections": 512,
       "timeout_ms": 10000,
       "keepalive_ms": 10000,
-      "netif": "eth0"
+      "netif": "eth0",
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000
     },
     "media-service": {
       "addr": "media-service",
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000
     },
     "media-mongodb": {
       "addr": {{ ternary (include "mongodb-sharded.connection" . | trim) "media-mongodb" .Values.global.mongodb.sharding.enabled | quote}},
@@ -163,21 +295,77 @@
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "multiplexed_clients": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "executor_threads": 64,
+      "executor_queue_size": 4096,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000
     },
     "user-mention-service": {
       "addr": "user-mention-service",
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000
     },
     "url-shorten-service": {
       "addr": "url-shorten-service",
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "executor_threads": 64,
+      "executor_queue_size": 4096,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000
     },
     "url-shorten-memcached": {
       "addr": {{ ternary (include "memcached-cluster.connection" . | trim) "url-shorten-memcached" .Values.global.memcached.cluster.enabled | quote}},
@@ -200,7 +388,24 @@
       "connections": 512,
       "timeout_ms": 10000,
       "keepalive_ms": 10000,
-      "netif": "eth0"
+      "netif": "eth0",
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000
     },
     "user-memcached": {
       "addr": {{ ternary (include "memcached-cluster.connection" . | trim) "user-memcached" .Values.global.memcached.cluster.enabled | quote}},
@@ -222,7 +427,30 @@
       "port": 9090,
       "connections": 512,
       "timeout_ms": 10000,
-      "keepalive_ms": 10000
+      "keepalive_ms": 10000,
+      "pool_shards": 1,
+      "multiplexed_connections": 0,
+      "server_mode": "threaded",
+      "server_io_threads": 4,
+      "server_worker_threads": 64,
+      "min_connections": 32,
+      "health_check_interval_ms": 1000,
+      "refresh_ahead_ms": 1000,
+      "metrics_port": 9091,
+      "concurrency_limit_initial": 128,
+      "concurrency_limit_min": 16,
+      "concurrency_limit_max": 0,
+      "circuit_breaker_failure_rate": 0,
+      "circuit_breaker_slow_call_ms": 5000,
+      "circuit_breaker_min_calls": 20,
+      "circuit_breaker_open_ms": 5000,
+      "resolve_interval_ms": 10000,
+      "fanout_threshold": 0,
+      "pull_users_refresh_ms": 1000,
+      "max_timeline_length": 0,
+      "deep_pagination": 0,
+      "timeline_encoding": "decimal",
+      "cluster_pipeline_parallelism": 8
     },
     "ssl": {
       "enabled": false,
@@ -69,6 +69,8 @@ function _M.ComposePost()
       { ["references"] = { { "child_of", parent_span_context } } })
     local carrier = {}
     tracer:text_map_inject(span:context(), carrier)
+    local deadline = require "deadline"
+    deadline.Inject(carrier)
 
     if (not _StrIsEmpty(post.media_ids) and not _StrIsEmpty(post.media_types)) then
       status, ret = pcall(client.ComposePost, client,
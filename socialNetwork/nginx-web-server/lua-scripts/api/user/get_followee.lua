@@ -39,6 +39,8 @@ function _M.GetFollowee()
       {["references"] = {{"child_of", parent_span_context}}})
   local carrier = {}
   tracer:text_map_inject(span:context(), carrier)
+  local deadline = require "deadline"
+  deadline.Inject(carrier)
 
   if (_StrIsEmpty(ngx.var.cookie_login_token)) then
     ngx.status = ngx.HTTP_UNAUTHORIZED
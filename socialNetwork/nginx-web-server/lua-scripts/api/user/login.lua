@@ -23,6 +23,8 @@ function _M.Login()
       {["references"] = {{"child_of", parent_span_context}}})
   local carrier = {}
   tracer:text_map_inject(span:context(), carrier)
+  local deadline = require "deadline"
+  deadline.Inject(carrier)
 
   ngx.req.read_body()
   local args = ngx.req.get_post_args()
@@ -0,0 +1,19 @@
+local _M = {}
+
+-- End-to-end time budget of a request in milliseconds, 0 to disable.
+-- The services forward the absolute deadline with the tracing context and
+-- stop working on a request once it has passed.
+local budget_ms = tonumber(os.getenv("deadline_ms"))
+if (budget_ms == nil) then
+  budget_ms = 10000
+end
+
+function _M.Inject(carrier)
+  if (budget_ms > 0) then
+    local ngx = ngx
+    carrier["deadline-ms"] = string.format("%d",
+        math.floor(ngx.now() * 1000) + budget_ms)
+  end
+end
+
+return _M
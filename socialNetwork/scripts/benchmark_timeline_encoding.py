@@ -0,0 +1,80 @@
+import argparse
+import random
+import struct
+import time
+
+import redis
+
+
+# Compares the memory and throughput of the decimal and binary
+# `timeline_encoding` of the timeline sorted sets on a scratch Redis. Writes
+# timelines of each encoding like WriteHomeTimeline does, then reads them
+# back like ReadHomeTimeline does and reports MEMORY USAGE per timeline.
+# Post ids are random 63-bit ids like those of unique-id-service.
+
+
+def encode(post_id, encoding):
+  if encoding == 'binary':
+    return b'\x00' + struct.pack('>q', post_id)
+  return str(post_id).encode()
+
+
+def decode(member):
+  if len(member) == 9 and member[:1] == b'\x00':
+    return struct.unpack('>q', member[1:])[0]
+  return int(member)
+
+
+def run(client, encoding, args):
+  keys = ['bench:{}:{}'.format(encoding, i) for i in range(args.timelines)]
+  client.delete(*keys)
+  rng = random.Random(0)
+  timestamp = int(time.time() * 1000)
+
+  start = time.perf_counter()
+  pipe = client.pipeline(transaction=False)
+  for i in range(args.length):
+    for key in keys:
+      pipe.zadd(key, {encode(rng.getrandbits(63), encoding): timestamp + i},
+                nx=True)
+    pipe.execute()
+  write_s = time.perf_counter() - start
+
+  start = time.perf_counter()
+  for _ in range(args.reads):
+    key = keys[rng.randrange(len(keys))]
+    [decode(member) for member in client.zrevrange(key, 0, args.page - 1)]
+  read_s = time.perf_counter() - start
+
+  memory = sum(client.memory_usage(key, samples=0) for key in keys)
+  client.delete(*keys)
+  return {
+      'bytes': memory / len(keys),
+      'zadd_per_s': args.timelines * args.length / write_s,
+      'read_per_s': args.reads / read_s,
+  }
+
+
+if __name__ == '__main__':
+
+  parser = argparse.ArgumentParser('Timeline encoding benchmark.')
+  parser.add_argument('--host', help='Redis host.', default='127.0.0.1')
+  parser.add_argument('--port', type=int, help='Redis port.', default=6379)
+  parser.add_argument('--timelines', type=int,
+                      help='number of timelines', default=1000)
+  parser.add_argument('--length', type=int,
+                      help='posts per timeline, 1000 is the default '
+                           'max_timeline_length', default=1000)
+  parser.add_argument('--page', type=int,
+                      help='posts per timeline read', default=10)
+  parser.add_argument('--reads', type=int,
+                      help='number of timeline reads', default=100000)
+  args = parser.parse_args()
+
+  client = redis.Redis(host=args.host, port=args.port)
+  print('{:>8} {:>14} {:>12} {:>12}'.format(
+      'encoding', 'bytes/timeline', 'ZADD/s', 'reads/s'))
+  for encoding in ('decimal', 'binary'):
+    result = run(client, encoding, args)
+    print('{:>8} {:>14.0f} {:>12.0f} {:>12.0f}'.format(
+        encoding, result['bytes'], result['zadd_per_s'], result['read_per_s']))
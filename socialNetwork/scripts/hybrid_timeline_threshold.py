@@ -0,0 +1,99 @@
+import argparse
+import os
+
+
+# Estimates the Redis work of hybrid push/pull home timelines on a bundled
+# social graph for a range of fan-out thresholds, to pick the
+# `fanout_threshold` of home-timeline-service for a deployment. Follows are
+# loaded like init_social_graph.py does: every edge is a follow both ways.
+# Every user is assumed to post and read at the same rate.
+
+
+def getNumNodes(file):
+  return int(file.readline())
+
+
+def getEdges(file):
+  edges = []
+  lines = file.readlines()
+  for line in lines:
+    edges.append(line.split())
+  return edges
+
+
+def getFollows(edges):
+  followers = {}
+  followees = {}
+  for edge in edges:
+    for user, followee in ((edge[0], edge[1]), (edge[1], edge[0])):
+      followers.setdefault(followee, set()).add(user)
+      followees.setdefault(user, set()).add(followee)
+  return followers, followees
+
+
+def percentile(values, q):
+  if not values:
+    return 0
+  values = sorted(values)
+  return values[min(len(values) - 1, int(q * len(values)))]
+
+
+def evaluate(nodes, followers, followees, threshold):
+  def is_pull(user):
+    return threshold > 0 and len(followers.get(user, ())) >= threshold
+
+  pull_users = {user for user in followers if is_pull(user)}
+  # ZADDs of a post: one per follower, or a single one into the pull
+  # timeline of its creator.
+  writes = [1 if user in pull_users else len(followers.get(user, ()))
+            for user in map(str, range(nodes))]
+  # Timelines merged by a read: the home timeline and the pull timelines
+  # of the followees. Reads also call GetFollowees once there are pull
+  # users at all.
+  reads = [1 + len(followees.get(user, set()) & pull_users)
+           for user in map(str, range(nodes))]
+  return {
+      'pull_users': len(pull_users),
+      'writes_mean': sum(writes) / len(writes),
+      'writes_max': max(writes),
+      'reads_mean': sum(reads) / len(reads),
+      'reads_p99': percentile(reads, 0.99),
+      'get_followees': 1 if pull_users else 0,
+  }
+
+
+if __name__ == '__main__':
+
+  parser = argparse.ArgumentParser(
+      'Hybrid home timeline fan-out threshold benchmark.')
+  parser.add_argument(
+      '--graph', help='Graph name. (`socfb-Reed98`, `ego-twitter`, or `soc-twitter-follows-mun`)', default='socfb-Reed98')
+  parser.add_argument('--thresholds', type=int, nargs='+',
+                      help='fan-out thresholds to evaluate, 0 pushes all posts',
+                      default=[0, 500, 200, 100, 50, 20, 10])
+  parser.add_argument('--reads-per-post', type=float,
+                      help='home timeline reads per composed post', default=10)
+  args = parser.parse_args()
+
+  with open(os.path.join('datasets/social-graph', args.graph, f'{args.graph}.nodes'), 'r') as f:
+    nodes = getNumNodes(f)
+  with open(os.path.join('datasets/social-graph', args.graph, f'{args.graph}.edges'), 'r') as f:
+    edges = getEdges(f)
+  followers, followees = getFollows(edges)
+
+  print('{:>10} {:>10} {:>12} {:>12} {:>12} {:>12} {:>14}'.format(
+      'threshold', 'pull users', 'ZADDs/post', 'max ZADDs', 'reads/read',
+      'p99 reads', 'ops/post'))
+  best = None
+  for threshold in args.thresholds:
+    result = evaluate(nodes, followers, followees, threshold)
+    # Redis commands and social graph calls per post and its reads.
+    ops = result['writes_mean'] + args.reads_per_post * (
+        result['reads_mean'] + result['get_followees'])
+    print('{:>10} {:>10} {:>12.1f} {:>12} {:>12.2f} {:>12} {:>14.1f}'.format(
+        threshold, result['pull_users'], result['writes_mean'],
+        result['writes_max'], result['reads_mean'], result['reads_p99'], ops))
+    if best is None or ops < best[1]:
+      best = (threshold, ops)
+  print('Lowest cost at {} reads per post: fanout_threshold = {}'.format(
+      args.reads_per_post, best[0]))
@@ -0,0 +1,80 @@
+import argparse
+import re
+import struct
+
+import redis
+
+
+# Re-encodes the post ids of the home or user timelines stored in a Redis to
+# the `timeline_encoding` of home-timeline-service and user-timeline-service.
+# The services read post ids of both encodings, so timelines can be migrated
+# while they are served: switch the config of the services first, then run
+# this against every timeline Redis. Each timeline is rewritten in a
+# transaction that is retried if the timeline changes meanwhile.
+
+TIMELINE_KEY = re.compile(rb'^(pull:)?\d+$')
+# Binary members are a 0x00 marker byte, which never starts a decimal
+# member, followed by the post id as 8 big-endian bytes.
+BINARY_MEMBER_MARKER = b'\x00'
+BINARY_MEMBER_SIZE = 9
+
+
+def decode(member):
+  if (len(member) == BINARY_MEMBER_SIZE and
+      member[:1] == BINARY_MEMBER_MARKER):
+    return struct.unpack('>q', member[1:])[0]
+  return int(member)
+
+
+def encode(post_id, encoding):
+  if encoding == 'binary':
+    return BINARY_MEMBER_MARKER + struct.pack('>q', post_id)
+  return str(post_id).encode()
+
+
+def migrate_timeline(client, key, encoding):
+  with client.pipeline() as pipe:
+    while True:
+      try:
+        pipe.watch(key)
+        entries = pipe.zrange(key, 0, -1, withscores=True)
+        updates = {}
+        for member, score in entries:
+          new_member = encode(decode(member), encoding)
+          if new_member != member:
+            updates[member] = (new_member, score)
+        if not updates:
+          pipe.unwatch()
+          return 0
+        pipe.multi()
+        pipe.zrem(key, *updates.keys())
+        pipe.zadd(key, {member: score for member, score in updates.values()})
+        pipe.execute()
+        return len(updates)
+      except redis.WatchError:
+        continue
+
+
+if __name__ == '__main__':
+
+  parser = argparse.ArgumentParser('Timeline post id encoding migration.')
+  parser.add_argument('--host', help='Redis host.', default='127.0.0.1')
+  parser.add_argument('--port', type=int, help='Redis port.', default=6379)
+  parser.add_argument('--to', choices=['binary', 'decimal'],
+                      help='encoding to migrate to', default='binary')
+  parser.add_argument('--scan-count', type=int,
+                      help='keys per SCAN call', default=1000)
+  args = parser.parse_args()
+
+  client = redis.Redis(host=args.host, port=args.port)
+  timelines = 0
+  members = 0
+  for key in client.scan_iter(count=args.scan_count, _type='zset'):
+    if not TIMELINE_KEY.match(key):
+      continue
+    members += migrate_timeline(client, key, args.to)
+    timelines += 1
+    if timelines % 10000 == 0:
+      print('{} timelines, {} post ids re-encoded'.format(timelines, members))
+  print('Done: {} timelines, {} post ids re-encoded to {}'.format(
+      timelines, members, args.to))
@@ -19,7 +19,8 @@ enum ErrorCode {
   SE_MONGODB_ERROR,
   SE_REDIS_ERROR,
   SE_THRIFT_HANDLER_ERROR,
-  SE_RABBITMQ_CONN_ERROR
+  SE_RABBITMQ_CONN_ERROR,
+  SE_SERVER_OVERLOADED
 }
 
 exception ServiceException {
@@ -166,6 +167,12 @@ service PostStorageService {
     2: list<i64> post_ids,
     3: map<string, string> carrier
   ) throws (1: ServiceException se)
+
+  void StorePosts(
+    1: i64 req_id,
+    2: list<Post> posts,
+    3: map<string, string> carrier
+  ) throws (1: ServiceException se)
 }
 
 service HomeTimelineService {
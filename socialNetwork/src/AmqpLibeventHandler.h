@@ -56,10 +56,32 @@ class AmqpLibeventHandler {
     return is_running_;
   }
 
+  // Runs fn on the event loop every interval_ms, e.g. to flush what the
+  // connection callbacks have buffered. Must be called before Start().
+  void SetInterval(int interval_ms, std::function<void()> fn)
+  {
+    interval_fn_ = std::move(fn);
+    interval_event_ = EventPtrT(
+        event_new(evbase_.get(), -1, EV_PERSIST, OnInterval, this),
+        event_free);
+    struct timeval interval;
+    interval.tv_sec = interval_ms / 1000;
+    interval.tv_usec = (interval_ms % 1000) * 1000;
+    event_add(interval_event_.get(), &interval);
+  }
+
  private:
+  static void OnInterval(evutil_socket_t fd, short events, void *arg)
+  {
+    static_cast<AmqpLibeventHandler *>(arg)->interval_fn_();
+  }
+
   EventBasePtrT evbase_;
   LibEventHandler evhandler_;
   bool is_running_;
+  std::function<void()> interval_fn_;
+  // Declared after evbase_, so that it is freed before the event base.
+  EventPtrT interval_event_;
 
 };
 
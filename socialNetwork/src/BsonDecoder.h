@@ -0,0 +1,219 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_BSONDECODER_H
+#define SOCIAL_NETWORK_MICROSERVICES_BSONDECODER_H
+
+#include <bson/bson.h>
+
+#include <cstring>
+#include <initializer_list>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "../gen-cpp/social_network_types.h"
+
+namespace social_network {
+
+// Decodes MongoDB documents straight into Thrift structs with the bson_iter
+// API, rather than printing them with bson_as_json and parsing the text
+// back. A struct is decodable once it has a DecodeBson(bson_iter_t *, T *)
+// overload, usually a single call to DecodeBsonFields naming its fields.
+// Decoding never throws: it returns false when a field is missing or holds
+// an unexpected BSON type, and the caller turns that into its own error.
+
+// Key of a document and the struct member it is decoded into.
+template <class T, class M>
+struct BsonField {
+  const char *key;
+  M T::*member;
+};
+
+template <class T, class M>
+BsonField<T, M> Field(const char *key, M T::*member) {
+  return BsonField<T, M>{key, member};
+}
+
+bool BsonRead(const bson_iter_t *iter, int64_t *value);
+bool BsonRead(const bson_iter_t *iter, int32_t *value);
+bool BsonRead(const bson_iter_t *iter, double *value);
+bool BsonRead(const bson_iter_t *iter, bool *value);
+bool BsonRead(const bson_iter_t *iter, std::string *value);
+
+template <class E>
+typename std::enable_if<std::is_enum<E>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, E *value);
+
+template <class T>
+bool BsonRead(const bson_iter_t *iter, std::vector<T> *value);
+
+template <class T>
+typename std::enable_if<std::is_class<T>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, T *value);
+
+// Decodes the keys of the document at iter that name a field into value.
+// Other keys are skipped. Returns whether every field was found and read.
+template <class T, class... M>
+bool DecodeBsonFields(bson_iter_t *iter, T *value,
+                      const BsonField<T, M> &... fields);
+
+// Decodes a whole document, e.g. one returned by a MongoDB cursor.
+template <class T>
+bool DecodeBson(const bson_t *doc, T *value);
+
+bool BsonRead(const bson_iter_t *iter, int64_t *value) {
+  switch (bson_iter_type(iter)) {
+    case BSON_TYPE_INT64:
+    case BSON_TYPE_INT32:
+    case BSON_TYPE_DOUBLE:
+      *value = bson_iter_as_int64(iter);
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool BsonRead(const bson_iter_t *iter, int32_t *value) {
+  int64_t value_64;
+  if (!BsonRead(iter, &value_64)) {
+    return false;
+  }
+  *value = static_cast<int32_t>(value_64);
+  return true;
+}
+
+bool BsonRead(const bson_iter_t *iter, double *value) {
+  if (!BSON_ITER_HOLDS_NUMBER(iter)) {
+    return false;
+  }
+  *value = bson_iter_as_double(iter);
+  return true;
+}
+
+bool BsonRead(const bson_iter_t *iter, bool *value) {
+  if (!BSON_ITER_HOLDS_BOOL(iter) && !BSON_ITER_HOLDS_NUMBER(iter)) {
+    return false;
+  }
+  *value = bson_iter_as_bool(iter);
+  return true;
+}
+
+bool BsonRead(const bson_iter_t *iter, std::string *value) {
+  if (!BSON_ITER_HOLDS_UTF8(iter)) {
+    return false;
+  }
+  uint32_t length;
+  const char *str = bson_iter_utf8(iter, &length);
+  value->assign(str, length);
+  return true;
+}
+
+template <class E>
+typename std::enable_if<std::is_enum<E>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, E *value) {
+  int32_t value_32;
+  if (!BsonRead(iter, &value_32)) {
+    return false;
+  }
+  *value = static_cast<E>(value_32);
+  return true;
+}
+
+template <class T>
+bool BsonRead(const bson_iter_t *iter, std::vector<T> *value) {
+  bson_iter_t child;
+  if (!BSON_ITER_HOLDS_ARRAY(iter) || !bson_iter_recurse(iter, &child)) {
+    return false;
+  }
+  value->clear();
+  while (bson_iter_next(&child)) {
+    value->emplace_back();
+    if (!BsonRead(&child, &value->back())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <class T>
+typename std::enable_if<std::is_class<T>::value, bool>::type BsonRead(
+    const bson_iter_t *iter, T *value) {
+  bson_iter_t child;
+  if (!BSON_ITER_HOLDS_DOCUMENT(iter) || !bson_iter_recurse(iter, &child)) {
+    return false;
+  }
+  return DecodeBson(&child, value);
+}
+
+template <class T, class M>
+void DecodeBsonField(const bson_iter_t *iter, const char *key, T *value,
+                     const BsonField<T, M> &field, bool *found,
+                     bool *failed) {
+  if (!*found && std::strcmp(key, field.key) == 0) {
+    *found = true;
+    *failed |= !BsonRead(iter, &(value->*field.member));
+  }
+}
+
+template <class T, class... M>
+bool DecodeBsonFields(bson_iter_t *iter, T *value,
+                      const BsonField<T, M> &... fields) {
+  bool found[sizeof...(M)] = {};
+  bool failed = false;
+  while (bson_iter_next(iter) && !failed) {
+    const char *key = bson_iter_key(iter);
+    size_t idx = 0;
+    (void)std::initializer_list<int>{
+        (DecodeBsonField(iter, key, value, fields, &found[idx++], &failed),
+         0)...};
+  }
+  for (bool field_found : found) {
+    failed |= !field_found;
+  }
+  return !failed;
+}
+
+template <class T>
+bool DecodeBson(const bson_t *doc, T *value) {
+  bson_iter_t iter;
+  return bson_iter_init(&iter, doc) && DecodeBson(&iter, value);
+}
+
+bool DecodeBson(bson_iter_t *iter, Creator *creator) {
+  return DecodeBsonFields(iter, creator,
+                          Field("user_id", &Creator::user_id),
+                          Field("username", &Creator::username));
+}
+
+bool DecodeBson(bson_iter_t *iter, Media *media) {
+  return DecodeBsonFields(iter, media,
+                          Field("media_id", &Media::media_id),
+                          Field("media_type", &Media::media_type));
+}
+
+bool DecodeBson(bson_iter_t *iter, UserMention *user_mention) {
+  return DecodeBsonFields(iter, user_mention,
+                          Field("user_id", &UserMention::user_id),
+                          Field("username", &UserMention::username));
+}
+
+bool DecodeBson(bson_iter_t *iter, Url *url) {
+  return DecodeBsonFields(iter, url,
+                          Field("shortened_url", &Url::shortened_url),
+                          Field("expanded_url", &Url::expanded_url));
+}
+
+bool DecodeBson(bson_iter_t *iter, Post *post) {
+  return DecodeBsonFields(iter, post,
+                          Field("post_id", &Post::post_id),
+                          Field("creator", &Post::creator),
+                          Field("req_id", &Post::req_id),
+                          Field("text", &Post::text),
+                          Field("user_mentions", &Post::user_mentions),
+                          Field("media", &Post::media),
+                          Field("urls", &Post::urls),
+                          Field("timestamp", &Post::timestamp),
+                          Field("post_type", &Post::post_type));
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_BSONDECODER_H
@@ -0,0 +1,231 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_CIRCUITBREAKER_H
+#define SOCIAL_NETWORK_MICROSERVICES_CIRCUITBREAKER_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <nlohmann/json.hpp>
+
+#include "logger.h"
+#include "Metrics.h"
+
+namespace social_network {
+using json = nlohmann::json;
+
+// Calls are counted over a sliding window of CIRCUIT_BREAKER_BUCKETS
+// buckets of CIRCUIT_BREAKER_BUCKET_MS each.
+#define CIRCUIT_BREAKER_BUCKETS 10
+#define CIRCUIT_BREAKER_BUCKET_MS 1000
+// Trial calls let through by a half-open breaker. All of them must succeed
+// for the breaker to close again.
+#define CIRCUIT_BREAKER_HALF_OPEN_CALLS 5
+
+struct CircuitBreakerOptions {
+  // Share of failed or slow calls in the window that opens the breaker,
+  // 0 disables the breaker.
+  double failure_rate = 0;
+  // Calls taking at least this long count as failed, 0 to only count
+  // errors.
+  int slow_call_ms = 0;
+  // The breaker does not open on fewer calls in the window than this.
+  int min_calls = 20;
+  // Time the breaker stays open before it lets trial calls through.
+  int open_ms = 5000;
+
+  // Reads the circuit_breaker_* keys of a service block of the config.
+  static CircuitBreakerOptions FromConfig(const json &service_config);
+};
+
+// Stops calls to a target whose recent calls mostly failed or were slow.
+// While closed, calls go through and their outcomes are counted. Once the
+// share of bad calls in the window reaches the failure rate, the breaker
+// opens and fails calls immediately for open_ms. Then, half open, it lets
+// a few trial calls through and closes again if they all succeed, or
+// re-opens otherwise.
+class CircuitBreaker {
+ public:
+  enum State { CLOSED = 0, OPEN = 1, HALF_OPEN = 2 };
+
+  CircuitBreaker(const std::string &name, const CircuitBreakerOptions &options);
+
+  CircuitBreaker(const CircuitBreaker&) = delete;
+  CircuitBreaker& operator=(const CircuitBreaker&) = delete;
+
+  // Returns false if the call must fail fast. A call that is allowed must
+  // report its outcome with Record().
+  bool Allow();
+  void Record(bool success, long latency_us);
+
+  State GetState() const { return _state.load(std::memory_order_acquire); }
+
+ private:
+  struct Bucket {
+    std::atomic<long> epoch{-1};
+    std::atomic<long> calls{0};
+    std::atomic<long> bad_calls{0};
+  };
+
+  static long _NowMs();
+  void _Count(bool bad, long now_ms);
+  bool _ShouldOpen(long now_ms) const;
+  void _SetState(State state, long now_ms);
+
+  const std::string _name;
+  const CircuitBreakerOptions _options;
+  std::atomic<State> _state{CLOSED};
+  Bucket _buckets[CIRCUIT_BREAKER_BUCKETS];
+
+  // State transitions and the half-open bookkeeping are guarded by _mtx.
+  std::mutex _mtx;
+  long _state_since_ms = 0;
+  int _trial_calls_left = 0;
+  int _trial_successes = 0;
+
+  std::atomic<long> *_state_gauge;
+  std::atomic<long> *_rejections;
+};
+
+CircuitBreakerOptions CircuitBreakerOptions::FromConfig(
+    const json &service_config) {
+  CircuitBreakerOptions options;
+  options.failure_rate = service_config["circuit_breaker_failure_rate"];
+  options.slow_call_ms = service_config["circuit_breaker_slow_call_ms"];
+  options.min_calls = service_config["circuit_breaker_min_calls"];
+  options.open_ms = service_config["circuit_breaker_open_ms"];
+  return options;
+}
+
+CircuitBreaker::CircuitBreaker(const std::string &name,
+                               const CircuitBreakerOptions &options)
+    : _name(name), _options(options) {
+  std::string labels = MetricLabel("target", name);
+  _state_gauge =
+      Metrics::GetInstance()->GetGauge("circuit_breaker_state", labels);
+  _rejections = Metrics::GetInstance()->GetCounter(
+      "circuit_breaker_rejections_total", labels);
+}
+
+long CircuitBreaker::_NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CircuitBreaker::Allow() {
+  if (_state.load(std::memory_order_acquire) == CLOSED) {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> lock(_mtx);
+  long now_ms = _NowMs();
+  State state = _state.load();
+  if (state == OPEN && now_ms - _state_since_ms >= _options.open_ms) {
+    _SetState(HALF_OPEN, now_ms);
+    state = HALF_OPEN;
+  }
+  // Trial calls that never reported back, e.g. because they timed out in
+  // the pool, must not keep the breaker half open forever.
+  if (state == HALF_OPEN && _trial_calls_left == 0 &&
+      now_ms - _state_since_ms >= _options.open_ms) {
+    _SetState(HALF_OPEN, now_ms);
+  }
+  if (state == CLOSED) {
+    return true;
+  }
+  if (state == HALF_OPEN && _trial_calls_left > 0) {
+    _trial_calls_left--;
+    return true;
+  }
+  (*_rejections)++;
+  return false;
+}
+
+void CircuitBreaker::Record(bool success, long latency_us) {
+  bool bad = !success || (_options.slow_call_ms > 0 &&
+                          latency_us >= _options.slow_call_ms * 1000l);
+  State state = _state.load(std::memory_order_acquire);
+  long now_ms = _NowMs();
+
+  if (state == HALF_OPEN) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_state.load() != HALF_OPEN) {
+      return;
+    }
+    if (bad) {
+      _SetState(OPEN, now_ms);
+    } else if (++_trial_successes >= CIRCUIT_BREAKER_HALF_OPEN_CALLS) {
+      _SetState(CLOSED, now_ms);
+    }
+    return;
+  }
+  if (state == OPEN) {
+    // A call that was let through before the breaker opened.
+    return;
+  }
+
+  _Count(bad, now_ms);
+  // Only a bad call can push the rate over the threshold.
+  if (bad && _ShouldOpen(now_ms)) {
+    std::lock_guard<std::mutex> lock(_mtx);
+    if (_state.load() == CLOSED) {
+      _SetState(OPEN, now_ms);
+    }
+  }
+}
+
+void CircuitBreaker::_Count(bool bad, long now_ms) {
+  long epoch = now_ms / CIRCUIT_BREAKER_BUCKET_MS;
+  Bucket &bucket = _buckets[epoch % CIRCUIT_BREAKER_BUCKETS];
+  long bucket_epoch = bucket.epoch.load(std::memory_order_acquire);
+  // The first call of a new period recycles the bucket. Calls racing with
+  // the reset may be lost, which the rate tolerates.
+  if (bucket_epoch != epoch &&
+      bucket.epoch.compare_exchange_strong(bucket_epoch, epoch)) {
+    bucket.calls = 0;
+    bucket.bad_calls = 0;
+  }
+  bucket.calls.fetch_add(1, std::memory_order_relaxed);
+  if (bad) {
+    bucket.bad_calls.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+bool CircuitBreaker::_ShouldOpen(long now_ms) const {
+  long epoch = now_ms / CIRCUIT_BREAKER_BUCKET_MS;
+  long calls = 0;
+  long bad_calls = 0;
+  for (const Bucket &bucket : _buckets) {
+    if (epoch - bucket.epoch.load(std::memory_order_acquire) <
+        CIRCUIT_BREAKER_BUCKETS) {
+      calls += bucket.calls.load(std::memory_order_relaxed);
+      bad_calls += bucket.bad_calls.load(std::memory_order_relaxed);
+    }
+  }
+  return calls >= _options.min_calls &&
+      bad_calls >= _options.failure_rate * calls;
+}
+
+void CircuitBreaker::_SetState(State state, long now_ms) {
+  State old_state = _state.load();
+  _state_since_ms = now_ms;
+  _trial_calls_left = state == HALF_OPEN ? CIRCUIT_BREAKER_HALF_OPEN_CALLS : 0;
+  _trial_successes = 0;
+  if (state == CLOSED) {
+    // Start from a clean window, the calls that opened the breaker are
+    // stale.
+    for (Bucket &bucket : _buckets) {
+      bucket.epoch = -1;
+    }
+  }
+  _state.store(state, std::memory_order_release);
+  *_state_gauge = state;
+  if (state == OPEN && old_state != OPEN) {
+    LOG(warning) << "Circuit breaker of " << _name << " opened";
+  } else if (state == CLOSED) {
+    LOG(info) << "Circuit breaker of " << _name << " closed";
+  }
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_CIRCUITBREAKER_H
@@ -1,25 +1,80 @@
 #ifndef SOCIAL_NETWORK_MICROSERVICES_CLIENTPOOL_H
 #define SOCIAL_NETWORK_MICROSERVICES_CLIENTPOOL_H
 
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <sched.h>
+
+#include <algorithm>
+#include <atomic>
 #include <vector>
+#include <memory>
 #include <mutex>
 #include <condition_variable>
 #include <deque>
+#include <exception>
+#include <functional>
+#include <limits>
 #include <chrono>
+#include <random>
 #include <string>
+#include <thread>
+#include <utility>
 #include <nlohmann/json.hpp>
 
+#include "CircuitBreaker.h"
+#include "Deadline.h"
+#include "Executor.h"
 #include "logger.h"
+#include "Metrics.h"
 
 namespace social_network {
 using json = nlohmann::json;
 
+// When the pool is split into several shards, a waiter re-scans the other
+// shards at this interval in case a client was pushed to a shard it is not
+// sleeping on.
+#define CLIENT_POOL_STEAL_INTERVAL_MS 5
+// Weight of the latest call in the moving latency average of an endpoint.
+#define CLIENT_POOL_LATENCY_EWMA_WEIGHT 0.1
+// The hedge delay is only updated from maintenance intervals with at least
+// this many calls.
+#define CLIENT_POOL_HEDGE_MIN_SAMPLES 100
+// Hedges that an idle pool may save up to spend on a burst.
+#define CLIENT_POOL_HEDGE_BURST 10
+
+// One replica of the target of a pool. Clients keep a reference to the
+// endpoint they connect to, so that their calls are accounted to it.
+struct ClientEndpoint {
+  ClientEndpoint(const std::string &addr, int port) : addr(addr), port(port) {}
+
+  // Whether the breaker keeps calls away from the endpoint.
+  bool Ejected() const {
+    return breaker && breaker->GetState() != CircuitBreaker::CLOSED;
+  }
+
+  const std::string addr;
+  const int port;
+  // Calls currently running on the endpoint.
+  std::atomic<int> in_flight{0};
+  // Clients of the pool that connect to the endpoint.
+  std::atomic<int> clients{0};
+  // Moving average of the call latency, 0 until the first call returns.
+  std::atomic<long> latency_us{0};
+  // Set once the endpoint is no longer resolved. Its clients are dropped
+  // as they come back to the pool.
+  std::atomic<bool> removed{false};
+  // Ejects the endpoint while its calls fail, if enabled.
+  std::unique_ptr<CircuitBreaker> breaker;
+};
+
 template<class TClient>
 class ClientPool {
  public:
+  // addr is a host or a comma-separated list of host[:port] replicas.
   ClientPool(const std::string &client_type, const std::string &addr,
       int port, int min_size, int max_size, int timeout_ms, int keepalive_ms,
-      const json &config_json);
+      const json &config_json, int num_shards = 1);
   ~ClientPool();
 
   ClientPool(const ClientPool&) = delete;
@@ -28,87 +83,408 @@ class ClientPool {
   ClientPool& operator=(ClientPool&&) = default;
 
   TClient * Pop();
+  // Waits for a client no longer than the deadline of the request allows,
+  // and bounds the I/O of the client by the time left. Throws a
+  // ServiceException if the deadline has already passed.
+  TClient * Pop(const Deadline &deadline);
   void Push(TClient *);
+  // Returns a client after a successful call.
   void Keepalive(TClient *);
+  // Drops a client after a failed call.
   void Remove(TClient *);
 
+  // Starts a background thread that every interval_ms opens connections up
+  // to min_size, replaces idle clients that are within refresh_ahead_ms of
+  // their keepalive deadline, and probes idle sockets, so that Pop() does
+  // not pay for a handshake on the request path.
+  void StartMaintenance(int interval_ms, int refresh_ahead_ms);
+
+  // Puts a circuit breaker in front of every endpoint. Calls are judged by
+  // whether the client comes back through Keepalive() or Remove(), and
+  // how long after Pop(). An endpoint whose breaker is open gets no calls;
+  // once all of them are open, Pop() returns nullptr right away. Must be
+  // called before the pool is used.
+  void EnableCircuitBreaker(const CircuitBreakerOptions &options);
+
+  // Balances over every address the hosts resolve to, e.g. all replicas
+  // behind a headless service, instead of the first one the resolver
+  // returns. The hosts are resolved again every interval_ms on the
+  // maintenance thread. Must be called before StartMaintenance().
+  void EnableResolution(int interval_ms);
+
+  // Lets HedgedCall() send a second copy of a call that has not returned
+  // after the given percentile of the recent call latency, e.g. 0.95. The
+  // hedges are capped at the budget, a fraction of the calls, e.g. 0.05.
+  // The percentile is measured on the maintenance thread; must be called
+  // before StartMaintenance().
+  void EnableHedging(double percentile, double budget);
+
+  // Runs call with a client of the pool and returns its result, or throws
+  // what it threw, after handing the client back. A ServiceException is
+  // thrown if no client can be had. With hedging enabled, a slow call is
+  // sent again on another client and the first response wins; the other
+  // one is ignored and its client returns to the pool once it is done. So
+  // call must be idempotent and must not capture the caller's stack by
+  // reference.
+  template<class TResult>
+  TResult HedgedCall(const Deadline &deadline,
+                     std::function<TResult(TClient *)> call);
+
  private:
-  std::deque<TClient *> _pool;
-  std::string _addr;
+  // Each shard owns a free list guarded by its own lock, so threads running
+  // on different cores do not contend on a single mutex.
+  struct Shard {
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<TClient *> pool;
+    std::atomic<int> waiters{0};
+  };
+
+  // Shared by the copies of a hedged call, which may outlive the caller.
+  template<class TResult>
+  struct HedgedCallState {
+    std::mutex mtx;
+    std::condition_variable cv;
+    int pending = 0;
+    bool done = false;
+    TResult result;
+    std::exception_ptr error;
+  };
+
+  using EndpointList = std::vector<std::shared_ptr<ClientEndpoint>>;
+
+  size_t _HomeShard() const;
+  // Waits until deadline for a client. The client's I/O is bounded by what
+  // is left of call_deadline once the client is available, if it is set.
+  TClient * _Pop(std::chrono::system_clock::time_point deadline,
+                 const Deadline &call_deadline);
+  TClient * _TryPop(size_t shard_idx, bool blocking,
+                    const ClientEndpoint *endpoint = nullptr);
+  bool _TryGrow();
+  void _Discard(TClient *);
+  size_t _WaitingShard(size_t home_idx) const;
+  void _Maintain();
+  void _MaintainShard(size_t shard_idx);
+  TClient * _NewClient(const std::shared_ptr<ClientEndpoint> &endpoint);
+  TClient * _NewConnectedClient(
+      const std::shared_ptr<ClientEndpoint> &endpoint);
+  void _DeleteClient(TClient *);
+
+  std::shared_ptr<const EndpointList> _Endpoints() const;
+  std::shared_ptr<ClientEndpoint> _NewEndpoint(const std::string &addr,
+                                               int port) const;
+  void _AttachBreaker(ClientEndpoint *endpoint) const;
+  std::shared_ptr<ClientEndpoint> _PickEndpoint(
+      const EndpointList &endpoints) const;
+  std::shared_ptr<ClientEndpoint> _LeastConnectedEndpoint() const;
+  bool _Usable(TClient *client, const ClientEndpoint &preferred,
+               size_t num_endpoints) const;
+  void _Resolve();
+  template<class TResult>
+  TResult _Call(const Deadline &deadline,
+                const std::function<TResult(TClient *)> &call);
+  bool _TakeHedgeToken();
+  void _UpdateHedgeDelay();
+
+  std::vector<std::unique_ptr<Shard>> _shards;
   std::string _client_type;
-  int _port;
+  std::vector<std::pair<std::string, int>> _targets;
+  // Replaced as a whole when the targets resolve differently, so that
+  // Pop() reads it without a lock.
+  std::shared_ptr<const EndpointList> _endpoints;
+  CircuitBreakerOptions _breaker_options;
+  int _resolve_interval_ms{};
+  std::chrono::steady_clock::time_point _next_resolve;
+  double _hedge_percentile{};
+  long _hedge_budget_milli{};
+  std::atomic<long> _hedge_tokens_milli{0};
+  std::atomic<long> _hedge_delay_us{0};
+  // Latency of the calls, recorded into one window while the maintenance
+  // thread reads the other.
+  std::unique_ptr<Histogram> _call_us[2];
+  std::atomic<int> _call_us_window{0};
   int _min_pool_size{};
   int _max_pool_size{};
-  int _curr_pool_size{};
+  std::atomic<int> _curr_pool_size{};
   int _timeout_ms;
   int _keepalive_ms;
-  std::mutex _mtx;
-  std::condition_variable _cv;
   const json *_config_json;
 
+  std::thread _maintenance_thread;
+  std::mutex _maintenance_mtx;
+  std::condition_variable _maintenance_cv;
+  bool _maintenance_stop{false};
+  int _maintenance_interval_ms{};
+  int _refresh_ahead_ms{};
+
+  Histogram *_wait_us;
+  std::atomic<long> *_timeouts;
+  std::atomic<long> *_num_endpoints;
+  std::atomic<long> *_hedge_delay_gauge;
+  std::atomic<long> *_hedges;
+  std::atomic<long> *_hedge_wins;
 };
 
 template<class TClient>
 ClientPool<TClient>::ClientPool(const std::string &client_type,
     const std::string &addr, int port, int min_pool_size,
     int max_pool_size, int timeout_ms, int keepalive_ms,
-    const json &config_json) {
-  _addr = addr;
-  _port = port;
+    const json &config_json, int num_shards) {
   _min_pool_size = min_pool_size;
   _max_pool_size = max_pool_size;
   _timeout_ms = timeout_ms;
   _client_type = client_type;
   _keepalive_ms = keepalive_ms;
   _config_json = &config_json;
+  _wait_us = Metrics::GetInstance()->GetHistogram(
+      "client_pool_wait_us", MetricLabel("pool", client_type));
+  _timeouts = Metrics::GetInstance()->GetCounter(
+      "client_pool_timeouts_total", MetricLabel("pool", client_type));
+  _num_endpoints = Metrics::GetInstance()->GetGauge(
+      "client_pool_endpoints", MetricLabel("pool", client_type));
+  _hedge_delay_gauge = Metrics::GetInstance()->GetGauge(
+      "client_pool_hedge_delay_us", MetricLabel("pool", client_type));
+  _hedges = Metrics::GetInstance()->GetCounter(
+      "client_pool_hedges_total", MetricLabel("pool", client_type));
+  _hedge_wins = Metrics::GetInstance()->GetCounter(
+      "client_pool_hedge_wins_total", MetricLabel("pool", client_type));
+
+  size_t begin = 0;
+  while (begin <= addr.size()) {
+    size_t end = addr.find(',', begin);
+    if (end == std::string::npos) {
+      end = addr.size();
+    }
+    std::string target = addr.substr(begin, end - begin);
+    target.erase(0, target.find_first_not_of(' '));
+    target.erase(target.find_last_not_of(' ') + 1);
+    size_t colon = target.find(':');
+    if (colon == std::string::npos) {
+      _targets.emplace_back(target, port);
+    } else {
+      _targets.emplace_back(target.substr(0, colon),
+                            std::stoi(target.substr(colon + 1)));
+    }
+    begin = end + 1;
+  }
+  auto endpoints = std::make_shared<EndpointList>();
+  for (auto &target : _targets) {
+    endpoints->emplace_back(_NewEndpoint(target.first, target.second));
+  }
+  _endpoints = endpoints;
+  *_num_endpoints = endpoints->size();
+
+  if (num_shards < 1) {
+    num_shards = 1;
+  }
+  for (int i = 0; i < num_shards; ++i) {
+    _shards.emplace_back(new Shard());
+  }
 
   for (int i = 0; i < min_pool_size; ++i) {
-    TClient *client = new TClient(addr, port, keepalive_ms, config_json);
-    _pool.emplace_back(client);
+    TClient *client = _NewClient((*endpoints)[i % endpoints->size()]);
+    _shards[i % num_shards]->pool.emplace_back(client);
   }
   _curr_pool_size = min_pool_size;
 }
 
 template<class TClient>
 ClientPool<TClient>::~ClientPool() {
-  while (!_pool.empty()) {
-    delete _pool.front();
-    _pool.pop_front();
+  if (_maintenance_thread.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(_maintenance_mtx);
+      _maintenance_stop = true;
+    }
+    _maintenance_cv.notify_all();
+    _maintenance_thread.join();
   }
+  for (auto &shard : _shards) {
+    while (!shard->pool.empty()) {
+      _DeleteClient(shard->pool.front());
+      shard->pool.pop_front();
+    }
+  }
+}
+
+template<class TClient>
+size_t ClientPool<TClient>::_HomeShard() const {
+  if (_shards.size() == 1) {
+    return 0;
+  }
+  int cpu = sched_getcpu();
+  if (cpu >= 0) {
+    return static_cast<size_t>(cpu) % _shards.size();
+  }
+  return std::hash<std::thread::id>()(std::this_thread::get_id()) %
+      _shards.size();
+}
+
+template<class TClient>
+TClient * ClientPool<TClient>::_TryPop(size_t shard_idx, bool blocking,
+                                       const ClientEndpoint *endpoint) {
+  Shard &shard = *_shards[shard_idx];
+  std::unique_lock<std::mutex> lock(shard.mtx, std::defer_lock);
+  if (blocking) {
+    lock.lock();
+  } else if (!lock.try_lock()) {
+    return nullptr;
+  }
+  // Without an endpoint given, any idle client will do.
+  auto it = shard.pool.begin();
+  if (endpoint) {
+    it = std::find_if(shard.pool.begin(), shard.pool.end(),
+        [endpoint](TClient *client) {
+          return client->_endpoint.get() == endpoint; });
+  }
+  if (it == shard.pool.end()) {
+    return nullptr;
+  }
+  TClient *client = *it;
+  shard.pool.erase(it);
+  return client;
+}
+
+template<class TClient>
+bool ClientPool<TClient>::_TryGrow() {
+  int curr = _curr_pool_size.load();
+  while (curr < _max_pool_size) {
+    if (_curr_pool_size.compare_exchange_weak(curr, curr + 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<class TClient>
+size_t ClientPool<TClient>::_WaitingShard(size_t home_idx) const {
+  for (size_t i = 0; i < _shards.size(); ++i) {
+    size_t idx = (home_idx + i) % _shards.size();
+    if (_shards[idx]->waiters.load() > 0) {
+      return idx;
+    }
+  }
+  return home_idx;
 }
 
 template<class TClient>
 TClient * ClientPool<TClient>::Pop() {
+  return _Pop(std::chrono::system_clock::now() +
+      std::chrono::milliseconds(_timeout_ms), Deadline());
+}
+
+template<class TClient>
+TClient * ClientPool<TClient>::Pop(const Deadline &deadline) {
+  auto pool_deadline = std::chrono::system_clock::now() +
+      std::chrono::milliseconds(_timeout_ms);
+  if (!deadline.IsSet()) {
+    return _Pop(pool_deadline, deadline);
+  }
+  deadline.Check();
+  return _Pop(std::min(pool_deadline, deadline.TimePoint()), deadline);
+}
+
+template<class TClient>
+TClient * ClientPool<TClient>::_Pop(
+    std::chrono::system_clock::time_point deadline,
+    const Deadline &call_deadline) {
+  std::shared_ptr<const EndpointList> endpoints = _Endpoints();
+  std::shared_ptr<ClientEndpoint> endpoint = _PickEndpoint(*endpoints);
+  if (!endpoint) {
+    return nullptr;
+  }
+  // Idle clients of other endpoints are only a fallback.
+  const ClientEndpoint *preferred = endpoint.get();
+  size_t num_endpoints = endpoints->size();
   TClient * client = nullptr;
-  {
-    std::unique_lock<std::mutex> cv_lock(_mtx);
-    while (_pool.size() == 0 && _curr_pool_size == _max_pool_size) {
-      // Create a new a client if current pool size is less than
-      // the max pool size.
-      auto wait_time = std::chrono::system_clock::now() +
-          std::chrono::milliseconds(_timeout_ms);
-      bool wait_success = _cv.wait_until(cv_lock, wait_time,
-            [this] { return _pool.size() > 0 || _curr_pool_size < _max_pool_size; });
-      if (!wait_success) {
-        LOG(warning) << "ClientPool pop timeout";
-        LOG(info) << _pool.size() << " " << _curr_pool_size;
-        cv_lock.unlock();
-        return nullptr;
+  size_t home_idx = _HomeShard();
+  size_t num_shards = _shards.size();
+  auto start = std::chrono::steady_clock::now();
+
+  while (!client) {
+    // Take an idle client from the home shard first, then steal from others.
+    client = _TryPop(home_idx, true, preferred);
+    for (size_t i = 1; !client && i < num_shards; ++i) {
+      client = _TryPop((home_idx + i) % num_shards, false, preferred);
+    }
+    if (client) {
+      break;
+    }
+
+    // Create a new a client if current pool size is less than
+    // the max pool size.
+    if (_TryGrow()) {
+      try {
+        client = _NewClient(endpoint);
+      } catch (...) {
+        _curr_pool_size--;
+        if (endpoint->breaker) {
+          endpoint->breaker->Record(false, 0);
+        }
+        throw;
       }
+      break;
     }
-    if (_pool.size() > 0) {
-      client = _pool.front();
-      _pool.pop_front();
-    } else {
-      client = new TClient(_addr, _port, _keepalive_ms, *_config_json);
-      _curr_pool_size++;
+
+    // The pool is full and has no idle client of the chosen endpoint. Use
+    // an idle client of another one, or make room for a new client if that
+    // endpoint is gone or ejected.
+    client = _TryPop(home_idx, true);
+    for (size_t i = 1; !client && i < num_shards; ++i) {
+      client = _TryPop((home_idx + i) % num_shards, false);
+    }
+    if (client && !_Usable(client, *preferred, num_endpoints)) {
+      _DeleteClient(client);
+      _curr_pool_size--;
+      client = nullptr;
+      continue;
+    }
+    if (client) {
+      break;
     }
-  cv_lock.unlock();
-  } // cv_lock(_mtx)
 
+    Shard &home = *_shards[home_idx];
+    std::unique_lock<std::mutex> cv_lock(home.mtx);
+    auto wait_time = deadline;
+    if (num_shards > 1) {
+      wait_time = std::min(deadline, std::chrono::system_clock::now() +
+          std::chrono::milliseconds(CLIENT_POOL_STEAL_INTERVAL_MS));
+    }
+    home.waiters++;
+    bool wait_success = home.cv.wait_until(cv_lock, wait_time,
+        [&] { return home.pool.size() > 0 ||
+            _curr_pool_size.load() < _max_pool_size; });
+    home.waiters--;
+    if (!wait_success && std::chrono::system_clock::now() >= deadline) {
+      (*_timeouts)++;
+      LOG(warning) << "ClientPool pop timeout";
+      LOG(info) << home.pool.size() << " " << _curr_pool_size.load();
+      return nullptr;
+    }
+    if (home.pool.size() > 0) {
+      client = home.pool.front();
+      home.pool.pop_front();
+    }
+    cv_lock.unlock();
+    if (client && !_Usable(client, *preferred, num_endpoints)) {
+      _DeleteClient(client);
+      _curr_pool_size--;
+      client = nullptr;
+    }
+  }
+  _wait_us->Record(std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count());
 
   if (client) {
+    // The budget is taken after the wait for the client, and never drops to
+    // 0, which would turn the socket timeouts off once the deadline passed.
+    int io_timeout_ms = 0;
+    if (call_deadline.IsSet()) {
+      io_timeout_ms = std::max(call_deadline.RemainingMs(), 1l);
+    }
+    client->_pop_time = std::chrono::steady_clock::now();
+    client->_endpoint->in_flight++;
     try {
+      client->SetTimeout(io_timeout_ms);
       client->Connect();
     } catch (...) {
       LOG(error) << "Failed to connect " + _client_type;
@@ -121,34 +497,532 @@ TClient * ClientPool<TClient>::Pop() {
 
 template<class TClient>
 void ClientPool<TClient>::Push(TClient *client) {
-  std::unique_lock<std::mutex> cv_lock(_mtx);
-  _pool.push_back(client);
+  // Hand the client to a shard that has a waiter, falling back to the
+  // caller's home shard.
+  Shard &shard = *_shards[_WaitingShard(_HomeShard())];
+  std::unique_lock<std::mutex> cv_lock(shard.mtx);
+  shard.pool.push_back(client);
   cv_lock.unlock();
-  _cv.notify_one();
+  shard.cv.notify_one();
 }
 
 template<class TClient>
 void ClientPool<TClient>::Remove(TClient *client) {
-  // No need to delete it from _pool because the *client has been poped out
-  delete client;
-  std::unique_lock<std::mutex> cv_lock(_mtx);
+  if (client) {
+    client->_endpoint->in_flight--;
+    if (client->_endpoint->breaker) {
+      client->_endpoint->breaker->Record(false, 0);
+    }
+  }
+  _Discard(client);
+}
+
+template<class TClient>
+void ClientPool<TClient>::_Discard(TClient *client) {
+  // No need to delete it from the shards because the *client has been
+  // poped out
+  _DeleteClient(client);
   _curr_pool_size--;
+  Shard &shard = *_shards[_WaitingShard(_HomeShard())];
+  std::unique_lock<std::mutex> cv_lock(shard.mtx);
   cv_lock.unlock();
-  _cv.notify_one();
+  shard.cv.notify_one();
 }
 
 template<class TClient>
 void ClientPool<TClient>::Keepalive(TClient *client) {
+  ClientEndpoint &endpoint = *client->_endpoint;
+  long latency_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - client->_pop_time).count();
+  endpoint.in_flight--;
+  // Concurrent updates may lose a sample, which the average tolerates.
+  long avg_us = endpoint.latency_us.load(std::memory_order_relaxed);
+  endpoint.latency_us.store(avg_us == 0 ? latency_us : static_cast<long>(
+      avg_us + CLIENT_POOL_LATENCY_EWMA_WEIGHT * (latency_us - avg_us)),
+      std::memory_order_relaxed);
+  if (endpoint.breaker) {
+    endpoint.breaker->Record(true, latency_us);
+  }
+  if (_hedge_percentile > 0) {
+    _call_us[_call_us_window.load(std::memory_order_relaxed)]->Record(
+        latency_us);
+  }
   long curr_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
           std::chrono::system_clock::now().time_since_epoch()).count();
-  if (curr_timestamp - client->_connect_timestamp > client->_keepalive_ms) {
-    Remove(client);
+  if (curr_timestamp - client->_connect_timestamp > client->_keepalive_ms ||
+      endpoint.removed) {
+    _Discard(client);
   } else {
     Push(client);
   }
 }
 
+template<class TClient>
+void ClientPool<TClient>::StartMaintenance(int interval_ms,
+                                           int refresh_ahead_ms) {
+  if ((interval_ms <= 0 && _resolve_interval_ms <= 0) ||
+      _maintenance_thread.joinable()) {
+    return;
+  }
+  _maintenance_interval_ms = interval_ms;
+  _refresh_ahead_ms = refresh_ahead_ms;
+  _maintenance_thread = std::thread(&ClientPool<TClient>::_Maintain, this);
+}
+
+template<class TClient>
+void ClientPool<TClient>::EnableCircuitBreaker(
+    const CircuitBreakerOptions &options) {
+  _breaker_options = options;
+  if (options.failure_rate <= 0) {
+    return;
+  }
+  for (auto &endpoint : *_Endpoints()) {
+    _AttachBreaker(endpoint.get());
+  }
+}
+
+template<class TClient>
+void ClientPool<TClient>::EnableResolution(int interval_ms) {
+  if (interval_ms <= 0) {
+    return;
+  }
+  // Certificates name the service, not the addresses of its replicas.
+  bool ssl_enabled = (*_config_json)["ssl"]["enabled"];
+  if (ssl_enabled) {
+    LOG(warning) << "Not resolving the endpoints of " << _client_type
+                 << " with SSL enabled";
+    return;
+  }
+  _resolve_interval_ms = interval_ms;
+  _Resolve();
+  _next_resolve = std::chrono::steady_clock::now() +
+      std::chrono::milliseconds(_resolve_interval_ms);
+}
+
+template<class TClient>
+void ClientPool<TClient>::EnableHedging(double percentile, double budget) {
+  if (percentile <= 0 || budget <= 0) {
+    return;
+  }
+  _call_us[0].reset(new Histogram());
+  _call_us[1].reset(new Histogram());
+  _hedge_budget_milli = static_cast<long>(budget * 1000);
+  _hedge_percentile = std::min(percentile, 1.0);
+}
+
+template<class TClient>
+template<class TResult>
+TResult ClientPool<TClient>::HedgedCall(
+    const Deadline &deadline, std::function<TResult(TClient *)> call) {
+  long delay_us = _hedge_delay_us.load(std::memory_order_relaxed);
+  if (delay_us <= 0) {
+    return _Call(deadline, call);
+  }
+
+  // Every call earns its share of a hedge.
+  long tokens = _hedge_tokens_milli.load(std::memory_order_relaxed);
+  while (tokens < CLIENT_POOL_HEDGE_BURST * 1000 &&
+         !_hedge_tokens_milli.compare_exchange_weak(
+             tokens, std::min(tokens + _hedge_budget_milli,
+                              CLIENT_POOL_HEDGE_BURST * 1000l))) {}
+
+  auto state = std::make_shared<HedgedCallState<TResult>>();
+  auto attempt = [this, state, deadline, call](bool hedge) {
+    try {
+      TResult result = _Call(deadline, call);
+      std::lock_guard<std::mutex> lock(state->mtx);
+      if (!state->done) {
+        state->done = true;
+        state->result = std::move(result);
+        if (hedge) {
+          (*_hedge_wins)++;
+        }
+      }
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(state->mtx);
+      if (!state->error) {
+        state->error = std::current_exception();
+      }
+    }
+    std::lock_guard<std::mutex> lock(state->mtx);
+    state->pending--;
+    state->cv.notify_all();
+  };
+
+  state->pending = 1;
+  if (!Executor::GetInstance()->Post([attempt]() { attempt(false); })) {
+    // No worker to run the call on, e.g. on a worker itself: call without
+    // hedging.
+    return _Call(deadline, call);
+  }
+
+  std::unique_lock<std::mutex> lock(state->mtx);
+  auto finished = [&state]() { return state->done || state->pending == 0; };
+  if (!state->cv.wait_for(lock, std::chrono::microseconds(delay_us),
+                          finished) && _TakeHedgeToken()) {
+    state->pending++;
+    if (Executor::GetInstance()->Post([attempt]() { attempt(true); })) {
+      (*_hedges)++;
+    } else {
+      state->pending--;
+    }
+  }
+  state->cv.wait(lock, finished);
+  if (state->done) {
+    return std::move(state->result);
+  }
+  std::rethrow_exception(state->error);
+}
+
+template<class TClient>
+template<class TResult>
+TResult ClientPool<TClient>::_Call(
+    const Deadline &deadline, const std::function<TResult(TClient *)> &call) {
+  TClient *client = Pop(deadline);
+  if (!client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
+    se.message = "Failed to connect to " + _client_type;
+    throw se;
+  }
+  TResult result;
+  try {
+    result = call(client);
+  } catch (...) {
+    Remove(client);
+    throw;
+  }
+  Keepalive(client);
+  return result;
+}
+
+template<class TClient>
+bool ClientPool<TClient>::_TakeHedgeToken() {
+  long tokens = _hedge_tokens_milli.load(std::memory_order_relaxed);
+  while (tokens >= 1000) {
+    if (_hedge_tokens_milli.compare_exchange_weak(tokens, tokens - 1000)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<class TClient>
+void ClientPool<TClient>::_UpdateHedgeDelay() {
+  // Start recording into the other window and read the one just closed.
+  int window = _call_us_window.load();
+  _call_us[1 - window]->Reset();
+  _call_us_window = 1 - window;
+  Histogram &call_us = *_call_us[window];
+  if (call_us.Count() >= CLIENT_POOL_HEDGE_MIN_SAMPLES) {
+    _hedge_delay_us = call_us.Quantile(_hedge_percentile);
+    *_hedge_delay_gauge = _hedge_delay_us.load();
+  }
+}
+
+template<class TClient>
+std::shared_ptr<const typename ClientPool<TClient>::EndpointList>
+ClientPool<TClient>::_Endpoints() const {
+  return std::atomic_load(&_endpoints);
+}
+
+template<class TClient>
+std::shared_ptr<ClientEndpoint> ClientPool<TClient>::_NewEndpoint(
+    const std::string &addr, int port) const {
+  auto endpoint = std::make_shared<ClientEndpoint>(addr, port);
+  if (_breaker_options.failure_rate > 0) {
+    _AttachBreaker(endpoint.get());
+  }
+  return endpoint;
+}
+
+template<class TClient>
+void ClientPool<TClient>::_AttachBreaker(ClientEndpoint *endpoint) const {
+  // With several replicas, their breakers are told apart by address.
+  std::string name = _client_type;
+  if (_resolve_interval_ms > 0 || _targets.size() > 1) {
+    name += "@" + endpoint->addr + ":" + std::to_string(endpoint->port);
+  }
+  endpoint->breaker.reset(new CircuitBreaker(name, _breaker_options));
+}
+
+template<class TClient>
+std::shared_ptr<ClientEndpoint> ClientPool<TClient>::_PickEndpoint(
+    const EndpointList &endpoints) const {
+  auto allows = [](const ClientEndpoint &endpoint) {
+    return !endpoint.breaker || endpoint.breaker->Allow();
+  };
+  size_t num_endpoints = endpoints.size();
+  if (num_endpoints == 1) {
+    return allows(*endpoints[0]) ? endpoints[0] : nullptr;
+  }
+
+  // Power of two choices: of two random endpoints, take the one with less
+  // work outstanding, weighted by how fast it has been answering. Ejected
+  // endpoints come last.
+  auto load = [](const ClientEndpoint &endpoint) {
+    if (endpoint.Ejected()) {
+      return std::numeric_limits<double>::max();
+    }
+    return (endpoint.in_flight.load(std::memory_order_relaxed) + 1.0) *
+        std::max(endpoint.latency_us.load(std::memory_order_relaxed), 1l);
+  };
+  static thread_local std::minstd_rand rng(static_cast<unsigned>(
+      std::hash<std::thread::id>()(std::this_thread::get_id()) ^
+      std::chrono::steady_clock::now().time_since_epoch().count()));
+  size_t first = rng() % num_endpoints;
+  size_t second = (first + 1 + rng() % (num_endpoints - 1)) % num_endpoints;
+  // An ejected endpoint gets a trial call whenever its breaker lets one
+  // through, otherwise it could never come back. A breaker that refused the
+  // trial is not asked again, every Allow() that refuses counts a rejection.
+  bool first_refused = false;
+  bool second_refused = false;
+  if (endpoints[first]->Ejected()) {
+    if (endpoints[first]->breaker->Allow()) {
+      return endpoints[first];
+    }
+    first_refused = true;
+  }
+  if (endpoints[second]->Ejected()) {
+    if (endpoints[second]->breaker->Allow()) {
+      return endpoints[second];
+    }
+    second_refused = true;
+  }
+  if (load(*endpoints[second]) < load(*endpoints[first])) {
+    std::swap(first, second);
+    std::swap(first_refused, second_refused);
+  }
+  if (!first_refused && allows(*endpoints[first])) {
+    return endpoints[first];
+  }
+  if (!second_refused && allows(*endpoints[second])) {
+    return endpoints[second];
+  }
+  // Both are ejected, take any endpoint that still accepts calls.
+  for (size_t i = 0; i < num_endpoints; ++i) {
+    if (i != first && i != second && allows(*endpoints[i])) {
+      return endpoints[i];
+    }
+  }
+  return nullptr;
+}
+
+template<class TClient>
+std::shared_ptr<ClientEndpoint>
+ClientPool<TClient>::_LeastConnectedEndpoint() const {
+  std::shared_ptr<const EndpointList> endpoints = _Endpoints();
+  std::shared_ptr<ClientEndpoint> least;
+  for (auto &endpoint : *endpoints) {
+    if (endpoint->Ejected()) {
+      continue;
+    }
+    if (!least || endpoint->clients.load() < least->clients.load()) {
+      least = endpoint;
+    }
+  }
+  return least ? least : endpoints->front();
+}
+
+template<class TClient>
+bool ClientPool<TClient>::_Usable(TClient *client,
+                                  const ClientEndpoint &preferred,
+                                  size_t num_endpoints) const {
+  const ClientEndpoint &endpoint = *client->_endpoint;
+  if (&endpoint == &preferred) {
+    return true;
+  }
+  if (endpoint.removed || endpoint.Ejected()) {
+    return false;
+  }
+  // Otherwise a full pool would never move connections to an endpoint on
+  // trial or to a replica added by a scale-out: take over the client if
+  // the chosen endpoint has less than its share of the pool.
+  return !preferred.Ejected() &&
+      preferred.clients.load() >=
+          _curr_pool_size.load() / static_cast<int>(num_endpoints);
+}
+
+template<class TClient>
+void ClientPool<TClient>::_Resolve() {
+  std::vector<std::pair<std::string, int>> addrs;
+  for (auto &target : _targets) {
+    struct addrinfo hints = {};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *result = nullptr;
+    int rc = getaddrinfo(target.first.c_str(), nullptr, &hints, &result);
+    if (rc != 0) {
+      // Keep the current endpoints rather than drop a whole target.
+      LOG(warning) << "Failed to resolve " << target.first << ": "
+                   << gai_strerror(rc);
+      return;
+    }
+    for (struct addrinfo *ai = result; ai; ai = ai->ai_next) {
+      char ip[INET_ADDRSTRLEN];
+      auto *sin = reinterpret_cast<struct sockaddr_in *>(ai->ai_addr);
+      if (inet_ntop(AF_INET, &sin->sin_addr, ip, sizeof(ip))) {
+        addrs.emplace_back(ip, target.second);
+      }
+    }
+    freeaddrinfo(result);
+  }
+  std::sort(addrs.begin(), addrs.end());
+  addrs.erase(std::unique(addrs.begin(), addrs.end()), addrs.end());
+  if (addrs.empty()) {
+    return;
+  }
+
+  // Endpoints that still resolve keep their state.
+  std::shared_ptr<const EndpointList> current = _Endpoints();
+  auto endpoints = std::make_shared<EndpointList>();
+  for (auto &addr : addrs) {
+    auto it = std::find_if(current->begin(), current->end(),
+        [&addr](const std::shared_ptr<ClientEndpoint> &endpoint) {
+          return endpoint->addr == addr.first &&
+              endpoint->port == addr.second; });
+    endpoints->emplace_back(
+        it != current->end() ? *it : _NewEndpoint(addr.first, addr.second));
+  }
+  bool changed = endpoints->size() != current->size();
+  for (auto &endpoint : *current) {
+    if (std::find(endpoints->begin(), endpoints->end(), endpoint) ==
+        endpoints->end()) {
+      endpoint->removed = true;
+      changed = true;
+    }
+  }
+  if (!changed) {
+    return;
+  }
+  std::atomic_store(&_endpoints,
+                    std::shared_ptr<const EndpointList>(endpoints));
+  *_num_endpoints = endpoints->size();
+  LOG(info) << _client_type << " balances over " << endpoints->size()
+            << " endpoints";
+}
+
+template<class TClient>
+TClient * ClientPool<TClient>::_NewClient(
+    const std::shared_ptr<ClientEndpoint> &endpoint) {
+  TClient *client = new TClient(endpoint->addr, endpoint->port,
+                                _keepalive_ms, *_config_json);
+  client->_endpoint = endpoint;
+  endpoint->clients++;
+  return client;
+}
+
+template<class TClient>
+TClient * ClientPool<TClient>::_NewConnectedClient(
+    const std::shared_ptr<ClientEndpoint> &endpoint) {
+  TClient *client = nullptr;
+  try {
+    client = _NewClient(endpoint);
+    client->Connect();
+  } catch (...) {
+    _DeleteClient(client);
+    return nullptr;
+  }
+  return client;
+}
+
+template<class TClient>
+void ClientPool<TClient>::_DeleteClient(TClient *client) {
+  if (client) {
+    client->_endpoint->clients--;
+    delete client;
+  }
+}
+
+template<class TClient>
+void ClientPool<TClient>::_MaintainShard(size_t shard_idx) {
+  Shard &shard = *_shards[shard_idx];
+  size_t num_idle;
+  {
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    num_idle = shard.pool.size();
+  }
+
+  // Check the idle clients one at a time, so that the shard is never
+  // emptied by the maintenance thread while requests are popping from it.
+  for (size_t i = 0; i < num_idle; ++i) {
+    TClient *client = _TryPop(shard_idx, true);
+    if (!client) {
+      break;
+    }
+    long curr_timestamp =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    bool expiring = curr_timestamp - client->_connect_timestamp >
+        client->_keepalive_ms - _refresh_ahead_ms;
+    bool removed = client->_endpoint->removed;
+    if (expiring || removed || !client->Probe()) {
+      // A client of a removed endpoint moves to the least used one.
+      std::shared_ptr<ClientEndpoint> endpoint =
+          removed ? _LeastConnectedEndpoint() : client->_endpoint;
+      _DeleteClient(client);
+      client = _NewConnectedClient(endpoint);
+      if (!client) {
+        LOG(warning) << "Failed to refresh a " << _client_type << " client";
+        _Discard(nullptr);
+        continue;
+      }
+    }
+    std::unique_lock<std::mutex> lock(shard.mtx);
+    shard.pool.push_back(client);
+    lock.unlock();
+    shard.cv.notify_one();
+  }
+}
+
+template<class TClient>
+void ClientPool<TClient>::_Maintain() {
+  std::unique_lock<std::mutex> lock(_maintenance_mtx);
+  // Wake up for whichever of the two jobs is due more often.
+  int wait_ms = _maintenance_interval_ms;
+  if (wait_ms <= 0 ||
+      (_resolve_interval_ms > 0 && _resolve_interval_ms < wait_ms)) {
+    wait_ms = _resolve_interval_ms;
+  }
+  while (!_maintenance_stop) {
+    lock.unlock();
+
+    if (_resolve_interval_ms > 0 &&
+        std::chrono::steady_clock::now() >= _next_resolve) {
+      _Resolve();
+      _next_resolve = std::chrono::steady_clock::now() +
+          std::chrono::milliseconds(_resolve_interval_ms);
+    }
+
+    if (_maintenance_interval_ms > 0) {
+      if (_hedge_percentile > 0) {
+        _UpdateHedgeDelay();
+      }
+      for (size_t i = 0; i < _shards.size(); ++i) {
+        _MaintainShard(i);
+      }
+
+      // Pre-open connections up to the minimum pool size, spread over the
+      // endpoints.
+      while (_curr_pool_size.load() < _min_pool_size && _TryGrow()) {
+        TClient *client = _NewConnectedClient(_LeastConnectedEndpoint());
+        if (!client) {
+          LOG(warning) << "Failed to pre-open a " << _client_type
+                       << " client";
+          _Discard(nullptr);
+          break;
+        }
+        Push(client);
+      }
+    }
+
+    lock.lock();
+    _maintenance_cv.wait_for(lock, std::chrono::milliseconds(wait_ms),
+                             [this] { return _maintenance_stop; });
+  }
+}
+
 } // namespace social_network
 
 
-#endif //SOCIAL_NETWORK_MICROSERVICES_CLIENTPOOL_H
\ No newline at end of file
+#endif //SOCIAL_NETWORK_MICROSERVICES_CLIENTPOOL_H
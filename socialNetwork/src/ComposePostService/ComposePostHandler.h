@@ -18,9 +18,13 @@
 #include "../../gen-cpp/UserTimelineService.h"
 #include "../../gen-cpp/social_network_types.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
+#include "../Executor.h"
+#include "../MultiplexedClientPool.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
 #include "../tracing.h"
+#include "RabbitmqClient.h"
 
 namespace social_network {
 using json = nlohmann::json;
@@ -37,8 +41,22 @@ class ComposePostHandler : public ComposePostServiceIf {
                      ClientPool<ThriftClient<MediaServiceClient>> *,
                      ClientPool<ThriftClient<TextServiceClient>> *,
                      ClientPool<ThriftClient<HomeTimelineServiceClient>> *);
+  ComposePostHandler(
+      MultiplexedClientPool<PostStorageServiceConcurrentClient> *,
+      MultiplexedClientPool<UserTimelineServiceConcurrentClient> *,
+      MultiplexedClientPool<UserServiceConcurrentClient> *,
+      MultiplexedClientPool<UniqueIdServiceConcurrentClient> *,
+      MultiplexedClientPool<MediaServiceConcurrentClient> *,
+      MultiplexedClientPool<TextServiceConcurrentClient> *,
+      MultiplexedClientPool<HomeTimelineServiceConcurrentClient> *);
   ~ComposePostHandler() override = default;
 
+  // Hands the home timeline fan-out to write-home-timeline-service through
+  // the write-home-timeline queue instead of calling WriteHomeTimeline, so
+  // that ComposePost does not wait for the posts to reach every follower.
+  // Must be called before the server starts.
+  void SetHomeTimelineQueue(ClientPool<RabbitmqClient> *rabbitmq_client_pool);
+
   void ComposePost(int64_t req_id, const std::string &username, int64_t user_id,
                    const std::string &text,
                    const std::vector<int64_t> &media_ids,
@@ -59,31 +77,62 @@ class ComposePostHandler : public ComposePostServiceIf {
   ClientPool<ThriftClient<HomeTimelineServiceClient>>
       *_home_timeline_client_pool;
 
+  // Set instead of the client pools above when downstream calls are
+  // pipelined over shared connections.
+  MultiplexedClientPool<PostStorageServiceConcurrentClient>
+      *_post_storage_mux_pool;
+  MultiplexedClientPool<UserTimelineServiceConcurrentClient>
+      *_user_timeline_mux_pool;
+  MultiplexedClientPool<UserServiceConcurrentClient> *_user_service_mux_pool;
+  MultiplexedClientPool<UniqueIdServiceConcurrentClient>
+      *_unique_id_service_mux_pool;
+  MultiplexedClientPool<MediaServiceConcurrentClient> *_media_service_mux_pool;
+  MultiplexedClientPool<TextServiceConcurrentClient> *_text_service_mux_pool;
+  MultiplexedClientPool<HomeTimelineServiceConcurrentClient>
+      *_home_timeline_mux_pool;
+
+  // Set when home timelines are written from the queue.
+  ClientPool<RabbitmqClient> *_rabbitmq_client_pool;
+
+  bool _IsMultiplexed() const;
+
+  void _ComposePostMultiplexed(
+      int64_t req_id, const std::string &username, int64_t user_id,
+      const std::string &text, const std::vector<int64_t> &media_ids,
+      const std::vector<std::string> &media_types, PostType::type post_type,
+      const TraceContext &trace_context, const Deadline &deadline);
+
   void _UploadUserTimelineHelper(
       int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
-      const std::map<std::string, std::string> &carrier);
+      const TraceContext &trace_context, const Deadline &deadline);
 
   void _UploadPostHelper(int64_t req_id, const Post &post,
-                         const std::map<std::string, std::string> &carrier);
+                         const TraceContext &trace_context,
+                         const Deadline &deadline);
 
   void _UploadHomeTimelineHelper(
       int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
       const std::vector<int64_t> &user_mentions_id,
-      const std::map<std::string, std::string> &carrier);
+      const TraceContext &trace_context, const Deadline &deadline);
+
+  void _PublishHomeTimelineHelper(
+      int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
+      const std::vector<int64_t> &user_mentions_id,
+      const TraceContext &trace_context, const Deadline &deadline);
 
   Creator _ComposeCreaterHelper(
       int64_t req_id, int64_t user_id, const std::string &username,
-      const std::map<std::string, std::string> &carrier);
+      const TraceContext &trace_context, const Deadline &deadline);
   TextServiceReturn _ComposeTextHelper(
       int64_t req_id, const std::string &text,
-      const std::map<std::string, std::string> &carrier);
+      const TraceContext &trace_context, const Deadline &deadline);
   std::vector<Media> _ComposeMediaHelper(
       int64_t req_id, const std::vector<std::string> &media_types,
       const std::vector<int64_t> &media_ids,
-      const std::map<std::string, std::string> &carrier);
+      const TraceContext &trace_context, const Deadline &deadline);
   int64_t _ComposeUniqueIdHelper(
       int64_t req_id, PostType::type post_type,
-      const std::map<std::string, std::string> &carrier);
+      const TraceContext &trace_context, const Deadline &deadline);
 };
 
 ComposePostHandler::ComposePostHandler(
@@ -105,20 +154,68 @@ ComposePostHandler::ComposePostHandler(
   _media_service_client_pool = media_service_client_pool;
   _text_service_client_pool = text_service_client_pool;
   _home_timeline_client_pool = home_timeline_client_pool;
+  _post_storage_mux_pool = nullptr;
+  _user_timeline_mux_pool = nullptr;
+  _user_service_mux_pool = nullptr;
+  _unique_id_service_mux_pool = nullptr;
+  _media_service_mux_pool = nullptr;
+  _text_service_mux_pool = nullptr;
+  _home_timeline_mux_pool = nullptr;
+  _rabbitmq_client_pool = nullptr;
+}
+
+ComposePostHandler::ComposePostHandler(
+    MultiplexedClientPool<PostStorageServiceConcurrentClient>
+        *post_storage_mux_pool,
+    MultiplexedClientPool<UserTimelineServiceConcurrentClient>
+        *user_timeline_mux_pool,
+    MultiplexedClientPool<UserServiceConcurrentClient> *user_service_mux_pool,
+    MultiplexedClientPool<UniqueIdServiceConcurrentClient>
+        *unique_id_service_mux_pool,
+    MultiplexedClientPool<MediaServiceConcurrentClient>
+        *media_service_mux_pool,
+    MultiplexedClientPool<TextServiceConcurrentClient> *text_service_mux_pool,
+    MultiplexedClientPool<HomeTimelineServiceConcurrentClient>
+        *home_timeline_mux_pool) {
+  _post_storage_client_pool = nullptr;
+  _user_timeline_client_pool = nullptr;
+  _user_service_client_pool = nullptr;
+  _unique_id_service_client_pool = nullptr;
+  _media_service_client_pool = nullptr;
+  _text_service_client_pool = nullptr;
+  _home_timeline_client_pool = nullptr;
+  _post_storage_mux_pool = post_storage_mux_pool;
+  _user_timeline_mux_pool = user_timeline_mux_pool;
+  _user_service_mux_pool = user_service_mux_pool;
+  _unique_id_service_mux_pool = unique_id_service_mux_pool;
+  _media_service_mux_pool = media_service_mux_pool;
+  _text_service_mux_pool = text_service_mux_pool;
+  _home_timeline_mux_pool = home_timeline_mux_pool;
+  _rabbitmq_client_pool = nullptr;
+}
+
+void ComposePostHandler::SetHomeTimelineQueue(
+    ClientPool<RabbitmqClient> *rabbitmq_client_pool) {
+  _rabbitmq_client_pool = rabbitmq_client_pool;
+}
+
+bool ComposePostHandler::_IsMultiplexed() const {
+  return _text_service_mux_pool != nullptr;
 }
 
 Creator ComposePostHandler::_ComposeCreaterHelper(
     int64_t req_id, int64_t user_id, const std::string &username,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "compose_creator_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto user_client_wrapper = _user_service_client_pool->Pop();
+  auto user_client_wrapper = _user_service_client_pool->Pop(deadline);
   if (!user_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -146,16 +243,17 @@ Creator ComposePostHandler::_ComposeCreaterHelper(
 
 TextServiceReturn ComposePostHandler::_ComposeTextHelper(
     int64_t req_id, const std::string &text,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "compose_text_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto text_client_wrapper = _text_service_client_pool->Pop();
+  auto text_client_wrapper = _text_service_client_pool->Pop(deadline);
   if (!text_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -184,16 +282,17 @@ TextServiceReturn ComposePostHandler::_ComposeTextHelper(
 std::vector<Media> ComposePostHandler::_ComposeMediaHelper(
     int64_t req_id, const std::vector<std::string> &media_types,
     const std::vector<int64_t> &media_ids,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "compose_media_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto media_client_wrapper = _media_service_client_pool->Pop();
+  auto media_client_wrapper = _media_service_client_pool->Pop(deadline);
   if (!media_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -222,16 +321,17 @@ std::vector<Media> ComposePostHandler::_ComposeMediaHelper(
 
 int64_t ComposePostHandler::_ComposeUniqueIdHelper(
     int64_t req_id, const PostType::type post_type,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "compose_unique_id_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto unique_id_client_wrapper = _unique_id_service_client_pool->Pop();
+  auto unique_id_client_wrapper = _unique_id_service_client_pool->Pop(deadline);
   if (!unique_id_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -259,22 +359,23 @@ int64_t ComposePostHandler::_ComposeUniqueIdHelper(
 
 void ComposePostHandler::_UploadPostHelper(
     int64_t req_id, const Post &post,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "store_post_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto post_storage_client_wrapper = _post_storage_client_pool->Pop();
+  auto post_storage_client_wrapper = _post_storage_client_pool->Pop(deadline);
   if (!post_storage_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
     se.message = "Failed to connect to post-storage-service";
     LOG(error) << se.message;
-    ;
+    span->Finish();
     throw se;
   }
   auto post_storage_client = post_storage_client_wrapper->GetClient();
@@ -283,6 +384,7 @@ void ComposePostHandler::_UploadPostHelper(
   } catch (...) {
     _post_storage_client_pool->Remove(post_storage_client_wrapper);
     LOG(error) << "Failed to store post to post-storage-service";
+    span->Finish();
     throw;
   }
   _post_storage_client_pool->Keepalive(post_storage_client_wrapper);
@@ -292,22 +394,23 @@ void ComposePostHandler::_UploadPostHelper(
 
 void ComposePostHandler::_UploadUserTimelineHelper(
     int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "write_user_timeline_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto user_timeline_client_wrapper = _user_timeline_client_pool->Pop();
+  auto user_timeline_client_wrapper = _user_timeline_client_pool->Pop(deadline);
   if (!user_timeline_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
     se.message = "Failed to connect to user-timeline-service";
     LOG(error) << se.message;
-    ;
+    span->Finish();
     throw se;
   }
   auto user_timeline_client = user_timeline_client_wrapper->GetClient();
@@ -316,6 +419,8 @@ void ComposePostHandler::_UploadUserTimelineHelper(
                                             writer_text_map);
   } catch (...) {
     _user_timeline_client_pool->Remove(user_timeline_client_wrapper);
+    LOG(error) << "Failed to write user timeline to user-timeline-service";
+    span->Finish();
     throw;
   }
   _user_timeline_client_pool->Keepalive(user_timeline_client_wrapper);
@@ -326,22 +431,29 @@ void ComposePostHandler::_UploadUserTimelineHelper(
 void ComposePostHandler::_UploadHomeTimelineHelper(
     int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
     const std::vector<int64_t> &user_mentions_id,
-    const std::map<std::string, std::string> &carrier) {
-  TextMapReader reader(carrier);
+    const TraceContext &trace_context, const Deadline &deadline) {
+  if (_rabbitmq_client_pool) {
+    _PublishHomeTimelineHelper(req_id, post_id, user_id, timestamp,
+                               user_mentions_id, trace_context, deadline);
+    return;
+  }
+
+  TraceContextReader reader(trace_context);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "write_home_timeline_client", {opentracing::ChildOf(parent_span->get())});
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  auto home_timeline_client_wrapper = _home_timeline_client_pool->Pop();
+  auto home_timeline_client_wrapper = _home_timeline_client_pool->Pop(deadline);
   if (!home_timeline_client_wrapper) {
     ServiceException se;
     se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
     se.message = "Failed to connect to home-timeline-service";
     LOG(error) << se.message;
-    ;
+    span->Finish();
     throw se;
   }
   auto home_timeline_client = home_timeline_client_wrapper->GetClient();
@@ -351,6 +463,7 @@ void ComposePostHandler::_UploadHomeTimelineHelper(
   } catch (...) {
     _home_timeline_client_pool->Remove(home_timeline_client_wrapper);
     LOG(error) << "Failed to write home timeline to home-timeline-service";
+    span->Finish();
     throw;
   }
   _home_timeline_client_pool->Keepalive(home_timeline_client_wrapper);
@@ -358,31 +471,299 @@ void ComposePostHandler::_UploadHomeTimelineHelper(
   span->Finish();
 }
 
+void ComposePostHandler::_PublishHomeTimelineHelper(
+    int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
+    const std::vector<int64_t> &user_mentions_id,
+    const TraceContext &trace_context, const Deadline &deadline) {
+  TraceContextReader reader(trace_context);
+  auto parent_span = opentracing::Tracer::Global()->Extract(reader);
+  auto span = opentracing::Tracer::Global()->StartSpan(
+      "write_home_timeline_publish_client",
+      {opentracing::ChildOf(parent_span->get())});
+  // The deadline is not passed on: the fan-out runs after ComposePost has
+  // returned and must not be dropped when the client stops waiting.
+  std::map<std::string, std::string> carrier;
+  TextMapWriter writer(carrier);
+  opentracing::Tracer::Global()->Inject(span->context(), writer);
+
+  json msg_json;
+  msg_json["req_id"] = req_id;
+  msg_json["user_id"] = user_id;
+  msg_json["post_id"] = post_id;
+  msg_json["timestamp"] = timestamp;
+  msg_json["user_mentions_id"] = user_mentions_id;
+  msg_json["carrier"] = carrier;
+
+  auto rabbitmq_client = _rabbitmq_client_pool->Pop(deadline);
+  if (!rabbitmq_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_RABBITMQ_CONN_ERROR;
+    se.message = "Failed to connect to write-home-timeline-rabbitmq";
+    LOG(error) << se.message;
+    span->Finish();
+    throw se;
+  }
+  try {
+    rabbitmq_client->Publish(msg_json.dump());
+  } catch (...) {
+    _rabbitmq_client_pool->Remove(rabbitmq_client);
+    LOG(error) << "Failed to publish to write-home-timeline-rabbitmq";
+    span->Finish();
+    throw;
+  }
+  _rabbitmq_client_pool->Keepalive(rabbitmq_client);
+
+  span->Finish();
+}
+
+void ComposePostHandler::_ComposePostMultiplexed(
+    const int64_t req_id, const std::string &username, int64_t user_id,
+    const std::string &text, const std::vector<int64_t> &media_ids,
+    const std::vector<std::string> &media_types, const PostType::type post_type,
+    const TraceContext &trace_context, const Deadline &deadline) {
+  // Each client span is finished by the future that reads its response.
+  // The shared connections carry no per-call socket timeout, so the
+  // deadline is only forwarded to the callees.
+  auto start_client_span = [&trace_context, &deadline](
+                               const std::string &name,
+                               std::map<std::string, std::string>
+                                   *writer_text_map) {
+    TraceContextReader reader(trace_context);
+    auto parent_span = opentracing::Tracer::Global()->Extract(reader);
+    std::shared_ptr<opentracing::Span> span =
+        opentracing::Tracer::Global()->StartSpan(
+            name, {opentracing::ChildOf(parent_span->get())});
+    TextMapWriter writer(*writer_text_map);
+    opentracing::Tracer::Global()->Inject(span->context(), writer);
+    deadline.Inject(writer_text_map);
+    return span;
+  };
+
+  // Issue the four compose requests back to back; they are in flight
+  // concurrently on their shared connections.
+  std::map<std::string, std::string> text_text_map;
+  auto text_span = start_client_span("compose_text_client", &text_text_map);
+  auto text_call = _text_service_mux_pool->Call<TextServiceReturn>(
+      [&](TextServiceConcurrentClient *client) {
+        return client->send_ComposeText(req_id, text, text_text_map);
+      },
+      [text_span](TextServiceConcurrentClient *client, int32_t seqid) {
+        TextServiceReturn _return_text;
+        try {
+          client->recv_ComposeText(_return_text, seqid);
+        } catch (...) {
+          LOG(error) << "Failed to send compose-text to text-service";
+          text_span->Finish();
+          throw;
+        }
+        text_span->Finish();
+        return _return_text;
+      });
+
+  std::map<std::string, std::string> creator_text_map;
+  auto creator_span =
+      start_client_span("compose_creator_client", &creator_text_map);
+  auto creator_call = _user_service_mux_pool->Call<Creator>(
+      [&](UserServiceConcurrentClient *client) {
+        return client->send_ComposeCreatorWithUserId(req_id, user_id, username,
+                                                     creator_text_map);
+      },
+      [creator_span](UserServiceConcurrentClient *client, int32_t seqid) {
+        Creator _return_creator;
+        try {
+          client->recv_ComposeCreatorWithUserId(_return_creator, seqid);
+        } catch (...) {
+          LOG(error) << "Failed to send compose-creator to user-service";
+          creator_span->Finish();
+          throw;
+        }
+        creator_span->Finish();
+        return _return_creator;
+      });
+
+  std::map<std::string, std::string> media_text_map;
+  auto media_span = start_client_span("compose_media_client", &media_text_map);
+  auto media_call = _media_service_mux_pool->Call<std::vector<Media>>(
+      [&](MediaServiceConcurrentClient *client) {
+        return client->send_ComposeMedia(req_id, media_types, media_ids,
+                                         media_text_map);
+      },
+      [media_span](MediaServiceConcurrentClient *client, int32_t seqid) {
+        std::vector<Media> _return_media;
+        try {
+          client->recv_ComposeMedia(_return_media, seqid);
+        } catch (...) {
+          LOG(error) << "Failed to send compose-media to media-service";
+          media_span->Finish();
+          throw;
+        }
+        media_span->Finish();
+        return _return_media;
+      });
+
+  std::map<std::string, std::string> unique_id_text_map;
+  auto unique_id_span =
+      start_client_span("compose_unique_id_client", &unique_id_text_map);
+  auto unique_id_call = _unique_id_service_mux_pool->Call<int64_t>(
+      [&](UniqueIdServiceConcurrentClient *client) {
+        return client->send_ComposeUniqueId(req_id, post_type,
+                                            unique_id_text_map);
+      },
+      [unique_id_span](UniqueIdServiceConcurrentClient *client,
+                       int32_t seqid) {
+        int64_t _return_unique_id;
+        try {
+          _return_unique_id = client->recv_ComposeUniqueId(seqid);
+        } catch (...) {
+          LOG(error) << "Failed to send compose-unique_id to unique_id-service";
+          unique_id_span->Finish();
+          throw;
+        }
+        unique_id_span->Finish();
+        return _return_unique_id;
+      });
+
+  Post post;
+  auto timestamp =
+      duration_cast<milliseconds>(system_clock::now().time_since_epoch())
+          .count();
+  post.timestamp = timestamp;
+  post.post_id = unique_id_call.Get();
+  post.creator = creator_call.Get();
+  post.media = media_call.Get();
+  auto text_return = text_call.Get();
+  post.text = text_return.text;
+  post.urls = text_return.urls;
+  post.user_mentions = text_return.user_mentions;
+  post.req_id = req_id;
+  post.post_type = post_type;
+
+  std::vector<int64_t> user_mention_ids;
+  for (auto &item : post.user_mentions) {
+    user_mention_ids.emplace_back(item.user_id);
+  }
+
+  // Do not store a post the client has already given up on.
+  deadline.Check();
+
+  // Like on the pooled path, the post and the timeline entries are written
+  // in parallel: all three requests are sent before any response is read.
+  std::map<std::string, std::string> post_text_map;
+  auto post_span = start_client_span("store_post_client", &post_text_map);
+  auto post_future = _post_storage_mux_pool
+      ->Call<void>(
+          [&](PostStorageServiceConcurrentClient *client) {
+            return client->send_StorePost(req_id, post, post_text_map);
+          },
+          [post_span](PostStorageServiceConcurrentClient *client,
+                      int32_t seqid) {
+            try {
+              client->recv_StorePost(seqid);
+            } catch (...) {
+              LOG(error) << "Failed to store post to post-storage-service";
+              post_span->Finish();
+              throw;
+            }
+            post_span->Finish();
+          });
+
+  std::map<std::string, std::string> user_timeline_text_map;
+  auto user_timeline_span =
+      start_client_span("write_user_timeline_client", &user_timeline_text_map);
+  auto user_timeline_future = _user_timeline_mux_pool
+      ->Call<void>(
+          [&](UserTimelineServiceConcurrentClient *client) {
+            return client->send_WriteUserTimeline(
+                req_id, post.post_id, user_id, timestamp,
+                user_timeline_text_map);
+          },
+          [user_timeline_span](UserTimelineServiceConcurrentClient *client,
+                               int32_t seqid) {
+            try {
+              client->recv_WriteUserTimeline(seqid);
+            } catch (...) {
+              LOG(error)
+                  << "Failed to write user timeline to user-timeline-service";
+              user_timeline_span->Finish();
+              throw;
+            }
+            user_timeline_span->Finish();
+          });
+
+  if (_rabbitmq_client_pool) {
+    // Queued while the two requests above are in flight.
+    _PublishHomeTimelineHelper(req_id, post.post_id, user_id, timestamp,
+                               user_mention_ids, trace_context, deadline);
+    post_future.Get();
+    user_timeline_future.Get();
+    return;
+  }
+
+  std::map<std::string, std::string> home_timeline_text_map;
+  auto home_timeline_span =
+      start_client_span("write_home_timeline_client", &home_timeline_text_map);
+  auto home_timeline_future = _home_timeline_mux_pool
+      ->Call<void>(
+          [&](HomeTimelineServiceConcurrentClient *client) {
+            return client->send_WriteHomeTimeline(
+                req_id, post.post_id, user_id, timestamp, user_mention_ids,
+                home_timeline_text_map);
+          },
+          [home_timeline_span](HomeTimelineServiceConcurrentClient *client,
+                               int32_t seqid) {
+            try {
+              client->recv_WriteHomeTimeline(seqid);
+            } catch (...) {
+              LOG(error)
+                  << "Failed to write home timeline to home-timeline-service";
+              home_timeline_span->Finish();
+              throw;
+            }
+            home_timeline_span->Finish();
+          });
+
+  post_future.Get();
+  user_timeline_future.Get();
+  home_timeline_future.Get();
+}
+
 void ComposePostHandler::ComposePost(
     const int64_t req_id, const std::string &username, int64_t user_id,
     const std::string &text, const std::vector<int64_t> &media_ids,
     const std::vector<std::string> &media_types, const PostType::type post_type,
     const std::map<std::string, std::string> &carrier) {
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "compose_post_server", {opentracing::ChildOf(parent_span->get())});
-  std::map<std::string, std::string> writer_text_map;
-  TextMapWriter writer(writer_text_map);
+  TraceContext trace_context;
+  TraceContextWriter writer(&trace_context);
   opentracing::Tracer::Global()->Inject(span->context(), writer);
 
+  if (_IsMultiplexed()) {
+    _ComposePostMultiplexed(req_id, username, user_id, text, media_ids,
+                            media_types, post_type, trace_context, deadline);
+    span->Finish();
+    return;
+  }
+
+  Executor *executor = Executor::GetInstance();
   auto text_future =
-      std::async(std::launch::async, &ComposePostHandler::_ComposeTextHelper,
-                 this, req_id, text, writer_text_map);
+      executor->Submit(&ComposePostHandler::_ComposeTextHelper,
+                       this, req_id, text, trace_context, deadline);
   auto creator_future =
-      std::async(std::launch::async, &ComposePostHandler::_ComposeCreaterHelper,
-                 this, req_id, user_id, username, writer_text_map);
+      executor->Submit(&ComposePostHandler::_ComposeCreaterHelper,
+                       this, req_id, user_id, username, trace_context,
+                       deadline);
   auto media_future =
-      std::async(std::launch::async, &ComposePostHandler::_ComposeMediaHelper,
-                 this, req_id, media_types, media_ids, writer_text_map);
-  auto unique_id_future = std::async(
-      std::launch::async, &ComposePostHandler::_ComposeUniqueIdHelper, this,
-      req_id, post_type, writer_text_map);
+      executor->Submit(&ComposePostHandler::_ComposeMediaHelper,
+                       this, req_id, media_types, media_ids, trace_context,
+                       deadline);
+  auto unique_id_future =
+      executor->Submit(&ComposePostHandler::_ComposeUniqueIdHelper,
+                       this, req_id, post_type, trace_context, deadline);
 
   Post post;
   auto timestamp =
@@ -412,20 +793,23 @@ void ComposePostHandler::ComposePost(
     user_mention_ids.emplace_back(item.user_id);
   }
 
-  //In mixed workloed condition, need to make sure _UploadPostHelper execute
-  //Before _UploadUserTimelineHelper and _UploadHomeTimelineHelper.
-  //Change _UploadUserTimelineHelper and _UploadHomeTimelineHelper to deferred.
-  //To let them start execute after post_future.get() return.
+  // Do not store a post the client has already given up on.
+  deadline.Check();
+
+  // The post and the timeline entries are written in parallel. A reader
+  // may thus find a timeline entry before its post is stored, but it never
+  // sees it: ReadPosts leaves out the posts it cannot find yet.
   auto post_future =
-      std::async(std::launch::async, &ComposePostHandler::_UploadPostHelper,
-                 this, req_id, post, writer_text_map);
-  auto user_timeline_future = std::async(
-      std::launch::deferred, &ComposePostHandler::_UploadUserTimelineHelper, this,
-      req_id, post.post_id, user_id, timestamp, writer_text_map);
-  auto home_timeline_future = std::async(
-      std::launch::deferred, &ComposePostHandler::_UploadHomeTimelineHelper, this,
-      req_id, post.post_id, user_id, timestamp, user_mention_ids,
-      writer_text_map);
+      executor->Submit(&ComposePostHandler::_UploadPostHelper,
+                       this, req_id, post, trace_context, deadline);
+  auto user_timeline_future =
+      executor->Submit(&ComposePostHandler::_UploadUserTimelineHelper,
+                       this, req_id, post.post_id, user_id, timestamp,
+                       trace_context, deadline);
+  auto home_timeline_future =
+      executor->Submit(&ComposePostHandler::_UploadHomeTimelineHelper,
+                       this, req_id, post.post_id, user_id, timestamp,
+                       user_mention_ids, trace_context, deadline);
 
   // try
   // {
@@ -1,17 +1,9 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include "../utils.h"
 #include "../utils_thrift.h"
 #include "ComposePostHandler.h"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
@@ -27,6 +19,18 @@ int main(int argc, char *argv[]) {
   }
 
   int port = config_json["compose-post-service"]["port"];
+  int executor_threads = config_json["compose-post-service"]["executor_threads"];
+  int executor_queue_size =
+      config_json["compose-post-service"]["executor_queue_size"];
+  Executor::Init(executor_threads, executor_queue_size);
+  int multiplexed_clients =
+      config_json["compose-post-service"]["multiplexed_clients"];
+  std::string home_timeline_fanout =
+      config_json["compose-post-service"]["home_timeline_fanout"];
+  if (home_timeline_fanout != "rpc" && home_timeline_fanout != "queue") {
+    LOG(fatal) << "Unknown home_timeline_fanout: " << home_timeline_fanout;
+    exit(EXIT_FAILURE);
+  }
 
   int post_storage_port = config_json["post-storage-service"]["port"];
   std::string post_storage_addr = config_json["post-storage-service"]["addr"];
@@ -34,6 +38,18 @@ int main(int argc, char *argv[]) {
   int post_storage_timeout = config_json["post-storage-service"]["timeout_ms"];
   int post_storage_keepalive =
       config_json["post-storage-service"]["keepalive_ms"];
+  int post_storage_shards = config_json["post-storage-service"]["pool_shards"];
+  int post_storage_min_conns =
+      config_json["post-storage-service"]["min_connections"];
+  int post_storage_health_check_ms =
+      config_json["post-storage-service"]["health_check_interval_ms"];
+  int post_storage_refresh_ahead_ms =
+      config_json["post-storage-service"]["refresh_ahead_ms"];
+  int post_storage_mux_conns =
+      config_json["post-storage-service"]["multiplexed_connections"];
+  if (post_storage_mux_conns < 1) {
+    post_storage_mux_conns = post_storage_conns;
+  }
 
   int user_timeline_port = config_json["user-timeline-service"]["port"];
   std::string user_timeline_addr = config_json["user-timeline-service"]["addr"];
@@ -42,24 +58,64 @@ int main(int argc, char *argv[]) {
       config_json["user-timeline-service"]["timeout_ms"];
   int user_timeline_keepalive =
       config_json["user-timeline-service"]["keepalive_ms"];
+  int user_timeline_shards =
+      config_json["user-timeline-service"]["pool_shards"];
+  int user_timeline_min_conns =
+      config_json["user-timeline-service"]["min_connections"];
+  int user_timeline_health_check_ms =
+      config_json["user-timeline-service"]["health_check_interval_ms"];
+  int user_timeline_refresh_ahead_ms =
+      config_json["user-timeline-service"]["refresh_ahead_ms"];
+  int user_timeline_mux_conns =
+      config_json["user-timeline-service"]["multiplexed_connections"];
+  if (user_timeline_mux_conns < 1) {
+    user_timeline_mux_conns = user_timeline_conns;
+  }
 
   int text_port = config_json["text-service"]["port"];
   std::string text_addr = config_json["text-service"]["addr"];
   int text_conns = config_json["text-service"]["connections"];
   int text_timeout = config_json["text-service"]["timeout_ms"];
   int text_keepalive = config_json["text-service"]["keepalive_ms"];
+  int text_shards = config_json["text-service"]["pool_shards"];
+  int text_min_conns = config_json["text-service"]["min_connections"];
+  int text_health_check_ms =
+      config_json["text-service"]["health_check_interval_ms"];
+  int text_refresh_ahead_ms = config_json["text-service"]["refresh_ahead_ms"];
+  int text_mux_conns = config_json["text-service"]["multiplexed_connections"];
+  if (text_mux_conns < 1) {
+    text_mux_conns = text_conns;
+  }
 
   int user_port = config_json["user-service"]["port"];
   std::string user_addr = config_json["user-service"]["addr"];
   int user_conns = config_json["user-service"]["connections"];
   int user_timeout = config_json["user-service"]["timeout_ms"];
   int user_keepalive = config_json["user-service"]["keepalive_ms"];
+  int user_shards = config_json["user-service"]["pool_shards"];
+  int user_min_conns = config_json["user-service"]["min_connections"];
+  int user_health_check_ms =
+      config_json["user-service"]["health_check_interval_ms"];
+  int user_refresh_ahead_ms = config_json["user-service"]["refresh_ahead_ms"];
+  int user_mux_conns = config_json["user-service"]["multiplexed_connections"];
+  if (user_mux_conns < 1) {
+    user_mux_conns = user_conns;
+  }
 
   int media_port = config_json["media-service"]["port"];
   std::string media_addr = config_json["media-service"]["addr"];
   int media_conns = config_json["media-service"]["connections"];
   int media_timeout = config_json["media-service"]["timeout_ms"];
   int media_keepalive = config_json["media-service"]["keepalive_ms"];
+  int media_shards = config_json["media-service"]["pool_shards"];
+  int media_min_conns = config_json["media-service"]["min_connections"];
+  int media_health_check_ms =
+      config_json["media-service"]["health_check_interval_ms"];
+  int media_refresh_ahead_ms = config_json["media-service"]["refresh_ahead_ms"];
+  int media_mux_conns = config_json["media-service"]["multiplexed_connections"];
+  if (media_mux_conns < 1) {
+    media_mux_conns = media_conns;
+  }
 
   int home_timeline_port = config_json["home-timeline-service"]["port"];
   std::string home_timeline_addr = config_json["home-timeline-service"]["addr"];
@@ -68,45 +124,167 @@ int main(int argc, char *argv[]) {
       config_json["home-timeline-service"]["timeout_ms"];
   int home_timeline_keepalive =
       config_json["home-timeline-service"]["keepalive_ms"];
+  int home_timeline_shards =
+      config_json["home-timeline-service"]["pool_shards"];
+  int home_timeline_min_conns =
+      config_json["home-timeline-service"]["min_connections"];
+  int home_timeline_health_check_ms =
+      config_json["home-timeline-service"]["health_check_interval_ms"];
+  int home_timeline_refresh_ahead_ms =
+      config_json["home-timeline-service"]["refresh_ahead_ms"];
+  int home_timeline_mux_conns =
+      config_json["home-timeline-service"]["multiplexed_connections"];
+  if (home_timeline_mux_conns < 1) {
+    home_timeline_mux_conns = home_timeline_conns;
+  }
+
+  std::string rabbitmq_addr =
+      config_json["write-home-timeline-rabbitmq"]["addr"];
+  int rabbitmq_port = config_json["write-home-timeline-rabbitmq"]["port"];
+  int rabbitmq_conns =
+      config_json["write-home-timeline-rabbitmq"]["connections"];
+  int rabbitmq_timeout =
+      config_json["write-home-timeline-rabbitmq"]["timeout_ms"];
+  int rabbitmq_keepalive =
+      config_json["write-home-timeline-rabbitmq"]["keepalive_ms"];
 
   int unique_id_port = config_json["unique-id-service"]["port"];
   std::string unique_id_addr = config_json["unique-id-service"]["addr"];
   int unique_id_conns = config_json["unique-id-service"]["connections"];
   int unique_id_timeout = config_json["unique-id-service"]["timeout_ms"];
   int unique_id_keepalive = config_json["unique-id-service"]["keepalive_ms"];
+  int unique_id_shards = config_json["unique-id-service"]["pool_shards"];
+  int unique_id_min_conns = config_json["unique-id-service"]["min_connections"];
+  int unique_id_health_check_ms =
+      config_json["unique-id-service"]["health_check_interval_ms"];
+  int unique_id_refresh_ahead_ms =
+      config_json["unique-id-service"]["refresh_ahead_ms"];
+  int unique_id_mux_conns =
+      config_json["unique-id-service"]["multiplexed_connections"];
+  if (unique_id_mux_conns < 1) {
+    unique_id_mux_conns = unique_id_conns;
+  }
 
   ClientPool<ThriftClient<PostStorageServiceClient>> post_storage_client_pool(
-      "post-storage-client", post_storage_addr, post_storage_port, 0,
-      post_storage_conns, post_storage_timeout, post_storage_keepalive, config_json);
+      "post-storage-client", post_storage_addr, post_storage_port,
+      post_storage_min_conns, post_storage_conns, post_storage_timeout,
+      post_storage_keepalive, config_json, post_storage_shards);
+  post_storage_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["post-storage-service"]));
+  post_storage_client_pool.EnableResolution(
+      config_json["post-storage-service"]["resolve_interval_ms"]);
+  post_storage_client_pool.StartMaintenance(post_storage_health_check_ms,
+                                            post_storage_refresh_ahead_ms);
   ClientPool<ThriftClient<UserTimelineServiceClient>> user_timeline_client_pool(
-      "user-timeline-client", user_timeline_addr, user_timeline_port, 0,
-      user_timeline_conns, user_timeline_timeout, user_timeline_keepalive, config_json);
+      "user-timeline-client", user_timeline_addr, user_timeline_port,
+      user_timeline_min_conns, user_timeline_conns, user_timeline_timeout,
+      user_timeline_keepalive, config_json, user_timeline_shards);
+  user_timeline_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["user-timeline-service"]));
+  user_timeline_client_pool.EnableResolution(
+      config_json["user-timeline-service"]["resolve_interval_ms"]);
+  user_timeline_client_pool.StartMaintenance(user_timeline_health_check_ms,
+                                             user_timeline_refresh_ahead_ms);
   ClientPool<ThriftClient<TextServiceClient>> text_client_pool(
-      "text-service-client", text_addr, text_port, 0, text_conns, text_timeout,
-      text_keepalive, config_json);
+      "text-service-client", text_addr, text_port, text_min_conns, text_conns,
+      text_timeout, text_keepalive, config_json, text_shards);
+  text_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["text-service"]));
+  text_client_pool.EnableResolution(
+      config_json["text-service"]["resolve_interval_ms"]);
+  text_client_pool.StartMaintenance(text_health_check_ms,
+                                    text_refresh_ahead_ms);
   ClientPool<ThriftClient<UserServiceClient>> user_client_pool(
-      "user-service-client", user_addr, user_port, 0, user_conns, user_timeout,
-      user_keepalive, config_json);
+      "user-service-client", user_addr, user_port, user_min_conns, user_conns,
+      user_timeout, user_keepalive, config_json, user_shards);
+  user_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["user-service"]));
+  user_client_pool.EnableResolution(
+      config_json["user-service"]["resolve_interval_ms"]);
+  user_client_pool.StartMaintenance(user_health_check_ms,
+                                    user_refresh_ahead_ms);
   ClientPool<ThriftClient<MediaServiceClient>> media_client_pool(
-      "media-service-client", media_addr, media_port, 0, media_conns,
-      media_timeout, media_keepalive, config_json);
+      "media-service-client", media_addr, media_port, media_min_conns,
+      media_conns, media_timeout, media_keepalive, config_json, media_shards);
+  media_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["media-service"]));
+  media_client_pool.EnableResolution(
+      config_json["media-service"]["resolve_interval_ms"]);
+  media_client_pool.StartMaintenance(media_health_check_ms,
+                                     media_refresh_ahead_ms);
   ClientPool<ThriftClient<HomeTimelineServiceClient>> home_timeline_client_pool(
-      "home-timeline-service-client", home_timeline_addr, home_timeline_port, 0,
-      home_timeline_conns, home_timeline_timeout, home_timeline_keepalive, config_json);
+      "home-timeline-service-client", home_timeline_addr, home_timeline_port,
+      home_timeline_min_conns, home_timeline_conns, home_timeline_timeout,
+      home_timeline_keepalive, config_json, home_timeline_shards);
+  home_timeline_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["home-timeline-service"]));
+  home_timeline_client_pool.EnableResolution(
+      config_json["home-timeline-service"]["resolve_interval_ms"]);
+  home_timeline_client_pool.StartMaintenance(home_timeline_health_check_ms,
+                                             home_timeline_refresh_ahead_ms);
   ClientPool<ThriftClient<UniqueIdServiceClient>> unique_id_client_pool(
-      "unique-id-service-client", unique_id_addr, unique_id_port, 0,
-      unique_id_conns, unique_id_timeout, unique_id_keepalive, config_json);
-
-  std::shared_ptr<TServerSocket> server_socket = get_server_socket(config_json, "0.0.0.0", port);
-  TThreadedServer server(
-      std::make_shared<ComposePostServiceProcessor>(
-          std::make_shared<ComposePostHandler>(
-              &post_storage_client_pool, &user_timeline_client_pool,
-              &user_client_pool, &unique_id_client_pool, &media_client_pool,
-              &text_client_pool, &home_timeline_client_pool)),
-      server_socket,
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
+      "unique-id-service-client", unique_id_addr, unique_id_port,
+      unique_id_min_conns, unique_id_conns, unique_id_timeout,
+      unique_id_keepalive, config_json, unique_id_shards);
+  unique_id_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["unique-id-service"]));
+  unique_id_client_pool.EnableResolution(
+      config_json["unique-id-service"]["resolve_interval_ms"]);
+  unique_id_client_pool.StartMaintenance(unique_id_health_check_ms,
+                                         unique_id_refresh_ahead_ms);
+
+  ClientPool<RabbitmqClient> rabbitmq_client_pool(
+      "write-home-timeline-rabbitmq", rabbitmq_addr, rabbitmq_port, 0,
+      rabbitmq_conns, rabbitmq_timeout, rabbitmq_keepalive, config_json);
+
+  MultiplexedClientPool<PostStorageServiceConcurrentClient>
+      post_storage_mux_pool("post-storage-client", post_storage_addr,
+                            post_storage_port, post_storage_mux_conns,
+                            post_storage_keepalive, config_json);
+  MultiplexedClientPool<UserTimelineServiceConcurrentClient>
+      user_timeline_mux_pool("user-timeline-client", user_timeline_addr,
+                             user_timeline_port, user_timeline_mux_conns,
+                             user_timeline_keepalive, config_json);
+  MultiplexedClientPool<TextServiceConcurrentClient> text_mux_pool(
+      "text-service-client", text_addr, text_port, text_mux_conns,
+      text_keepalive, config_json);
+  MultiplexedClientPool<UserServiceConcurrentClient> user_mux_pool(
+      "user-service-client", user_addr, user_port, user_mux_conns,
+      user_keepalive, config_json);
+  MultiplexedClientPool<MediaServiceConcurrentClient> media_mux_pool(
+      "media-service-client", media_addr, media_port, media_mux_conns,
+      media_keepalive, config_json);
+  MultiplexedClientPool<HomeTimelineServiceConcurrentClient>
+      home_timeline_mux_pool("home-timeline-service-client",
+                             home_timeline_addr, home_timeline_port,
+                             home_timeline_mux_conns, home_timeline_keepalive,
+                             config_json);
+  MultiplexedClientPool<UniqueIdServiceConcurrentClient> unique_id_mux_pool(
+      "unique-id-service-client", unique_id_addr, unique_id_port,
+      unique_id_mux_conns, unique_id_keepalive, config_json);
+
+  std::shared_ptr<ComposePostHandler> handler;
+  if (multiplexed_clients) {
+    handler = std::make_shared<ComposePostHandler>(
+        &post_storage_mux_pool, &user_timeline_mux_pool, &user_mux_pool,
+        &unique_id_mux_pool, &media_mux_pool, &text_mux_pool,
+        &home_timeline_mux_pool);
+  } else {
+    handler = std::make_shared<ComposePostHandler>(
+        &post_storage_client_pool, &user_timeline_client_pool,
+        &user_client_pool, &unique_id_client_pool, &media_client_pool,
+        &text_client_pool, &home_timeline_client_pool);
+  }
+  if (home_timeline_fanout == "queue") {
+    LOG(info) << "Home timelines are written from the write-home-timeline "
+                 "queue";
+    handler->SetHomeTimelineQueue(&rabbitmq_client_pool);
+  }
+
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "compose-post-service",
+      std::make_shared<ComposePostServiceProcessor>(handler),
+      "0.0.0.0", port);
   LOG(info) << "Starting the compose-post-service server ...";
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
@@ -1,15 +1,22 @@
 #ifndef SOCIAL_NETWORK_MICROSERVICES_SRC_COMPOSEPOSTSERVICE_RABBITMQCLIENT_H_
 #define SOCIAL_NETWORK_MICROSERVICES_SRC_COMPOSEPOSTSERVICE_RABBITMQCLIENT_H_
 
+#include <chrono>
+#include <nlohmann/json.hpp>
 #include <SimpleAmqpClient/SimpleAmqpClient.h>
 
 #include "../GenericClient.h"
 
 namespace social_network {
+using json = nlohmann::json;
+
+#define WRITE_HOME_TIMELINE_QUEUE "write-home-timeline"
 
 class RabbitmqClient : public GenericClient {
  public:
   RabbitmqClient(const std::string &addr, int port);
+  RabbitmqClient(const std::string &addr, int port, int keepalive_ms,
+                 const json &config_json);
   RabbitmqClient(const RabbitmqClient &) = delete;
   RabbitmqClient &operator=(const RabbitmqClient &) = delete;
   RabbitmqClient(RabbitmqClient &&) = default;
@@ -19,55 +26,62 @@ class RabbitmqClient : public GenericClient {
 
   void Connect() override;
   void Disconnect() override;
-  void KeepAlive() override;
-  void KeepAlive(int timeout_ms) override;
   bool IsConnected() override;
 
+  // Publishes a persistent message to the write-home-timeline queue.
+  // SimpleAmqpClient opens its channels in confirm mode, so this returns
+  // once the broker has taken the message and throws if it refused it.
+  void Publish(const std::string &body);
+
   AmqpClient::Channel::ptr_t GetChannel();
 
  private:
-  std::string _addr;
-  int _port;
   AmqpClient::Channel::ptr_t _channel;
-  bool _is_connected;
 };
 
 RabbitmqClient::RabbitmqClient(const std::string &addr, int port) {
   _addr = addr;
   _port = port;
-  _channel = AmqpClient::Channel::Create(addr, port);
-  _is_connected = false;
+  _connect_timestamp = 0;
+  _keepalive_ms = 0;
+}
+
+RabbitmqClient::RabbitmqClient(const std::string &addr, int port,
+                               int keepalive_ms, const json &config_json) {
+  _addr = addr;
+  _port = port;
+  _connect_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  _keepalive_ms = keepalive_ms;
 }
 
 RabbitmqClient::~RabbitmqClient() { Disconnect(); }
 
 void RabbitmqClient::Connect() {
   if (!IsConnected()) {
-    try {
-      _channel->DeclareQueue("write-home-timeline", false, true, false, false);
-    } catch (...) {
-      throw;
-    }
-    _is_connected = true;
+    auto channel = AmqpClient::Channel::Create(_addr, _port);
+    // Same declaration as the consumers: durable, so that queued posts
+    // survive a broker restart.
+    channel->DeclareQueue(WRITE_HOME_TIMELINE_QUEUE, false, true, false,
+                          false);
+    _channel = channel;
   }
 }
 
 void RabbitmqClient::Disconnect() {
-  if (IsConnected()) {
-    try {
-      _channel->DeleteQueue("write-home-timeline");
-      _is_connected = false;
-    } catch (...) {
-      throw;
-    }
-  }
+  // The queue is shared with the consumers and must outlive the client,
+  // dropping the channel closes the connection.
+  _channel.reset();
 }
 
-void RabbitmqClient::KeepAlive() {}
+bool RabbitmqClient::IsConnected() { return _channel != nullptr; }
 
-void RabbitmqClient::KeepAlive(int timeout_ms) {}
-
-bool RabbitmqClient::IsConnected() { return _is_connected; }
+void RabbitmqClient::Publish(const std::string &body) {
+  auto message = AmqpClient::BasicMessage::Create(body);
+  message->DeliveryMode(AmqpClient::BasicMessage::dm_persistent);
+  message->ContentType("application/json");
+  _channel->BasicPublish("", WRITE_HOME_TIMELINE_QUEUE, message);
+}
 
 AmqpClient::Channel::ptr_t RabbitmqClient::GetChannel() { return _channel; }
 
@@ -0,0 +1,172 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_CONCURRENCYLIMITER_H
+#define SOCIAL_NETWORK_MICROSERVICES_CONCURRENCYLIMITER_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+#include "Metrics.h"
+
+namespace social_network {
+
+// Latency samples are averaged over windows of at least this duration and
+// this many requests before the limit is updated.
+#define CONCURRENCY_LIMIT_WINDOW_MS 100
+#define CONCURRENCY_LIMIT_WINDOW_MIN_SAMPLES 10
+// Number of windows the no-load latency estimate is averaged over.
+#define CONCURRENCY_LIMIT_LONG_WINDOWS 100
+// A window latency up to this factor above the no-load latency is not
+// treated as queueing.
+#define CONCURRENCY_LIMIT_RTT_TOLERANCE 1.5
+#define CONCURRENCY_LIMIT_SMOOTHING 0.2
+// Head room added to the limit, so that it can grow while there is no
+// queueing.
+#define CONCURRENCY_LIMIT_QUEUE_SIZE 4
+
+// Adaptive limit on the number of requests a server works on at once,
+// after the gradient algorithm of Netflix concurrency-limits. The limit
+// shrinks when the latency of recent requests rises above the long-term
+// (no-load) latency, which means requests are queueing somewhere, and grows
+// while it does not. Requests above the limit are rejected right away
+// instead of adding to the queue.
+class ConcurrencyLimiter {
+ public:
+  ConcurrencyLimiter(const std::string &name, int initial_limit,
+                     int min_limit, int max_limit);
+
+  ConcurrencyLimiter(const ConcurrencyLimiter&) = delete;
+  ConcurrencyLimiter& operator=(const ConcurrencyLimiter&) = delete;
+
+  // Returns false if the request must be rejected. Every successful
+  // TryAcquire() must be followed by a Release().
+  bool TryAcquire();
+  void Release(long latency_us);
+
+  int Limit() const { return _limit.load(std::memory_order_relaxed); }
+  int InFlight() const { return _in_flight.load(std::memory_order_relaxed); }
+
+ private:
+  void _Update(double short_rtt_us, int max_in_flight);
+
+  const int _min_limit;
+  const int _max_limit;
+  std::atomic<int> _limit;
+  std::atomic<int> _in_flight{0};
+
+  // The samples of the current window are accumulated without a lock;
+  // _mtx is only taken by the Release() that rolls the window over, and
+  // guards the limit estimate.
+  std::atomic<long> _window_start_ns;
+  std::atomic<long> _window_sum_us{0};
+  std::atomic<long> _window_count{0};
+  std::atomic<int> _window_max_in_flight{0};
+
+  std::mutex _mtx;
+  double _estimated_limit;
+  double _long_rtt_us = 0;
+
+  std::atomic<long> *_limit_gauge;
+  std::atomic<long> *_rejected;
+};
+
+ConcurrencyLimiter::ConcurrencyLimiter(const std::string &name,
+                                       int initial_limit, int min_limit,
+                                       int max_limit)
+    : _min_limit(std::max(min_limit, 1)),
+      _max_limit(std::max(max_limit, _min_limit)) {
+  _estimated_limit = std::min(std::max(initial_limit, _min_limit), _max_limit);
+  _limit = static_cast<int>(_estimated_limit);
+  _window_start_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  std::string labels = MetricLabel("server", name);
+  _limit_gauge = Metrics::GetInstance()->GetGauge("concurrency_limit", labels);
+  _rejected =
+      Metrics::GetInstance()->GetCounter("rpc_rejected_total", labels);
+  *_limit_gauge = _limit.load();
+}
+
+bool ConcurrencyLimiter::TryAcquire() {
+  int in_flight = _in_flight.load(std::memory_order_relaxed);
+  do {
+    if (in_flight >= _limit.load(std::memory_order_relaxed)) {
+      (*_rejected)++;
+      return false;
+    }
+  } while (!_in_flight.compare_exchange_weak(in_flight, in_flight + 1));
+  return true;
+}
+
+void ConcurrencyLimiter::Release(long latency_us) {
+  int in_flight = _in_flight.fetch_sub(1);
+
+  _window_sum_us.fetch_add(latency_us, std::memory_order_relaxed);
+  long count = _window_count.fetch_add(1, std::memory_order_relaxed) + 1;
+  int max_in_flight = _window_max_in_flight.load(std::memory_order_relaxed);
+  while (in_flight > max_in_flight &&
+      !_window_max_in_flight.compare_exchange_weak(max_in_flight, in_flight)) {}
+  if (count < CONCURRENCY_LIMIT_WINDOW_MIN_SAMPLES) {
+    return;
+  }
+  long now_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  long window_ns = CONCURRENCY_LIMIT_WINDOW_MS * 1000000l;
+  if (now_ns - _window_start_ns.load() < window_ns) {
+    return;
+  }
+
+  // One caller rolls the window over, the others carry on.
+  std::unique_lock<std::mutex> lock(_mtx, std::try_to_lock);
+  if (!lock.owns_lock() || now_ns - _window_start_ns.load() < window_ns) {
+    return;
+  }
+  _window_start_ns = now_ns;
+  // A sample racing with the reset may count towards either window, which
+  // only blurs the average.
+  count = _window_count.exchange(0);
+  long sum_us = _window_sum_us.exchange(0);
+  max_in_flight = _window_max_in_flight.exchange(0);
+  if (count > 0) {
+    _Update(static_cast<double>(sum_us) / count, max_in_flight);
+  }
+}
+
+void ConcurrencyLimiter::_Update(double short_rtt_us, int max_in_flight) {
+  if (short_rtt_us <= 0) {
+    short_rtt_us = 1;
+  }
+  if (_long_rtt_us == 0) {
+    _long_rtt_us = short_rtt_us;
+  } else {
+    _long_rtt_us +=
+        (short_rtt_us - _long_rtt_us) / CONCURRENCY_LIMIT_LONG_WINDOWS;
+  }
+  // Let the no-load estimate recover quickly once a latency spike is over.
+  if (_long_rtt_us / short_rtt_us > 2) {
+    _long_rtt_us *= 0.95;
+  }
+
+  // The latency says nothing about the limit while the server is far from
+  // using it.
+  if (max_in_flight < _estimated_limit / 2) {
+    return;
+  }
+
+  // Never shed more than half of the limit at once, so that a few outliers
+  // do not throttle the server.
+  double gradient = std::max(0.5, std::min(1.0,
+      CONCURRENCY_LIMIT_RTT_TOLERANCE * _long_rtt_us / short_rtt_us));
+  double new_limit =
+      _estimated_limit * gradient + CONCURRENCY_LIMIT_QUEUE_SIZE;
+  new_limit = _estimated_limit * (1 - CONCURRENCY_LIMIT_SMOOTHING) +
+      new_limit * CONCURRENCY_LIMIT_SMOOTHING;
+  _estimated_limit = std::max<double>(_min_limit,
+                                      std::min<double>(_max_limit, new_limit));
+  _limit = static_cast<int>(_estimated_limit);
+  *_limit_gauge = _limit.load();
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_CONCURRENCYLIMITER_H
@@ -0,0 +1,93 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_DEADLINE_H
+#define SOCIAL_NETWORK_MICROSERVICES_DEADLINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <string>
+
+#include "../gen-cpp/social_network_types.h"
+
+namespace social_network {
+
+// Carrier entry holding the absolute deadline of a request, in milliseconds
+// since the epoch. nginx sets it; every hop forwards it next to the tracing
+// context.
+#define DEADLINE_CARRIER_KEY "deadline-ms"
+
+// End-to-end deadline of a request. A default-constructed Deadline, e.g. for
+// a request whose carrier has no deadline, never expires.
+class Deadline {
+ public:
+  Deadline() = default;
+  explicit Deadline(long deadline_ms) : _deadline_ms(deadline_ms) {}
+
+  static Deadline FromCarrier(const std::map<std::string, std::string> &carrier);
+  static long NowMs();
+
+  void Inject(std::map<std::string, std::string> *carrier) const;
+
+  bool IsSet() const { return _deadline_ms > 0; }
+  bool Expired() const { return IsSet() && NowMs() >= _deadline_ms; }
+  // Milliseconds left, at least 1 while the deadline has not passed, 0 once
+  // it has. Only meaningful if IsSet().
+  long RemainingMs() const;
+  std::chrono::system_clock::time_point TimePoint() const;
+
+  // Throws a ServiceException once the deadline has passed, so that a hop
+  // gives up on a request its caller no longer waits for.
+  void Check() const;
+
+ private:
+  long _deadline_ms = 0;
+};
+
+long Deadline::NowMs() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+Deadline Deadline::FromCarrier(
+    const std::map<std::string, std::string> &carrier) {
+  auto it = carrier.find(DEADLINE_CARRIER_KEY);
+  if (it == carrier.end()) {
+    return Deadline();
+  }
+  try {
+    return Deadline(std::stol(it->second));
+  } catch (...) {
+    return Deadline();
+  }
+}
+
+void Deadline::Inject(std::map<std::string, std::string> *carrier) const {
+  if (IsSet()) {
+    (*carrier)[DEADLINE_CARRIER_KEY] = std::to_string(_deadline_ms);
+  }
+}
+
+long Deadline::RemainingMs() const {
+  long now_ms = NowMs();
+  if (now_ms >= _deadline_ms) {
+    return 0;
+  }
+  return std::max(_deadline_ms - now_ms, 1l);
+}
+
+std::chrono::system_clock::time_point Deadline::TimePoint() const {
+  return std::chrono::system_clock::time_point(
+      std::chrono::milliseconds(_deadline_ms));
+}
+
+void Deadline::Check() const {
+  if (Expired()) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
+    se.message = "Deadline exceeded";
+    throw se;
+  }
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_DEADLINE_H
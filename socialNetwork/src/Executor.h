@@ -0,0 +1,263 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_EXECUTOR_H
+#define SOCIAL_NETWORK_MICROSERVICES_EXECUTOR_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "logger.h"
+#include "Metrics.h"
+
+namespace social_network {
+
+#define EXECUTOR_DEFAULT_THREADS 64
+#define EXECUTOR_DEFAULT_QUEUE_SIZE 4096
+
+// Future returned by Executor::Submit. Like the futures of std::async, it
+// waits for the task on destruction, so that tasks capturing the caller's
+// stack by reference never outlive it when an exception unwinds the caller.
+template<class T>
+class ExecutorFuture : public std::future<T> {
+ public:
+  ExecutorFuture() = default;
+  ExecutorFuture(std::future<T> &&future) : std::future<T>(std::move(future)) {}
+  ExecutorFuture(ExecutorFuture &&) = default;
+  ExecutorFuture &operator=(ExecutorFuture &&other) {
+    if (this->valid()) {
+      this->wait();
+    }
+    std::future<T>::operator=(std::move(other));
+    return *this;
+  }
+  ~ExecutorFuture() {
+    if (this->valid()) {
+      this->wait();
+    }
+  }
+};
+
+// Process-wide pool of worker threads used by the handlers to fan out
+// requests, instead of paying for a new thread per std::async call.
+// Every worker owns a task queue; an idle worker steals from the back of the
+// other queues. The total number of queued tasks is bounded: once the bound
+// is reached, or when a worker submits a nested task, the task runs on the
+// calling thread, which both applies back-pressure and rules out deadlocks
+// between tasks waiting on each other.
+// The number of queued tasks is exported as the executor_queue_depth gauge
+// and the time tasks wait in the queue as the executor_task_wait_us
+// histogram.
+class Executor {
+ public:
+  Executor(int num_threads, int max_queue_size);
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  // Sizes the process-wide executor. Must be called before the first
+  // GetInstance(), i.e. in main() before the handler is constructed.
+  static void Init(int num_threads, int max_queue_size);
+  static Executor *GetInstance();
+
+  template<class F, class... Args>
+  ExecutorFuture<typename std::result_of<
+      typename std::decay<F>::type(typename std::decay<Args>::type...)>::type>
+  Submit(F &&f, Args &&... args);
+
+  // Queues a task nobody waits for. Returns false, without running the
+  // task, when the queue is full or when called from a worker of this
+  // executor, where waiting for the task could deadlock.
+  bool Post(std::function<void()> fn);
+
+  long QueueDepth() const;
+
+ private:
+  struct Task {
+    std::function<void()> fn;
+    std::chrono::steady_clock::time_point enqueue_time;
+  };
+
+  struct Worker {
+    std::mutex mtx;
+    std::deque<Task> tasks;
+  };
+
+  static Executor *_Instance(int num_threads, int max_queue_size);
+  static Executor *&_CurrentExecutor();
+
+  bool _Enqueue(std::function<void()> &&fn);
+  bool _Pop(size_t worker_idx, Task *task);
+  void _Run(size_t worker_idx);
+
+  std::vector<std::unique_ptr<Worker>> _workers;
+  std::vector<std::thread> _threads;
+  std::mutex _sleep_mtx;
+  std::condition_variable _sleep_cv;
+  std::atomic<unsigned> _next_worker{0};
+  // Slots of the queue bound taken by submitters, counted before their task
+  // is pushed.
+  std::atomic<long> _reserved{0};
+  // Tasks in the worker queues, counted under the worker's mutex once the
+  // task is pushed, so that a worker woken by a non-zero depth finds a task.
+  std::atomic<long> _queue_depth{0};
+  long _max_queue_size;
+  bool _stop{false};
+
+  std::atomic<long> *_queue_depth_gauge;
+  Histogram *_task_wait_us;
+};
+
+Executor::Executor(int num_threads, int max_queue_size) {
+  if (num_threads < 1) {
+    num_threads = 1;
+  }
+  _max_queue_size = max_queue_size;
+  _queue_depth_gauge =
+      Metrics::GetInstance()->GetGauge("executor_queue_depth", "");
+  _task_wait_us =
+      Metrics::GetInstance()->GetHistogram("executor_task_wait_us", "");
+  for (int i = 0; i < num_threads; ++i) {
+    _workers.emplace_back(new Worker());
+  }
+  for (int i = 0; i < num_threads; ++i) {
+    _threads.emplace_back(&Executor::_Run, this, i);
+  }
+}
+
+Executor::~Executor() {
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mtx);
+    _stop = true;
+  }
+  _sleep_cv.notify_all();
+  for (auto &thread : _threads) {
+    thread.join();
+  }
+}
+
+Executor *Executor::_Instance(int num_threads, int max_queue_size) {
+  // Intentionally leaked: the services exit() from their signal handlers,
+  // and joining workers that are blocked on an RPC would hang the exit.
+  static Executor *instance = new Executor(
+      num_threads > 0 ? num_threads : EXECUTOR_DEFAULT_THREADS,
+      max_queue_size > 0 ? max_queue_size : EXECUTOR_DEFAULT_QUEUE_SIZE);
+  return instance;
+}
+
+void Executor::Init(int num_threads, int max_queue_size) {
+  _Instance(num_threads, max_queue_size);
+}
+
+Executor *Executor::GetInstance() {
+  return _Instance(0, 0);
+}
+
+Executor *&Executor::_CurrentExecutor() {
+  static thread_local Executor *current = nullptr;
+  return current;
+}
+
+template<class F, class... Args>
+ExecutorFuture<typename std::result_of<
+    typename std::decay<F>::type(typename std::decay<Args>::type...)>::type>
+Executor::Submit(F &&f, Args &&... args) {
+  using TReturn = typename std::result_of<
+      typename std::decay<F>::type(typename std::decay<Args>::type...)>::type;
+  auto task = std::make_shared<std::packaged_task<TReturn()>>(
+      std::bind(std::forward<F>(f), std::forward<Args>(args)...));
+  ExecutorFuture<TReturn> future(task->get_future());
+  if (_CurrentExecutor() == this || !_Enqueue([task]() { (*task)(); })) {
+    (*task)();
+  }
+  return future;
+}
+
+bool Executor::Post(std::function<void()> fn) {
+  if (_CurrentExecutor() == this || !_Enqueue(std::move(fn))) {
+    return false;
+  }
+  return true;
+}
+
+bool Executor::_Enqueue(std::function<void()> &&fn) {
+  if (_reserved.fetch_add(1) >= _max_queue_size) {
+    _reserved--;
+    return false;
+  }
+  Worker &worker = *_workers[_next_worker++ % _workers.size()];
+  {
+    std::lock_guard<std::mutex> lock(worker.mtx);
+    worker.tasks.push_back({std::move(fn), std::chrono::steady_clock::now()});
+    _queue_depth++;
+    (*_queue_depth_gauge)++;
+  }
+  {
+    std::lock_guard<std::mutex> lock(_sleep_mtx);
+  }
+  _sleep_cv.notify_one();
+  return true;
+}
+
+bool Executor::_Pop(size_t worker_idx, Task *task) {
+  // Own queue first (FIFO), then steal the newest task of another worker.
+  for (size_t i = 0; i < _workers.size(); ++i) {
+    Worker &worker = *_workers[(worker_idx + i) % _workers.size()];
+    std::lock_guard<std::mutex> lock(worker.mtx);
+    if (worker.tasks.empty()) {
+      continue;
+    }
+    if (i == 0) {
+      *task = std::move(worker.tasks.front());
+      worker.tasks.pop_front();
+    } else {
+      *task = std::move(worker.tasks.back());
+      worker.tasks.pop_back();
+    }
+    _queue_depth--;
+    _reserved--;
+    (*_queue_depth_gauge)--;
+    return true;
+  }
+  return false;
+}
+
+void Executor::_Run(size_t worker_idx) {
+  _CurrentExecutor() = this;
+  Task task;
+  while (true) {
+    if (!_Pop(worker_idx, &task)) {
+      std::unique_lock<std::mutex> lock(_sleep_mtx);
+      _sleep_cv.wait(lock, [this] {
+        return _stop || _queue_depth.load() > 0;
+      });
+      if (_stop) {
+        return;
+      }
+      continue;
+    }
+
+    _task_wait_us->Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - task.enqueue_time).count());
+
+    // Exceptions are stored in the task's future by packaged_task.
+    task.fn();
+    task.fn = nullptr;
+  }
+}
+
+long Executor::QueueDepth() const {
+  return _queue_depth.load();
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_EXECUTOR_H
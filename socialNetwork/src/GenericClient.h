@@ -3,18 +3,30 @@
 
 #include <string>
 #include <chrono>
+#include <memory>
 
 namespace social_network {
 
+struct ClientEndpoint;
+
 class GenericClient{
  public:
   virtual ~GenericClient() = default;
   virtual void Connect() = 0;
   virtual void Disconnect() = 0;
   virtual bool IsConnected() = 0;
+  // Checks that an idle connection is still usable.
+  virtual bool Probe() { return IsConnected(); }
+  // Bounds the I/O of the next calls, 0 for no timeout. Clients without
+  // per-call timeouts ignore it.
+  virtual void SetTimeout(int timeout_ms) {}
 
   long _connect_timestamp;
   long _keepalive_ms;
+  // When the client was last handed out by its pool.
+  std::chrono::steady_clock::time_point _pop_time;
+  // Replica the client connects to, set by its pool.
+  std::shared_ptr<ClientEndpoint> _endpoint;
 
  protected:
   std::string _addr;
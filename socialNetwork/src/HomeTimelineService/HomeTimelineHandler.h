@@ -3,15 +3,26 @@
 
 #include <sw/redis++/redis++.h>
 
+#include <atomic>
+#include <chrono>
 #include <future>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 
 #include "../../gen-cpp/HomeTimelineService.h"
 #include "../../gen-cpp/PostStorageService.h"
 #include "../../gen-cpp/SocialGraphService.h"
+#include "../../gen-cpp/UserTimelineService.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
+#include "../Executor.h"
+#include "../HybridTimeline.h"
+#include "../ShardFanout.h"
 #include "../ThriftClient.h"
+#include "../TimelineEncoding.h"
 #include "../logger.h"
 #include "../tracing.h"
 
@@ -36,6 +47,31 @@ class HomeTimelineHandler : public HomeTimelineServiceIf {
 
   bool IsRedisReplicationEnabled();
 
+  // Stops pushing the posts of users with at least fanout_threshold
+  // followers to their followers, who merge them in when they read their
+  // home timelines. The set of such users is re-read from Redis every
+  // pull_users_refresh_ms. Must be called before the server starts.
+  void EnableHybridTimeline(int fanout_threshold, int pull_users_refresh_ms);
+
+  // Keeps only the newest max_timeline_length posts of every timeline, 0
+  // keeps them all. Must be called before the server starts.
+  void SetMaxTimelineLength(int max_timeline_length);
+
+  // Serves the pages of home timelines beyond the posts kept in Redis from
+  // the user timelines of the followees. Must be called before the server
+  // starts.
+  void EnableDeepPagination(
+      ClientPool<ThriftClient<UserTimelineServiceClient>>
+          *user_timeline_client_pool);
+
+  // Encoding of the post ids written to the timelines. Post ids of either
+  // encoding are read. Must be called before the server starts.
+  void SetTimelineEncoding(TimelineEncoding timeline_encoding);
+
+  // Number of Redis Cluster shards written to at a time by
+  // WriteHomeTimeline. Must be called before the server starts.
+  void SetClusterPipelineParallelism(int cluster_pipeline_parallelism);
+
   void ReadHomeTimeline(std::vector<Post> &, int64_t, int64_t, int, int,
                         const std::map<std::string, std::string> &) override;
 
@@ -50,6 +86,39 @@ class HomeTimelineHandler : public HomeTimelineServiceIf {
      RedisCluster *_redis_cluster_client_pool;
      ClientPool<ThriftClient<PostStorageServiceClient>> *_post_client_pool;
      ClientPool<ThriftClient<SocialGraphServiceClient>> *_social_graph_client_pool;
+
+  int _fanout_threshold = 0;
+  int _pull_users_refresh_ms = 0;
+  std::shared_ptr<const std::unordered_set<int64_t>> _pull_users;
+  std::atomic<long> _pull_users_refreshed_ms{0};
+  std::mutex _pull_users_mtx;
+
+  int _max_timeline_length = 0;
+  TimelineEncoding _timeline_encoding = TimelineEncoding::DECIMAL;
+  int _cluster_pipeline_parallelism = 1;
+  ClientPool<ThriftClient<UserTimelineServiceClient>>
+      *_user_timeline_client_pool = nullptr;
+
+  // Runs fn with the Redis that serves reads, or writes if write is set.
+  template <class F>
+  void _WithRedis(bool write, F &&fn);
+  static Pipeline _NewPipeline(Redis *redis, const std::string &key);
+  static Pipeline _NewPipeline(RedisCluster *redis, const std::string &key);
+  // Adds a post to a timeline through a Redis client or pipeline, and
+  // trims the timeline to its maximum length.
+  template <class TRedis>
+  void _AddToTimeline(TRedis &redis, const std::string &key,
+                      const std::string &post_id_str, int64_t timestamp);
+  std::shared_ptr<const std::unordered_set<int64_t>> _GetPullUsers();
+  std::vector<int64_t> _GetFollowees(
+      int64_t req_id, int64_t user_id, const opentracing::Span &parent_span,
+      const Deadline &deadline);
+  std::vector<int64_t> _GetPullFollowees(
+      int64_t req_id, int64_t user_id, const opentracing::Span &parent_span,
+      const Deadline &deadline);
+  std::vector<Post> _ReadDeepHomeTimeline(
+      int64_t req_id, int64_t user_id, int start_idx, int stop_idx,
+      const opentracing::Span &parent_span, const Deadline &deadline);
 };
 
 HomeTimelineHandler::HomeTimelineHandler(
@@ -96,44 +165,270 @@ bool HomeTimelineHandler::IsRedisReplicationEnabled() {
     return (_redis_primary_pool || _redis_replica_pool);
 }
 
+void HomeTimelineHandler::EnableHybridTimeline(int fanout_threshold,
+                                               int pull_users_refresh_ms) {
+  _fanout_threshold = fanout_threshold;
+  _pull_users_refresh_ms = pull_users_refresh_ms;
+}
+
+void HomeTimelineHandler::SetMaxTimelineLength(int max_timeline_length) {
+  _max_timeline_length = max_timeline_length;
+}
+
+void HomeTimelineHandler::EnableDeepPagination(
+    ClientPool<ThriftClient<UserTimelineServiceClient>>
+        *user_timeline_client_pool) {
+  _user_timeline_client_pool = user_timeline_client_pool;
+}
+
+void HomeTimelineHandler::SetTimelineEncoding(
+    TimelineEncoding timeline_encoding) {
+  _timeline_encoding = timeline_encoding;
+}
+
+void HomeTimelineHandler::SetClusterPipelineParallelism(
+    int cluster_pipeline_parallelism) {
+  _cluster_pipeline_parallelism = cluster_pipeline_parallelism;
+}
+
+template <class TRedis>
+void HomeTimelineHandler::_AddToTimeline(TRedis &redis, const std::string &key,
+                                         const std::string &post_id_str,
+                                         int64_t timestamp) {
+  redis.zadd(key, post_id_str, timestamp, UpdateType::NOT_EXIST);
+  if (_max_timeline_length > 0) {
+    // Ranks count from the oldest post, -1 being the newest one.
+    redis.zremrangebyrank(key, 0, -(_max_timeline_length + 1));
+  }
+}
+
+template <class F>
+void HomeTimelineHandler::_WithRedis(bool write, F &&fn) {
+  if (_redis_client_pool) {
+    fn(_redis_client_pool);
+  } else if (IsRedisReplicationEnabled()) {
+    fn(write ? _redis_primary_pool : _redis_replica_pool);
+  } else {
+    fn(_redis_cluster_client_pool);
+  }
+}
+
+Pipeline HomeTimelineHandler::_NewPipeline(Redis *redis,
+                                           const std::string &key) {
+  return redis->pipeline(false);
+}
+
+Pipeline HomeTimelineHandler::_NewPipeline(RedisCluster *redis,
+                                           const std::string &key) {
+  return redis->pipeline(key, false);
+}
+
+std::shared_ptr<const std::unordered_set<int64_t>>
+HomeTimelineHandler::_GetPullUsers() {
+  long now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  auto pull_users = std::atomic_load(&_pull_users);
+  if (pull_users &&
+      now_ms - _pull_users_refreshed_ms.load() < _pull_users_refresh_ms) {
+    return pull_users;
+  }
+
+  // One request refreshes the set while the others go on with the old one.
+  // Only the first requests wait, as there is no old set yet.
+  std::unique_lock<std::mutex> lock(_pull_users_mtx, std::defer_lock);
+  if (pull_users) {
+    if (!lock.try_lock()) {
+      return pull_users;
+    }
+  } else {
+    lock.lock();
+  }
+  pull_users = std::atomic_load(&_pull_users);
+  if (pull_users &&
+      now_ms - _pull_users_refreshed_ms.load() < _pull_users_refresh_ms) {
+    return pull_users;
+  }
+
+  std::vector<std::string> user_ids_str;
+  try {
+    _WithRedis(false, [&](auto *redis) {
+      redis->smembers(HOME_TIMELINE_PULL_USERS_KEY,
+                      std::back_inserter(user_ids_str));
+    });
+  } catch (const Error &err) {
+    LOG(error) << err.what();
+    if (pull_users) {
+      return pull_users;
+    }
+    throw err;
+  }
+  auto new_pull_users = std::make_shared<std::unordered_set<int64_t>>();
+  for (auto &user_id_str : user_ids_str) {
+    new_pull_users->insert(std::stol(user_id_str));
+  }
+  pull_users = new_pull_users;
+  std::atomic_store(&_pull_users, pull_users);
+  _pull_users_refreshed_ms = now_ms;
+  return pull_users;
+}
+
+std::vector<int64_t> HomeTimelineHandler::_GetFollowees(
+    int64_t req_id, int64_t user_id, const opentracing::Span &parent_span,
+    const Deadline &deadline) {
+  auto followees_span = opentracing::Tracer::Global()->StartSpan(
+      "get_followees_client", {opentracing::ChildOf(&parent_span.context())});
+  std::map<std::string, std::string> writer_text_map;
+  TextMapWriter writer(writer_text_map);
+  opentracing::Tracer::Global()->Inject(followees_span->context(), writer);
+  deadline.Inject(&writer_text_map);
+
+  // GetFollowees is a read, so a slow call may be hedged.
+  std::vector<int64_t> followees_id;
+  try {
+    followees_id =
+        _social_graph_client_pool->HedgedCall<std::vector<int64_t>>(
+            deadline,
+            [req_id, user_id, writer_text_map](
+                ThriftClient<SocialGraphServiceClient> *client) {
+              std::vector<int64_t> followees;
+              client->GetClient()->GetFollowees(followees, req_id, user_id,
+                                                writer_text_map);
+              return followees;
+            });
+  } catch (...) {
+    LOG(error) << "Failed to get followees from social-network-service";
+    throw;
+  }
+  followees_span->Finish();
+  return followees_id;
+}
+
+std::vector<int64_t> HomeTimelineHandler::_GetPullFollowees(
+    int64_t req_id, int64_t user_id, const opentracing::Span &parent_span,
+    const Deadline &deadline) {
+  std::vector<int64_t> pull_followees;
+  auto pull_users = _GetPullUsers();
+  if (pull_users->empty()) {
+    return pull_followees;
+  }
+
+  for (auto followee_id :
+       _GetFollowees(req_id, user_id, parent_span, deadline)) {
+    if (pull_users->count(followee_id)) {
+      pull_followees.emplace_back(followee_id);
+    }
+  }
+  return pull_followees;
+}
+
+std::vector<Post> HomeTimelineHandler::_ReadDeepHomeTimeline(
+    int64_t req_id, int64_t user_id, int start_idx, int stop_idx,
+    const opentracing::Span &parent_span, const Deadline &deadline) {
+  std::vector<int64_t> followees_id =
+      _GetFollowees(req_id, user_id, parent_span, deadline);
+
+  // The first stop_idx posts of every followee hold the first stop_idx
+  // posts of the home timeline. The posts that only mention the user are
+  // not in any of them, so deep pages leave mentions out. A deep page costs
+  // one ReadUserTimeline of up to stop_idx posts per followee.
+  auto user_timeline_span = opentracing::Tracer::Global()->StartSpan(
+      "read_user_timelines_client",
+      {opentracing::ChildOf(&parent_span.context())});
+  std::map<std::string, std::string> writer_text_map;
+  TextMapWriter writer(writer_text_map);
+  opentracing::Tracer::Global()->Inject(user_timeline_span->context(), writer);
+  deadline.Inject(&writer_text_map);
+
+  auto *user_timeline_client_pool = _user_timeline_client_pool;
+  std::vector<ExecutorFuture<std::vector<Post>>> user_timeline_futures;
+  for (auto followee_id : followees_id) {
+    user_timeline_futures.emplace_back(Executor::GetInstance()->Submit(
+        [=]() {
+          return user_timeline_client_pool->HedgedCall<std::vector<Post>>(
+              deadline,
+              [=](ThriftClient<UserTimelineServiceClient> *client) {
+                std::vector<Post> posts;
+                client->GetClient()->ReadUserTimeline(
+                    posts, req_id, followee_id, 0, stop_idx,
+                    writer_text_map);
+                return posts;
+              });
+        }));
+  }
+
+  std::map<std::string, Post> posts;
+  std::vector<TimelineEntries> timelines;
+  try {
+    for (auto &user_timeline_future : user_timeline_futures) {
+      timelines.emplace_back();
+      for (auto &post : user_timeline_future.get()) {
+        std::string post_id_str = std::to_string(post.post_id);
+        timelines.back().emplace_back(post_id_str, post.timestamp);
+        posts[post_id_str] = std::move(post);
+      }
+    }
+  } catch (...) {
+    LOG(error) << "Failed to read user timelines from user-timeline-service";
+    throw;
+  }
+  user_timeline_span->Finish();
+
+  std::vector<Post> page;
+  for (auto &post_id_str : MergeTimelines(timelines, start_idx, stop_idx)) {
+    page.emplace_back(std::move(posts[post_id_str]));
+  }
+  return page;
+}
+
 void HomeTimelineHandler::WriteHomeTimeline(
     int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
     const std::vector<int64_t> &user_mentions_id,
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "write_home_timeline_server", {opentracing::ChildOf(parent_span->get())});
 
-  // Find followers of the user
-  auto followers_span = opentracing::Tracer::Global()->StartSpan(
-      "get_followers_client", {opentracing::ChildOf(&span->context())});
-  std::map<std::string, std::string> writer_text_map;
-  TextMapWriter writer(writer_text_map);
-  opentracing::Tracer::Global()->Inject(followers_span->context(), writer);
-
-  auto social_graph_client_wrapper = _social_graph_client_pool->Pop();
-  if (!social_graph_client_wrapper) {
-    ServiceException se;
-    se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
-    se.message = "Failed to connect to social-graph-service";
-    throw se;
-  }
-  auto social_graph_client = social_graph_client_wrapper->GetClient();
+  // The posts of a user with too many followers to push to are pulled by
+  // the followers instead. Mentioned users still get them pushed. A user
+  // whose posts are pulled stays so, without reading the followers again.
+  bool pull = _fanout_threshold > 0 && _GetPullUsers()->count(user_id) > 0;
   std::vector<int64_t> followers_id;
-  try {
-    social_graph_client->GetFollowers(followers_id, req_id, user_id,
-                                      writer_text_map);
-  } catch (...) {
-    LOG(error) << "Failed to get followers from social-network-service";
-    _social_graph_client_pool->Remove(social_graph_client_wrapper);
-    throw;
+  if (!pull) {
+    // Find followers of the user
+    auto followers_span = opentracing::Tracer::Global()->StartSpan(
+        "get_followers_client", {opentracing::ChildOf(&span->context())});
+    std::map<std::string, std::string> writer_text_map;
+    TextMapWriter writer(writer_text_map);
+    opentracing::Tracer::Global()->Inject(followers_span->context(), writer);
+    deadline.Inject(&writer_text_map);
+
+    // GetFollowers is a read, so a slow call may be hedged.
+    try {
+      followers_id =
+          _social_graph_client_pool->HedgedCall<std::vector<int64_t>>(
+              deadline,
+              [req_id, user_id, writer_text_map](
+                  ThriftClient<SocialGraphServiceClient> *client) {
+                std::vector<int64_t> followers;
+                client->GetClient()->GetFollowers(followers, req_id, user_id,
+                                                  writer_text_map);
+                return followers;
+              });
+    } catch (...) {
+      LOG(error) << "Failed to get followers from social-network-service";
+      throw;
+    }
+    followers_span->Finish();
+    pull = IsPullUser(followers_id.size(), _fanout_threshold);
+  }
+  std::set<int64_t> followers_id_set;
+  if (!pull) {
+    followers_id_set.insert(followers_id.begin(), followers_id.end());
   }
-  _social_graph_client_pool->Keepalive(social_graph_client_wrapper);
-  followers_span->Finish();
-
-  std::set<int64_t> followers_id_set(followers_id.begin(), followers_id.end());
   followers_id_set.insert(user_mentions_id.begin(), user_mentions_id.end());
 
   // Update Redis ZSet
@@ -141,14 +436,27 @@ void HomeTimelineHandler::WriteHomeTimeline(
   auto redis_span = opentracing::Tracer::Global()->StartSpan(
       "write_home_timeline_redis_update_client",
       {opentracing::ChildOf(&span->context())});
-  std::string post_id_str = std::to_string(post_id);
+  std::string post_id_str = EncodePostId(post_id, _timeline_encoding);
+
+  if (pull) {
+    try {
+      _WithRedis(true, [&](auto *redis) {
+        _AddToTimeline(*redis, PullTimelineKey(user_id), post_id_str,
+                       timestamp);
+        redis->sadd(HOME_TIMELINE_PULL_USERS_KEY, std::to_string(user_id));
+      });
+    } catch (const Error &err) {
+      LOG(error) << err.what();
+      throw err;
+    }
+  }
 
-  {
+  if (!followers_id_set.empty()) {
     if (_redis_client_pool) {
       auto pipe = _redis_client_pool->pipeline(false);
       for (auto &follower_id : followers_id_set) {
-        pipe.zadd(std::to_string(follower_id), post_id_str, timestamp,
-                  UpdateType::NOT_EXIST);
+        _AddToTimeline(pipe, std::to_string(follower_id), post_id_str,
+                       timestamp);
       }
       try {
         auto replies = pipe.exec();
@@ -161,8 +469,8 @@ void HomeTimelineHandler::WriteHomeTimeline(
     else if (IsRedisReplicationEnabled()) {
         auto pipe = _redis_primary_pool->pipeline(false);
         for (auto& follower_id : followers_id_set) {
-            pipe.zadd(std::to_string(follower_id), post_id_str, timestamp,
-                UpdateType::NOT_EXIST);
+            _AddToTimeline(pipe, std::to_string(follower_id), post_id_str,
+                timestamp);
         }
         try {
             auto replies = pipe.exec();
@@ -185,22 +493,23 @@ void HomeTimelineHandler::WriteHomeTimeline(
           auto new_pipe = std::make_shared<Pipeline>(_redis_cluster_client_pool->pipeline(std::to_string(follower_id), false));
           pipe_map.insert(make_pair(conn, new_pipe));
           auto *_pipe = new_pipe.get();
-          _pipe->zadd(std::to_string(follower_id), post_id_str, timestamp,
-                  UpdateType::NOT_EXIST);
+          _AddToTimeline(*_pipe, std::to_string(follower_id), post_id_str,
+                  timestamp);
         }else{//Found, use exist pipeline
           std::pair<std::shared_ptr<ConnectionPool>, std::shared_ptr<Pipeline>> found = *pipe;
           auto *_pipe = found.second.get();
-          _pipe->zadd(std::to_string(follower_id), post_id_str, timestamp,
-                  UpdateType::NOT_EXIST);
+          _AddToTimeline(*_pipe, std::to_string(follower_id), post_id_str,
+                  timestamp);
         }
       }
       // LOG(info) <<"followers_id_set items:" << followers_id_set.size()<<"; pipeline items:" << pipe_map.size();
+      std::vector<std::function<void()>> shard_tasks;
+      for (auto const &it : pipe_map) {
+        auto _pipe = it.second.get();
+        shard_tasks.emplace_back([_pipe]() { _pipe->exec(); });
+      }
       try {
-        for(auto const &it : pipe_map) {
-          auto _pipe = it.second.get();
-          _pipe->exec();
-        }
-
+        RunShardTasks(shard_tasks, _cluster_pipeline_parallelism);
       } catch (const Error &err) {
         LOG(error) << err.what();
         throw err;
@@ -216,24 +525,70 @@ void HomeTimelineHandler::ReadHomeTimeline(
     int stop_idx, const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "read_home_timeline_server", {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
   if (stop_idx <= start_idx || start_idx < 0) {
     return;
   }
 
+  // A page beyond the posts kept in Redis is rebuilt from the user timelines
+  // of the followees, if the home timeline was trimmed.
+  bool deep = _user_timeline_client_pool && _max_timeline_length > 0 &&
+      stop_idx > _max_timeline_length;
+  bool trimmed = false;
+
+  // Followees whose posts are not in the home timeline.
+  std::vector<int64_t> pull_followees;
+  if (_fanout_threshold > 0) {
+    pull_followees = _GetPullFollowees(req_id, user_id, *span, deadline);
+  }
+
   auto redis_span = opentracing::Tracer::Global()->StartSpan(
       "read_home_timeline_redis_find_client",
       {opentracing::ChildOf(&span->context())});
 
   std::vector<std::string> post_ids_str;
   try {
-    if (_redis_client_pool) {
+    if (!pull_followees.empty()) {
+      // The first stop_idx posts of every timeline hold the first stop_idx
+      // posts of the merged one.
+      std::vector<TimelineEntries> timelines(pull_followees.size() + 1);
+      _WithRedis(false, [&](auto *redis) {
+        redis->zrevrange(std::to_string(user_id), 0, stop_idx - 1,
+                         std::back_inserter(timelines[0]));
+        for (size_t i = 0; i < pull_followees.size(); ++i) {
+          redis->zrevrange(PullTimelineKey(pull_followees[i]), 0,
+                           stop_idx - 1, std::back_inserter(timelines[i + 1]));
+        }
+      });
+      post_ids_str = MergeTimelines(timelines, start_idx, stop_idx);
+      // Timelines are trimmed to _max_timeline_length posts, so a timeline
+      // read up to stop_idx that holds that many posts may have lost some.
+      for (auto &timeline : timelines) {
+        trimmed = trimmed ||
+            timeline.size() >= static_cast<size_t>(_max_timeline_length);
+      }
+    }
+    else if (deep) {
+      // The length of the timeline is read in the same round trip.
+      std::string key = std::to_string(user_id);
+      _WithRedis(false, [&](auto *redis) {
+        auto pipe = _NewPipeline(redis, key);
+        pipe.zrevrange(key, start_idx, stop_idx - 1).zcard(key);
+        auto replies = pipe.exec();
+        replies.get(0, std::back_inserter(post_ids_str));
+        trimmed = replies.template get<long long>(1) >= _max_timeline_length;
+      });
+    }
+    else if (_redis_client_pool) {
       _redis_client_pool->zrevrange(std::to_string(user_id), start_idx,
                                     stop_idx - 1,
                                     std::back_inserter(post_ids_str));
@@ -255,27 +610,34 @@ void HomeTimelineHandler::ReadHomeTimeline(
   }
   redis_span->Finish();
 
+  if (deep && trimmed &&
+      post_ids_str.size() < static_cast<size_t>(stop_idx - start_idx)) {
+    _return = _ReadDeepHomeTimeline(req_id, user_id, start_idx, stop_idx,
+                                    *span, deadline);
+    span->Finish();
+    return;
+  }
+
   std::vector<int64_t> post_ids;
   for (auto &post_id_str : post_ids_str) {
-    post_ids.emplace_back(std::stoul(post_id_str));
+    post_ids.emplace_back(DecodePostId(post_id_str));
   }
 
-  auto post_client_wrapper = _post_client_pool->Pop();
-  if (!post_client_wrapper) {
-    ServiceException se;
-    se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
-    se.message = "Failed to connect to post-storage-service";
-    throw se;
-  }
-  auto post_client = post_client_wrapper->GetClient();
+  // ReadPosts is a read, so a slow call may be hedged.
   try {
-    post_client->ReadPosts(_return, req_id, post_ids, writer_text_map);
+    _return = _post_client_pool->HedgedCall<std::vector<Post>>(
+        deadline,
+        [req_id, post_ids, writer_text_map](
+            ThriftClient<PostStorageServiceClient> *client) {
+          std::vector<Post> posts;
+          client->GetClient()->ReadPosts(posts, req_id, post_ids,
+                                         writer_text_map);
+          return posts;
+        });
   } catch (...) {
-    _post_client_pool->Remove(post_client_wrapper);
     LOG(error) << "Failed to read posts from post-storage-service";
     throw;
   }
-  _post_client_pool->Keepalive(post_client_wrapper);
   span->Finish();
 }
 
@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include <boost/program_options.hpp>
 
@@ -14,10 +10,6 @@
 #include "../utils_thrift.h"
 #include "HomeTimelineHandler.h"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
@@ -58,6 +50,28 @@ int main(int argc, char *argv[]) {
   }
 
   int port = config_json["home-timeline-service"]["port"];
+  int fanout_threshold =
+      config_json["home-timeline-service"]["fanout_threshold"];
+  int pull_users_refresh_ms =
+      config_json["home-timeline-service"]["pull_users_refresh_ms"];
+  int max_timeline_length =
+      config_json["home-timeline-service"]["max_timeline_length"];
+  int deep_pagination =
+      config_json["home-timeline-service"]["deep_pagination"];
+  if (max_timeline_length > 0 && !deep_pagination) {
+    LOG(warning) << "Home timelines are trimmed to " << max_timeline_length
+                 << " posts without deep_pagination, older posts can no "
+                    "longer be read";
+  }
+  int cluster_pipeline_parallelism =
+      config_json["home-timeline-service"]["cluster_pipeline_parallelism"];
+  TimelineEncoding timeline_encoding;
+  std::string timeline_encoding_name =
+      config_json["home-timeline-service"]["timeline_encoding"];
+  if (!ParseTimelineEncoding(timeline_encoding_name, &timeline_encoding)) {
+    LOG(fatal) << "Unknown timeline_encoding: " << timeline_encoding_name;
+    exit(EXIT_FAILURE);
+  }
   int redis_cluster_config_flag = config_json["home-timeline-redis"]["use_cluster"];
 
   int redis_replica_config_flag = config_json["home-timeline-redis"]["use_replica"];
@@ -68,6 +82,13 @@ int main(int argc, char *argv[]) {
   int post_storage_timeout = config_json["post-storage-service"]["timeout_ms"];
   int post_storage_keepalive =
       config_json["post-storage-service"]["keepalive_ms"];
+  int post_storage_shards = config_json["post-storage-service"]["pool_shards"];
+  int post_storage_min_conns =
+      config_json["post-storage-service"]["min_connections"];
+  int post_storage_health_check_ms =
+      config_json["post-storage-service"]["health_check_interval_ms"];
+  int post_storage_refresh_ahead_ms =
+      config_json["post-storage-service"]["refresh_ahead_ms"];
 
   int social_graph_port = config_json["social-graph-service"]["port"];
   std::string social_graph_addr = config_json["social-graph-service"]["addr"];
@@ -75,6 +96,29 @@ int main(int argc, char *argv[]) {
   int social_graph_timeout = config_json["social-graph-service"]["timeout_ms"];
   int social_graph_keepalive =
       config_json["social-graph-service"]["keepalive_ms"];
+  int social_graph_shards = config_json["social-graph-service"]["pool_shards"];
+  int social_graph_min_conns =
+      config_json["social-graph-service"]["min_connections"];
+  int social_graph_health_check_ms =
+      config_json["social-graph-service"]["health_check_interval_ms"];
+  int social_graph_refresh_ahead_ms =
+      config_json["social-graph-service"]["refresh_ahead_ms"];
+
+  int user_timeline_port = config_json["user-timeline-service"]["port"];
+  std::string user_timeline_addr = config_json["user-timeline-service"]["addr"];
+  int user_timeline_conns = config_json["user-timeline-service"]["connections"];
+  int user_timeline_timeout =
+      config_json["user-timeline-service"]["timeout_ms"];
+  int user_timeline_keepalive =
+      config_json["user-timeline-service"]["keepalive_ms"];
+  int user_timeline_shards =
+      config_json["user-timeline-service"]["pool_shards"];
+  int user_timeline_min_conns =
+      config_json["user-timeline-service"]["min_connections"];
+  int user_timeline_health_check_ms =
+      config_json["user-timeline-service"]["health_check_interval_ms"];
+  int user_timeline_refresh_ahead_ms =
+      config_json["user-timeline-service"]["refresh_ahead_ms"];
 
   if (redis_replica_config_flag && (redis_cluster_config_flag || redis_cluster_flag)) {
       LOG(error) << "Can't start service when Redis Cluster and Redis Replica are enabled at the same time";
@@ -82,34 +126,79 @@ int main(int argc, char *argv[]) {
   }
 
   ClientPool<ThriftClient<PostStorageServiceClient>> post_storage_client_pool(
-      "post-storage-client", post_storage_addr, post_storage_port, 0,
-      post_storage_conns, post_storage_timeout, post_storage_keepalive,
-      config_json);
+      "post-storage-client", post_storage_addr, post_storage_port,
+      post_storage_min_conns, post_storage_conns, post_storage_timeout,
+      post_storage_keepalive, config_json, post_storage_shards);
+  post_storage_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["post-storage-service"]));
+  post_storage_client_pool.EnableResolution(
+      config_json["post-storage-service"]["resolve_interval_ms"]);
+  post_storage_client_pool.EnableHedging(
+      config_json["post-storage-service"]["hedge_percentile"],
+      config_json["post-storage-service"]["hedge_budget"]);
+  post_storage_client_pool.StartMaintenance(post_storage_health_check_ms,
+                                            post_storage_refresh_ahead_ms);
 
   ClientPool<ThriftClient<SocialGraphServiceClient>> social_graph_client_pool(
-      "social-graph-client", social_graph_addr, social_graph_port, 0,
-      social_graph_conns, social_graph_timeout, social_graph_keepalive,
-      config_json);
-
-  std::shared_ptr<TServerSocket> server_socket =
-      get_server_socket(config_json, "0.0.0.0", port);
+      "social-graph-client", social_graph_addr, social_graph_port,
+      social_graph_min_conns, social_graph_conns, social_graph_timeout,
+      social_graph_keepalive, config_json, social_graph_shards);
+  social_graph_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["social-graph-service"]));
+  social_graph_client_pool.EnableResolution(
+      config_json["social-graph-service"]["resolve_interval_ms"]);
+  social_graph_client_pool.EnableHedging(
+      config_json["social-graph-service"]["hedge_percentile"],
+      config_json["social-graph-service"]["hedge_budget"]);
+  social_graph_client_pool.StartMaintenance(social_graph_health_check_ms,
+                                            social_graph_refresh_ahead_ms);
+
+  // Only needed to serve the pages of home timelines that were trimmed.
+  // Such a page reads the user timeline of every followee and has no
+  // mentions of the user.
+  std::unique_ptr<ClientPool<ThriftClient<UserTimelineServiceClient>>>
+      user_timeline_client_pool;
+  if (deep_pagination) {
+    user_timeline_client_pool =
+        std::make_unique<ClientPool<ThriftClient<UserTimelineServiceClient>>>(
+            "user-timeline-client", user_timeline_addr, user_timeline_port,
+            user_timeline_min_conns, user_timeline_conns,
+            user_timeline_timeout, user_timeline_keepalive, config_json,
+            user_timeline_shards);
+    user_timeline_client_pool->EnableCircuitBreaker(
+        CircuitBreakerOptions::FromConfig(
+            config_json["user-timeline-service"]));
+    user_timeline_client_pool->EnableResolution(
+        config_json["user-timeline-service"]["resolve_interval_ms"]);
+    user_timeline_client_pool->StartMaintenance(
+        user_timeline_health_check_ms, user_timeline_refresh_ahead_ms);
+  }
 
+  auto set_up_handler = [&](HomeTimelineHandler *handler) {
+    handler->EnableHybridTimeline(fanout_threshold, pull_users_refresh_ms);
+    handler->SetMaxTimelineLength(max_timeline_length);
+    handler->SetTimelineEncoding(timeline_encoding);
+    handler->SetClusterPipelineParallelism(cluster_pipeline_parallelism);
+    if (user_timeline_client_pool) {
+      handler->EnableDeepPagination(user_timeline_client_pool.get());
+    }
+  };
 
   if (redis_replica_config_flag) {
           Redis redis_replica_client_pool = init_redis_replica_client_pool(config_json, "redis-replica");
           Redis redis_primary_client_pool = init_redis_replica_client_pool(config_json, "redis-primary");
 
-          TThreadedServer server(
-              std::make_shared<HomeTimelineServiceProcessor>(
-                  std::make_shared<HomeTimelineHandler>(&redis_replica_client_pool,
-                      &redis_primary_client_pool,
-                      &post_storage_client_pool,
-                      &social_graph_client_pool)),
-              server_socket, std::make_shared<TFramedTransportFactory>(),
-              std::make_shared<TBinaryProtocolFactory>());
+          auto handler = std::make_shared<HomeTimelineHandler>(
+              &redis_replica_client_pool, &redis_primary_client_pool,
+              &post_storage_client_pool, &social_graph_client_pool);
+          set_up_handler(handler.get());
+          std::shared_ptr<TServer> server = get_server(
+              config_json, "home-timeline-service",
+              std::make_shared<HomeTimelineServiceProcessor>(handler),
+              "0.0.0.0", port);
 
           LOG(info) << "Starting the home-timeline-service server with replicated Redis support...";
-          server.serve();
+          server->serve();
 
       
   }
@@ -117,28 +206,30 @@ int main(int argc, char *argv[]) {
   else if (redis_cluster_flag || redis_cluster_config_flag) {
     RedisCluster redis_cluster_client_pool =
         init_redis_cluster_client_pool(config_json, "home-timeline");
-    TThreadedServer server(
-        std::make_shared<HomeTimelineServiceProcessor>(
-            std::make_shared<HomeTimelineHandler>(&redis_cluster_client_pool,
-                                                  &post_storage_client_pool,
-                                                  &social_graph_client_pool)),
-        server_socket, std::make_shared<TFramedTransportFactory>(),
-        std::make_shared<TBinaryProtocolFactory>());
+    auto handler = std::make_shared<HomeTimelineHandler>(
+        &redis_cluster_client_pool, &post_storage_client_pool,
+        &social_graph_client_pool);
+    set_up_handler(handler.get());
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "home-timeline-service",
+        std::make_shared<HomeTimelineServiceProcessor>(handler),
+        "0.0.0.0", port);
 
     LOG(info) << "Starting the home-timeline-service server with Redis Cluster support...";
-    server.serve();
+    server->serve();
   } else {
     Redis redis_client_pool =
         init_redis_client_pool(config_json, "home-timeline");
-    TThreadedServer server(
-        std::make_shared<HomeTimelineServiceProcessor>(
-            std::make_shared<HomeTimelineHandler>(&redis_client_pool,
-                                                  &post_storage_client_pool,
-                                                  &social_graph_client_pool)),
-        server_socket, std::make_shared<TFramedTransportFactory>(),
-        std::make_shared<TBinaryProtocolFactory>());
+    auto handler = std::make_shared<HomeTimelineHandler>(
+        &redis_client_pool, &post_storage_client_pool,
+        &social_graph_client_pool);
+    set_up_handler(handler.get());
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "home-timeline-service",
+        std::make_shared<HomeTimelineServiceProcessor>(handler),
+        "0.0.0.0", port);
 
     LOG(info) << "Starting the home-timeline-service server...";
-    server.serve();
+    server->serve();
   }
 }
\ No newline at end of file
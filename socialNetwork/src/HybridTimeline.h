@@ -0,0 +1,94 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_HYBRIDTIMELINE_H
+#define SOCIAL_NETWORK_MICROSERVICES_HYBRIDTIMELINE_H
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <tuple>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "TimelineEncoding.h"
+
+namespace social_network {
+
+// Hybrid push/pull home timelines. The posts of a user with many followers
+// are not pushed into the home timeline of every follower. They go once
+// into the pull timeline of their creator instead, a sorted set of the
+// home-timeline Redis laid out like a home timeline, and ReadHomeTimeline
+// merges the pull timelines of the followees into the home timeline.
+
+// Set of the users whose posts are pulled.
+#define HOME_TIMELINE_PULL_USERS_KEY "pull-users"
+
+// Post ids with their timestamps as scores, newest first.
+using TimelineEntries = std::vector<std::pair<std::string, double>>;
+
+std::string PullTimelineKey(int64_t user_id);
+
+// Whether the posts of a user with this many followers are pulled. A
+// threshold of 0 pushes all posts.
+bool IsPullUser(size_t num_followers, int fanout_threshold);
+
+// K-way merge of timelines into the post ids at [start_idx, stop_idx) of
+// the merged timeline. A post found in several timelines, e.g. pulled by a
+// follower it was also pushed to as a mention, is listed once, even when
+// the timelines store it in different encodings.
+std::vector<std::string> MergeTimelines(
+    const std::vector<TimelineEntries> &timelines, int start_idx,
+    int stop_idx);
+
+std::string PullTimelineKey(int64_t user_id) {
+  return "pull:" + std::to_string(user_id);
+}
+
+bool IsPullUser(size_t num_followers, int fanout_threshold) {
+  return fanout_threshold > 0 &&
+      num_followers >= static_cast<size_t>(fanout_threshold);
+}
+
+std::vector<std::string> MergeTimelines(
+    const std::vector<TimelineEntries> &timelines, int start_idx,
+    int stop_idx) {
+  // (score, timeline, position) of the newest entry not merged yet of each
+  // timeline. Equal scores are taken in timeline order.
+  using Head = std::tuple<double, int, size_t>;
+  auto newer = [](const Head &a, const Head &b) {
+    if (std::get<0>(a) != std::get<0>(b)) {
+      return std::get<0>(a) < std::get<0>(b);
+    }
+    return std::get<1>(a) > std::get<1>(b);
+  };
+  std::priority_queue<Head, std::vector<Head>, decltype(newer)> heads(newer);
+  for (size_t i = 0; i < timelines.size(); ++i) {
+    if (!timelines[i].empty()) {
+      heads.emplace(timelines[i][0].second, i, 0);
+    }
+  }
+
+  std::vector<std::string> post_ids;
+  std::unordered_set<int64_t> merged;
+  int idx = 0;
+  while (!heads.empty() && idx < stop_idx) {
+    Head head = heads.top();
+    heads.pop();
+    const TimelineEntries &timeline = timelines[std::get<1>(head)];
+    const std::string &post_id = timeline[std::get<2>(head)].first;
+    if (merged.insert(DecodePostId(post_id)).second) {
+      if (idx >= start_idx) {
+        post_ids.emplace_back(post_id);
+      }
+      idx++;
+    }
+    size_t next = std::get<2>(head) + 1;
+    if (next < timeline.size()) {
+      heads.emplace(timeline[next].second, std::get<1>(head), next);
+    }
+  }
+  return post_ids;
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_HYBRIDTIMELINE_H
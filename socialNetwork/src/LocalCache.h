@@ -0,0 +1,159 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_LOCALCACHE_H
+#define SOCIAL_NETWORK_MICROSERVICES_LOCALCACHE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace social_network {
+
+// Percentage of the entries of a shard kept in its protected segment.
+#define LOCAL_CACHE_PROTECTED_PERCENT 80
+
+// Bounded in-process cache of immutable values, in front of a remote cache.
+// Keys are spread over shards with a lock each. A shard is a segmented LRU:
+// new entries go to a probation segment and move to the protected segment
+// when hit again, so a scan of keys read once only churns the probation
+// segment while the keys read repeatedly stay cached. Entries expire
+// ttl_ms after they are put, 0 keeps them until they are evicted. Values
+// are shared, so a hit copies no more than a pointer under the lock.
+template <class K, class V>
+class LocalCache {
+ public:
+  LocalCache(size_t capacity, int ttl_ms, int num_shards);
+
+  LocalCache(const LocalCache &) = delete;
+  LocalCache &operator=(const LocalCache &) = delete;
+
+  // Returns nullptr on a miss.
+  std::shared_ptr<const V> Get(const K &key);
+  void Put(const K &key, std::shared_ptr<const V> value);
+  size_t Size();
+
+ private:
+  struct Entry {
+    K key;
+    std::shared_ptr<const V> value;
+    std::chrono::steady_clock::time_point expiry;
+    bool is_protected;
+  };
+
+  struct Shard {
+    std::mutex mtx;
+    std::list<Entry> probation;
+    std::list<Entry> protected_entries;
+    std::unordered_map<K, typename std::list<Entry>::iterator> index;
+  };
+
+  Shard &_GetShard(const K &key);
+  void _Erase(Shard &shard, typename std::list<Entry>::iterator it);
+
+  std::vector<std::unique_ptr<Shard>> _shards;
+  size_t _shard_capacity;
+  size_t _shard_protected_capacity;
+  std::chrono::milliseconds _ttl;
+};
+
+template <class K, class V>
+LocalCache<K, V>::LocalCache(size_t capacity, int ttl_ms, int num_shards) {
+  num_shards = std::max(num_shards, 1);
+  for (int i = 0; i < num_shards; ++i) {
+    _shards.emplace_back(new Shard());
+  }
+  _shard_capacity = std::max<size_t>(capacity / num_shards, 1);
+  _shard_protected_capacity =
+      _shard_capacity * LOCAL_CACHE_PROTECTED_PERCENT / 100;
+  _ttl = std::chrono::milliseconds(ttl_ms);
+}
+
+template <class K, class V>
+typename LocalCache<K, V>::Shard &LocalCache<K, V>::_GetShard(const K &key) {
+  // Ids often differ in their low bits only, so the hash is mixed before
+  // it is reduced to a shard.
+  uint64_t hash = std::hash<K>()(key) * 0x9E3779B97F4A7C15ULL;
+  return *_shards[(hash >> 32) % _shards.size()];
+}
+
+template <class K, class V>
+void LocalCache<K, V>::_Erase(Shard &shard,
+                              typename std::list<Entry>::iterator it) {
+  shard.index.erase(it->key);
+  if (it->is_protected) {
+    shard.protected_entries.erase(it);
+  } else {
+    shard.probation.erase(it);
+  }
+}
+
+template <class K, class V>
+std::shared_ptr<const V> LocalCache<K, V>::Get(const K &key) {
+  Shard &shard = _GetShard(key);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto index_it = shard.index.find(key);
+  if (index_it == shard.index.end()) {
+    return nullptr;
+  }
+  auto it = index_it->second;
+  if (_ttl.count() > 0 && it->expiry <= std::chrono::steady_clock::now()) {
+    _Erase(shard, it);
+    return nullptr;
+  }
+
+  if (it->is_protected) {
+    shard.protected_entries.splice(shard.protected_entries.begin(),
+                                   shard.protected_entries, it);
+  } else {
+    it->is_protected = true;
+    shard.protected_entries.splice(shard.protected_entries.begin(),
+                                   shard.probation, it);
+    // Demote the least recently used protected entry to make room.
+    if (shard.protected_entries.size() > _shard_protected_capacity) {
+      auto demoted = std::prev(shard.protected_entries.end());
+      demoted->is_protected = false;
+      shard.probation.splice(shard.probation.begin(),
+                             shard.protected_entries, demoted);
+    }
+  }
+  return it->value;
+}
+
+template <class K, class V>
+void LocalCache<K, V>::Put(const K &key, std::shared_ptr<const V> value) {
+  Shard &shard = _GetShard(key);
+  auto expiry = std::chrono::steady_clock::now() + _ttl;
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto index_it = shard.index.find(key);
+  if (index_it != shard.index.end()) {
+    index_it->second->value = std::move(value);
+    index_it->second->expiry = expiry;
+    return;
+  }
+
+  shard.probation.push_front(Entry{key, std::move(value), expiry, false});
+  shard.index[key] = shard.probation.begin();
+  if (shard.index.size() > _shard_capacity) {
+    _Erase(shard, shard.probation.empty()
+                      ? std::prev(shard.protected_entries.end())
+                      : std::prev(shard.probation.end()));
+  }
+}
+
+template <class K, class V>
+size_t LocalCache<K, V>::Size() {
+  size_t size = 0;
+  for (auto &shard : _shards) {
+    std::lock_guard<std::mutex> lock(shard->mtx);
+    size += shard->index.size();
+  }
+  return size;
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_LOCALCACHE_H
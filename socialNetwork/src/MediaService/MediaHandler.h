@@ -6,6 +6,7 @@
 #include <string>
 
 #include "../../gen-cpp/MediaService.h"
+#include "../Deadline.h"
 #include "../logger.h"
 #include "../tracing.h"
 
@@ -34,6 +35,7 @@ void MediaHandler::ComposeMedia(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
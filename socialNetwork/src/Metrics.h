@@ -0,0 +1,331 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_METRICS_H
+#define SOCIAL_NETWORK_MICROSERVICES_METRICS_H
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+
+#include "logger.h"
+
+namespace social_network {
+
+// Every power of two is split into 2^METRICS_HISTOGRAM_PRECISION_BITS linear
+// sub-buckets, i.e. quantiles are reported within ~3% of the exact value.
+#define METRICS_HISTOGRAM_PRECISION_BITS 5
+// Values above 2^METRICS_HISTOGRAM_MAX_EXPONENT are counted in the last bucket.
+#define METRICS_HISTOGRAM_MAX_EXPONENT 40
+// Bound on each read and write of a scrape, so that a client that stalls
+// cannot hold up the single thread serving the endpoint.
+#define METRICS_SOCKET_TIMEOUT_MS 1000
+
+// Fixed-memory latency histogram with the bucket layout of HdrHistogram:
+// bucket widths double with each power of two, so the relative error is
+// the same at any magnitude. Recording is lock-free.
+class Histogram {
+ public:
+  Histogram();
+
+  Histogram(const Histogram&) = delete;
+  Histogram& operator=(const Histogram&) = delete;
+
+  void Record(long value);
+  // Empties the histogram. Values recorded concurrently may be lost.
+  void Reset();
+  long Count() const { return _count.load(std::memory_order_relaxed); }
+  long Sum() const { return _sum.load(std::memory_order_relaxed); }
+  // Upper bound of the bucket holding the q-th quantile, 0 if empty.
+  long Quantile(double q) const;
+
+ private:
+  static size_t _NumBuckets();
+  static size_t _Index(long value);
+  static long _UpperBound(size_t index);
+
+  std::unique_ptr<std::atomic<long>[]> _buckets;
+  std::atomic<long> _count{0};
+  std::atomic<long> _sum{0};
+};
+
+struct CacheMetrics {
+  std::atomic<long> *hits;
+  std::atomic<long> *misses;
+};
+
+// Process-wide registry of the service metrics, rendered in the Prometheus
+// text exposition format by the endpoint started with StartServer().
+// Metrics are identified by name and a label string such as
+// method="ComposePost"; lookups take a lock, so callers keep the returned
+// pointers, which stay valid for the life of the process.
+class Metrics {
+ public:
+  static Metrics *GetInstance();
+
+  Histogram *GetHistogram(const std::string &name, const std::string &labels);
+  std::atomic<long> *GetCounter(const std::string &name,
+                                const std::string &labels);
+  std::atomic<long> *GetGauge(const std::string &name,
+                              const std::string &labels);
+  CacheMetrics GetCacheMetrics(const std::string &cache);
+
+  std::string Render();
+
+  // Serves GET /metrics over plain HTTP on a background thread. A port <= 0
+  // disables the endpoint.
+  void StartServer(int port);
+
+ private:
+  Metrics() = default;
+  ~Metrics() = delete;
+
+  enum MetricType { COUNTER, GAUGE, SUMMARY };
+  using MetricKey = std::pair<std::string, std::string>;
+
+  void _Serve(int listen_fd);
+
+  std::mutex _mtx;
+  std::map<std::string, MetricType> _types;
+  std::map<MetricKey, std::unique_ptr<Histogram>> _histograms;
+  std::map<MetricKey, std::unique_ptr<std::atomic<long>>> _values;
+};
+
+std::string MetricLabel(const std::string &key, const std::string &value) {
+  return key + "=\"" + value + "\"";
+}
+
+Histogram::Histogram() : _buckets(new std::atomic<long>[_NumBuckets()]) {
+  for (size_t i = 0; i < _NumBuckets(); ++i) {
+    _buckets[i] = 0;
+  }
+}
+
+size_t Histogram::_NumBuckets() {
+  return (1ul << METRICS_HISTOGRAM_PRECISION_BITS) *
+      (METRICS_HISTOGRAM_MAX_EXPONENT - METRICS_HISTOGRAM_PRECISION_BITS + 2);
+}
+
+size_t Histogram::_Index(long value) {
+  const long sub_buckets = 1l << METRICS_HISTOGRAM_PRECISION_BITS;
+  if (value < sub_buckets) {
+    return value < 0 ? 0 : value;
+  }
+  int exponent = 63 - __builtin_clzl(value);
+  if (exponent > METRICS_HISTOGRAM_MAX_EXPONENT) {
+    return _NumBuckets() - 1;
+  }
+  int shift = exponent - METRICS_HISTOGRAM_PRECISION_BITS;
+  return sub_buckets * (shift + 1) + ((value >> shift) - sub_buckets);
+}
+
+long Histogram::_UpperBound(size_t index) {
+  const long sub_buckets = 1l << METRICS_HISTOGRAM_PRECISION_BITS;
+  if (index < static_cast<size_t>(sub_buckets)) {
+    return index;
+  }
+  int shift = index / sub_buckets - 1;
+  long lower = (sub_buckets + index % sub_buckets) << shift;
+  return lower + (1l << shift) - 1;
+}
+
+void Histogram::Record(long value) {
+  _buckets[_Index(value)].fetch_add(1, std::memory_order_relaxed);
+  _count.fetch_add(1, std::memory_order_relaxed);
+  _sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+void Histogram::Reset() {
+  for (size_t i = 0; i < _NumBuckets(); ++i) {
+    _buckets[i].store(0, std::memory_order_relaxed);
+  }
+  _count = 0;
+  _sum = 0;
+}
+
+long Histogram::Quantile(double q) const {
+  long total = 0;
+  for (size_t i = 0; i < _NumBuckets(); ++i) {
+    total += _buckets[i].load(std::memory_order_relaxed);
+  }
+  if (total == 0) {
+    return 0;
+  }
+  long rank = static_cast<long>(q * total + 0.5);
+  if (rank < 1) {
+    rank = 1;
+  }
+  long seen = 0;
+  for (size_t i = 0; i < _NumBuckets(); ++i) {
+    seen += _buckets[i].load(std::memory_order_relaxed);
+    if (seen >= rank) {
+      return _UpperBound(i);
+    }
+  }
+  return _UpperBound(_NumBuckets() - 1);
+}
+
+Metrics *Metrics::GetInstance() {
+  // Intentionally leaked, like the Executor and the Logger.
+  static Metrics *instance = new Metrics();
+  return instance;
+}
+
+Histogram *Metrics::GetHistogram(const std::string &name,
+                                 const std::string &labels) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  _types[name] = SUMMARY;
+  auto &histogram = _histograms[std::make_pair(name, labels)];
+  if (!histogram) {
+    histogram.reset(new Histogram());
+  }
+  return histogram.get();
+}
+
+std::atomic<long> *Metrics::GetCounter(const std::string &name,
+                                       const std::string &labels) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  _types[name] = COUNTER;
+  auto &value = _values[std::make_pair(name, labels)];
+  if (!value) {
+    value.reset(new std::atomic<long>(0));
+  }
+  return value.get();
+}
+
+std::atomic<long> *Metrics::GetGauge(const std::string &name,
+                                     const std::string &labels) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  _types[name] = GAUGE;
+  auto &value = _values[std::make_pair(name, labels)];
+  if (!value) {
+    value.reset(new std::atomic<long>(0));
+  }
+  return value.get();
+}
+
+CacheMetrics Metrics::GetCacheMetrics(const std::string &cache) {
+  CacheMetrics cache_metrics;
+  cache_metrics.hits =
+      GetCounter("cache_hits_total", MetricLabel("cache", cache));
+  cache_metrics.misses =
+      GetCounter("cache_misses_total", MetricLabel("cache", cache));
+  return cache_metrics;
+}
+
+std::string Metrics::Render() {
+  std::lock_guard<std::mutex> lock(_mtx);
+  std::ostringstream out;
+  for (auto &type : _types) {
+    const std::string &name = type.first;
+    switch (type.second) {
+      case COUNTER:
+        out << "# TYPE " << name << " counter\n";
+        break;
+      case GAUGE:
+        out << "# TYPE " << name << " gauge\n";
+        break;
+      case SUMMARY:
+        out << "# TYPE " << name << " summary\n";
+        break;
+    }
+
+    if (type.second == SUMMARY) {
+      for (auto it = _histograms.lower_bound(std::make_pair(name, ""));
+           it != _histograms.end() && it->first.first == name; ++it) {
+        const std::string &labels = it->first.second;
+        std::string sep = labels.empty() ? "" : ",";
+        for (double q : {0.5, 0.9, 0.99, 0.999}) {
+          out << name << "{" << labels << sep << "quantile=\"" << q << "\"} "
+              << it->second->Quantile(q) << "\n";
+        }
+        out << name << "_sum{" << labels << "} " << it->second->Sum() << "\n";
+        out << name << "_count{" << labels << "} " << it->second->Count()
+            << "\n";
+      }
+    } else {
+      for (auto it = _values.lower_bound(std::make_pair(name, ""));
+           it != _values.end() && it->first.first == name; ++it) {
+        out << name << "{" << it->first.second << "} " << it->second->load()
+            << "\n";
+      }
+    }
+  }
+  return out.str();
+}
+
+void Metrics::StartServer(int port) {
+  if (port <= 0) {
+    return;
+  }
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    LOG(error) << "Failed to create the metrics socket";
+    return;
+  }
+  int reuse = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  struct sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  addr.sin_port = htons(port);
+  if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&addr),
+           sizeof(addr)) < 0 || listen(listen_fd, 16) < 0) {
+    // Metrics are best effort, the service runs without the endpoint.
+    LOG(error) << "Failed to listen on metrics port " << port;
+    close(listen_fd);
+    return;
+  }
+  std::thread(&Metrics::_Serve, this, listen_fd).detach();
+  LOG(info) << "Serving metrics on port " << port;
+}
+
+void Metrics::_Serve(int listen_fd) {
+  while (true) {
+    int fd = accept(listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      continue;
+    }
+    struct timeval timeout = {};
+    timeout.tv_sec = METRICS_SOCKET_TIMEOUT_MS / 1000;
+    timeout.tv_usec = (METRICS_SOCKET_TIMEOUT_MS % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char request[1024];
+    ssize_t len = recv(fd, request, sizeof(request) - 1, 0);
+    std::string response;
+    if (len > 0 &&
+        std::string(request, len).compare(0, 13, "GET /metrics ") == 0) {
+      std::string body = Render();
+      response = "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4\r\n"
+                 "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                 "Connection: close\r\n\r\n" + body;
+    } else {
+      response = "HTTP/1.1 404 Not Found\r\n"
+                 "Content-Length: 0\r\n"
+                 "Connection: close\r\n\r\n";
+    }
+    size_t sent = 0;
+    while (sent < response.size()) {
+      ssize_t n = send(fd, response.data() + sent, response.size() - sent,
+                       MSG_NOSIGNAL);
+      if (n <= 0) {
+        break;
+      }
+      sent += n;
+    }
+    close(fd);
+  }
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_METRICS_H
@@ -0,0 +1,211 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_MULTIPLEXEDCLIENTPOOL_H
+#define SOCIAL_NETWORK_MICROSERVICES_MULTIPLEXEDCLIENTPOOL_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "logger.h"
+#include "ThriftClient.h"
+
+namespace social_network {
+using json = nlohmann::json;
+
+// Result of a call issued through a MultiplexedClientPool. The request has
+// already been written to the shared connection; Get() reads the matching
+// response (by seqid) off the socket. A future that is dropped without Get()
+// still drains its response, otherwise the concurrent client would stall the
+// other callers waiting on the same connection.
+template<class TReturn>
+class MultiplexedFuture {
+ public:
+  MultiplexedFuture() = default;
+  explicit MultiplexedFuture(std::function<TReturn()> recv)
+      : _recv(std::move(recv)) {}
+  MultiplexedFuture(MultiplexedFuture &&other) noexcept
+      : _recv(std::move(other._recv)) {
+    other._recv = nullptr;
+  }
+  MultiplexedFuture(const MultiplexedFuture &) = delete;
+  MultiplexedFuture &operator=(const MultiplexedFuture &) = delete;
+  MultiplexedFuture &operator=(MultiplexedFuture &&) = delete;
+
+  ~MultiplexedFuture() {
+    if (_recv) {
+      try {
+        _recv();
+      } catch (...) {
+        LOG(warning) << "Failed to drain an abandoned multiplexed call";
+      }
+    }
+  }
+
+  TReturn Get() {
+    auto recv = std::move(_recv);
+    _recv = nullptr;
+    return recv();
+  }
+
+ private:
+  std::function<TReturn()> _recv;
+};
+
+// A small set of long-lived connections shared by all handler threads. Each
+// connection carries many in-flight requests at once; the generated
+// *ConcurrentClient demultiplexes responses by seqid. A Thrift server, in
+// both the threaded and the nonblocking mode, serves the requests of one
+// connection one at a time and in order, so calls pipelined on a connection
+// wait behind the slowest of them and num_conns bounds the concurrency
+// towards the downstream service. Connections are opened on first use and a
+// call takes an idle connection when there is one, so num_conns should be
+// sized to the expected number of concurrent calls rather than kept small.
+template<class TThriftConcurrentClient>
+class MultiplexedClientPool {
+ public:
+  MultiplexedClientPool(const std::string &client_type,
+      const std::string &addr, int port, int num_conns, int keepalive_ms,
+      const json &config_json);
+
+  MultiplexedClientPool(const MultiplexedClientPool&) = delete;
+  MultiplexedClientPool& operator=(const MultiplexedClientPool&) = delete;
+
+  // send: issues the request and returns its seqid,
+  //   e.g. [&](auto *c) { return c->send_ComposeText(req_id, text, carrier); }
+  // recv: reads the response for a seqid,
+  //   e.g. [](auto *c, int32_t seqid) {
+  //     TextServiceReturn r; c->recv_ComposeText(r, seqid); return r; }
+  template<class TReturn, class TSend, class TRecv>
+  MultiplexedFuture<TReturn> Call(TSend send, TRecv recv);
+
+ private:
+  using Connection = ThriftClient<TThriftConcurrentClient>;
+
+  struct Slot {
+    std::mutex mtx;
+    std::shared_ptr<Connection> conn;
+    std::atomic<int> in_flight{0};
+  };
+
+  std::shared_ptr<Connection> _Acquire(Slot *slot);
+  void _Reset(Slot *slot, const std::shared_ptr<Connection> &conn);
+  Slot *_PickSlot();
+
+  std::vector<std::unique_ptr<Slot>> _slots;
+  std::atomic<unsigned> _next_slot{0};
+  std::string _client_type;
+  std::string _addr;
+  int _port;
+  int _keepalive_ms;
+  const json *_config_json;
+};
+
+template<class TThriftConcurrentClient>
+MultiplexedClientPool<TThriftConcurrentClient>::MultiplexedClientPool(
+    const std::string &client_type, const std::string &addr, int port,
+    int num_conns, int keepalive_ms, const json &config_json) {
+  _client_type = client_type;
+  _addr = addr;
+  _port = port;
+  _keepalive_ms = keepalive_ms;
+  _config_json = &config_json;
+  if (num_conns < 1) {
+    num_conns = 1;
+  }
+  for (int i = 0; i < num_conns; ++i) {
+    _slots.emplace_back(new Slot());
+  }
+}
+
+template<class TThriftConcurrentClient>
+typename MultiplexedClientPool<TThriftConcurrentClient>::Slot *
+MultiplexedClientPool<TThriftConcurrentClient>::_PickSlot() {
+  // Least in-flight requests, starting the scan at a rotating offset so that
+  // idle connections are used evenly.
+  size_t start = _next_slot++ % _slots.size();
+  Slot *best = _slots[start].get();
+  for (size_t i = 1; i < _slots.size() && best->in_flight.load() > 0; ++i) {
+    Slot *slot = _slots[(start + i) % _slots.size()].get();
+    if (slot->in_flight.load() < best->in_flight.load()) {
+      best = slot;
+    }
+  }
+  return best;
+}
+
+template<class TThriftConcurrentClient>
+std::shared_ptr<ThriftClient<TThriftConcurrentClient>>
+MultiplexedClientPool<TThriftConcurrentClient>::_Acquire(Slot *slot) {
+  std::lock_guard<std::mutex> lock(slot->mtx);
+  long curr_timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  // Connections past their keepalive are replaced; calls still in flight
+  // on the old one keep it alive through their shared_ptr.
+  if (!slot->conn ||
+      curr_timestamp - slot->conn->_connect_timestamp > _keepalive_ms) {
+    slot->conn = std::make_shared<Connection>(
+        _addr, _port, _keepalive_ms, *_config_json);
+  }
+  if (!slot->conn->IsConnected()) {
+    try {
+      slot->conn->Connect();
+    } catch (...) {
+      LOG(error) << "Failed to connect " + _client_type;
+      slot->conn.reset();
+      throw;
+    }
+  }
+  return slot->conn;
+}
+
+template<class TThriftConcurrentClient>
+void MultiplexedClientPool<TThriftConcurrentClient>::_Reset(
+    Slot *slot, const std::shared_ptr<Connection> &conn) {
+  // A transport error leaves the stream in an unknown state for every call
+  // sharing it, so the connection is retired rather than reused.
+  std::lock_guard<std::mutex> lock(slot->mtx);
+  if (slot->conn == conn) {
+    slot->conn.reset();
+  }
+}
+
+template<class TThriftConcurrentClient>
+template<class TReturn, class TSend, class TRecv>
+MultiplexedFuture<TReturn>
+MultiplexedClientPool<TThriftConcurrentClient>::Call(TSend send, TRecv recv) {
+  Slot *slot = _PickSlot();
+  auto conn = _Acquire(slot);
+  int32_t seqid;
+  slot->in_flight++;
+  try {
+    seqid = send(conn->GetClient());
+  } catch (const apache::thrift::transport::TTransportException &) {
+    slot->in_flight--;
+    _Reset(slot, conn);
+    throw;
+  } catch (...) {
+    slot->in_flight--;
+    throw;
+  }
+
+  return MultiplexedFuture<TReturn>([this, slot, conn, seqid, recv]() {
+    struct InFlightGuard {
+      Slot *slot;
+      ~InFlightGuard() { slot->in_flight--; }
+    } in_flight_guard{slot};
+    try {
+      return recv(conn->GetClient(), seqid);
+    } catch (const apache::thrift::transport::TTransportException &) {
+      _Reset(slot, conn);
+      throw;
+    }
+  });
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_MULTIPLEXEDCLIENTPOOL_H
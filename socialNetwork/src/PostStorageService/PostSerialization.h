@@ -0,0 +1,89 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_POSTSERIALIZATION_H
+#define SOCIAL_NETWORK_MICROSERVICES_POSTSERIALIZATION_H
+
+#include <thrift/protocol/TCompactProtocol.h>
+#include <thrift/transport/TBufferTransports.h>
+
+#include <memory>
+#include <nlohmann/json.hpp>
+#include <string>
+
+#include "../../gen-cpp/social_network_types.h"
+
+namespace social_network {
+using json = nlohmann::json;
+using apache::thrift::protocol::TCompactProtocolT;
+using apache::thrift::transport::TMemoryBuffer;
+
+// Format of the posts cached in Memcached: a version byte followed by the
+// Post in the Thrift compact protocol. Posts cached before were the JSON
+// text of their MongoDB document, which starts with '{' and so never with
+// a version byte; such entries are still read until they expire.
+#define POST_CACHE_FORMAT_COMPACT_V1 '\x01'
+
+std::string SerializePost(const Post &post);
+
+// Decodes a cached post of any format into post. Throws on malformed
+// entries.
+void DeserializePost(const char *data, size_t size, Post *post);
+
+// Decodes the JSON text of a post document.
+void PostFromJson(const json &post_json, Post *post);
+
+std::string SerializePost(const Post &post) {
+  auto buffer = std::make_shared<TMemoryBuffer>();
+  TCompactProtocolT<TMemoryBuffer> protocol(buffer);
+  post.write(&protocol);
+  uint8_t *serialized;
+  uint32_t serialized_size;
+  buffer->getBuffer(&serialized, &serialized_size);
+  std::string value;
+  value.reserve(serialized_size + 1);
+  value.push_back(POST_CACHE_FORMAT_COMPACT_V1);
+  value.append(reinterpret_cast<const char *>(serialized), serialized_size);
+  return value;
+}
+
+void DeserializePost(const char *data, size_t size, Post *post) {
+  if (size > 0 && data[0] == POST_CACHE_FORMAT_COMPACT_V1) {
+    auto buffer = std::make_shared<TMemoryBuffer>(
+        reinterpret_cast<uint8_t *>(const_cast<char *>(data + 1)), size - 1,
+        TMemoryBuffer::OBSERVE);
+    TCompactProtocolT<TMemoryBuffer> protocol(buffer);
+    post->read(&protocol);
+  } else {
+    PostFromJson(json::parse(data, data + size), post);
+  }
+}
+
+void PostFromJson(const json &post_json, Post *post) {
+  post->req_id = post_json["req_id"];
+  post->timestamp = post_json["timestamp"];
+  post->post_id = post_json["post_id"];
+  post->creator.user_id = post_json["creator"]["user_id"];
+  post->creator.username = post_json["creator"]["username"];
+  post->post_type = post_json["post_type"];
+  post->text = post_json["text"];
+  for (auto &item : post_json["media"]) {
+    Media media;
+    media.media_id = item["media_id"];
+    media.media_type = item["media_type"];
+    post->media.emplace_back(media);
+  }
+  for (auto &item : post_json["user_mentions"]) {
+    UserMention user_mention;
+    user_mention.username = item["username"];
+    user_mention.user_id = item["user_id"];
+    post->user_mentions.emplace_back(user_mention);
+  }
+  for (auto &item : post_json["urls"]) {
+    Url url;
+    url.shortened_url = item["shortened_url"];
+    url.expanded_url = item["expanded_url"];
+    post->urls.emplace_back(url);
+  }
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_POSTSERIALIZATION_H
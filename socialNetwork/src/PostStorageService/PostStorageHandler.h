@@ -6,14 +6,26 @@
 #include <libmemcached/util.h>
 #include <mongoc.h>
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <future>
 #include <iostream>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <string>
 
 #include "../../gen-cpp/PostStorageService.h"
+#include "../Deadline.h"
+#include "../BsonDecoder.h"
+#include "../Executor.h"
+#include "../LocalCache.h"
+#include "../Metrics.h"
+#include "../SingleFlight.h"
 #include "../logger.h"
 #include "../tracing.h"
+#include "PostSerialization.h"
 
 namespace social_network {
 using json = nlohmann::json;
@@ -23,6 +35,19 @@ class PostStorageHandler : public PostStorageServiceIf {
   PostStorageHandler(memcached_pool_st *, mongoc_client_pool_t *);
   ~PostStorageHandler() override = default;
 
+  // Caches up to capacity decoded posts in the process for ttl_ms, in front
+  // of Memcached. Posts never change once stored, so the cache is never
+  // invalidated. Must be called before the server starts.
+  void EnableLocalCache(size_t capacity, int ttl_ms, int num_shards);
+
+  // Commits concurrent StorePost calls together, up to max_batch_size posts
+  // in one MongoDB bulk insert. The first caller of a batch waits up to
+  // linger_ms for it to fill. Up to max_in_flight batches are committed at
+  // once, e.g. one per MongoDB connection; past that, the next batch grows
+  // until one of them ends. Must be called before the server starts.
+  void EnableGroupCommit(int max_batch_size, int linger_ms,
+                         int max_in_flight);
+
   void StorePost(int64_t req_id, const Post &post,
                  const std::map<std::string, std::string> &carrier) override;
 
@@ -33,49 +58,89 @@ class PostStorageHandler : public PostStorageServiceIf {
                  const std::vector<int64_t> &post_ids,
                  const std::map<std::string, std::string> &carrier) override;
 
+  void StorePosts(int64_t req_id, const std::vector<Post> &posts,
+                  const std::map<std::string, std::string> &carrier) override;
+
  private:
+  // A StorePost waiting in the group commit queue.
+  struct PendingStore {
+    const Post *post;
+    const opentracing::SpanContext *span_context;
+    bool done;
+    std::string error;
+  };
+
+  // Inserts posts with one unordered bulk write, traced with a span in each
+  // of span_contexts, the requests the write serves. errors gets an empty
+  // string for each post stored and the error otherwise.
+  void _InsertPosts(
+      const std::vector<const Post *> &posts,
+      const std::vector<const opentracing::SpanContext *> &span_contexts,
+      std::vector<std::string> *errors);
+  // Writes stored posts through to Memcached and the local cache, so that
+  // they are read from the cache from the start. Failures are only logged.
+  void _CachePosts(const std::vector<const Post *> &posts,
+                   const opentracing::SpanContext &span_context);
+  // Reads posts from MongoDB and caches them. A post not found throws, while
+  // the posts not found among several are left out.
+  std::shared_ptr<const Post> _FetchPost(
+      int64_t post_id, const opentracing::SpanContext &span_context);
+  SingleFlight<int64_t, Post>::Results _FetchPosts(
+      int64_t req_id, const std::vector<int64_t> &post_ids,
+      const opentracing::SpanContext &span_context);
+  // Returns the error of the post once its batch is committed.
+  std::string _StoreInBatch(const Post &post,
+                            const opentracing::SpanContext &span_context);
+
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
+  std::atomic<long> *_missing_posts;
+  std::unique_ptr<LocalCache<int64_t, Post>> _local_cache;
+  CacheMetrics _local_cache_metrics;
+  SingleFlight<int64_t, Post> _post_flight{"post-storage"};
+  int _max_batch_size = 1;
+  std::chrono::milliseconds _batch_linger{0};
+  int _max_batches_in_flight = 1;
+  int _batches_in_flight = 0;
+  std::mutex _store_mtx;
+  std::condition_variable _store_cv;
+  std::deque<PendingStore *> _store_queue;
+  Histogram *_store_batch_size;
 };
 
+// MongoDB document of a post, to be destroyed by the caller.
+bson_t *NewPostDocument(const Post &post);
+
 PostStorageHandler::PostStorageHandler(
     memcached_pool_st *memcached_client_pool,
     mongoc_client_pool_t *mongodb_client_pool) {
   _memcached_client_pool = memcached_client_pool;
   _mongodb_client_pool = mongodb_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("post-storage-memcached");
+  _missing_posts =
+      Metrics::GetInstance()->GetCounter("post_storage_missing_posts_total", "");
+  _store_batch_size =
+      Metrics::GetInstance()->GetHistogram("post_storage_store_batch_size", "");
 }
 
-void PostStorageHandler::StorePost(
-    int64_t req_id, const social_network::Post &post,
-    const std::map<std::string, std::string> &carrier) {
-  // Initialize a span
-  TextMapReader reader(carrier);
-  std::map<std::string, std::string> writer_text_map;
-  TextMapWriter writer(writer_text_map);
-  auto parent_span = opentracing::Tracer::Global()->Extract(reader);
-  auto span = opentracing::Tracer::Global()->StartSpan(
-      "store_post_server", {opentracing::ChildOf(parent_span->get())});
-  opentracing::Tracer::Global()->Inject(span->context(), writer);
-
-  mongoc_client_t *mongodb_client =
-      mongoc_client_pool_pop(_mongodb_client_pool);
-  if (!mongodb_client) {
-    ServiceException se;
-    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-    se.message = "Failed to pop a client from MongoDB pool";
-    throw se;
-  }
+void PostStorageHandler::EnableLocalCache(size_t capacity, int ttl_ms,
+                                          int num_shards) {
+  _local_cache.reset(
+      new LocalCache<int64_t, Post>(capacity, ttl_ms, num_shards));
+  _local_cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("post-storage-local");
+}
 
-  auto collection =
-      mongoc_client_get_collection(mongodb_client, "post", "post");
-  if (!collection) {
-    ServiceException se;
-    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-    se.message = "Failed to create collection user from DB user";
-    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-    throw se;
-  }
+void PostStorageHandler::EnableGroupCommit(int max_batch_size, int linger_ms,
+                                           int max_in_flight) {
+  _max_batch_size = std::max(max_batch_size, 1);
+  _batch_linger = std::chrono::milliseconds(std::max(linger_ms, 0));
+  _max_batches_in_flight = std::max(max_in_flight, 1);
+}
 
+bson_t *NewPostDocument(const Post &post) {
   bson_t *new_doc = bson_new();
   BSON_APPEND_INT64(new_doc, "post_id", post.post_id);
   BSON_APPEND_INT64(new_doc, "timestamp", post.timestamp);
@@ -134,31 +199,464 @@ void PostStorageHandler::StorePost(
     idx++;
   }
   bson_append_array_end(new_doc, &media_list);
+  return new_doc;
+}
 
+void PostStorageHandler::_InsertPosts(
+    const std::vector<const Post *> &posts,
+    const std::vector<const opentracing::SpanContext *> &span_contexts,
+    std::vector<std::string> *errors) {
+  errors->assign(posts.size(), "");
+  mongoc_client_t *mongodb_client =
+      mongoc_client_pool_pop(_mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+
+  auto collection =
+      mongoc_client_get_collection(mongodb_client, "post", "post");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection user from DB user";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+
+  // Unordered, so that a failed post does not hold back the rest.
+  bson_t opts;
+  bson_init(&opts);
+  BSON_APPEND_BOOL(&opts, "ordered", false);
+  mongoc_bulk_operation_t *bulk =
+      mongoc_collection_create_bulk_operation_with_opts(collection, &opts);
+  bson_destroy(&opts);
+  for (auto post : posts) {
+    bson_t *new_doc = NewPostDocument(*post);
+    mongoc_bulk_operation_insert(bulk, new_doc);
+    bson_destroy(new_doc);
+  }
+
+  bson_t reply;
   bson_error_t error;
-  auto insert_span = opentracing::Tracer::Global()->StartSpan(
-      "post_storage_mongo_insert_client",
-      {opentracing::ChildOf(&span->context())});
-  bool inserted = mongoc_collection_insert_one(collection, new_doc, nullptr,
-                                               nullptr, &error);
-  insert_span->Finish();
+  // A batch serves the requests of several traces, each of them shows the
+  // write.
+  std::vector<std::unique_ptr<opentracing::Span>> insert_spans;
+  for (auto span_context : span_contexts) {
+    insert_spans.emplace_back(opentracing::Tracer::Global()->StartSpan(
+        "post_storage_mongo_insert_client",
+        {opentracing::ChildOf(span_context)}));
+  }
+  bool inserted = mongoc_bulk_operation_execute(bulk, &reply, &error);
+  for (auto &insert_span : insert_spans) {
+    insert_span->Finish();
+  }
 
   if (!inserted) {
-    LOG(error) << "Error: Failed to insert post to MongoDB: " << error.message;
+    // Tell the posts that failed from those stored by the write errors of
+    // the reply; without any, the whole write failed. A duplicate post_id
+    // is a retried StorePost of a post already stored.
+    bson_iter_t iter;
+    bson_iter_t write_errors;
+    if (bson_iter_init_find(&iter, &reply, "writeErrors") &&
+        BSON_ITER_HOLDS_ARRAY(&iter) &&
+        bson_iter_recurse(&iter, &write_errors)) {
+      while (bson_iter_next(&write_errors)) {
+        bson_iter_t field;
+        if (!BSON_ITER_HOLDS_DOCUMENT(&write_errors) ||
+            !bson_iter_recurse(&write_errors, &field)) {
+          continue;
+        }
+        int64_t index = -1;
+        int64_t code = 0;
+        std::string message;
+        while (bson_iter_next(&field)) {
+          std::string key = bson_iter_key(&field);
+          if (key == "index") {
+            BsonRead(&field, &index);
+          } else if (key == "code") {
+            BsonRead(&field, &code);
+          } else if (key == "errmsg") {
+            BsonRead(&field, &message);
+          }
+        }
+        if (index < 0 || index >= static_cast<int64_t>(posts.size())) {
+          continue;
+        }
+        if (code == MONGOC_ERROR_DUPLICATE_KEY) {
+          LOG(debug) << "Post_id: " << posts[index]->post_id
+                     << " is already stored";
+        } else {
+          (*errors)[index] = message;
+        }
+      }
+    } else {
+      errors->assign(posts.size(), error.message);
+    }
+  }
+  _store_batch_size->Record(posts.size());
+
+  bson_destroy(&reply);
+  mongoc_bulk_operation_destroy(bulk);
+  mongoc_collection_destroy(collection);
+  mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+}
+
+void PostStorageHandler::_CachePosts(
+    const std::vector<const Post *> &posts,
+    const opentracing::SpanContext &span_context) {
+  if (_local_cache) {
+    for (auto post : posts) {
+      _local_cache->Put(post->post_id, std::make_shared<const Post>(*post));
+    }
+  }
+
+  memcached_return_t memcached_rc;
+  memcached_st *memcached_client =
+      memcached_pool_pop(_memcached_client_pool, true, &memcached_rc);
+  if (!memcached_client) {
+    LOG(warning) << "Failed to pop a client from memcached pool";
+    return;
+  }
+  auto set_span = opentracing::Tracer::Global()->StartSpan(
+      "post_storage_mmc_set_client", {opentracing::ChildOf(&span_context)});
+  for (auto post : posts) {
+    std::string post_id_str = std::to_string(post->post_id);
+    std::string post_cached = SerializePost(*post);
+    memcached_rc = memcached_set(
+        memcached_client, post_id_str.c_str(), post_id_str.length(),
+        post_cached.c_str(), post_cached.length(), static_cast<time_t>(0),
+        static_cast<uint32_t>(0));
+    if (memcached_rc != MEMCACHED_SUCCESS) {
+      LOG(warning) << "Failed to set post to Memcached: "
+                   << memcached_strerror(memcached_client, memcached_rc);
+    }
+  }
+  set_span->Finish();
+  memcached_pool_push(_memcached_client_pool, memcached_client);
+}
+
+std::string PostStorageHandler::_StoreInBatch(
+    const Post &post, const opentracing::SpanContext &span_context) {
+  PendingStore pending{&post, &span_context, false, ""};
+  std::unique_lock<std::mutex> lock(_store_mtx);
+  _store_queue.push_back(&pending);
+  if (_store_queue.size() >= static_cast<size_t>(_max_batch_size)) {
+    _store_cv.notify_all();
+  }
+  // The caller at the front of the queue commits the batch, the others
+  // wait for their batch to be committed or to reach the front themselves.
+  while (!pending.done &&
+         (_store_queue.empty() || _store_queue.front() != &pending)) {
+    _store_cv.wait(lock);
+  }
+  if (pending.done) {
+    return pending.error;
+  }
+
+  if (_batch_linger.count() > 0) {
+    _store_cv.wait_for(lock, _batch_linger, [this]() {
+      return _store_queue.size() >= static_cast<size_t>(_max_batch_size);
+    });
+  }
+  // Past the batches in flight, the batch keeps growing until one ends.
+  _store_cv.wait(lock, [this]() {
+    return _batches_in_flight < _max_batches_in_flight;
+  });
+  // The batch leaves the queue before it is committed, so that the next
+  // front can commit the next batch meanwhile.
+  size_t batch_size =
+      std::min(_store_queue.size(), static_cast<size_t>(_max_batch_size));
+  std::vector<PendingStore *> batch(_store_queue.begin(),
+                                    _store_queue.begin() + batch_size);
+  _store_queue.erase(_store_queue.begin(),
+                     _store_queue.begin() + batch_size);
+  _batches_in_flight++;
+  if (!_store_queue.empty()) {
+    _store_cv.notify_all();
+  }
+  lock.unlock();
+
+  std::vector<const Post *> posts;
+  std::vector<const opentracing::SpanContext *> span_contexts;
+  for (auto batch_pending : batch) {
+    posts.emplace_back(batch_pending->post);
+    span_contexts.emplace_back(batch_pending->span_context);
+  }
+
+  // Whatever happens, the batch must be ended below, or its callers would
+  // wait forever.
+  std::vector<std::string> errors;
+  try {
+    _InsertPosts(posts, span_contexts, &errors);
+  } catch (const ServiceException &e) {
+    errors.assign(batch_size, e.message);
+  } catch (const std::exception &e) {
+    errors.assign(batch_size, e.what());
+  } catch (...) {
+    errors.assign(batch_size, "Unknown error inserting posts to MongoDB");
+  }
+  errors.resize(batch_size);
+
+  lock.lock();
+  for (size_t i = 0; i < batch_size; ++i) {
+    batch[i]->error = errors[i];
+    batch[i]->done = true;
+  }
+  _batches_in_flight--;
+  _store_cv.notify_all();
+  return pending.error;
+}
+
+void PostStorageHandler::StorePost(
+    int64_t req_id, const social_network::Post &post,
+    const std::map<std::string, std::string> &carrier) {
+  // Initialize a span
+  TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
+  std::map<std::string, std::string> writer_text_map;
+  TextMapWriter writer(writer_text_map);
+  auto parent_span = opentracing::Tracer::Global()->Extract(reader);
+  auto span = opentracing::Tracer::Global()->StartSpan(
+      "store_post_server", {opentracing::ChildOf(parent_span->get())});
+  opentracing::Tracer::Global()->Inject(span->context(), writer);
+
+  std::string error;
+  if (_max_batch_size > 1) {
+    error = _StoreInBatch(post, span->context());
+  } else {
+    std::vector<std::string> errors;
+    _InsertPosts({&post}, {&span->context()}, &errors);
+    error = errors[0];
+  }
+  if (!error.empty()) {
+    LOG(error) << "Error: Failed to insert post to MongoDB: " << error;
     ServiceException se;
     se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-    se.message = error.message;
-    bson_destroy(new_doc);
+    se.message = error;
+    throw se;
+  }
+
+  _CachePosts({&post}, span->context());
+  span->Finish();
+}
+
+void PostStorageHandler::StorePosts(
+    int64_t req_id, const std::vector<Post> &posts,
+    const std::map<std::string, std::string> &carrier) {
+  // Initialize a span
+  TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
+  std::map<std::string, std::string> writer_text_map;
+  TextMapWriter writer(writer_text_map);
+  auto parent_span = opentracing::Tracer::Global()->Extract(reader);
+  auto span = opentracing::Tracer::Global()->StartSpan(
+      "store_posts_server", {opentracing::ChildOf(parent_span->get())});
+  opentracing::Tracer::Global()->Inject(span->context(), writer);
+
+  if (posts.empty()) {
+    span->Finish();
+    return;
+  }
+
+  std::vector<const Post *> batch;
+  for (auto &post : posts) {
+    batch.emplace_back(&post);
+  }
+  std::vector<std::string> errors;
+  _InsertPosts(batch, {&span->context()}, &errors);
+
+  // The posts stored are cached even when others failed.
+  std::vector<const Post *> stored;
+  std::string first_error;
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (errors[i].empty()) {
+      stored.emplace_back(batch[i]);
+    } else if (first_error.empty()) {
+      first_error = errors[i];
+    }
+  }
+  if (!stored.empty()) {
+    _CachePosts(stored, span->context());
+  }
+  if (stored.size() != batch.size()) {
+    LOG(error) << "Error: Failed to insert " << batch.size() - stored.size()
+               << " of " << batch.size()
+               << " posts to MongoDB: " << first_error;
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = std::to_string(batch.size() - stored.size()) + " of " +
+        std::to_string(batch.size()) + " posts failed to store: " +
+        first_error;
+    throw se;
+  }
+  span->Finish();
+}
+
+std::shared_ptr<const Post> PostStorageHandler::_FetchPost(
+    int64_t post_id, const opentracing::SpanContext &span_context) {
+  mongoc_client_t *mongodb_client =
+      mongoc_client_pool_pop(_mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+
+  auto collection =
+      mongoc_client_get_collection(mongodb_client, "post", "post");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection user from DB user";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+
+  bson_t *query = bson_new();
+  BSON_APPEND_INT64(query, "post_id", post_id);
+  auto find_span = opentracing::Tracer::Global()->StartSpan(
+      "post_storage_mongo_find_client", {opentracing::ChildOf(&span_context)});
+  mongoc_cursor_t *cursor =
+      mongoc_collection_find_with_opts(collection, query, nullptr, nullptr);
+  const bson_t *doc;
+  bool found = mongoc_cursor_next(cursor, &doc);
+  find_span->Finish();
+  if (!found) {
+    bson_error_t error;
+    if (mongoc_cursor_error(cursor, &error)) {
+      LOG(warning) << error.message;
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+      se.message = error.message;
+      throw se;
+    } else {
+      LOG(warning) << "Post_id: " << post_id << " doesn't exist in MongoDB";
+      bson_destroy(query);
+      mongoc_cursor_destroy(cursor);
+      mongoc_collection_destroy(collection);
+      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+      ServiceException se;
+      se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
+      se.message =
+          "Post_id: " + std::to_string(post_id) + " doesn't exist in MongoDB";
+      throw se;
+    }
+  }
+
+  LOG(debug) << "Post_id: " << post_id << " found in MongoDB";
+  auto post = std::make_shared<Post>();
+  if (!DecodeBson(doc, post.get())) {
+    LOG(error) << "Post_id: " << post_id << " is malformed in MongoDB";
+    bson_destroy(query);
+    mongoc_cursor_destroy(cursor);
     mongoc_collection_destroy(collection);
     mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Attribute of MongoDB item is not complete";
     throw se;
   }
+  bson_destroy(query);
+  mongoc_cursor_destroy(cursor);
+  mongoc_collection_destroy(collection);
+  mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
 
-  bson_destroy(new_doc);
+  // The post was found, so failing to cache it must not fail the callers
+  // waiting for it.
+  _CachePosts({post.get()}, span_context);
+  return post;
+}
+
+SingleFlight<int64_t, Post>::Results PostStorageHandler::_FetchPosts(
+    int64_t req_id, const std::vector<int64_t> &post_ids,
+    const opentracing::SpanContext &span_context) {
+  mongoc_client_t *mongodb_client =
+      mongoc_client_pool_pop(_mongodb_client_pool);
+  if (!mongodb_client) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to pop a client from MongoDB pool";
+    throw se;
+  }
+  auto collection =
+      mongoc_client_get_collection(mongodb_client, "post", "post");
+  if (!collection) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = "Failed to create collection user from DB user";
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    throw se;
+  }
+  bson_t *query = bson_new();
+  bson_t query_child;
+  bson_t query_post_id_list;
+  const char *key;
+  int idx = 0;
+  char buf[16];
+
+  BSON_APPEND_DOCUMENT_BEGIN(query, "post_id", &query_child);
+  BSON_APPEND_ARRAY_BEGIN(&query_child, "$in", &query_post_id_list);
+  for (auto &item : post_ids) {
+    bson_uint32_to_string(idx, &key, buf, sizeof buf);
+    BSON_APPEND_INT64(&query_post_id_list, key, item);
+    idx++;
+  }
+  bson_append_array_end(&query_child, &query_post_id_list);
+  bson_append_document_end(query, &query_child);
+  mongoc_cursor_t *cursor =
+      mongoc_collection_find_with_opts(collection, query, nullptr, nullptr);
+  const bson_t *doc;
+
+  SingleFlight<int64_t, Post>::Results posts;
+  std::vector<const Post *> posts_found;
+  auto find_span = opentracing::Tracer::Global()->StartSpan(
+      "mongo_find_client", {opentracing::ChildOf(&span_context)});
+  while (true) {
+    bool found = mongoc_cursor_next(cursor, &doc);
+    if (!found) {
+      break;
+    }
+    // A malformed post is left out like a missing one.
+    auto new_post = std::make_shared<Post>();
+    if (!DecodeBson(doc, new_post.get())) {
+      LOG(error) << "Request " << req_id
+                 << " reads a post that is malformed in MongoDB";
+      continue;
+    }
+    posts.insert({new_post->post_id, new_post});
+    posts_found.emplace_back(new_post.get());
+  }
+  find_span->Finish();
+  bson_error_t error;
+  if (mongoc_cursor_error(cursor, &error)) {
+    LOG(warning) << error.message;
+    bson_destroy(query);
+    mongoc_cursor_destroy(cursor);
+    mongoc_collection_destroy(collection);
+    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_MONGODB_ERROR;
+    se.message = error.message;
+    throw se;
+  }
+  bson_destroy(query);
+  mongoc_cursor_destroy(cursor);
   mongoc_collection_destroy(collection);
   mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
 
-  span->Finish();
+  // upload posts to memcached
+  if (!posts_found.empty()) {
+    _CachePosts(posts_found, span_context);
+  }
+  return posts;
 }
 
 void PostStorageHandler::ReadPost(
@@ -166,6 +664,7 @@ void PostStorageHandler::ReadPost(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -173,6 +672,17 @@ void PostStorageHandler::ReadPost(
       "read_post_server", {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
 
+  if (_local_cache) {
+    auto cached_post = _local_cache->Get(post_id);
+    if (cached_post) {
+      (*_local_cache_metrics.hits)++;
+      _return = *cached_post;
+      span->Finish();
+      return;
+    }
+    (*_local_cache_metrics.misses)++;
+  }
+
   std::string post_id_str = std::to_string(post_id);
 
   memcached_return_t memcached_rc;
@@ -202,150 +712,34 @@ void PostStorageHandler::ReadPost(
   memcached_pool_push(_memcached_client_pool, memcached_client);
   get_span->Finish();
 
+  // An entry that cannot be decoded is read again from MongoDB, which
+  // overwrites it.
+  bool cached = false;
   if (post_mmc) {
-    LOG(debug) << "Get post " << post_id << " cache hit from Memcached";
-    json post_json =
-        json::parse(std::string(post_mmc, post_mmc + post_mmc_size));
-    _return.req_id = post_json["req_id"];
-    _return.timestamp = post_json["timestamp"];
-    _return.post_id = post_json["post_id"];
-    _return.creator.user_id = post_json["creator"]["user_id"];
-    _return.creator.username = post_json["creator"]["username"];
-    _return.post_type = post_json["post_type"];
-    _return.text = post_json["text"];
-    for (auto &item : post_json["media"]) {
-      Media media;
-      media.media_id = item["media_id"];
-      media.media_type = item["media_type"];
-      _return.media.emplace_back(media);
-    }
-    for (auto &item : post_json["user_mentions"]) {
-      UserMention user_mention;
-      user_mention.username = item["username"];
-      user_mention.user_id = item["user_id"];
-      _return.user_mentions.emplace_back(user_mention);
-    }
-    for (auto &item : post_json["urls"]) {
-      Url url;
-      url.shortened_url = item["shortened_url"];
-      url.expanded_url = item["expanded_url"];
-      _return.urls.emplace_back(url);
+    try {
+      DeserializePost(post_mmc, post_mmc_size, &_return);
+      cached = true;
+    } catch (const std::exception &e) {
+      LOG(warning) << "Failed to decode post " << post_id
+                   << " from Memcached: " << e.what();
+      _return = Post();
     }
     free(post_mmc);
-  } else {
-    // If not cached in memcached
-    mongoc_client_t *mongodb_client =
-        mongoc_client_pool_pop(_mongodb_client_pool);
-    if (!mongodb_client) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to pop a client from MongoDB pool";
-      throw se;
-    }
-
-    auto collection =
-        mongoc_client_get_collection(mongodb_client, "post", "post");
-    if (!collection) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to create collection user from DB user";
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      throw se;
-    }
-
-    bson_t *query = bson_new();
-    BSON_APPEND_INT64(query, "post_id", post_id);
-    auto find_span = opentracing::Tracer::Global()->StartSpan(
-        "post_storage_mongo_find_client",
-        {opentracing::ChildOf(&span->context())});
-    mongoc_cursor_t *cursor =
-        mongoc_collection_find_with_opts(collection, query, nullptr, nullptr);
-    const bson_t *doc;
-    bool found = mongoc_cursor_next(cursor, &doc);
-    find_span->Finish();
-    if (!found) {
-      bson_error_t error;
-      if (mongoc_cursor_error(cursor, &error)) {
-        LOG(warning) << error.message;
-        bson_destroy(query);
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-        se.message = error.message;
-        throw se;
-      } else {
-        LOG(warning) << "Post_id: " << post_id << " doesn't exist in MongoDB";
-        bson_destroy(query);
-        mongoc_cursor_destroy(cursor);
-        mongoc_collection_destroy(collection);
-        mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
-        se.message =
-            "Post_id: " + std::to_string(post_id) + " doesn't exist in MongoDB";
-        throw se;
-      }
-    } else {
-      LOG(debug) << "Post_id: " << post_id << " found in MongoDB";
-      auto post_json_char = bson_as_json(doc, nullptr);
-      json post_json = json::parse(post_json_char);
-      _return.req_id = post_json["req_id"];
-      _return.timestamp = post_json["timestamp"];
-      _return.post_id = post_json["post_id"];
-      _return.creator.user_id = post_json["creator"]["user_id"];
-      _return.creator.username = post_json["creator"]["username"];
-      _return.post_type = post_json["post_type"];
-      _return.text = post_json["text"];
-      for (auto &item : post_json["media"]) {
-        Media media;
-        media.media_id = item["media_id"];
-        media.media_type = item["media_type"];
-        _return.media.emplace_back(media);
-      }
-      for (auto &item : post_json["user_mentions"]) {
-        UserMention user_mention;
-        user_mention.username = item["username"];
-        user_mention.user_id = item["user_id"];
-        _return.user_mentions.emplace_back(user_mention);
-      }
-      for (auto &item : post_json["urls"]) {
-        Url url;
-        url.shortened_url = item["shortened_url"];
-        url.expanded_url = item["expanded_url"];
-        _return.urls.emplace_back(url);
-      }
-      bson_destroy(query);
-      mongoc_cursor_destroy(cursor);
-      mongoc_collection_destroy(collection);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
+  }
 
-      // upload post to memcached
-      memcached_client =
-          memcached_pool_pop(_memcached_client_pool, true, &memcached_rc);
-      if (!memcached_client) {
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
-        se.message = "Failed to pop a client from memcached pool";
-        throw se;
-      }
-      auto set_span = opentracing::Tracer::Global()->StartSpan(
-          "post_storage_mmc_set_client",
-          {opentracing::ChildOf(&span->context())});
-
-      memcached_rc = memcached_set(
-          memcached_client, post_id_str.c_str(), post_id_str.length(),
-          post_json_char, std::strlen(post_json_char), static_cast<time_t>(0),
-          static_cast<uint32_t>(0));
-      if (memcached_rc != MEMCACHED_SUCCESS) {
-        LOG(warning) << "Failed to set post to Memcached: "
-                     << memcached_strerror(memcached_client, memcached_rc);
-      }
-      set_span->Finish();
-      bson_free(post_json_char);
-      memcached_pool_push(_memcached_client_pool, memcached_client);
+  if (cached) {
+    (*_cache_metrics.hits)++;
+    LOG(debug) << "Get post " << post_id << " cache hit from Memcached";
+    if (_local_cache) {
+      _local_cache->Put(post_id, std::make_shared<const Post>(_return));
     }
+  } else {
+    // If not cached in memcached
+    (*_cache_metrics.misses)++;
+    // Concurrent misses of the post share one read from MongoDB.
+    _return = *_post_flight.Do(post_id, [&]() {
+      return _FetchPost(post_id, span->context());
+    });
   }
 
   span->Finish();
@@ -356,6 +750,7 @@ void PostStorageHandler::ReadPosts(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -377,6 +772,26 @@ void PostStorageHandler::ReadPosts(
     throw se;
   }
   std::map<int64_t, Post> return_map;
+  if (_local_cache) {
+    for (auto &post_id : post_ids) {
+      auto cached_post = _local_cache->Get(post_id);
+      if (cached_post) {
+        return_map.emplace(post_id, *cached_post);
+        post_ids_not_cached.erase(post_id);
+      }
+    }
+    *_local_cache_metrics.hits += return_map.size();
+    *_local_cache_metrics.misses += post_ids_not_cached.size();
+    if (post_ids_not_cached.empty()) {
+      for (auto &post_id : post_ids) {
+        _return.emplace_back(std::move(return_map[post_id]));
+      }
+      span->Finish();
+      return;
+    }
+  }
+  size_t num_locally_cached = return_map.size();
+
   memcached_return_t memcached_rc;
   auto memcached_client =
       memcached_pool_pop(_memcached_client_pool, true, &memcached_rc);
@@ -387,12 +802,13 @@ void PostStorageHandler::ReadPosts(
     throw se;
   }
 
+  size_t num_keys = post_ids_not_cached.size();
   char **keys;
   size_t *key_sizes;
-  keys = new char *[post_ids.size()];
-  key_sizes = new size_t[post_ids.size()];
+  keys = new char *[num_keys];
+  key_sizes = new size_t[num_keys];
   int idx = 0;
-  for (auto &post_id : post_ids) {
+  for (auto &post_id : post_ids_not_cached) {
     std::string key_str = std::to_string(post_id);
     keys[idx] = new char[key_str.length() + 1];
     strcpy(keys[idx], key_str.c_str());
@@ -400,7 +816,7 @@ void PostStorageHandler::ReadPosts(
     idx++;
   }
   memcached_rc =
-      memcached_mget(memcached_client, keys, key_sizes, post_ids.size());
+      memcached_mget(memcached_client, keys, key_sizes, num_keys);
   if (memcached_rc != MEMCACHED_SUCCESS) {
     LOG(error) << "Cannot get post_ids of request " << req_id << ": "
                << memcached_strerror(memcached_client, memcached_rc);
@@ -437,33 +853,20 @@ void PostStorageHandler::ReadPosts(
       se.message = "Cannot get posts of request " + std::to_string(req_id);
       throw se;
     }
+    // An entry that cannot be decoded is read again from MongoDB.
     Post new_post;
-    json post_json = json::parse(
-        std::string(return_value, return_value + return_value_length));
-    new_post.req_id = post_json["req_id"];
-    new_post.timestamp = post_json["timestamp"];
-    new_post.post_id = post_json["post_id"];
-    new_post.creator.user_id = post_json["creator"]["user_id"];
-    new_post.creator.username = post_json["creator"]["username"];
-    new_post.post_type = post_json["post_type"];
-    new_post.text = post_json["text"];
-    for (auto &item : post_json["media"]) {
-      Media media;
-      media.media_id = item["media_id"];
-      media.media_type = item["media_type"];
-      new_post.media.emplace_back(media);
-    }
-    for (auto &item : post_json["user_mentions"]) {
-      UserMention user_mention;
-      user_mention.username = item["username"];
-      user_mention.user_id = item["user_id"];
-      new_post.user_mentions.emplace_back(user_mention);
+    try {
+      DeserializePost(return_value, return_value_length, &new_post);
+    } catch (const std::exception &e) {
+      LOG(warning) << "Failed to decode post "
+                   << std::string(return_key, return_key_length)
+                   << " from Memcached: " << e.what();
+      free(return_value);
+      continue;
     }
-    for (auto &item : post_json["urls"]) {
-      Url url;
-      url.shortened_url = item["shortened_url"];
-      url.expanded_url = item["expanded_url"];
-      new_post.urls.emplace_back(url);
+    if (_local_cache) {
+      _local_cache->Put(new_post.post_id,
+                        std::make_shared<const Post>(new_post));
     }
     return_map.insert(std::make_pair(new_post.post_id, new_post));
     post_ids_not_cached.erase(new_post.post_id);
@@ -472,162 +875,44 @@ void PostStorageHandler::ReadPosts(
   get_span->Finish();
   memcached_quit(memcached_client);
   memcached_pool_push(_memcached_client_pool, memcached_client);
-  for (int i = 0; i < post_ids.size(); ++i) {
+  *_cache_metrics.hits += return_map.size() - num_locally_cached;
+  *_cache_metrics.misses += post_ids_not_cached.size();
+  for (int i = 0; i < num_keys; ++i) {
     delete keys[i];
   }
   delete[] keys;
   delete[] key_sizes;
 
-  std::vector<std::future<void>> set_futures;
-  std::map<int64_t, std::string> post_json_map;
-
-  // Find the rest in MongoDB
+  // Find the rest in MongoDB. Concurrent misses of a post share one read.
   if (!post_ids_not_cached.empty()) {
-    mongoc_client_t *mongodb_client =
-        mongoc_client_pool_pop(_mongodb_client_pool);
-    if (!mongodb_client) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to pop a client from MongoDB pool";
-      throw se;
-    }
-    auto collection =
-        mongoc_client_get_collection(mongodb_client, "post", "post");
-    if (!collection) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = "Failed to create collection user from DB user";
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      throw se;
-    }
-    bson_t *query = bson_new();
-    bson_t query_child;
-    bson_t query_post_id_list;
-    const char *key;
-    idx = 0;
-    char buf[16];
-
-    BSON_APPEND_DOCUMENT_BEGIN(query, "post_id", &query_child);
-    BSON_APPEND_ARRAY_BEGIN(&query_child, "$in", &query_post_id_list);
-    for (auto &item : post_ids_not_cached) {
-      bson_uint32_to_string(idx, &key, buf, sizeof buf);
-      BSON_APPEND_INT64(&query_post_id_list, key, item);
-      idx++;
+    auto fetched = _post_flight.DoMany(
+        post_ids_not_cached, [&](const std::vector<int64_t> &fetch_ids) {
+          return _FetchPosts(req_id, fetch_ids, span->context());
+        });
+    for (auto &it : fetched) {
+      return_map.emplace(it.first, *it.second);
     }
-    bson_append_array_end(&query_child, &query_post_id_list);
-    bson_append_document_end(query, &query_child);
-    mongoc_cursor_t *cursor =
-        mongoc_collection_find_with_opts(collection, query, nullptr, nullptr);
-    const bson_t *doc;
-
-    auto find_span = opentracing::Tracer::Global()->StartSpan(
-        "mongo_find_client", {opentracing::ChildOf(&span->context())});
-    while (true) {
-      bool found = mongoc_cursor_next(cursor, &doc);
-      if (!found) {
-        break;
-      }
-      Post new_post;
-      char *post_json_char = bson_as_json(doc, nullptr);
-      json post_json = json::parse(post_json_char);
-      new_post.req_id = post_json["req_id"];
-      new_post.timestamp = post_json["timestamp"];
-      new_post.post_id = post_json["post_id"];
-      new_post.creator.user_id = post_json["creator"]["user_id"];
-      new_post.creator.username = post_json["creator"]["username"];
-      new_post.post_type = post_json["post_type"];
-      new_post.text = post_json["text"];
-      for (auto &item : post_json["media"]) {
-        Media media;
-        media.media_id = item["media_id"];
-        media.media_type = item["media_type"];
-        new_post.media.emplace_back(media);
-      }
-      for (auto &item : post_json["user_mentions"]) {
-        UserMention user_mention;
-        user_mention.username = item["username"];
-        user_mention.user_id = item["user_id"];
-        new_post.user_mentions.emplace_back(user_mention);
-      }
-      for (auto &item : post_json["urls"]) {
-        Url url;
-        url.shortened_url = item["shortened_url"];
-        url.expanded_url = item["expanded_url"];
-        new_post.urls.emplace_back(url);
-      }
-      post_json_map.insert({new_post.post_id, std::string(post_json_char)});
-      return_map.insert({new_post.post_id, new_post});
-      bson_free(post_json_char);
-    }
-    find_span->Finish();
-    bson_error_t error;
-    if (mongoc_cursor_error(cursor, &error)) {
-      LOG(warning) << error.message;
-      bson_destroy(query);
-      mongoc_cursor_destroy(cursor);
-      mongoc_collection_destroy(collection);
-      mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-      se.message = error.message;
-      throw se;
-    }
-    bson_destroy(query);
-    mongoc_cursor_destroy(cursor);
-    mongoc_collection_destroy(collection);
-    mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-
-    // upload posts to memcached
-    set_futures.emplace_back(std::async(std::launch::async, [&]() {
-      memcached_return_t _rc;
-      auto _memcached_client =
-          memcached_pool_pop(_memcached_client_pool, true, &_rc);
-      if (!_memcached_client) {
-        LOG(error) << "Failed to pop a client from memcached pool";
-        ServiceException se;
-        se.errorCode = ErrorCode::SE_MEMCACHED_ERROR;
-        se.message = "Failed to pop a client from memcached pool";
-        throw se;
-      }
-      auto set_span = opentracing::Tracer::Global()->StartSpan(
-          "mmc_set_client", {opentracing::ChildOf(&span->context())});
-      for (auto &it : post_json_map) {
-        std::string id_str = std::to_string(it.first);
-        _rc = memcached_set(_memcached_client, id_str.c_str(), id_str.length(),
-                            it.second.c_str(), it.second.length(),
-                            static_cast<time_t>(0), static_cast<uint32_t>(0));
-      }
-      memcached_pool_push(_memcached_client_pool, _memcached_client);
-      set_span->Finish();
-    }));
   }
 
+  // ComposePost writes a post and its timeline entries in parallel, so a
+  // timeline may list a post that is not stored yet, or whose StorePost
+  // failed. Leave such posts out rather than fail the whole read; readers
+  // thus never see a timeline entry before its post exists.
   if (return_map.size() != post_ids.size()) {
-    try {
-      for (auto &it : set_futures) {
-        it.get();
-      }
-    } catch (...) {
-      LOG(warning) << "Failed to set posts to memcached";
-    }
-    LOG(error) << "Return set incomplete";
-    ServiceException se;
-    se.errorCode = ErrorCode::SE_THRIFT_HANDLER_ERROR;
-    se.message = "Return set incomplete";
-    throw se;
+    *_missing_posts += post_ids.size() - return_map.size();
+    LOG(warning) << "Request " << req_id << " reads "
+                 << post_ids.size() - return_map.size()
+                 << " posts that are not stored";
   }
 
   for (auto &post_id : post_ids) {
-    _return.emplace_back(return_map[post_id]);
-  }
-
-  try {
-    for (auto &it : set_futures) {
-      it.get();
+    auto it = return_map.find(post_id);
+    if (it != return_map.end()) {
+      _return.emplace_back(it->second);
     }
-  } catch (...) {
-    LOG(warning) << "Failed to set posts to memcached";
   }
+
+  span->Finish();
 }
 
 }  // namespace social_network
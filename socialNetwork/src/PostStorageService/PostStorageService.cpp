@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include "../utils.h"
 #include "../utils_memcached.h"
@@ -10,10 +6,6 @@
 #include "../utils_thrift.h"
 #include "PostStorageHandler.h"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 static memcached_pool_st* memcached_client_pool;
@@ -40,12 +32,26 @@ int main(int argc, char* argv[]) {
   }
 
   int port = config_json["post-storage-service"]["port"];
+  int executor_threads = config_json["post-storage-service"]["executor_threads"];
+  int executor_queue_size =
+      config_json["post-storage-service"]["executor_queue_size"];
+  Executor::Init(executor_threads, executor_queue_size);
 
   int mongodb_conns = config_json["post-storage-mongodb"]["connections"];
   int mongodb_timeout = config_json["post-storage-mongodb"]["timeout_ms"];
 
   int memcached_conns = config_json["post-storage-memcached"]["connections"];
   int memcached_timeout = config_json["post-storage-memcached"]["timeout_ms"];
+  int local_cache_capacity =
+      config_json["post-storage-service"]["local_cache_capacity"];
+  int local_cache_ttl_ms =
+      config_json["post-storage-service"]["local_cache_ttl_ms"];
+  int local_cache_shards =
+      config_json["post-storage-service"]["local_cache_shards"];
+  int store_batch_size =
+      config_json["post-storage-service"]["store_batch_size"];
+  int store_batch_linger_ms =
+      config_json["post-storage-service"]["store_batch_linger_ms"];
 
   memcached_client_pool = init_memcached_client_pool(
       config_json, "post-storage", 32, memcached_conns);
@@ -69,15 +75,22 @@ int main(int argc, char* argv[]) {
     }
   }
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
-  std::shared_ptr<TServerSocket> server_socket = get_server_socket(config_json, "0.0.0.0", port);
 
-  TThreadedServer server(std::make_shared<PostStorageServiceProcessor>(
-                             std::make_shared<PostStorageHandler>(
-                                 memcached_client_pool, mongodb_client_pool)),
-                         server_socket,
-                         std::make_shared<TFramedTransportFactory>(),
-                         std::make_shared<TBinaryProtocolFactory>());
+  auto handler = std::make_shared<PostStorageHandler>(memcached_client_pool,
+                                                      mongodb_client_pool);
+  if (local_cache_capacity > 0) {
+    handler->EnableLocalCache(local_cache_capacity, local_cache_ttl_ms,
+                              local_cache_shards);
+  }
+  if (store_batch_size > 1) {
+    handler->EnableGroupCommit(store_batch_size, store_batch_linger_ms,
+                               mongodb_conns);
+  }
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "post-storage-service",
+      std::make_shared<PostStorageServiceProcessor>(handler),
+      "0.0.0.0", port);
 
   LOG(info) << "Starting the post-storage-service server...";
-  server.serve();
+  server->serve();
 }
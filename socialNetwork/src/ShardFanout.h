@@ -0,0 +1,68 @@
+#ifndef SOCIAL_NETWORK_MICROSERVICES_SHARDFANOUT_H
+#define SOCIAL_NETWORK_MICROSERVICES_SHARDFANOUT_H
+
+#include <sw/redis++/redis++.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "Executor.h"
+
+namespace social_network {
+
+// Runs the Redis Cluster requests of a fan-out, one task per shard, with at
+// most max_parallelism of them in flight, so that the fan-out takes about as
+// long as its slowest shard rather than the sum of the shards. The calling
+// thread takes part; called from an Executor worker, the tasks run in turn.
+// Every task runs even if some fail, and the failures are thrown together as
+// one sw::redis::Error.
+void RunShardTasks(const std::vector<std::function<void()>> &tasks,
+                   int max_parallelism);
+
+void RunShardTasks(const std::vector<std::function<void()>> &tasks,
+                   int max_parallelism) {
+  std::atomic<size_t> next_task{0};
+  std::mutex errors_mtx;
+  std::vector<std::string> errors;
+  auto run_tasks = [&]() {
+    for (size_t i = next_task++; i < tasks.size(); i = next_task++) {
+      try {
+        tasks[i]();
+      } catch (const std::exception &e) {
+        std::lock_guard<std::mutex> lock(errors_mtx);
+        errors.emplace_back(e.what());
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(errors_mtx);
+        errors.emplace_back("unknown error");
+      }
+    }
+  };
+
+  size_t num_runners = std::min(
+      tasks.size(), static_cast<size_t>(std::max(max_parallelism, 1)));
+  std::vector<ExecutorFuture<void>> futures;
+  for (size_t i = 1; i < num_runners; ++i) {
+    futures.emplace_back(Executor::GetInstance()->Submit(run_tasks));
+  }
+  run_tasks();
+  for (auto &future : futures) {
+    future.get();
+  }
+
+  if (!errors.empty()) {
+    std::string message = std::to_string(errors.size()) + " of " +
+        std::to_string(tasks.size()) + " shard requests failed:";
+    for (auto &error : errors) {
+      message += " " + error + ";";
+    }
+    throw sw::redis::Error(message);
+  }
+}
+
+} // namespace social_network
+
+#endif //SOCIAL_NETWORK_MICROSERVICES_SHARDFANOUT_H
@@ -15,6 +15,9 @@
 #include "../../gen-cpp/SocialGraphService.h"
 #include "../../gen-cpp/UserService.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
+#include "../Executor.h"
+#include "../ShardFanout.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
 #include "../tracing.h"
@@ -105,6 +108,7 @@ void SocialGraphHandler::Follow(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -116,8 +120,8 @@ void SocialGraphHandler::Follow(
       duration_cast<milliseconds>(system_clock::now().time_since_epoch())
           .count();
 
-  std::future<void> mongo_update_follower_future =
-      std::async(std::launch::async, [&]() {
+  ExecutorFuture<void> mongo_update_follower_future =
+      Executor::GetInstance()->Submit([&]() {
         mongoc_client_t *mongodb_client =
             mongoc_client_pool_pop(_mongodb_client_pool);
         if (!mongodb_client) {
@@ -173,8 +177,8 @@ void SocialGraphHandler::Follow(
         mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
       });
 
-  std::future<void> mongo_update_followee_future =
-      std::async(std::launch::async, [&]() {
+  ExecutorFuture<void> mongo_update_followee_future =
+      Executor::GetInstance()->Submit([&]() {
         mongoc_client_t *mongodb_client =
             mongoc_client_pool_pop(_mongodb_client_pool);
         if (!mongodb_client) {
@@ -230,7 +234,7 @@ void SocialGraphHandler::Follow(
         mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
       });
 
-  std::future<void> redis_update_future = std::async(std::launch::async, [&]() {
+  auto redis_update = [&]() {
     auto redis_span = opentracing::Tracer::Global()->StartSpan(
         "social_graph_redis_update_client",
         {opentracing::ChildOf(&span->context())});
@@ -271,12 +275,20 @@ void SocialGraphHandler::Follow(
         //       of Redis++ clients:
         //       https://github.com/sewenew/redis-plus-plus/issues/212
         try {
-          _redis_cluster_client_pool->zadd(
-              std::to_string(user_id) + ":followees",
-              std::to_string(followee_id), timestamp, UpdateType::NOT_EXIST);
-          _redis_cluster_client_pool->zadd(
-              std::to_string(followee_id) + ":followers",
-              std::to_string(user_id), timestamp, UpdateType::NOT_EXIST);
+          RunShardTasks(
+              {[&]() {
+                 _redis_cluster_client_pool->zadd(
+                     std::to_string(user_id) + ":followees",
+                     std::to_string(followee_id), timestamp,
+                     UpdateType::NOT_EXIST);
+               },
+               [&]() {
+                 _redis_cluster_client_pool->zadd(
+                     std::to_string(followee_id) + ":followers",
+                     std::to_string(user_id), timestamp,
+                     UpdateType::NOT_EXIST);
+               }},
+              2);
         } catch (const Error &err) {
           LOG(error) << err.what();
           throw err;
@@ -284,7 +296,18 @@ void SocialGraphHandler::Follow(
       }
     }
     redis_span->Finish();
-  });
+  };
+
+  // In cluster mode the two sets live on different shards. The update fans
+  // out over them itself, which on an Executor worker would run in turn.
+  ExecutorFuture<void> redis_update_future;
+  if (_redis_cluster_client_pool) {
+    std::packaged_task<void()> redis_update_task(redis_update);
+    redis_update_future = redis_update_task.get_future();
+    redis_update_task();
+  } else {
+    redis_update_future = Executor::GetInstance()->Submit(redis_update);
+  }
 
   try {
     redis_update_future.get();
@@ -305,6 +328,7 @@ void SocialGraphHandler::Unfollow(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -312,8 +336,8 @@ void SocialGraphHandler::Unfollow(
       "unfollow_server", {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
 
-  std::future<void> mongo_update_follower_future =
-      std::async(std::launch::async, [&]() {
+  ExecutorFuture<void> mongo_update_follower_future =
+      Executor::GetInstance()->Submit([&]() {
         mongoc_client_t *mongodb_client =
             mongoc_client_pool_pop(_mongodb_client_pool);
         if (!mongodb_client) {
@@ -366,8 +390,8 @@ void SocialGraphHandler::Unfollow(
         mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
       });
 
-  std::future<void> mongo_update_followee_future =
-      std::async(std::launch::async, [&]() {
+  ExecutorFuture<void> mongo_update_followee_future =
+      Executor::GetInstance()->Submit([&]() {
         mongoc_client_t *mongodb_client =
             mongoc_client_pool_pop(_mongodb_client_pool);
         if (!mongodb_client) {
@@ -420,7 +444,7 @@ void SocialGraphHandler::Unfollow(
         mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
       });
 
-  std::future<void> redis_update_future = std::async(std::launch::async, [&]() {
+  auto redis_update = [&]() {
     auto redis_span = opentracing::Tracer::Global()->StartSpan(
         "social_graph_redis_update_client",
         {opentracing::ChildOf(&span->context())});
@@ -458,10 +482,16 @@ void SocialGraphHandler::Unfollow(
         std::string followee_key = std::to_string(user_id) + ":followees";
         std::string follower_key = std::to_string(followee_id) + ":followers";
         try {
-          _redis_cluster_client_pool->zrem(followee_key,
-                                           std::to_string(followee_id));
-          _redis_cluster_client_pool->zrem(follower_key,
-                                           std::to_string(user_id));
+          RunShardTasks(
+              {[&]() {
+                 _redis_cluster_client_pool->zrem(followee_key,
+                                                  std::to_string(followee_id));
+               },
+               [&]() {
+                 _redis_cluster_client_pool->zrem(follower_key,
+                                                  std::to_string(user_id));
+               }},
+              2);
         } catch (const Error &err) {
           LOG(error) << err.what();
           throw err;
@@ -469,7 +499,18 @@ void SocialGraphHandler::Unfollow(
       }
     }
     redis_span->Finish();
-  });
+  };
+
+  // In cluster mode the two sets live on different shards. The update fans
+  // out over them itself, which on an Executor worker would run in turn.
+  ExecutorFuture<void> redis_update_future;
+  if (_redis_cluster_client_pool) {
+    std::packaged_task<void()> redis_update_task(redis_update);
+    redis_update_future = redis_update_task.get_future();
+    redis_update_task();
+  } else {
+    redis_update_future = Executor::GetInstance()->Submit(redis_update);
+  }
 
   try {
     redis_update_future.get();
@@ -487,6 +528,7 @@ void SocialGraphHandler::GetFollowers(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -625,6 +667,7 @@ void SocialGraphHandler::GetFollowees(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -770,6 +813,7 @@ void SocialGraphHandler::InsertUser(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -827,6 +871,8 @@ void SocialGraphHandler::FollowWithUsername(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -834,9 +880,10 @@ void SocialGraphHandler::FollowWithUsername(
       "follow_with_username_server",
       {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  std::future<int64_t> user_id_future = std::async(std::launch::async, [&]() {
-    auto user_client_wrapper = _user_service_client_pool->Pop();
+  ExecutorFuture<int64_t> user_id_future = Executor::GetInstance()->Submit([&]() {
+    auto user_client_wrapper = _user_service_client_pool->Pop(deadline);
     if (!user_client_wrapper) {
       ServiceException se;
       se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -856,9 +903,9 @@ void SocialGraphHandler::FollowWithUsername(
     return _return;
   });
 
-  std::future<int64_t> followee_id_future =
-      std::async(std::launch::async, [&]() {
-        auto user_client_wrapper = _user_service_client_pool->Pop();
+  ExecutorFuture<int64_t> followee_id_future =
+      Executor::GetInstance()->Submit([&]() {
+        auto user_client_wrapper = _user_service_client_pool->Pop(deadline);
         if (!user_client_wrapper) {
           ServiceException se;
           se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -901,6 +948,8 @@ void SocialGraphHandler::UnfollowWithUsername(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -908,9 +957,10 @@ void SocialGraphHandler::UnfollowWithUsername(
       "unfollow_with_username_server",
       {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
-  std::future<int64_t> user_id_future = std::async(std::launch::async, [&]() {
-    auto user_client_wrapper = _user_service_client_pool->Pop();
+  ExecutorFuture<int64_t> user_id_future = Executor::GetInstance()->Submit([&]() {
+    auto user_client_wrapper = _user_service_client_pool->Pop(deadline);
     if (!user_client_wrapper) {
       ServiceException se;
       se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -930,9 +980,9 @@ void SocialGraphHandler::UnfollowWithUsername(
     return _return;
   });
 
-  std::future<int64_t> followee_id_future =
-      std::async(std::launch::async, [&]() {
-        auto user_client_wrapper = _user_service_client_pool->Pop();
+  ExecutorFuture<int64_t> followee_id_future =
+      Executor::GetInstance()->Submit([&]() {
+        auto user_client_wrapper = _user_service_client_pool->Pop(deadline);
         if (!user_client_wrapper) {
           ServiceException se;
           se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include <boost/program_options.hpp>
 
@@ -13,10 +9,6 @@
 #include "SocialGraphHandler.h"
 
 using json = nlohmann::json;
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
@@ -57,6 +49,10 @@ int main(int argc, char *argv[]) {
   }
 
   int port = config_json["social-graph-service"]["port"];
+  int executor_threads = config_json["social-graph-service"]["executor_threads"];
+  int executor_queue_size =
+      config_json["social-graph-service"]["executor_queue_size"];
+  Executor::Init(executor_threads, executor_queue_size);
 
   int mongodb_conns = config_json["social-graph-mongodb"]["connections"];
   int mongodb_timeout = config_json["social-graph-mongodb"]["timeout_ms"];
@@ -66,6 +62,11 @@ int main(int argc, char *argv[]) {
   int user_conns = config_json["user-service"]["connections"];
   int user_timeout = config_json["user-service"]["timeout_ms"];
   int user_keepalive = config_json["user-service"]["keepalive_ms"];
+  int user_shards = config_json["user-service"]["pool_shards"];
+  int user_min_conns = config_json["user-service"]["min_connections"];
+  int user_health_check_ms =
+      config_json["user-service"]["health_check_interval_ms"];
+  int user_refresh_ahead_ms = config_json["user-service"]["refresh_ahead_ms"];
 
   int redis_cluster_config_flag = config_json["social-graph-redis"]["use_cluster"];
   int redis_replica_config_flag = config_json["social-graph-redis"]["use_replica"];
@@ -82,8 +83,14 @@ int main(int argc, char *argv[]) {
   }
 
   ClientPool<ThriftClient<UserServiceClient>> user_client_pool(
-      "social-graph", user_addr, user_port, 0, user_conns, user_timeout,
-      user_keepalive, config_json);
+      "social-graph", user_addr, user_port, user_min_conns, user_conns,
+      user_timeout, user_keepalive, config_json, user_shards);
+  user_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["user-service"]));
+  user_client_pool.EnableResolution(
+      config_json["user-service"]["resolve_interval_ms"]);
+  user_client_pool.StartMaintenance(user_health_check_ms,
+                                    user_refresh_ahead_ms);
 
   mongoc_client_t *mongodb_client = mongoc_client_pool_pop(mongodb_client_pool);
   if (!mongodb_client) {
@@ -100,47 +107,45 @@ int main(int argc, char *argv[]) {
   }
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
 
-  std::shared_ptr<TServerSocket> server_socket =
-      get_server_socket(config_json, "0.0.0.0", port);
 
   if (redis_cluster_flag || redis_cluster_config_flag) {
     RedisCluster redis_cluster_client_pool =
         init_redis_cluster_client_pool(config_json, "social-graph");
-    TThreadedServer server(
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "social-graph-service",
         std::make_shared<SocialGraphServiceProcessor>(
             std::make_shared<SocialGraphHandler>(mongodb_client_pool,
-                                                 &redis_cluster_client_pool,
-                                                 &user_client_pool)),
-        server_socket, std::make_shared<TFramedTransportFactory>(),
-        std::make_shared<TBinaryProtocolFactory>());
+                &redis_cluster_client_pool,
+                &user_client_pool)),
+        "0.0.0.0", port);
     LOG(info) << "Starting the social-graph-service server with Redis Cluster support...";
-    server.serve();
+    server->serve();
   }
   
   else if (redis_replica_config_flag) {
       Redis redis_replica_client_pool = init_redis_replica_client_pool(config_json, "redis-replica");
       Redis redis_primary_client_pool = init_redis_replica_client_pool(config_json, "redis-primary");
 
-      TThreadedServer server(
+      std::shared_ptr<TServer> server = get_server(
+          config_json, "social-graph-service",
           std::make_shared<SocialGraphServiceProcessor>(
               std::make_shared<SocialGraphHandler>(
                   mongodb_client_pool, &redis_replica_client_pool, &redis_primary_client_pool, &user_client_pool)),
-          server_socket, std::make_shared<TFramedTransportFactory>(),
-          std::make_shared<TBinaryProtocolFactory>());
+          "0.0.0.0", port);
       LOG(info) << "Starting the social-graph-service server with Redis replica support";
-      server.serve();
+      server->serve();
   }
 
   else {
     Redis redis_client_pool =
         init_redis_client_pool(config_json, "social-graph");
-    TThreadedServer server(
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "social-graph-service",
         std::make_shared<SocialGraphServiceProcessor>(
             std::make_shared<SocialGraphHandler>(
                 mongodb_client_pool, &redis_client_pool, &user_client_pool)),
-        server_socket, std::make_shared<TFramedTransportFactory>(),
-        std::make_shared<TBinaryProtocolFactory>());
+        "0.0.0.0", port);
     LOG(info) << "Starting the social-graph-service server ...";
-    server.serve();
+    server->serve();
   }
 }
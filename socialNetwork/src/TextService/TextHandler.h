@@ -10,6 +10,9 @@
 #include "../../gen-cpp/UrlShortenService.h"
 #include "../../gen-cpp/UserMentionService.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
+#include "../Executor.h"
+#include "../MultiplexedClientPool.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
 #include "../tracing.h"
@@ -20,6 +23,8 @@ class TextHandler : public TextServiceIf {
  public:
   TextHandler(ClientPool<ThriftClient<UrlShortenServiceClient>> *,
               ClientPool<ThriftClient<UserMentionServiceClient>> *);
+  TextHandler(MultiplexedClientPool<UrlShortenServiceConcurrentClient> *,
+              MultiplexedClientPool<UserMentionServiceConcurrentClient> *);
   ~TextHandler() override = default;
 
   void ComposeText(TextServiceReturn &_return, int64_t, const std::string &,
@@ -28,6 +33,9 @@ class TextHandler : public TextServiceIf {
  private:
   ClientPool<ThriftClient<UrlShortenServiceClient>> *_url_client_pool;
   ClientPool<ThriftClient<UserMentionServiceClient>> *_user_mention_client_pool;
+  MultiplexedClientPool<UrlShortenServiceConcurrentClient> *_url_mux_pool;
+  MultiplexedClientPool<UserMentionServiceConcurrentClient>
+      *_user_mention_mux_pool;
 };
 
 TextHandler::TextHandler(
@@ -36,6 +44,18 @@ TextHandler::TextHandler(
         *user_mention_client_pool) {
   _url_client_pool = url_client_pool;
   _user_mention_client_pool = user_mention_client_pool;
+  _url_mux_pool = nullptr;
+  _user_mention_mux_pool = nullptr;
+}
+
+TextHandler::TextHandler(
+    MultiplexedClientPool<UrlShortenServiceConcurrentClient> *url_mux_pool,
+    MultiplexedClientPool<UserMentionServiceConcurrentClient>
+        *user_mention_mux_pool) {
+  _url_client_pool = nullptr;
+  _user_mention_client_pool = nullptr;
+  _url_mux_pool = url_mux_pool;
+  _user_mention_mux_pool = user_mention_mux_pool;
 }
 
 void TextHandler::ComposeText(
@@ -43,12 +63,15 @@ void TextHandler::ComposeText(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "compose_text_server", {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
   std::vector<std::string> mention_usernames;
   std::smatch m;
@@ -70,81 +93,143 @@ void TextHandler::ComposeText(
     s = m.suffix().str();
   }
 
-  auto shortened_urls_future = std::async(std::launch::async, [&]() {
-    auto url_span = opentracing::Tracer::Global()->StartSpan(
-        "compose_urls_client", {opentracing::ChildOf(&span->context())});
-
+  std::vector<Url> target_urls;
+  std::vector<UserMention> user_mentions;
+  if (_url_mux_pool && _user_mention_mux_pool) {
+    // Both requests are pipelined on shared connections instead of holding
+    // a pooled client and a thread each.
+    std::shared_ptr<opentracing::Span> url_span =
+        opentracing::Tracer::Global()->StartSpan(
+            "compose_urls_client", {opentracing::ChildOf(&span->context())});
     std::map<std::string, std::string> url_writer_text_map;
     TextMapWriter url_writer(url_writer_text_map);
     opentracing::Tracer::Global()->Inject(url_span->context(), url_writer);
+    deadline.Inject(&url_writer_text_map);
 
-    auto url_client_wrapper = _url_client_pool->Pop();
-    if (!url_client_wrapper) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
-      se.message = "Failed to connect to url-shorten-service";
-      throw se;
-    }
-    std::vector<Url> _return_urls;
-    auto url_client = url_client_wrapper->GetClient();
-    try {
-      url_client->ComposeUrls(_return_urls, req_id, urls, url_writer_text_map);
-    } catch (...) {
-      LOG(error) << "Failed to upload urls to url-shorten-service";
-      _url_client_pool->Remove(url_client_wrapper);
-      throw;
-    }
-    _url_client_pool->Keepalive(url_client_wrapper);
-    return _return_urls;
-  });
-
-  auto user_mention_future = std::async(std::launch::async, [&]() {
-    auto user_mention_span = opentracing::Tracer::Global()->StartSpan(
-        "compose_user_mentions_client",
-        {opentracing::ChildOf(&span->context())});
-
+    std::shared_ptr<opentracing::Span> user_mention_span =
+        opentracing::Tracer::Global()->StartSpan(
+            "compose_user_mentions_client",
+            {opentracing::ChildOf(&span->context())});
     std::map<std::string, std::string> user_mention_writer_text_map;
     TextMapWriter user_mention_writer(user_mention_writer_text_map);
     opentracing::Tracer::Global()->Inject(user_mention_span->context(),
                                           user_mention_writer);
+    deadline.Inject(&user_mention_writer_text_map);
 
-    auto user_mention_client_wrapper = _user_mention_client_pool->Pop();
-    if (!user_mention_client_wrapper) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
-      se.message = "Failed to connect to user-mention-service";
-      throw se;
+    auto shortened_urls_call = _url_mux_pool->Call<std::vector<Url>>(
+        [&](UrlShortenServiceConcurrentClient *client) {
+          return client->send_ComposeUrls(req_id, urls, url_writer_text_map);
+        },
+        [url_span](UrlShortenServiceConcurrentClient *client, int32_t seqid) {
+          std::vector<Url> _return_urls;
+          client->recv_ComposeUrls(_return_urls, seqid);
+          url_span->Finish();
+          return _return_urls;
+        });
+    auto user_mention_call =
+        _user_mention_mux_pool->Call<std::vector<UserMention>>(
+            [&](UserMentionServiceConcurrentClient *client) {
+              return client->send_ComposeUserMentions(
+                  req_id, mention_usernames, user_mention_writer_text_map);
+            },
+            [user_mention_span](UserMentionServiceConcurrentClient *client,
+                                int32_t seqid) {
+              std::vector<UserMention> _return_user_mentions;
+              client->recv_ComposeUserMentions(_return_user_mentions, seqid);
+              user_mention_span->Finish();
+              return _return_user_mentions;
+            });
+
+    try {
+      target_urls = shortened_urls_call.Get();
+    } catch (...) {
+      LOG(error) << "Failed to get shortened urls from url-shorten-service";
+      throw;
     }
-    std::vector<UserMention> _return_user_mentions;
-    auto user_mention_client = user_mention_client_wrapper->GetClient();
     try {
-      user_mention_client->ComposeUserMentions(_return_user_mentions, req_id,
-                                               mention_usernames,
-                                               user_mention_writer_text_map);
+      user_mentions = user_mention_call.Get();
     } catch (...) {
-      LOG(error) << "Failed to upload user_mentions to user-mention-service";
-      _user_mention_client_pool->Remove(user_mention_client_wrapper);
+      LOG(error) << "Failed to upload user mentions to user-mention-service";
       throw;
     }
+  } else {
+    auto shortened_urls_future = Executor::GetInstance()->Submit([&]() {
+      auto url_span = opentracing::Tracer::Global()->StartSpan(
+          "compose_urls_client", {opentracing::ChildOf(&span->context())});
 
-    _user_mention_client_pool->Keepalive(user_mention_client_wrapper);
-    return _return_user_mentions;
-  });
+      std::map<std::string, std::string> url_writer_text_map;
+      TextMapWriter url_writer(url_writer_text_map);
+      opentracing::Tracer::Global()->Inject(url_span->context(), url_writer);
+      deadline.Inject(&url_writer_text_map);
 
-  std::vector<Url> target_urls;
-  try {
-    target_urls = shortened_urls_future.get();
-  } catch (...) {
-    LOG(error) << "Failed to get shortened urls from url-shorten-service";
-    throw;
-  }
+      auto url_client_wrapper = _url_client_pool->Pop(deadline);
+      if (!url_client_wrapper) {
+        ServiceException se;
+        se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
+        se.message = "Failed to connect to url-shorten-service";
+        throw se;
+      }
+      std::vector<Url> _return_urls;
+      auto url_client = url_client_wrapper->GetClient();
+      try {
+        url_client->ComposeUrls(_return_urls, req_id, urls, url_writer_text_map);
+      } catch (...) {
+        LOG(error) << "Failed to upload urls to url-shorten-service";
+        _url_client_pool->Remove(url_client_wrapper);
+        throw;
+      }
+      _url_client_pool->Keepalive(url_client_wrapper);
+      return _return_urls;
+    });
 
-  std::vector<UserMention> user_mentions;
-  try {
-    user_mentions = user_mention_future.get();
-  } catch (...) {
-    LOG(error) << "Failed to upload user mentions to user-mention-service";
-    throw;
+    auto user_mention_future = Executor::GetInstance()->Submit([&]() {
+      auto user_mention_span = opentracing::Tracer::Global()->StartSpan(
+          "compose_user_mentions_client",
+          {opentracing::ChildOf(&span->context())});
+
+      std::map<std::string, std::string> user_mention_writer_text_map;
+      TextMapWriter user_mention_writer(user_mention_writer_text_map);
+      opentracing::Tracer::Global()->Inject(user_mention_span->context(),
+                                            user_mention_writer);
+      deadline.Inject(&user_mention_writer_text_map);
+
+      auto user_mention_client_wrapper =
+          _user_mention_client_pool->Pop(deadline);
+      if (!user_mention_client_wrapper) {
+        ServiceException se;
+        se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
+        se.message = "Failed to connect to user-mention-service";
+        throw se;
+      }
+      std::vector<UserMention> _return_user_mentions;
+      auto user_mention_client = user_mention_client_wrapper->GetClient();
+      try {
+        user_mention_client->ComposeUserMentions(_return_user_mentions, req_id,
+                                                 mention_usernames,
+                                                 user_mention_writer_text_map);
+      } catch (...) {
+        LOG(error) << "Failed to upload user_mentions to user-mention-service";
+        _user_mention_client_pool->Remove(user_mention_client_wrapper);
+        throw;
+      }
+
+      _user_mention_client_pool->Keepalive(user_mention_client_wrapper);
+      return _return_user_mentions;
+    });
+
+    try {
+      target_urls = shortened_urls_future.get();
+    } catch (...) {
+      LOG(error) << "Failed to get shortened urls from url-shorten-service";
+      throw;
+    }
+
+    try {
+      user_mentions = user_mention_future.get();
+    } catch (...) {
+      LOG(error) << "Failed to upload user mentions to user-mention-service";
+      throw;
+    }
   }
 
   std::string updated_text;
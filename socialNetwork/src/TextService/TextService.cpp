@@ -1,17 +1,9 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include "../utils.h"
 #include "../utils_thrift.h"
 #include "TextHandler.h"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
@@ -24,12 +16,28 @@ int main(int argc, char *argv[]) {
   json config_json;
   if (load_config_file("config/service-config.json", &config_json) == 0) {
     int port = config_json["text-service"]["port"];
+    int executor_threads = config_json["text-service"]["executor_threads"];
+    int executor_queue_size =
+        config_json["text-service"]["executor_queue_size"];
+    Executor::Init(executor_threads, executor_queue_size);
+    int multiplexed_clients = config_json["text-service"]["multiplexed_clients"];
 
     std::string url_addr = config_json["url-shorten-service"]["addr"];
     int url_port = config_json["url-shorten-service"]["port"];
     int url_conns = config_json["url-shorten-service"]["connections"];
     int url_timeout = config_json["url-shorten-service"]["timeout_ms"];
     int url_keepalive = config_json["url-shorten-service"]["keepalive_ms"];
+    int url_shards = config_json["url-shorten-service"]["pool_shards"];
+    int url_min_conns = config_json["url-shorten-service"]["min_connections"];
+    int url_health_check_ms =
+        config_json["url-shorten-service"]["health_check_interval_ms"];
+    int url_refresh_ahead_ms =
+        config_json["url-shorten-service"]["refresh_ahead_ms"];
+    int url_mux_conns =
+        config_json["url-shorten-service"]["multiplexed_connections"];
+    if (url_mux_conns < 1) {
+      url_mux_conns = url_conns;
+    }
 
     std::string user_mention_addr = config_json["user-mention-service"]["addr"];
     int user_mention_port = config_json["user-mention-service"]["port"];
@@ -38,25 +46,65 @@ int main(int argc, char *argv[]) {
         config_json["user-mention-service"]["timeout_ms"];
     int user_mention_keepalive =
         config_json["user-mention-service"]["keepalive_ms"];
+    int user_mention_shards =
+        config_json["user-mention-service"]["pool_shards"];
+    int user_mention_min_conns =
+        config_json["user-mention-service"]["min_connections"];
+    int user_mention_health_check_ms =
+        config_json["user-mention-service"]["health_check_interval_ms"];
+    int user_mention_refresh_ahead_ms =
+        config_json["user-mention-service"]["refresh_ahead_ms"];
+    int user_mention_mux_conns =
+        config_json["user-mention-service"]["multiplexed_connections"];
+    if (user_mention_mux_conns < 1) {
+      user_mention_mux_conns = user_mention_conns;
+    }
 
     ClientPool<ThriftClient<UrlShortenServiceClient>> url_client_pool(
-        "url-shorten-service", url_addr, url_port, 0, url_conns, url_timeout,
-        url_keepalive, config_json);
+        "url-shorten-service", url_addr, url_port, url_min_conns, url_conns,
+        url_timeout, url_keepalive, config_json, url_shards);
+    url_client_pool.EnableCircuitBreaker(
+        CircuitBreakerOptions::FromConfig(config_json["url-shorten-service"]));
+    url_client_pool.EnableResolution(
+        config_json["url-shorten-service"]["resolve_interval_ms"]);
+    url_client_pool.StartMaintenance(url_health_check_ms, url_refresh_ahead_ms);
 
     ClientPool<ThriftClient<UserMentionServiceClient>> user_mention_pool(
-        "user-mention-service", user_mention_addr, user_mention_port, 0,
-        user_mention_conns, user_mention_timeout, user_mention_keepalive, config_json);
+        "user-mention-service", user_mention_addr, user_mention_port,
+        user_mention_min_conns, user_mention_conns, user_mention_timeout,
+        user_mention_keepalive, config_json, user_mention_shards);
+    user_mention_pool.EnableCircuitBreaker(
+        CircuitBreakerOptions::FromConfig(config_json["user-mention-service"]));
+    user_mention_pool.EnableResolution(
+        config_json["user-mention-service"]["resolve_interval_ms"]);
+    user_mention_pool.StartMaintenance(user_mention_health_check_ms,
+                                       user_mention_refresh_ahead_ms);
+
+    MultiplexedClientPool<UrlShortenServiceConcurrentClient> url_mux_pool(
+        "url-shorten-service", url_addr, url_port, url_mux_conns,
+        url_keepalive, config_json);
+
+    MultiplexedClientPool<UserMentionServiceConcurrentClient>
+        user_mention_mux_pool("user-mention-service", user_mention_addr,
+                              user_mention_port, user_mention_mux_conns,
+                              user_mention_keepalive, config_json);
+
+    std::shared_ptr<TextHandler> handler;
+    if (multiplexed_clients) {
+      handler = std::make_shared<TextHandler>(&url_mux_pool,
+                                              &user_mention_mux_pool);
+    } else {
+      handler = std::make_shared<TextHandler>(&url_client_pool,
+                                              &user_mention_pool);
+    }
 
-    std::shared_ptr<TServerSocket> server_socket = get_server_socket(config_json, "0.0.0.0", port);
-    TThreadedServer server(
-        std::make_shared<TextServiceProcessor>(std::make_shared<TextHandler>(
-            &url_client_pool, &user_mention_pool)),
-        server_socket,
-        std::make_shared<TFramedTransportFactory>(),
-        std::make_shared<TBinaryProtocolFactory>());
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "text-service",
+        std::make_shared<TextServiceProcessor>(handler),
+        "0.0.0.0", port);
 
     LOG(info) << "Starting the text-service server...";
-    server.serve();
+    server->serve();
   } else
     exit(EXIT_FAILURE);
 }
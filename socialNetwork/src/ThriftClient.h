@@ -1,6 +1,8 @@
 #ifndef SOCIAL_NETWORK_MICROSERVICES_THRIFTCLIENT_H
 #define SOCIAL_NETWORK_MICROSERVICES_THRIFTCLIENT_H
 
+#include <poll.h>
+
 #include <string>
 #include <thread>
 #include <iostream>
@@ -46,9 +48,12 @@ class ThriftClient : public GenericClient {
   void Connect() override;
   void Disconnect() override;
   bool IsConnected() override;
+  bool Probe() override;
+  void SetTimeout(int timeout_ms) override;
 
  private:
   TThriftClient *_client;
+  int _timeout_ms = 0;
 
   std::shared_ptr<TSocket> _socket;
   std::shared_ptr<TTransport> _transport;
@@ -123,6 +128,33 @@ bool ThriftClient<TThriftClient>::IsConnected() {
   return _transport->isOpen();
 }
 
+template<class TThriftClient>
+bool ThriftClient<TThriftClient>::Probe() {
+  if (!IsConnected()) {
+    return false;
+  }
+  // No request is outstanding on an idle client, so a readable socket means
+  // the peer has closed the connection (or sent bytes nobody will consume).
+  struct pollfd pfd;
+  pfd.fd = _socket->getSocketFD();
+  pfd.events = POLLIN;
+  pfd.revents = 0;
+  return poll(&pfd, 1, 0) == 0;
+}
+
+template<class TThriftClient>
+void ThriftClient<TThriftClient>::SetTimeout(int timeout_ms) {
+  // Only touch the socket options when the timeout actually changes, which
+  // is rare for clients serving requests without a deadline.
+  if (timeout_ms == _timeout_ms) {
+    return;
+  }
+  _socket->setConnTimeout(timeout_ms);
+  _socket->setRecvTimeout(timeout_ms);
+  _socket->setSendTimeout(timeout_ms);
+  _timeout_ms = timeout_ms;
+}
+
 template<class TThriftClient>
 void ThriftClient<TThriftClient>::Connect() {
   if (!IsConnected()) {
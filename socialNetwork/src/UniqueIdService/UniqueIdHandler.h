@@ -10,6 +10,7 @@
 
 #include "../../gen-cpp/UniqueIdService.h"
 #include "../../gen-cpp/social_network_types.h"
+#include "../Deadline.h"
 #include "../logger.h"
 #include "../tracing.h"
 
@@ -63,6 +64,7 @@ int64_t UniqueIdHandler::ComposeUniqueId(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
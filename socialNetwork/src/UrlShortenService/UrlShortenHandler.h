@@ -12,6 +12,8 @@
 
 #include "../../gen-cpp/UrlShortenService.h"
 #include "../../gen-cpp/social_network_types.h"
+#include "../Deadline.h"
+#include "../Executor.h"
 #include "../logger.h"
 #include "../tracing.h"
 
@@ -73,6 +75,7 @@ void UrlShortenHandler::ComposeUrls(
 
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -82,7 +85,7 @@ void UrlShortenHandler::ComposeUrls(
   opentracing::Tracer::Global()->Inject(span->context(), writer);
 
   std::vector<Url> target_urls;
-  std::future<void> mongo_future;
+  ExecutorFuture<void> mongo_future;
 
   if (!urls.empty()) {
     for (auto &url : urls) {
@@ -93,8 +96,7 @@ void UrlShortenHandler::ComposeUrls(
       target_urls.emplace_back(new_target_url);
     }
 
-    mongo_future = std::async(
-        std::launch::async, [&](){
+    mongo_future = Executor::GetInstance()->Submit([&](){
           mongoc_client_t *mongodb_client = mongoc_client_pool_pop(
               _mongodb_client_pool);
           if (!mongodb_client) {
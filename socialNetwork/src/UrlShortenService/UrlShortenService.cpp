@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include "../utils.h"
 #include "../utils_memcached.h"
@@ -11,10 +7,6 @@
 #include "UrlShortenHandler.h"
 #include "nlohmann/json.hpp"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 static memcached_pool_st* memcached_client_pool;
@@ -38,6 +30,10 @@ int main(int argc, char* argv[]) {
     exit(EXIT_FAILURE);
   }
   int port = config_json["url-shorten-service"]["port"];
+  int executor_threads = config_json["url-shorten-service"]["executor_threads"];
+  int executor_queue_size =
+      config_json["url-shorten-service"]["executor_queue_size"];
+  Executor::Init(executor_threads, executor_queue_size);
 
   int mongodb_conns = config_json["url-shorten-mongodb"]["connections"];
   int mongodb_timeout = config_json["url-shorten-mongodb"]["timeout_ms"];
@@ -69,15 +65,13 @@ int main(int argc, char* argv[]) {
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
 
   std::mutex thread_lock;
-  std::shared_ptr<TServerSocket> server_socket = get_server_socket(config_json, "0.0.0.0", port);
-  TThreadedServer server(
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "url-shorten-service",
       std::make_shared<UrlShortenServiceProcessor>(
           std::make_shared<UrlShortenHandler>(
               memcached_client_pool, mongodb_client_pool, &thread_lock)),
-      server_socket,
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
+      "0.0.0.0", port);
 
   LOG(info) << "Starting the url-shorten-service server...";
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
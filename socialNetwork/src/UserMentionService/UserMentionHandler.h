@@ -8,8 +8,11 @@
 
 #include "../../gen-cpp/UserMentionService.h"
 #include "../../gen-cpp/social_network_types.h"
+#include "../BsonDecoder.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -27,6 +30,7 @@ class UserMentionHandler : public UserMentionServiceIf {
  private:
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
+  CacheMetrics _cache_metrics;
 };
 
 UserMentionHandler::UserMentionHandler(
@@ -34,6 +38,8 @@ UserMentionHandler::UserMentionHandler(
     mongoc_client_pool_t *mongodb_client_pool) {
   _memcached_client_pool = memcached_client_pool;
   _mongodb_client_pool = mongodb_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("user-mention-memcached");
 }
 
 void UserMentionHandler::ComposeUserMentions(
@@ -42,6 +48,7 @@ void UserMentionHandler::ComposeUserMentions(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -136,6 +143,8 @@ void UserMentionHandler::ComposeUserMentions(
     memcached_quit(client);
     memcached_pool_push(_memcached_client_pool, client);
     get_span->Finish();
+    *_cache_metrics.hits += user_mentions.size();
+    *_cache_metrics.misses += usernames_not_cached.size();
     for (int i = 0; i < usernames.size(); ++i) {
       delete keys[i];
     }
@@ -188,24 +197,8 @@ void UserMentionHandler::ComposeUserMentions(
       const bson_t *doc;
 
       while (mongoc_cursor_next(cursor, &doc)) {
-        bson_iter_t iter;
         UserMention new_user_mention;
-        if (bson_iter_init_find(&iter, doc, "user_id")) {
-          new_user_mention.user_id = bson_iter_value(&iter)->value.v_int64;
-        } else {
-          ServiceException se;
-          se.errorCode = ErrorCode::SE_MONGODB_ERROR;
-          se.message = "Attribute of MongoDB item is not complete";
-          bson_destroy(query);
-          mongoc_cursor_destroy(cursor);
-          mongoc_collection_destroy(collection);
-          mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
-          find_span->Finish();
-          throw se;
-        }
-        if (bson_iter_init_find(&iter, doc, "username")) {
-          new_user_mention.username = bson_iter_value(&iter)->value.v_utf8.str;
-        } else {
+        if (!DecodeBson(doc, &new_user_mention)) {
           ServiceException se;
           se.errorCode = ErrorCode::SE_MONGODB_ERROR;
           se.message = "Attribute of MongoDB item is not complete";
@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include "../utils.h"
 #include "../utils_memcached.h"
@@ -11,10 +7,6 @@
 #include "UserMentionHandler.h"
 #include "nlohmann/json.hpp"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 static memcached_pool_st* memcached_client_pool;
@@ -56,15 +48,14 @@ int main(int argc, char* argv[]) {
     return EXIT_FAILURE;
   }
 
-  std::shared_ptr<TServerSocket> server_socket = get_server_socket(config_json, "0.0.0.0", port);
 
-  TThreadedServer server(std::make_shared<UserMentionServiceProcessor>(
-                             std::make_shared<UserMentionHandler>(
-                                 memcached_client_pool, mongodb_client_pool)),
-                         server_socket,
-                         std::make_shared<TFramedTransportFactory>(),
-                         std::make_shared<TBinaryProtocolFactory>());
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "user-mention-service",
+      std::make_shared<UserMentionServiceProcessor>(
+          std::make_shared<UserMentionHandler>(
+              memcached_client_pool, mongodb_client_pool)),
+      "0.0.0.0", port);
 
   LOG(info) << "Starting the user-mention-service server...";
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
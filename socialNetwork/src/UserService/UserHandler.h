@@ -18,8 +18,10 @@
 #include "../../gen-cpp/social_network_types.h"
 #include "../../third_party/PicoSHA2/picosha2.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
 #include "../ThriftClient.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 
 // Custom Epoch (January 1, 2018 Midnight GMT = 2018-01-01T00:00:00Z)
@@ -98,6 +100,7 @@ class UserHandler : public UserServiceIf {
   memcached_pool_st *_memcached_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
   ClientPool<ThriftClient<SocialGraphServiceClient>> *_social_graph_client_pool;
+  CacheMetrics _cache_metrics;
 };
 
 UserHandler::UserHandler(std::mutex *thread_lock, const std::string &machine_id,
@@ -112,6 +115,7 @@ UserHandler::UserHandler(std::mutex *thread_lock, const std::string &machine_id,
   _mongodb_client_pool = mongodb_client_pool;
   _secret = secret;
   _social_graph_client_pool = social_graph_client_pool;
+  _cache_metrics = Metrics::GetInstance()->GetCacheMetrics("user-memcached");
 }
 
 void UserHandler::RegisterUserWithId(
@@ -121,6 +125,8 @@ void UserHandler::RegisterUserWithId(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -128,6 +134,7 @@ void UserHandler::RegisterUserWithId(
       "register_user_withid_server",
       {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
   // Store user info into mongodb
   mongoc_client_t *mongodb_client =
@@ -208,7 +215,7 @@ void UserHandler::RegisterUserWithId(
   mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
 
   if (!found) {
-    auto social_graph_client_wrapper = _social_graph_client_pool->Pop();
+    auto social_graph_client_wrapper = _social_graph_client_pool->Pop(deadline);
     if (!social_graph_client_wrapper) {
       ServiceException se;
       se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -236,12 +243,15 @@ void UserHandler::RegisterUser(
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "register_user_server", {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
   // Compose user_id
   _thread_lock->lock();
@@ -355,7 +365,7 @@ void UserHandler::RegisterUser(
   mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
 
   if (!found) {
-    auto social_graph_client_wrapper = _social_graph_client_pool->Pop();
+    auto social_graph_client_wrapper = _social_graph_client_pool->Pop(deadline);
     if (!social_graph_client_wrapper) {
       ServiceException se;
       se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
@@ -381,6 +391,7 @@ void UserHandler::ComposeCreatorWithUsername(
     Creator &_return, const int64_t req_id, const std::string &username,
     const std::map<std::string, std::string> &carrier) {
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -419,6 +430,7 @@ void UserHandler::ComposeCreatorWithUsername(
   bool cached = false;
   if (user_id_mmc) {
     cached = true;
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Found user_id of username :" << username << " in Memcached";
     user_id = std::stoul(user_id_mmc);
     free(user_id_mmc);
@@ -426,6 +438,7 @@ void UserHandler::ComposeCreatorWithUsername(
 
   // If not cached in memcached
   else {
+    (*_cache_metrics.misses)++;
     LOG(debug) << "user_id not cached in Memcached";
     mongoc_client_t *mongodb_client =
         mongoc_client_pool_pop(_mongodb_client_pool);
@@ -540,6 +553,7 @@ void UserHandler::ComposeCreatorWithUserId(
     const std::string &username,
     const std::map<std::string, std::string> &carrier) {
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -561,6 +575,7 @@ void UserHandler::Login(std::string &_return, int64_t req_id,
                         const std::string &password,
                         const std::map<std::string, std::string> &carrier) {
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -605,11 +620,13 @@ void UserHandler::Login(std::string &_return, int64_t req_id,
     salt_stored = login_json["salt"];
     user_id_stored = login_json["user_id"];
     cached = true;
+    (*_cache_metrics.hits)++;
     free(login_mmc);
   }
 
   else {
     // If not cached in memcached
+    (*_cache_metrics.misses)++;
     LOG(debug) << "Username: " << username << " NOT cached in Memcached";
 
     mongoc_client_t *mongodb_client =
@@ -750,6 +767,7 @@ int64_t UserHandler::GetUserId(
     int64_t req_id, const std::string &username,
     const std::map<std::string, std::string> &carrier) {
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -789,11 +807,13 @@ int64_t UserHandler::GetUserId(
   bool cached = false;
   if (user_id_mmc) {
     cached = true;
+    (*_cache_metrics.hits)++;
     LOG(debug) << "Found user_id of username :" << username << " in Memcached";
     user_id = std::stoul(user_id_mmc);
     free(user_id_mmc);
   } else {
     // If not cached in memcached
+    (*_cache_metrics.misses)++;
     LOG(debug) << "user_id not cached in Memcached";
     mongoc_client_t *mongodb_client =
         mongoc_client_pool_pop(_mongodb_client_pool);
@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include "../utils.h"
 #include "../utils_memcached.h"
@@ -10,10 +6,6 @@
 #include "../utils_thrift.h"
 #include "UserHandler.h"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
@@ -39,6 +31,13 @@ int main(int argc, char *argv[]) {
   int social_graph_timeout = config_json["social-graph-service"]["timeout_ms"];
   int social_graph_keepalive =
       config_json["social-graph-service"]["keepalive_ms"];
+  int social_graph_shards = config_json["social-graph-service"]["pool_shards"];
+  int social_graph_min_conns =
+      config_json["social-graph-service"]["min_connections"];
+  int social_graph_health_check_ms =
+      config_json["social-graph-service"]["health_check_interval_ms"];
+  int social_graph_refresh_ahead_ms =
+      config_json["social-graph-service"]["refresh_ahead_ms"];
 
   int mongodb_conns = config_json["user-mongodb"]["connections"];
   int mongodb_timeout = config_json["user-mongodb"]["timeout_ms"];
@@ -65,8 +64,15 @@ int main(int argc, char *argv[]) {
   std::mutex thread_lock;
 
   ClientPool<ThriftClient<SocialGraphServiceClient>> social_graph_client_pool(
-      "social-graph", social_graph_addr, social_graph_port, 0,
-      social_graph_conns, social_graph_timeout, social_graph_keepalive, config_json);
+      "social-graph", social_graph_addr, social_graph_port,
+      social_graph_min_conns, social_graph_conns, social_graph_timeout,
+      social_graph_keepalive, config_json, social_graph_shards);
+  social_graph_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["social-graph-service"]));
+  social_graph_client_pool.EnableResolution(
+      config_json["social-graph-service"]["resolve_interval_ms"]);
+  social_graph_client_pool.StartMaintenance(social_graph_health_check_ms,
+                                            social_graph_refresh_ahead_ms);
 
   mongoc_client_t *mongodb_client = mongoc_client_pool_pop(mongodb_client_pool);
   if (!mongodb_client) {
@@ -82,15 +88,13 @@ int main(int argc, char *argv[]) {
     }
   }
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
-  std::shared_ptr<TServerSocket> server_socket = get_server_socket(config_json, "0.0.0.0", port);
 
-  TThreadedServer server(
+  std::shared_ptr<TServer> server = get_server(
+      config_json, "user-service",
       std::make_shared<UserServiceProcessor>(std::make_shared<UserHandler>(
-          &thread_lock, machine_id, secret, memcached_client_pool,
-          mongodb_client_pool, &social_graph_client_pool)),
-      server_socket,
-      std::make_shared<TFramedTransportFactory>(),
-      std::make_shared<TBinaryProtocolFactory>());
+              &thread_lock, machine_id, secret, memcached_client_pool,
+              mongodb_client_pool, &social_graph_client_pool)),
+      "0.0.0.0", port);
   LOG(info) << "Starting the user-service server ...";
-  server.serve();
+  server->serve();
 }
\ No newline at end of file
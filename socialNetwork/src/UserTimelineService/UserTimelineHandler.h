@@ -12,8 +12,12 @@
 #include "../../gen-cpp/PostStorageService.h"
 #include "../../gen-cpp/UserTimelineService.h"
 #include "../ClientPool.h"
+#include "../Deadline.h"
+#include "../Executor.h"
 #include "../ThriftClient.h"
+#include "../TimelineEncoding.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 
 using namespace sw::redis;
@@ -34,6 +38,10 @@ class UserTimelineHandler : public UserTimelineServiceIf {
 
   bool IsRedisReplicationEnabled();
 
+  // Encoding of the post ids written to the timelines. Post ids of either
+  // encoding are read. Must be called before the server starts.
+  void SetTimelineEncoding(TimelineEncoding timeline_encoding);
+
   void WriteUserTimeline(
       int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
       const std::map<std::string, std::string> &carrier) override;
@@ -48,6 +56,8 @@ class UserTimelineHandler : public UserTimelineServiceIf {
   RedisCluster *_redis_cluster_client_pool;
   mongoc_client_pool_t *_mongodb_client_pool;
   ClientPool<ThriftClient<PostStorageServiceClient>> *_post_client_pool;
+  CacheMetrics _cache_metrics;
+  TimelineEncoding _timeline_encoding = TimelineEncoding::DECIMAL;
 };
 
 UserTimelineHandler::UserTimelineHandler(
@@ -59,6 +69,8 @@ UserTimelineHandler::UserTimelineHandler(
   _redis_cluster_client_pool = nullptr;
   _mongodb_client_pool = mongodb_pool;
   _post_client_pool = post_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("user-timeline-redis");
 }
 
 UserTimelineHandler::UserTimelineHandler(
@@ -70,6 +82,8 @@ UserTimelineHandler::UserTimelineHandler(
     _redis_cluster_client_pool = nullptr;
     _mongodb_client_pool = mongodb_pool;
     _post_client_pool = post_client_pool;
+    _cache_metrics =
+        Metrics::GetInstance()->GetCacheMetrics("user-timeline-redis");
 }
 
 UserTimelineHandler::UserTimelineHandler(
@@ -81,17 +95,25 @@ UserTimelineHandler::UserTimelineHandler(
   _redis_client_pool = nullptr;
   _mongodb_client_pool = mongodb_pool;
   _post_client_pool = post_client_pool;
+  _cache_metrics =
+      Metrics::GetInstance()->GetCacheMetrics("user-timeline-redis");
 }
 
 bool UserTimelineHandler::IsRedisReplicationEnabled() {
     return (_redis_primary_pool || _redis_replica_pool);
 }
 
+void UserTimelineHandler::SetTimelineEncoding(
+    TimelineEncoding timeline_encoding) {
+  _timeline_encoding = timeline_encoding;
+}
+
 void UserTimelineHandler::WriteUserTimeline(
     int64_t req_id, int64_t post_id, int64_t user_id, int64_t timestamp,
     const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline::FromCarrier(carrier).Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
@@ -163,16 +185,17 @@ void UserTimelineHandler::WriteUserTimeline(
   auto redis_span = opentracing::Tracer::Global()->StartSpan(
       "write_user_timeline_redis_update_client",
       {opentracing::ChildOf(&span->context())});
+  std::string post_id_str = EncodePostId(post_id, _timeline_encoding);
   try {
     if (_redis_client_pool)
-      _redis_client_pool->zadd(std::to_string(user_id), std::to_string(post_id),
+      _redis_client_pool->zadd(std::to_string(user_id), post_id_str,
                               timestamp, UpdateType::NOT_EXIST);
     else if (IsRedisReplicationEnabled()) {
-        _redis_primary_pool->zadd(std::to_string(user_id), std::to_string(post_id),
+        _redis_primary_pool->zadd(std::to_string(user_id), post_id_str,
                               timestamp, UpdateType::NOT_EXIST);
     }
     else
-      _redis_cluster_client_pool->zadd(std::to_string(user_id), std::to_string(post_id),
+      _redis_cluster_client_pool->zadd(std::to_string(user_id), post_id_str,
                               timestamp, UpdateType::NOT_EXIST);
 
   } catch (const Error &err) {
@@ -188,12 +211,15 @@ void UserTimelineHandler::ReadUserTimeline(
     int stop, const std::map<std::string, std::string> &carrier) {
   // Initialize a span
   TextMapReader reader(carrier);
+  Deadline deadline = Deadline::FromCarrier(carrier);
+  deadline.Check();
   std::map<std::string, std::string> writer_text_map;
   TextMapWriter writer(writer_text_map);
   auto parent_span = opentracing::Tracer::Global()->Extract(reader);
   auto span = opentracing::Tracer::Global()->StartSpan(
       "read_user_timeline_server", {opentracing::ChildOf(parent_span->get())});
   opentracing::Tracer::Global()->Inject(span->context(), writer);
+  deadline.Inject(&writer_text_map);
 
   if (stop <= start || start < 0) {
     return;
@@ -223,11 +249,16 @@ void UserTimelineHandler::ReadUserTimeline(
 
   std::vector<int64_t> post_ids;
   for (auto &post_id_str : post_ids_str) {
-    post_ids.emplace_back(std::stoul(post_id_str));
+    post_ids.emplace_back(DecodePostId(post_id_str));
   }
 
   // find in mongodb
   int mongo_start = start + post_ids.size();
+  if (mongo_start < stop) {
+    (*_cache_metrics.misses)++;
+  } else {
+    (*_cache_metrics.hits)++;
+  }
   std::unordered_map<std::string, double> redis_update_map;
   if (mongo_start < stop) {
     // Instead find post_ids from mongodb
@@ -286,8 +317,9 @@ void UserTimelineHandler::ReadUserTimeline(
             post_ids.emplace_back(curr_post_id);
           }
         }
-        redis_update_map.insert(std::make_pair(std::to_string(curr_post_id),
-                                               (double)curr_timestamp));
+        redis_update_map.insert(
+            std::make_pair(EncodePostId(curr_post_id, _timeline_encoding),
+                           (double)curr_timestamp));
         bson_iter_init(&iter_0, doc);
         bson_iter_init(&iter_1, doc);
         idx++;
@@ -300,61 +332,54 @@ void UserTimelineHandler::ReadUserTimeline(
     mongoc_client_pool_push(_mongodb_client_pool, mongodb_client);
   }
 
-  std::future<std::vector<Post>> post_future =
-      std::async(std::launch::async, [&]() {
-        auto post_client_wrapper = _post_client_pool->Pop();
-        if (!post_client_wrapper) {
-          ServiceException se;
-          se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
-          se.message = "Failed to connect to post-storage-service";
-          throw se;
-        }
-        std::vector<Post> _return_posts;
-        auto post_client = post_client_wrapper->GetClient();
-        try {
-          post_client->ReadPosts(_return_posts, req_id, post_ids,
-                                 writer_text_map);
-        } catch (...) {
-          _post_client_pool->Remove(post_client_wrapper);
-          LOG(error) << "Failed to read posts from post-storage-service";
-          throw;
-        }
-        _post_client_pool->Keepalive(post_client_wrapper);
-        return _return_posts;
-      });
-
+  // Write the ids found in MongoDB back to Redis on a worker, while the
+  // posts are read on this thread, where a slow read can be hedged.
+  ExecutorFuture<void> redis_update_future;
   if (redis_update_map.size() > 0) {
-    auto redis_update_span = opentracing::Tracer::Global()->StartSpan(
-        "user_timeline_redis_update_client",
-        {opentracing::ChildOf(&span->context())});
-    try {
-      if (_redis_client_pool)
-        _redis_client_pool->zadd(std::to_string(user_id),
-                               redis_update_map.begin(),
-                               redis_update_map.end());
-      else if (IsRedisReplicationEnabled()) {
-          _redis_primary_pool->zadd(std::to_string(user_id),
-              redis_update_map.begin(),
-              redis_update_map.end());
+    redis_update_future = Executor::GetInstance()->Submit([&]() {
+      auto redis_update_span = opentracing::Tracer::Global()->StartSpan(
+          "user_timeline_redis_update_client",
+          {opentracing::ChildOf(&span->context())});
+      try {
+        if (_redis_client_pool)
+          _redis_client_pool->zadd(std::to_string(user_id),
+                                 redis_update_map.begin(),
+                                 redis_update_map.end());
+        else if (IsRedisReplicationEnabled()) {
+            _redis_primary_pool->zadd(std::to_string(user_id),
+                redis_update_map.begin(),
+                redis_update_map.end());
+        }
+        else
+          _redis_cluster_client_pool->zadd(std::to_string(user_id),
+                                 redis_update_map.begin(),
+                                 redis_update_map.end());
+
+      } catch (const Error &err) {
+        LOG(error) << err.what();
+        throw err;
       }
-      else
-        _redis_cluster_client_pool->zadd(std::to_string(user_id),
-                               redis_update_map.begin(),
-                               redis_update_map.end());
-
-    } catch (const Error &err) {
-      LOG(error) << err.what();
-      throw err;
-    }
-    redis_update_span->Finish();
+      redis_update_span->Finish();
+    });
   }
 
   try {
-    _return = post_future.get();
+    _return = _post_client_pool->HedgedCall<std::vector<Post>>(
+        deadline,
+        [req_id, post_ids, writer_text_map](
+            ThriftClient<PostStorageServiceClient> *client) {
+          std::vector<Post> posts;
+          client->GetClient()->ReadPosts(posts, req_id, post_ids,
+                                         writer_text_map);
+          return posts;
+        });
   } catch (...) {
     LOG(error) << "Failed to get post from post-storage-service";
     throw;
   }
+  if (redis_update_future.valid()) {
+    redis_update_future.get();
+  }
   span->Finish();
 }
 
@@ -1,8 +1,4 @@
 #include <signal.h>
-#include <thrift/protocol/TBinaryProtocol.h>
-#include <thrift/server/TThreadedServer.h>
-#include <thrift/transport/TBufferTransports.h>
-#include <thrift/transport/TServerSocket.h>
 
 #include <boost/program_options.hpp>
 
@@ -16,10 +12,6 @@
 #include "../utils_thrift.h"
 #include "UserTimelineHandler.h"
 
-using apache::thrift::protocol::TBinaryProtocolFactory;
-using apache::thrift::server::TThreadedServer;
-using apache::thrift::transport::TFramedTransportFactory;
-using apache::thrift::transport::TServerSocket;
 using namespace social_network;
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
@@ -60,6 +52,17 @@ int main(int argc, char *argv[]) {
   }
 
   int port = config_json["user-timeline-service"]["port"];
+  int executor_threads = config_json["user-timeline-service"]["executor_threads"];
+  int executor_queue_size =
+      config_json["user-timeline-service"]["executor_queue_size"];
+  Executor::Init(executor_threads, executor_queue_size);
+  TimelineEncoding timeline_encoding;
+  std::string timeline_encoding_name =
+      config_json["user-timeline-service"]["timeline_encoding"];
+  if (!ParseTimelineEncoding(timeline_encoding_name, &timeline_encoding)) {
+    LOG(fatal) << "Unknown timeline_encoding: " << timeline_encoding_name;
+    exit(EXIT_FAILURE);
+  }
 
   int post_storage_port = config_json["post-storage-service"]["port"];
   std::string post_storage_addr = config_json["post-storage-service"]["addr"];
@@ -67,6 +70,13 @@ int main(int argc, char *argv[]) {
   int post_storage_timeout = config_json["post-storage-service"]["timeout_ms"];
   int post_storage_keepalive =
       config_json["post-storage-service"]["keepalive_ms"];
+  int post_storage_shards = config_json["post-storage-service"]["pool_shards"];
+  int post_storage_min_conns =
+      config_json["post-storage-service"]["min_connections"];
+  int post_storage_health_check_ms =
+      config_json["post-storage-service"]["health_check_interval_ms"];
+  int post_storage_refresh_ahead_ms =
+      config_json["post-storage-service"]["refresh_ahead_ms"];
 
   int mongodb_conns = config_json["user-timeline-mongodb"]["connections"];
   int mongodb_timeout = config_json["user-timeline-mongodb"]["timeout_ms"];
@@ -87,9 +97,18 @@ int main(int argc, char *argv[]) {
   }
 
   ClientPool<ThriftClient<PostStorageServiceClient>> post_storage_client_pool(
-      "post-storage-client", post_storage_addr, post_storage_port, 0,
-      post_storage_conns, post_storage_timeout, post_storage_keepalive,
-      config_json);
+      "post-storage-client", post_storage_addr, post_storage_port,
+      post_storage_min_conns, post_storage_conns, post_storage_timeout,
+      post_storage_keepalive, config_json, post_storage_shards);
+  post_storage_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["post-storage-service"]));
+  post_storage_client_pool.EnableResolution(
+      config_json["post-storage-service"]["resolve_interval_ms"]);
+  post_storage_client_pool.EnableHedging(
+      config_json["post-storage-service"]["hedge_percentile"],
+      config_json["post-storage-service"]["hedge_budget"]);
+  post_storage_client_pool.StartMaintenance(post_storage_health_check_ms,
+                                            post_storage_refresh_ahead_ms);
 
   mongoc_client_t *mongodb_client = mongoc_client_pool_pop(mongodb_client_pool);
   if (!mongodb_client) {
@@ -105,47 +124,46 @@ int main(int argc, char *argv[]) {
     }
   }
   mongoc_client_pool_push(mongodb_client_pool, mongodb_client);
-  std::shared_ptr<TServerSocket> server_socket =
-      get_server_socket(config_json, "0.0.0.0", port);
 
   if (redis_cluster_flag || redis_cluster_config_flag) {
     RedisCluster redis_client_pool =
         init_redis_cluster_client_pool(config_json, "user-timeline");
-    TThreadedServer server(std::make_shared<UserTimelineServiceProcessor>(
-                               std::make_shared<UserTimelineHandler>(
-                                   &redis_client_pool, mongodb_client_pool,
-                                   &post_storage_client_pool)),
-                           server_socket,
-                           std::make_shared<TFramedTransportFactory>(),
-                           std::make_shared<TBinaryProtocolFactory>());
+    auto handler = std::make_shared<UserTimelineHandler>(
+        &redis_client_pool, mongodb_client_pool, &post_storage_client_pool);
+    handler->SetTimelineEncoding(timeline_encoding);
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "user-timeline-service",
+        std::make_shared<UserTimelineServiceProcessor>(handler),
+        "0.0.0.0", port);
     LOG(info) << "Starting the user-timeline-service server with Redis Cluster support...";
-    server.serve();
+    server->serve();
   }
   else if (redis_replica_config_flag) {
       Redis redis_replica_client_pool = init_redis_replica_client_pool(config_json, "redis-replica");
       Redis redis_primary_client_pool = init_redis_replica_client_pool(config_json, "redis-primary");
-      TThreadedServer server(std::make_shared<UserTimelineServiceProcessor>(
-          std::make_shared<UserTimelineHandler>(
-              &redis_replica_client_pool, &redis_primary_client_pool, mongodb_client_pool,
-              &post_storage_client_pool)),
-          server_socket,
-          std::make_shared<TFramedTransportFactory>(),
-          std::make_shared<TBinaryProtocolFactory>());
+      auto handler = std::make_shared<UserTimelineHandler>(
+          &redis_replica_client_pool, &redis_primary_client_pool,
+          mongodb_client_pool, &post_storage_client_pool);
+      handler->SetTimelineEncoding(timeline_encoding);
+      std::shared_ptr<TServer> server = get_server(
+          config_json, "user-timeline-service",
+          std::make_shared<UserTimelineServiceProcessor>(handler),
+          "0.0.0.0", port);
       LOG(info) << "Starting the user-timeline-service server with replicated Redis support...";
-      server.serve();
+      server->serve();
 
   }
   else {
     Redis redis_client_pool =
         init_redis_client_pool(config_json, "user-timeline");
-    TThreadedServer server(std::make_shared<UserTimelineServiceProcessor>(
-                               std::make_shared<UserTimelineHandler>(
-                                   &redis_client_pool, mongodb_client_pool,
-                                   &post_storage_client_pool)),
-                           server_socket,
-                           std::make_shared<TFramedTransportFactory>(),
-                           std::make_shared<TBinaryProtocolFactory>());
+    auto handler = std::make_shared<UserTimelineHandler>(
+        &redis_client_pool, mongodb_client_pool, &post_storage_client_pool);
+    handler->SetTimelineEncoding(timeline_encoding);
+    std::shared_ptr<TServer> server = get_server(
+        config_json, "user-timeline-service",
+        std::make_shared<UserTimelineServiceProcessor>(handler),
+        "0.0.0.0", port);
     LOG(info) << "Starting the user-timeline-service server...";
-    server.serve();
+    server->serve();
   }
 }
\ No newline at end of file
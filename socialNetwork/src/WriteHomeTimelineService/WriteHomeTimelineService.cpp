@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <atomic>
 #include <cpp_redis/cpp_redis>
 #include <csignal>
 #include <mutex>
@@ -10,9 +12,13 @@
 #include "../../gen-cpp/social_network_types.h"
 #include "../AmqpLibeventHandler.h"
 #include "../ClientPool.h"
+#include "../Executor.h"
+#include "../HybridTimeline.h"
 #include "../RedisClient.h"
 #include "../ThriftClient.h"
+#include "../TimelineEncoding.h"
 #include "../logger.h"
+#include "../Metrics.h"
 #include "../tracing.h"
 #include "../utils.h"
 
@@ -22,93 +28,195 @@ static std::exception_ptr _teptr;
 static ClientPool<RedisClient> *_redis_client_pool;
 static ClientPool<ThriftClient<SocialGraphServiceClient>>
     *_social_graph_client_pool;
+static Histogram *_message_latency_us;
+static Histogram *_batch_size;
+static std::atomic<long> *_dropped_messages;
+static int _fanout_threshold;
+static int _max_timeline_length;
+static TimelineEncoding _timeline_encoding;
+
+// A post taken from the write-home-timeline queue.
+struct HomeTimelineMessage {
+  int64_t req_id;
+  int64_t user_id;
+  int64_t post_id;
+  int64_t timestamp;
+  std::vector<int64_t> user_mentions_id;
+  std::unique_ptr<opentracing::Span> span;
+};
 
 void sigintHandler(int sig) { exit(EXIT_SUCCESS); }
 
-void OnReceivedWorker(const AMQP::Message &msg) {
+std::vector<int64_t> GetFollowers(int64_t req_id, int64_t user_id,
+                                  const opentracing::Span *parent_span) {
+  auto followers_span = opentracing::Tracer::Global()->StartSpan(
+      "get_followers_client", {opentracing::ChildOf(&parent_span->context())});
+  std::map<std::string, std::string> writer_text_map;
+  TextMapWriter writer(writer_text_map);
+  opentracing::Tracer::Global()->Inject(followers_span->context(), writer);
+
+  // GetFollowers is a read, so a slow call may be hedged.
+  std::vector<int64_t> followers_id;
   try {
-    json msg_json = json::parse(std::string(msg.body(), msg.bodySize()));
+    followers_id =
+        _social_graph_client_pool->HedgedCall<std::vector<int64_t>>(
+            Deadline(),
+            [req_id, user_id, writer_text_map](
+                ThriftClient<SocialGraphServiceClient> *client) {
+              std::vector<int64_t> followers;
+              client->GetClient()->GetFollowers(followers, req_id, user_id,
+                                                writer_text_map);
+              return followers;
+            });
+  } catch (...) {
+    LOG(error) << "Failed to get followers from social-network-service";
+    throw;
+  }
+  followers_span->Finish();
+  return followers_id;
+}
 
+// Writes a batch of posts to the home timelines of the followers and the
+// mentioned users of their authors. The followers of each author are read
+// once, in parallel, and every home timeline gets a single ZADD holding all
+// of its new posts, in one pipeline for the whole batch.
+void OnReceivedWorker(const std::vector<std::string> &bodies) {
+  std::vector<HomeTimelineMessage> messages;
+  messages.reserve(bodies.size());
+  for (auto &body : bodies) {
+    HomeTimelineMessage message;
     std::map<std::string, std::string> carrier;
-    for (auto it = msg_json["carrier"].begin(); it != msg_json["carrier"].end();
-         ++it) {
-      carrier.emplace(std::make_pair(it.key(), it.value()));
+    try {
+      json msg_json = json::parse(body);
+      for (auto it = msg_json["carrier"].begin();
+           it != msg_json["carrier"].end(); ++it) {
+        carrier.emplace(std::make_pair(it.key(), it.value()));
+      }
+      message.req_id = msg_json["req_id"];
+      message.user_id = msg_json["user_id"];
+      message.post_id = msg_json["post_id"];
+      message.timestamp = msg_json["timestamp"];
+      message.user_mentions_id =
+          msg_json["user_mentions_id"].get<std::vector<int64_t>>();
+    } catch (const json::exception &ex) {
+      // Retrying would not help, the message is acknowledged with the batch.
+      LOG(error) << "Dropped malformed message: " << ex.what();
+      continue;
     }
 
     // Jaeger tracing
     TextMapReader span_reader(carrier);
     auto parent_span = opentracing::Tracer::Global()->Extract(span_reader);
-    auto span = opentracing::Tracer::Global()->StartSpan(
+    message.span = opentracing::Tracer::Global()->StartSpan(
         "write_home_timeline_server",
         {opentracing::ChildOf(parent_span->get())});
+    messages.emplace_back(std::move(message));
+  }
+  if (messages.empty()) {
+    return;
+  }
 
-    // Extract information from rabbitmq messages
-    int64_t user_id = msg_json["user_id"];
-    int64_t req_id = msg_json["req_id"];
-    int64_t post_id = msg_json["post_id"];
-    int64_t timestamp = msg_json["timestamp"];
-    std::vector<int64_t> user_mentions_id = msg_json["user_mentions_id"];
-
-    // Find followers of the user
-    auto followers_span = opentracing::Tracer::Global()->StartSpan(
-        "get_followers_client", {opentracing::ChildOf(&span->context())});
-    std::map<std::string, std::string> writer_text_map;
-    TextMapWriter writer(writer_text_map);
-    opentracing::Tracer::Global()->Inject(followers_span->context(), writer);
-
-    auto social_graph_client_wrapper = _social_graph_client_pool->Pop();
-    if (!social_graph_client_wrapper) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_THRIFT_CONN_ERROR;
-      se.message = "Failed to connect to social-graph-service";
-      throw se;
-    }
-    auto social_graph_client = social_graph_client_wrapper->GetClient();
-    std::vector<int64_t> followers_id;
-    try {
-      social_graph_client->GetFollowers(followers_id, req_id, user_id,
-                                        writer_text_map);
-    } catch (...) {
-      LOG(error) << "Failed to get followers from social-network-service";
-      _social_graph_client_pool->Remove(social_graph_client_wrapper);
-      throw;
-    }
-    _social_graph_client_pool->Keepalive(social_graph_client_wrapper);
-    followers_span->Finish();
-
-    std::set<int64_t> followers_id_set(followers_id.begin(),
-                                       followers_id.end());
-    followers_id_set.insert(user_mentions_id.begin(), user_mentions_id.end());
-
-    // Update Redis ZSet
-    auto redis_span = opentracing::Tracer::Global()->StartSpan(
-        "write_home_timeline_redis_update_client",
-        {opentracing::ChildOf(&span->context())});
-    auto redis_client_wrapper = _redis_client_pool->Pop();
-    if (!redis_client_wrapper) {
-      ServiceException se;
-      se.errorCode = ErrorCode::SE_REDIS_ERROR;
-      se.message = "Cannot connect to Redis server";
-      throw se;
+  // Find followers of the users
+  std::map<int64_t, ExecutorFuture<std::vector<int64_t>>> followers_futures;
+  for (auto &message : messages) {
+    if (followers_futures.count(message.user_id) == 0) {
+      followers_futures.emplace(
+          message.user_id,
+          Executor::GetInstance()->Submit(GetFollowers, message.req_id,
+                                          message.user_id,
+                                          message.span.get()));
     }
-    auto redis_client = redis_client_wrapper->GetClient();
-    std::vector<std::string> options{"NX"};
-    std::string post_id_str = std::to_string(post_id);
-    std::string timestamp_str = std::to_string(timestamp);
-    std::multimap<std::string, std::string> value = {
-        {timestamp_str, post_id_str}};
+  }
+  std::map<int64_t, std::vector<int64_t>> followers_by_user;
+  for (auto &followers_future : followers_futures) {
+    followers_by_user[followers_future.first] = followers_future.second.get();
+  }
 
+  // Zset key: follower_id, Zset value: post_id_str, Zset score: timestamp_str
+  std::map<int64_t, std::multimap<std::string, std::string>> entries;
+  // The posts of users with too many followers to push to go to the pull
+  // timelines of their creators, the followers merge them in on reads.
+  std::map<int64_t, std::multimap<std::string, std::string>> pull_entries;
+  for (auto &message : messages) {
+    auto &followers_id = followers_by_user[message.user_id];
+    std::string post_id_str =
+        EncodePostId(message.post_id, _timeline_encoding);
+    std::string timestamp_str = std::to_string(message.timestamp);
+    std::set<int64_t> followers_id_set;
+    if (IsPullUser(followers_id.size(), _fanout_threshold)) {
+      pull_entries[message.user_id].emplace(timestamp_str, post_id_str);
+    } else {
+      followers_id_set.insert(followers_id.begin(), followers_id.end());
+    }
+    followers_id_set.insert(message.user_mentions_id.begin(),
+                            message.user_mentions_id.end());
     for (auto &follower_id : followers_id_set) {
-      redis_client->zadd(std::to_string(follower_id), options, value);
+      entries[follower_id].emplace(timestamp_str, post_id_str);
     }
+  }
 
+  // Update Redis ZSet
+  auto redis_span = opentracing::Tracer::Global()->StartSpan(
+      "write_home_timeline_redis_update_client",
+      {opentracing::ChildOf(&messages.front().span->context())});
+  auto redis_client_wrapper = _redis_client_pool->Pop();
+  if (!redis_client_wrapper) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_REDIS_ERROR;
+    se.message = "Cannot connect to Redis server";
+    throw se;
+  }
+  auto redis_client = redis_client_wrapper->GetClient();
+  std::vector<std::string> options{"NX"};
+  std::atomic<int> failed_writes{0};
+  auto count_failures = [&failed_writes](cpp_redis::reply &reply) {
+    if (reply.is_error()) {
+      failed_writes++;
+    }
+  };
+  // Keeps the newest _max_timeline_length posts, ranks count from the
+  // oldest post.
+  auto add_to_timeline = [&](const std::string &key,
+                             const std::multimap<std::string, std::string>
+                                 &score_members) {
+    redis_client->zadd(key, options, score_members, count_failures);
+    if (_max_timeline_length > 0) {
+      redis_client->zremrangebyrank(key, 0, -(_max_timeline_length + 1),
+                                    count_failures);
+    }
+  };
+  for (auto &entry : entries) {
+    add_to_timeline(std::to_string(entry.first), entry.second);
+  }
+  if (!pull_entries.empty()) {
+    std::vector<std::string> pull_user_ids;
+    for (auto &entry : pull_entries) {
+      add_to_timeline(PullTimelineKey(entry.first), entry.second);
+      pull_user_ids.emplace_back(std::to_string(entry.first));
+    }
+    redis_client->sadd(HOME_TIMELINE_PULL_USERS_KEY, pull_user_ids,
+                       count_failures);
+  }
+  try {
     redis_client->sync_commit();
-    redis_span->Finish();
-    _redis_client_pool->Keepalive(redis_client_wrapper);
   } catch (...) {
-    LOG(error) << "OnReveived worker error";
+    _redis_client_pool->Remove(redis_client_wrapper);
+    LOG(error) << "Failed to update home timelines in Redis";
     throw;
   }
+  _redis_client_pool->Keepalive(redis_client_wrapper);
+  if (failed_writes > 0) {
+    ServiceException se;
+    se.errorCode = ErrorCode::SE_REDIS_ERROR;
+    se.message = std::to_string(failed_writes.load()) +
+        " home timeline writes failed";
+    LOG(error) << se.message;
+    throw se;
+  }
+  redis_span->Finish();
+  for (auto &message : messages) {
+    message.span->Finish();
+  }
 }
 
 void HeartbeatSend(AmqpLibeventHandler &handler,
@@ -120,7 +228,8 @@ void HeartbeatSend(AmqpLibeventHandler &handler,
   }
 }
 
-void WorkerThread(std::string &addr, int port) {
+void WorkerThread(std::string &addr, int port, int prefetch_count,
+                  int batch_size, int batch_linger_ms) {
   AmqpLibeventHandler handler;
   AMQP::TcpConnection connection(
       handler, AMQP::Address(addr, port, AMQP::Login("guest", "guest"), "/"));
@@ -129,16 +238,74 @@ void WorkerThread(std::string &addr, int port) {
     LOG(error) << "Channel error: " << message;
     handler.Stop();
   });
+  // Caps the unacknowledged messages the broker sends this consumer. Above
+  // the batch size, the next batch is already on its way while one is
+  // written.
+  channel.setQos(std::max(prefetch_count, batch_size));
   channel.declareQueue("write-home-timeline", AMQP::durable)
       .onSuccess([&connection](const std::string &name, uint32_t messagecount,
                                uint32_t consumercount) {
         LOG(debug) << "Created queue: " << name;
       });
-  channel.consume("write-home-timeline", AMQP::noack)
-      .onReceived([](const AMQP::Message &msg, uint64_t tag, bool redelivered) {
-        LOG(debug) << "Received: " << std::string(msg.body(), msg.bodySize());
-        OnReceivedWorker(msg);
+
+  // Messages are acknowledged once their batch is in Redis, so that the
+  // broker redelivers them if the consumer dies before. When a batch fails,
+  // its messages are written one by one, so that a message that cannot be
+  // written does not fail the others with it. A message that still fails
+  // goes back to the queue once; on its redelivery it is rejected for good
+  // (to the dead-letter exchange of the queue, if it has one) rather than
+  // requeued in a loop. ZADD NX makes writing a post twice harmless.
+  std::vector<std::string> batch;
+  std::vector<uint64_t> batch_tags;
+  std::vector<bool> batch_redelivered;
+  auto flush = [&]() {
+    if (batch.empty()) {
+      return;
+    }
+    auto start = std::chrono::steady_clock::now();
+    try {
+      OnReceivedWorker(batch);
+      channel.ack(batch_tags.back(), AMQP::multiple);
+    } catch (...) {
+      LOG(error) << "Failed to write a batch of " << batch.size()
+                 << " posts, writing them one by one";
+      for (size_t i = 0; i < batch.size(); ++i) {
+        try {
+          OnReceivedWorker({batch[i]});
+          channel.ack(batch_tags[i]);
+        } catch (...) {
+          if (batch_redelivered[i]) {
+            LOG(error) << "Failed to write a redelivered post, dropping it: "
+                       << batch[i];
+            (*_dropped_messages)++;
+            channel.reject(batch_tags[i]);
+          } else {
+            LOG(error) << "Failed to write a post, requeueing it";
+            channel.reject(batch_tags[i], AMQP::requeue);
+          }
+        }
+      }
+    }
+    _message_latency_us->Record(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count());
+    _batch_size->Record(batch.size());
+    batch.clear();
+    batch_tags.clear();
+    batch_redelivered.clear();
+  };
+  channel.consume("write-home-timeline")
+      .onReceived([&](const AMQP::Message &msg, uint64_t tag,
+                      bool redelivered) {
+        batch.emplace_back(msg.body(), msg.bodySize());
+        batch_tags.push_back(tag);
+        batch_redelivered.push_back(redelivered);
+        if (batch.size() >= static_cast<size_t>(batch_size)) {
+          flush();
+        }
       });
+  // Bounds how long a post waits for its batch to fill up.
+  handler.SetInterval(batch_linger_ms, flush);
 
   std::thread heartbeat_thread(HeartbeatSend, std::ref(handler),
                                std::ref(connection), 30);
@@ -161,6 +328,22 @@ int main(int argc, char *argv[]) {
 
   int port = config_json["write-home-timeline-service"]["port"];
   int n_workers = config_json["write-home-timeline-service"]["workers"];
+  int metrics_port =
+      config_json["write-home-timeline-service"]["metrics_port"];
+  int prefetch_count =
+      config_json["write-home-timeline-service"]["prefetch_count"];
+  int batch_size = config_json["write-home-timeline-service"]["batch_size"];
+  int batch_linger_ms =
+      config_json["write-home-timeline-service"]["batch_linger_ms"];
+  _fanout_threshold = config_json["home-timeline-service"]["fanout_threshold"];
+  _max_timeline_length =
+      config_json["home-timeline-service"]["max_timeline_length"];
+  std::string timeline_encoding =
+      config_json["home-timeline-service"]["timeline_encoding"];
+  if (!ParseTimelineEncoding(timeline_encoding, &_timeline_encoding)) {
+    LOG(fatal) << "Unknown timeline_encoding: " << timeline_encoding;
+    exit(EXIT_FAILURE);
+  }
 
   std::string rabbitmq_addr =
       config_json["write-home-timeline-rabbitmq"]["addr"];
@@ -181,6 +364,14 @@ int main(int argc, char *argv[]) {
       config_json["social-graph-service"]["timeout_ms"];
   int social_graph_service_keepalive =
       config_json["social-graph-service"]["keepalive_ms"];
+  int social_graph_service_shards =
+      config_json["social-graph-service"]["pool_shards"];
+  int social_graph_service_min_conns =
+      config_json["social-graph-service"]["min_connections"];
+  int social_graph_service_health_check_ms =
+      config_json["social-graph-service"]["health_check_interval_ms"];
+  int social_graph_service_refresh_ahead_ms =
+      config_json["social-graph-service"]["refresh_ahead_ms"];
 
   ClientPool<RedisClient> redis_client_pool("redis", redis_addr, redis_port, 0,
                                             redis_conns, redis_timeout,
@@ -188,16 +379,35 @@ int main(int argc, char *argv[]) {
 
   ClientPool<ThriftClient<SocialGraphServiceClient>> social_graph_client_pool(
       "social-graph-service", social_graph_service_addr,
-      social_graph_service_port, 0, social_graph_service_conns,
-      social_graph_service_timeout, social_graph_service_keepalive, config_json);
+      social_graph_service_port, social_graph_service_min_conns,
+      social_graph_service_conns, social_graph_service_timeout,
+      social_graph_service_keepalive, config_json, social_graph_service_shards);
+  social_graph_client_pool.EnableCircuitBreaker(
+      CircuitBreakerOptions::FromConfig(config_json["social-graph-service"]));
+  social_graph_client_pool.EnableResolution(
+      config_json["social-graph-service"]["resolve_interval_ms"]);
+  social_graph_client_pool.EnableHedging(
+      config_json["social-graph-service"]["hedge_percentile"],
+      config_json["social-graph-service"]["hedge_budget"]);
+  social_graph_client_pool.StartMaintenance(
+      social_graph_service_health_check_ms,
+      social_graph_service_refresh_ahead_ms);
 
   _redis_client_pool = &redis_client_pool;
   _social_graph_client_pool = &social_graph_client_pool;
+  _message_latency_us = Metrics::GetInstance()->GetHistogram(
+      "rpc_latency_us", MetricLabel("method", "WriteHomeTimeline"));
+  _batch_size = Metrics::GetInstance()->GetHistogram(
+      "write_home_timeline_batch_size", "");
+  _dropped_messages = Metrics::GetInstance()->GetCounter(
+      "write_home_timeline_dropped_total", "");
+  Metrics::GetInstance()->StartServer(metrics_port);
 
   std::unique_ptr<std::thread> threads_ptr[n_workers];
   for (auto &thread_ptr : threads_ptr) {
     thread_ptr = std::make_unique<std::thread>(
-        WorkerThread, std::ref(rabbitmq_addr), rabbitmq_port);
+        WorkerThread, std::ref(rabbitmq_addr), rabbitmq_port, prefetch_count,
+        batch_size, batch_linger_ms);
   }
   for (auto &thread_ptr : threads_ptr) {
     thread_ptr->join();
@@ -2,28 +2,370 @@
 #define SOCIAL_NETWORK_MICROSERVICES_LOGGER_H
 
 #include <boost/log/trivial.hpp>
-#include <boost/log/utility/setup/console.hpp>
-#include <boost/log/utility/setup/common_attributes.hpp>
 
 #include <string.h>
+#include <time.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
 
 namespace social_network {
+
+// Statements below this severity are compiled out, together with the
+// formatting of their arguments. Override with e.g. -DLOG_COMPILED_SEVERITY=0
+// to keep debug statements in the binary.
+#ifndef LOG_COMPILED_SEVERITY
+#define LOG_COMPILED_SEVERITY ::boost::log::trivial::info
+#endif
+
+// Slots of the per-thread ring buffers. Messages logged while the ring of
+// the thread is full are dropped and counted.
+#define LOG_RING_CAPACITY 1024
+#define LOG_FLUSH_INTERVAL_MS 50
+// Messages per second and call site before further ones are suppressed.
+#define LOG_DEFAULT_RATE_LIMIT 100
+
 #define __FILENAME__ \
     (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
+
+#define LOG_IS_ON(severity) \
+    (::boost::log::trivial::severity >= LOG_COMPILED_SEVERITY && \
+     ::social_network::Logger::IsEnabled(::boost::log::trivial::severity))
+
+// The message is only formatted when the severity is enabled and the call
+// site is within its rate limit. The if/else keeps the macro safe inside
+// unbraced if statements.
 #define LOG(severity) \
-    BOOST_LOG_TRIVIAL(severity) << "(" << __FILENAME__ << ":" \
-    << __LINE__ << ":" << __FUNCTION__ << ") "
+    if (!LOG_IS_ON(severity)) {} else \
+    for (::social_network::LogGate _log_gate( \
+             ::boost::log::trivial::severity, \
+             []() -> ::social_network::LogSite & { \
+               static ::social_network::LogSite site; \
+               return site; }()); \
+         _log_gate.IsOpen();) \
+      ::social_network::LogMessage( \
+          ::boost::log::trivial::severity, _log_gate.Close()).stream() \
+          << "(" << __FILENAME__ << ":" << __LINE__ << ":" << __FUNCTION__ \
+          << ") "
+
+// Rate limiting state of one LOG statement.
+class LogSite {
+ public:
+  // Returns false if the message must be suppressed. Otherwise, stores the
+  // number of messages suppressed since the last one that got through.
+  bool Allow(long *suppressed);
+
+ private:
+  std::atomic<long> _window_s{0};
+  std::atomic<int> _count{0};
+  std::atomic<long> _suppressed{0};
+};
+
+class LogGate {
+ public:
+  LogGate(::boost::log::trivial::severity_level severity, LogSite &site);
+  bool IsOpen() const { return _open; }
+  long Close() {
+    _open = false;
+    return _suppressed;
+  }
+
+ private:
+  bool _open;
+  long _suppressed = 0;
+};
+
+class LogMessage {
+ public:
+  LogMessage(::boost::log::trivial::severity_level severity, long suppressed);
+  ~LogMessage();
+  std::ostream &stream() { return _stream; }
+
+ private:
+  ::boost::log::trivial::severity_level _severity;
+  long _suppressed;
+  std::ostringstream _stream;
+};
+
+// Single-producer single-consumer ring owned by one logging thread and
+// drained by the flusher thread.
+class LogRing {
+ public:
+  struct Record {
+    ::boost::log::trivial::severity_level severity;
+    long timestamp_us;
+    std::string message;
+  };
+
+  LogRing() : _records(LOG_RING_CAPACITY) {}
+  bool Push(::boost::log::trivial::severity_level severity, long timestamp_us,
+            std::string &&message);
+  // Appends the formatted records to out and returns how many were drained.
+  size_t Drain(std::string *out);
+  bool Empty() const;
+
+  std::atomic<bool> orphaned{false};
+
+ private:
+  std::vector<Record> _records;
+  std::atomic<size_t> _head{0};
+  std::atomic<size_t> _tail{0};
+};
+
+// Asynchronous backend of LOG. Handler threads only format the message and
+// push it to a ring buffer of their own, without taking any lock; a
+// background thread writes the buffered records to stderr in batches.
+// fatal messages are flushed synchronously.
+class Logger {
+ public:
+  static Logger *GetInstance();
+
+  static bool IsEnabled(::boost::log::trivial::severity_level severity) {
+    return severity >= _Level().load(std::memory_order_relaxed);
+  }
+  static void SetLevel(::boost::log::trivial::severity_level severity) {
+    _Level() = severity;
+  }
+  static int RateLimit() {
+    return _RateLimit().load(std::memory_order_relaxed);
+  }
+  // Maximum number of messages per second and call site, 0 for no limit.
+  static void SetRateLimit(int messages_per_second) {
+    _RateLimit() = messages_per_second;
+  }
+
+  void Push(::boost::log::trivial::severity_level severity,
+            std::string &&message);
+  void Flush();
+
+ private:
+  Logger();
+  ~Logger() = delete;
+
+  static std::atomic<int> &_Level();
+  static std::atomic<int> &_RateLimit();
+  static void _FlushAtExit();
+
+  LogRing *_ThreadRing();
+  void _Run();
+
+  std::mutex _rings_mtx;
+  std::vector<std::shared_ptr<LogRing>> _rings;
+  std::mutex _flush_mtx;
+  std::atomic<long> _dropped{0};
+  std::thread _flusher;
+};
+
+bool LogSite::Allow(long *suppressed) {
+  int limit = Logger::RateLimit();
+  if (limit <= 0) {
+    *suppressed = _suppressed.exchange(0);
+    return true;
+  }
+  long now_s = std::chrono::duration_cast<std::chrono::seconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+  long window_s = _window_s.load(std::memory_order_relaxed);
+  if (window_s != now_s &&
+      _window_s.compare_exchange_strong(window_s, now_s)) {
+    _count = 0;
+  }
+  if (_count.fetch_add(1, std::memory_order_relaxed) >= limit) {
+    _suppressed++;
+    return false;
+  }
+  *suppressed = _suppressed.exchange(0);
+  return true;
+}
+
+LogGate::LogGate(::boost::log::trivial::severity_level severity,
+                 LogSite &site) {
+  // fatal messages are never suppressed.
+  _open = site.Allow(&_suppressed) || severity >= ::boost::log::trivial::fatal;
+}
+
+LogMessage::LogMessage(::boost::log::trivial::severity_level severity,
+                       long suppressed)
+    : _severity(severity), _suppressed(suppressed) {}
+
+LogMessage::~LogMessage() {
+  if (_suppressed > 0) {
+    _stream << " [" << _suppressed << " similar messages suppressed]";
+  }
+  Logger::GetInstance()->Push(_severity, _stream.str());
+}
+
+// Same layout as the former Boost.Log console sink:
+// [%TimeStamp%] <%Severity%>: %Message%
+void AppendLogRecord(std::string *out,
+                     ::boost::log::trivial::severity_level severity,
+                     long timestamp_us, const std::string &message) {
+  time_t seconds = timestamp_us / 1000000;
+  struct tm tm;
+  localtime_r(&seconds, &tm);
+  char timestamp[64];
+  size_t len = strftime(timestamp, sizeof(timestamp), "%Y-%m-%d %H:%M:%S", &tm);
+  snprintf(timestamp + len, sizeof(timestamp) - len, ".%06ld",
+           timestamp_us % 1000000);
+  out->append("[");
+  out->append(timestamp);
+  out->append("] <");
+  out->append(::boost::log::trivial::to_string(severity));
+  out->append(">: ");
+  out->append(message);
+  out->append("\n");
+}
+
+bool LogRing::Push(::boost::log::trivial::severity_level severity,
+                   long timestamp_us, std::string &&message) {
+  size_t tail = _tail.load(std::memory_order_relaxed);
+  if (tail - _head.load(std::memory_order_acquire) >= _records.size()) {
+    return false;
+  }
+  Record &record = _records[tail % _records.size()];
+  record.severity = severity;
+  record.timestamp_us = timestamp_us;
+  record.message = std::move(message);
+  _tail.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+size_t LogRing::Drain(std::string *out) {
+  size_t head = _head.load(std::memory_order_relaxed);
+  size_t tail = _tail.load(std::memory_order_acquire);
+  for (size_t i = head; i < tail; ++i) {
+    Record &record = _records[i % _records.size()];
+    AppendLogRecord(out, record.severity, record.timestamp_us, record.message);
+    record.message.clear();
+  }
+  _head.store(tail, std::memory_order_release);
+  return tail - head;
+}
+
+bool LogRing::Empty() const {
+  return _head.load(std::memory_order_acquire) ==
+      _tail.load(std::memory_order_acquire);
+}
+
+std::atomic<int> &Logger::_Level() {
+  static std::atomic<int> level{::boost::log::trivial::info};
+  return level;
+}
+
+std::atomic<int> &Logger::_RateLimit() {
+  static std::atomic<int> rate_limit{LOG_DEFAULT_RATE_LIMIT};
+  return rate_limit;
+}
+
+Logger *Logger::GetInstance() {
+  // Intentionally leaked, like the Executor: the services exit() from their
+  // signal handlers while other threads may still be logging.
+  static Logger *instance = new Logger();
+  return instance;
+}
+
+Logger::Logger() {
+  _flusher = std::thread(&Logger::_Run, this);
+  _flusher.detach();
+  atexit(&Logger::_FlushAtExit);
+}
+
+void Logger::_FlushAtExit() {
+  GetInstance()->Flush();
+}
+
+LogRing *Logger::_ThreadRing() {
+  // The ring outlives its thread until the flusher has drained it.
+  struct RingHolder {
+    std::shared_ptr<LogRing> ring;
+    ~RingHolder() {
+      if (ring) {
+        ring->orphaned = true;
+      }
+    }
+  };
+  static thread_local RingHolder holder;
+  if (!holder.ring) {
+    holder.ring = std::make_shared<LogRing>();
+    std::lock_guard<std::mutex> lock(_rings_mtx);
+    _rings.emplace_back(holder.ring);
+  }
+  return holder.ring.get();
+}
+
+void Logger::Push(::boost::log::trivial::severity_level severity,
+                  std::string &&message) {
+  long timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  LogRing *ring = _ThreadRing();
+  if (severity >= ::boost::log::trivial::fatal) {
+    // The process is likely about to exit: make room if needed and write
+    // the message out before returning.
+    if (!ring->Push(severity, timestamp_us, std::move(message))) {
+      Flush();
+      ring->Push(severity, timestamp_us, std::move(message));
+    }
+    Flush();
+  } else if (!ring->Push(severity, timestamp_us, std::move(message))) {
+    _dropped++;
+  }
+}
+
+void Logger::Flush() {
+  std::lock_guard<std::mutex> flush_lock(_flush_mtx);
+  std::vector<std::shared_ptr<LogRing>> rings;
+  {
+    std::lock_guard<std::mutex> lock(_rings_mtx);
+    rings = _rings;
+  }
+
+  std::string out;
+  long dropped = _dropped.exchange(0);
+  if (dropped > 0) {
+    long timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    AppendLogRecord(&out, ::boost::log::trivial::warning, timestamp_us,
+                    "Dropped " + std::to_string(dropped) +
+                    " log messages, the log buffers were full");
+  }
+  for (auto &ring : rings) {
+    ring->Drain(&out);
+  }
+  if (!out.empty()) {
+    fwrite(out.data(), 1, out.size(), stderr);
+    fflush(stderr);
+  }
+
+  // Forget the rings of exited threads once they are drained.
+  std::lock_guard<std::mutex> lock(_rings_mtx);
+  for (auto it = _rings.begin(); it != _rings.end();) {
+    if ((*it)->orphaned && (*it)->Empty()) {
+      it = _rings.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
+void Logger::_Run() {
+  while (true) {
+    std::this_thread::sleep_for(
+        std::chrono::milliseconds(LOG_FLUSH_INTERVAL_MS));
+    Flush();
+  }
+}
 
 void init_logger() {
-  boost::log::register_simple_formatter_factory
-      <boost::log::trivial::severity_level, char>("Severity");
-  boost::log::add_common_attributes();
-  boost::log::add_console_log(
-      std::cerr, boost::log::keywords::format =
-          "[%TimeStamp%] <%Severity%>: %Message%");
-  boost::log::core::get()->set_filter (
-      boost::log::trivial::severity >= boost::log::trivial::info
-  );
+  Logger::SetLevel(::boost::log::trivial::info);
+  Logger::GetInstance();
 }
 
 
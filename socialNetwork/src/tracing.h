@@ -8,6 +8,14 @@
 #include <jaegertracing/Tracer.h>
 
 #include <opentracing/propagation.h>
+#include <opentracing/span.h>
+#include <opentracing/tracer.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
 #include <string>
 #include <map>
 #include "logger.h"
@@ -50,6 +58,493 @@ class TextMapWriter : public opentracing::TextMapWriter {
   std::map<std::string, std::string>& _text_map;
 };
 
+// Jaeger's propagation header, "{trace-id}:{span-id}:{parent-id}:{flags}"
+#define TRACE_CONTEXT_HEADER "uber-trace-id"
+#define TRACE_CONTEXT_MAX_LEN 72
+#define TRACE_CONTEXT_SAMPLED_FLAG 0x1
+
+// Fixed-size span context used to hand a trace from a handler to its own
+// client calls (e.g. the tasks it submits to the executor) without going
+// through a std::map carrier: injecting into it, copying it and extracting
+// from it never allocate. Baggage items are not carried.
+struct TraceContext {
+  uint64_t trace_id_high = 0;
+  uint64_t trace_id_low = 0;
+  uint64_t span_id = 0;
+  uint64_t parent_id = 0;
+  uint8_t flags = 0;
+
+  bool IsValid() const {
+    return trace_id_high != 0 || trace_id_low != 0;
+  }
+
+  // Writes the header value into buf, which must hold TRACE_CONTEXT_MAX_LEN
+  // bytes, and returns its length.
+  size_t Format(char *buf) const {
+    char *out = buf;
+    if (trace_id_high != 0) {
+      out = _FormatHex(out, trace_id_high, 1);
+      out = _FormatHex(out, trace_id_low, 16);
+    } else {
+      out = _FormatHex(out, trace_id_low, 1);
+    }
+    *out++ = ':';
+    out = _FormatHex(out, span_id, 1);
+    *out++ = ':';
+    out = _FormatHex(out, parent_id, 1);
+    *out++ = ':';
+    out = _FormatHex(out, flags, 1);
+    return out - buf;
+  }
+
+  bool Parse(string_view value) {
+    const char *fields[5];
+    int num_fields = 0;
+    const char *end = value.data() + value.size();
+    fields[num_fields++] = value.data();
+    for (const char *c = value.data(); c < end && num_fields < 5; ++c) {
+      if (*c == ':') {
+        fields[num_fields++] = c + 1;
+      }
+    }
+    if (num_fields != 4) {
+      return false;
+    }
+
+    const char *trace_id_end = fields[1] - 1;
+    const char *trace_id_split = trace_id_end - 16 > fields[0] ?
+        trace_id_end - 16 : fields[0];
+    uint64_t parsed_flags;
+    bool ok = (trace_id_split == fields[0] ||
+               _ParseHex(fields[0], trace_id_split, &trace_id_high)) &&
+        _ParseHex(trace_id_split, trace_id_end, &trace_id_low) &&
+        _ParseHex(fields[1], fields[2] - 1, &span_id) &&
+        _ParseHex(fields[2], fields[3] - 1, &parent_id) &&
+        _ParseHex(fields[3], end, &parsed_flags);
+    if (!ok) {
+      *this = TraceContext();
+      return false;
+    }
+    if (trace_id_split == fields[0]) {
+      trace_id_high = 0;
+    }
+    flags = static_cast<uint8_t>(parsed_flags);
+    return IsValid();
+  }
+
+ private:
+  static char *_FormatHex(char *out, uint64_t value, int min_digits) {
+    char digits[16];
+    int num_digits = 0;
+    do {
+      digits[num_digits++] = "0123456789abcdef"[value & 0xf];
+      value >>= 4;
+    } while (value != 0);
+    while (num_digits < min_digits) {
+      digits[num_digits++] = '0';
+    }
+    while (num_digits > 0) {
+      *out++ = digits[--num_digits];
+    }
+    return out;
+  }
+
+  static bool _ParseHex(const char *begin, const char *end, uint64_t *value) {
+    if (begin >= end || end - begin > 16) {
+      return false;
+    }
+    uint64_t result = 0;
+    for (const char *c = begin; c < end; ++c) {
+      int digit;
+      if (*c >= '0' && *c <= '9') {
+        digit = *c - '0';
+      } else if (*c >= 'a' && *c <= 'f') {
+        digit = *c - 'a' + 10;
+      } else if (*c >= 'A' && *c <= 'F') {
+        digit = *c - 'A' + 10;
+      } else {
+        return false;
+      }
+      result = (result << 4) | digit;
+    }
+    *value = result;
+    return true;
+  }
+};
+
+class TraceContextReader : public opentracing::TextMapReader {
+ public:
+  explicit TraceContextReader(const TraceContext &trace_context)
+      : _trace_context(trace_context) {}
+
+  expected<void> ForeachKey(
+      std::function<expected<void>(string_view key, string_view value)> f)
+  const override {
+    if (!_trace_context.IsValid()) {
+      return {};
+    }
+    char buf[TRACE_CONTEXT_MAX_LEN];
+    size_t len = _trace_context.Format(buf);
+    return f(TRACE_CONTEXT_HEADER, string_view(buf, len));
+  }
+
+ private:
+  const TraceContext &_trace_context;
+};
+
+class TraceContextWriter : public opentracing::TextMapWriter {
+ public:
+  explicit TraceContextWriter(TraceContext *trace_context)
+      : _trace_context(trace_context) {}
+
+  expected<void> Set(string_view key, string_view value) const override {
+    if (key == TRACE_CONTEXT_HEADER) {
+      _trace_context->Parse(value);
+    }
+    return {};
+  }
+
+ private:
+  TraceContext *_trace_context;
+};
+
+// Decides whether a trace that starts in this process is recorded.
+class Sampler {
+ public:
+  virtual ~Sampler() = default;
+  virtual bool IsSampled() = 0;
+  // Duration of an unsampled root span, for samplers that adapt to latency.
+  virtual bool ObservesLatency() const { return false; }
+  virtual void Observe(long duration_us) {}
+
+ protected:
+  static uint64_t _NextRandom() {
+    static thread_local uint64_t state = std::random_device()() | 1;
+    state ^= state << 13;
+    state ^= state >> 7;
+    state ^= state << 17;
+    return state;
+  }
+};
+
+class ProbabilisticSampler : public Sampler {
+ public:
+  explicit ProbabilisticSampler(double rate) : _rate(rate) {}
+
+  bool IsSampled() override {
+    return _IsSampled(_rate);
+  }
+
+ protected:
+  static bool _IsSampled(double rate) {
+    if (rate <= 0) {
+      return false;
+    }
+    if (rate >= 1) {
+      return true;
+    }
+    return (_NextRandom() >> 11) < static_cast<uint64_t>(rate * (1ULL << 53));
+  }
+
+  double _rate;
+};
+
+// Samples at most traces_per_second traces, with a burst of one second.
+class RateLimitingSampler : public Sampler {
+ public:
+  explicit RateLimitingSampler(double traces_per_second)
+      : _traces_per_second(traces_per_second),
+        _balance(traces_per_second),
+        _last_tick(std::chrono::steady_clock::now()) {}
+
+  bool IsSampled() override {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto now = std::chrono::steady_clock::now();
+    double elapsed_s = std::chrono::duration<double>(now - _last_tick).count();
+    _last_tick = now;
+    _balance = std::min(_traces_per_second,
+                        _balance + elapsed_s * _traces_per_second);
+    if (_balance < 1) {
+      return false;
+    }
+    _balance -= 1;
+    return true;
+  }
+
+ private:
+  std::mutex _mtx;
+  double _traces_per_second;
+  double _balance;
+  std::chrono::steady_clock::time_point _last_tick;
+};
+
+// Samples at rate, and at tail_rate for boost_ms after an unsampled trace
+// took longer than latency_threshold_ms, so that the traces around a latency
+// spike are recorded densely.
+class LatencyBiasedSampler : public ProbabilisticSampler {
+ public:
+  LatencyBiasedSampler(double rate, double tail_rate,
+                       long latency_threshold_ms, long boost_ms)
+      : ProbabilisticSampler(rate), _tail_rate(tail_rate),
+        _latency_threshold_us(latency_threshold_ms * 1000),
+        _boost_us(boost_ms * 1000) {}
+
+  bool IsSampled() override {
+    return _IsSampled(_NowUs() < _boost_until_us.load() ? _tail_rate : _rate);
+  }
+
+  bool ObservesLatency() const override {
+    return true;
+  }
+
+  void Observe(long duration_us) override {
+    if (duration_us > _latency_threshold_us) {
+      _boost_until_us = _NowUs() + _boost_us;
+    }
+  }
+
+ private:
+  static long _NowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  double _tail_rate;
+  long _latency_threshold_us;
+  long _boost_us;
+  std::atomic<long> _boost_until_us{0};
+};
+
+// Context of a trace that is not recorded. It only remembers the ids, so
+// that the decision can be propagated through the carrier.
+class UnsampledSpanContext : public opentracing::SpanContext {
+ public:
+  explicit UnsampledSpanContext(const TraceContext &trace_context)
+      : _trace_context(trace_context) {
+    _trace_context.flags = 0;
+  }
+
+  void ForeachBaggageItem(
+      std::function<bool(const std::string &, const std::string &)> f)
+  const override {}
+
+  std::unique_ptr<opentracing::SpanContext> Clone() const noexcept {
+    return std::unique_ptr<opentracing::SpanContext>(
+        new UnsampledSpanContext(_trace_context));
+  }
+
+  const TraceContext &GetTraceContext() const {
+    return _trace_context;
+  }
+
+ private:
+  TraceContext _trace_context;
+};
+
+class SamplingTracer;
+
+// Span of an unsampled trace: records nothing and is never reported.
+class UnsampledSpan : public opentracing::Span {
+ public:
+  UnsampledSpan(const SamplingTracer *tracer, const TraceContext &context,
+                Sampler *observer)
+      : _tracer(tracer), _context(context), _observer(observer) {
+    if (_observer) {
+      _start_time = std::chrono::steady_clock::now();
+    }
+  }
+
+  void FinishWithOptions(
+      const opentracing::FinishSpanOptions &options) noexcept override {
+    if (_observer) {
+      _observer->Observe(
+          std::chrono::duration_cast<std::chrono::microseconds>(
+              std::chrono::steady_clock::now() - _start_time).count());
+      _observer = nullptr;
+    }
+  }
+  void SetOperationName(string_view name) noexcept override {}
+  void SetTag(string_view key,
+              const opentracing::Value &value) noexcept override {}
+  void SetBaggageItem(string_view key,
+                      string_view value) noexcept override {}
+  std::string BaggageItem(string_view key) const noexcept override {
+    return {};
+  }
+  void Log(std::initializer_list<std::pair<string_view, opentracing::Value>>
+               fields) noexcept override {}
+  const opentracing::SpanContext &context() const noexcept override {
+    return _context;
+  }
+  const opentracing::Tracer &tracer() const noexcept override;
+
+ private:
+  const SamplingTracer *_tracer;
+  UnsampledSpanContext _context;
+  Sampler *_observer;
+  std::chrono::steady_clock::time_point _start_time;
+};
+
+// Wraps the Jaeger tracer. Traces started in this process are sampled by
+// the configured Sampler; traces arriving through a carrier keep the
+// upstream decision. Spans of unsampled traces are UnsampledSpans, so they
+// skip Jaeger's span allocation, tags and reporter entirely, and Inject
+// passes the unsampled flag on to the next hop.
+class SamplingTracer : public opentracing::Tracer {
+ public:
+  SamplingTracer(std::shared_ptr<opentracing::Tracer> tracer,
+                 std::unique_ptr<Sampler> sampler)
+      : _tracer(std::move(tracer)), _sampler(std::move(sampler)) {}
+
+  std::unique_ptr<opentracing::Span> StartSpanWithOptions(
+      string_view operation_name,
+      const opentracing::StartSpanOptions &options) const noexcept override {
+    const opentracing::SpanContext *parent = nullptr;
+    for (auto &reference : options.references) {
+      if (reference.second) {
+        parent = reference.second;
+        break;
+      }
+    }
+
+    if (parent) {
+      auto unsampled = dynamic_cast<const UnsampledSpanContext *>(parent);
+      if (unsampled) {
+        return std::unique_ptr<opentracing::Span>(new UnsampledSpan(
+            this, unsampled->GetTraceContext(), nullptr));
+      }
+      auto jaeger_context =
+          dynamic_cast<const jaegertracing::SpanContext *>(parent);
+      if (jaeger_context && !jaeger_context->isSampled()) {
+        TraceContext trace_context;
+        trace_context.trace_id_high = jaeger_context->traceID().high();
+        trace_context.trace_id_low = jaeger_context->traceID().low();
+        trace_context.span_id = jaeger_context->spanID();
+        return std::unique_ptr<opentracing::Span>(
+            new UnsampledSpan(this, trace_context, nullptr));
+      }
+      return _tracer->StartSpanWithOptions(operation_name, options);
+    }
+
+    if (_sampler->IsSampled()) {
+      return _tracer->StartSpanWithOptions(operation_name, options);
+    }
+    TraceContext trace_context;
+    trace_context.trace_id_low = _NewId();
+    trace_context.span_id = trace_context.trace_id_low;
+    return std::unique_ptr<opentracing::Span>(new UnsampledSpan(
+        this, trace_context,
+        _sampler->ObservesLatency() ? _sampler.get() : nullptr));
+  }
+
+  expected<void> Inject(const opentracing::SpanContext &sc,
+                        std::ostream &writer) const override {
+    if (dynamic_cast<const UnsampledSpanContext *>(&sc)) {
+      return opentracing::make_unexpected(
+          opentracing::invalid_span_context_error);
+    }
+    return _tracer->Inject(sc, writer);
+  }
+
+  expected<void> Inject(
+      const opentracing::SpanContext &sc,
+      const opentracing::TextMapWriter &writer) const override {
+    auto unsampled = dynamic_cast<const UnsampledSpanContext *>(&sc);
+    if (unsampled) {
+      char buf[TRACE_CONTEXT_MAX_LEN];
+      size_t len = unsampled->GetTraceContext().Format(buf);
+      return writer.Set(TRACE_CONTEXT_HEADER, string_view(buf, len));
+    }
+    return _tracer->Inject(sc, writer);
+  }
+
+  expected<void> Inject(
+      const opentracing::SpanContext &sc,
+      const opentracing::HTTPHeadersWriter &writer) const override {
+    auto unsampled = dynamic_cast<const UnsampledSpanContext *>(&sc);
+    if (unsampled) {
+      char buf[TRACE_CONTEXT_MAX_LEN];
+      size_t len = unsampled->GetTraceContext().Format(buf);
+      return writer.Set(TRACE_CONTEXT_HEADER, string_view(buf, len));
+    }
+    return _tracer->Inject(sc, writer);
+  }
+
+  expected<std::unique_ptr<opentracing::SpanContext>> Extract(
+      std::istream &reader) const override {
+    return _tracer->Extract(reader);
+  }
+
+  expected<std::unique_ptr<opentracing::SpanContext>> Extract(
+      const opentracing::TextMapReader &reader) const override {
+    // An unsampled upstream decision is honoured without asking Jaeger to
+    // build a span context.
+    TraceContext trace_context;
+    bool found = false;
+    reader.ForeachKey([&](string_view key, string_view value)
+                          -> expected<void> {
+      if (key == TRACE_CONTEXT_HEADER) {
+        found = trace_context.Parse(value);
+      }
+      return {};
+    });
+    if (found && !(trace_context.flags & TRACE_CONTEXT_SAMPLED_FLAG)) {
+      return std::unique_ptr<opentracing::SpanContext>(
+          new UnsampledSpanContext(trace_context));
+    }
+    return _tracer->Extract(reader);
+  }
+
+  expected<std::unique_ptr<opentracing::SpanContext>> Extract(
+      const opentracing::HTTPHeadersReader &reader) const override {
+    return _tracer->Extract(reader);
+  }
+
+  void Close() noexcept override {
+    _tracer->Close();
+  }
+
+ private:
+  static uint64_t _NewId() {
+    static thread_local std::mt19937_64 engine(std::random_device{}());
+    uint64_t id = 0;
+    while (id == 0) {
+      id = engine();
+    }
+    return id;
+  }
+
+  std::shared_ptr<opentracing::Tracer> _tracer;
+  std::unique_ptr<Sampler> _sampler;
+};
+
+const opentracing::Tracer &UnsampledSpan::tracer() const noexcept {
+  return *_tracer;
+}
+
+// Builds the sampler described by the "sampling" section of the Jaeger
+// config:
+//   type: "probabilistic" (param: rate), "ratelimiting" (param: traces per
+//   second) or "latency" (param: rate, tail_param: rate after a slow trace,
+//   latency_threshold_ms, boost_ms).
+std::unique_ptr<Sampler> MakeSampler(const YAML::Node &sampling) {
+  std::string type = sampling["type"].as<std::string>();
+  double param = sampling["param"].as<double>();
+  if (type == "probabilistic") {
+    return std::unique_ptr<Sampler>(new ProbabilisticSampler(param));
+  } else if (type == "ratelimiting") {
+    return std::unique_ptr<Sampler>(new RateLimitingSampler(param));
+  } else if (type == "latency") {
+    return std::unique_ptr<Sampler>(new LatencyBiasedSampler(
+        param, sampling["tail_param"].as<double>(),
+        sampling["latency_threshold_ms"].as<long>(),
+        sampling["boost_ms"].as<long>()));
+  }
+  LOG(warning) << "Unknown sampling type " << type
+               << ", sampling every trace";
+  return std::unique_ptr<Sampler>(new ProbabilisticSampler(1));
+}
+
 void SetUpTracer(
     const std::string &config_file_path,
     const std::string &service) {
@@ -60,6 +555,15 @@ void SetUpTracer(
   // configYAML["reporter"]["localAgentHostPort"] = service + "-" +
   //     configYAML["reporter"]["localAgentHostPort"].as<std::string>();
 
+  // With in-process sampling, Jaeger records every trace it is handed and
+  // the Sampler decides which traces reach it.
+  std::unique_ptr<Sampler> sampler;
+  if (configYAML["sampling"]) {
+    sampler = MakeSampler(configYAML["sampling"]);
+    configYAML["sampler"]["type"] = "const";
+    configYAML["sampler"]["param"] = 1;
+  }
+
   auto config = jaegertracing::Config::parse(configYAML);
 
   bool r = false;
@@ -69,8 +573,14 @@ void SetUpTracer(
       auto tracer = jaegertracing::Tracer::make(
         service, config, jaegertracing::logging::consoleLogger());
       r = true;
-      opentracing::Tracer::InitGlobal(
-      std::static_pointer_cast<opentracing::Tracer>(tracer));
+      if (sampler) {
+        opentracing::Tracer::InitGlobal(std::make_shared<SamplingTracer>(
+            std::static_pointer_cast<opentracing::Tracer>(tracer),
+            std::move(sampler)));
+      } else {
+        opentracing::Tracer::InitGlobal(
+        std::static_pointer_cast<opentracing::Tracer>(tracer));
+      }
     }
     catch(...)
     {
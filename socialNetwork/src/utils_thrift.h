@@ -1,18 +1,212 @@
 #ifndef SOCIAL_NETWORK_MICROSERVICES_SRC_UTILS_THRIFT_H_
 #define SOCIAL_NETWORK_MICROSERVICES_SRC_UTILS_THRIFT_H_
 
+#include <chrono>
+#include <map>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
+#include <thrift/TProcessor.h>
+#include <thrift/concurrency/PlatformThreadFactory.h>
+#include <thrift/concurrency/ThreadManager.h>
+#include <thrift/protocol/TBinaryProtocol.h>
+#include <thrift/protocol/TProtocol.h>
+#include <thrift/server/TNonblockingServer.h>
+#include <thrift/server/TThreadedServer.h>
+#include <thrift/transport/TBufferTransports.h>
+#include <thrift/transport/TNonblockingServerSocket.h>
 #include <thrift/transport/TServerSocket.h>
 #include <thrift/transport/TSSLSocket.h>
 #include <thrift/transport/TSSLServerSocket.h>
 
+#include "../gen-cpp/social_network_types.h"
+#include "ConcurrencyLimiter.h"
+#include "logger.h"
+#include "Metrics.h"
+
 namespace social_network{
 using json = nlohmann::json;
+using apache::thrift::TProcessor;
+using apache::thrift::TProcessorEventHandler;
+using apache::thrift::concurrency::PlatformThreadFactory;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::server::TNonblockingServer;
+using apache::thrift::server::TServer;
+using apache::thrift::server::TThreadedServer;
+using apache::thrift::transport::TFramedTransportFactory;
+using apache::thrift::transport::TNonblockingServerSocket;
+using apache::thrift::transport::TNonblockingServerTransport;
 using apache::thrift::transport::TServerSocket;
 using apache::thrift::transport::TSSLServerSocket;
 using apache::thrift::transport::TSSLSocketFactory;
 
+// Records the latency, in-flight count and errors of every RPC served by a
+// processor, labelled by method.
+class MetricsEventHandler : public TProcessorEventHandler {
+ public:
+  void *getContext(const char *fn_name, void *server_context) override;
+  void handlerError(void *ctx, const char *fn_name) override;
+  void freeContext(void *ctx, const char *fn_name) override;
+
+ private:
+  struct MethodMetrics {
+    Histogram *latency_us;
+    std::atomic<long> *in_flight;
+    std::atomic<long> *errors;
+  };
+  struct CallContext {
+    MethodMetrics *metrics;
+    std::chrono::steady_clock::time_point start;
+  };
+
+  MethodMetrics *_GetMethodMetrics(const char *fn_name);
+
+  std::mutex _mtx;
+  std::map<std::string, std::unique_ptr<MethodMetrics>> _methods;
+};
+
+MetricsEventHandler::MethodMetrics *MetricsEventHandler::_GetMethodMetrics(
+    const char *fn_name) {
+  // fn_name is a string literal of the generated processor, so its address
+  // identifies the method; the per-thread cache keeps the lock off the
+  // request path.
+  static thread_local std::unordered_map<const char *, MethodMetrics *> cache;
+  auto cached = cache.find(fn_name);
+  if (cached != cache.end()) {
+    return cached->second;
+  }
+
+  // "ComposePostService.ComposePost" -> "ComposePost"
+  std::string method(fn_name);
+  size_t dot = method.rfind('.');
+  if (dot != std::string::npos) {
+    method = method.substr(dot + 1);
+  }
+  std::lock_guard<std::mutex> lock(_mtx);
+  auto &method_metrics = _methods[method];
+  if (!method_metrics) {
+    Metrics *metrics = Metrics::GetInstance();
+    std::string labels = MetricLabel("method", method);
+    method_metrics.reset(new MethodMetrics{
+        metrics->GetHistogram("rpc_latency_us", labels),
+        metrics->GetGauge("rpc_in_flight", labels),
+        metrics->GetCounter("rpc_errors_total", labels)});
+  }
+  cache[fn_name] = method_metrics.get();
+  return method_metrics.get();
+}
+
+void *MetricsEventHandler::getContext(const char *fn_name,
+                                      void *server_context) {
+  MethodMetrics *metrics = _GetMethodMetrics(fn_name);
+  (*metrics->in_flight)++;
+  return new CallContext{metrics, std::chrono::steady_clock::now()};
+}
+
+void MetricsEventHandler::handlerError(void *ctx, const char *fn_name) {
+  (*static_cast<CallContext *>(ctx)->metrics->errors)++;
+}
+
+void MetricsEventHandler::freeContext(void *ctx, const char *fn_name) {
+  CallContext *call = static_cast<CallContext *>(ctx);
+  call->metrics->latency_us->Record(
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::steady_clock::now() - call->start).count());
+  (*call->metrics->in_flight)--;
+  delete call;
+}
+
+// Admits a request to the wrapped processor only while the server works on
+// fewer requests than the adaptive limit of its ConcurrencyLimiter. Excess
+// requests are answered right away with a ServiceException of code
+// SE_SERVER_OVERLOADED instead of queueing behind the admitted ones, so
+// callers can fail fast or retry elsewhere.
+class AdmissionControlProcessor : public TProcessor {
+ public:
+  AdmissionControlProcessor(std::shared_ptr<TProcessor> processor,
+                            std::shared_ptr<ConcurrencyLimiter> limiter)
+      : _processor(std::move(processor)), _limiter(std::move(limiter)) {}
+
+  bool process(std::shared_ptr<TProtocol> in, std::shared_ptr<TProtocol> out,
+               void *connection_context) override;
+
+ private:
+  bool _Reject(TProtocol *in, TProtocol *out);
+
+  std::shared_ptr<TProcessor> _processor;
+  std::shared_ptr<ConcurrencyLimiter> _limiter;
+};
+
+bool AdmissionControlProcessor::process(std::shared_ptr<TProtocol> in,
+                                        std::shared_ptr<TProtocol> out,
+                                        void *connection_context) {
+  if (!_limiter->TryAcquire()) {
+    return _Reject(in.get(), out.get());
+  }
+  auto start = std::chrono::steady_clock::now();
+  try {
+    bool keep_open = _processor->process(in, out, connection_context);
+    _limiter->Release(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    return keep_open;
+  } catch (...) {
+    _limiter->Release(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    throw;
+  }
+}
+
+bool AdmissionControlProcessor::_Reject(TProtocol *in, TProtocol *out) {
+  std::string fn_name;
+  TMessageType message_type;
+  int32_t seqid;
+  in->readMessageBegin(fn_name, message_type, seqid);
+  in->skip(apache::thrift::protocol::T_STRUCT);
+  in->readMessageEnd();
+  in->getTransport()->readEnd();
+  if (message_type == apache::thrift::protocol::T_ONEWAY) {
+    return true;
+  }
+
+  // Every method of the IDL declares "throws (1: ServiceException se)", so
+  // the result struct of any of them carries the exception as field 1.
+  ServiceException se;
+  se.errorCode = ErrorCode::SE_SERVER_OVERLOADED;
+  se.message = "Server overloaded, concurrency limit " +
+      std::to_string(_limiter->Limit()) + " reached";
+  out->writeMessageBegin(fn_name, apache::thrift::protocol::T_REPLY, seqid);
+  out->writeStructBegin("result");
+  out->writeFieldBegin("se", apache::thrift::protocol::T_STRUCT, 1);
+  se.write(out);
+  out->writeFieldEnd();
+  out->writeFieldStop();
+  out->writeStructEnd();
+  out->writeMessageEnd();
+  out->getTransport()->writeEnd();
+  out->getTransport()->flush();
+  return true;
+}
+
+// Wraps the processor of a service in an AdmissionControlProcessor unless
+// "concurrency_limit_max" is 0.
+std::shared_ptr<TProcessor> get_admission_control_processor(
+    const json &config_json, const std::string &service_name,
+    const std::shared_ptr<TProcessor> &processor) {
+  int max_limit = config_json[service_name]["concurrency_limit_max"];
+  if (max_limit <= 0) {
+    return processor;
+  }
+  int initial_limit = config_json[service_name]["concurrency_limit_initial"];
+  int min_limit = config_json[service_name]["concurrency_limit_min"];
+  return std::make_shared<AdmissionControlProcessor>(
+      processor, std::make_shared<ConcurrencyLimiter>(
+          service_name, initial_limit, min_limit, max_limit));
+}
+
 std::shared_ptr<TServerSocket> get_server_socket(const json &config_json, const std::string &address, int port) {
   bool ssl_enabled = config_json["ssl"]["enabled"];
   if (ssl_enabled) {
@@ -35,6 +229,57 @@ std::shared_ptr<TServerSocket> get_server_socket(const json &config_json, const
   return std::make_shared<TServerSocket>(address, port);
 };
 
+// Builds the server of a service according to its "server_mode":
+//   "threaded"    - TThreadedServer, one thread per inbound connection.
+//   "nonblocking" - TNonblockingServer, "server_io_threads" libevent loops
+//                   that hand complete requests to a ThreadManager of
+//                   "server_worker_threads" threads.
+// The processor is instrumented with a MetricsEventHandler and the metrics
+// endpoint is started on "metrics_port". Requests are admitted by an
+// AdmissionControlProcessor, see get_admission_control_processor().
+std::shared_ptr<TServer> get_server(const json &config_json,
+    const std::string &service_name,
+    const std::shared_ptr<TProcessor> &processor,
+    const std::string &address, int port) {
+  int metrics_port = config_json[service_name]["metrics_port"];
+  processor->setEventHandler(std::make_shared<MetricsEventHandler>());
+  Metrics::GetInstance()->StartServer(metrics_port);
+  std::shared_ptr<TProcessor> admitted_processor =
+      get_admission_control_processor(config_json, service_name, processor);
+
+  std::string server_mode = config_json[service_name]["server_mode"];
+  if (server_mode == "nonblocking") {
+    bool ssl_enabled = config_json["ssl"]["enabled"];
+    if (!ssl_enabled) {
+      int io_threads = config_json[service_name]["server_io_threads"];
+      int worker_threads = config_json[service_name]["server_worker_threads"];
+
+      std::shared_ptr<ThreadManager> thread_manager =
+          ThreadManager::newSimpleThreadManager(worker_threads);
+      thread_manager->threadFactory(std::make_shared<PlatformThreadFactory>());
+      thread_manager->start();
+
+      std::shared_ptr<TNonblockingServerTransport> server_socket =
+          std::make_shared<TNonblockingServerSocket>(address, port);
+      auto server = std::make_shared<TNonblockingServer>(
+          admitted_processor, std::make_shared<TBinaryProtocolFactory>(),
+          server_socket, thread_manager);
+      server->setNumIOThreads(io_threads);
+      return server;
+    }
+    LOG(warning) << "The nonblocking server mode does not support SSL, "
+                 << "starting " << service_name << " in threaded mode";
+  } else if (server_mode != "threaded") {
+    LOG(warning) << "Unknown server_mode " << server_mode << ", starting "
+                 << service_name << " in threaded mode";
+  }
+
+  return std::make_shared<TThreadedServer>(
+      admitted_processor, get_server_socket(config_json, address, port),
+      std::make_shared<TFramedTransportFactory>(),
+      std::make_shared<TBinaryProtocolFactory>());
+}
+
 } //namespace social_network
 
 #endif //SOCIAL_NETWORK_MICROSERVICES_SRC_UTILS_THRIFT_H_
@@ -68,6 +68,24 @@ def read_posts():
   posts = client.ReadPosts(req_id, post_id, {})
   print(posts)
 
+def store_posts():
+  socket = TSocket.TSocket("ath-8.ece.cornell.edu", 9090)
+  transport = TTransport.TFramedTransport(socket)
+  protocol = TBinaryProtocol.TBinaryProtocol(transport)
+  client = PostStorageService.Client(protocol)
+
+  transport.open()
+  req_id = random.getrandbits(63)
+  creator = Creator(username="user_0", user_id=0)
+  posts = []
+  for post_id in range(1, 11):
+    posts.append(Post(user_mentions=[], req_id=req_id, creator=creator,
+      post_type=PostType.POST, urls=[], media=[], post_id=post_id,
+      text="HelloWorld_" + str(post_id)))
+  client.StorePosts(req_id, posts, {})
+  print(client.ReadPosts(req_id, [post.post_id for post in posts], {}))
+  transport.close()
+
 
 if __name__ == '__main__':
   try:
@@ -0,0 +1,103 @@
+#include "../src/tracing.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <new>
+#include <string>
+
+using namespace social_network;
+
+// Counts every heap allocation made by the process, so that the benchmark
+// reports allocations per hop rather than a timing that depends on malloc.
+static std::atomic<long> num_allocs{0};
+
+void *operator new(size_t size) {
+  num_allocs++;
+  void *p = malloc(size);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+// What the tracer writes on Inject and reads on Extract.
+static const char *kTraceHeader = "80f198ee56343ba864fe8b2a57d3eff7"
+                                  ":e457b5a2e4d86bd1:5b2c3d4e5f607182:1";
+
+// Stand-in for a client helper that receives the carrier by value, as the
+// tasks submitted by ComposePostHandler do.
+template<class TCarrier, class TReader>
+__attribute__((noinline)) size_t extractHop(TCarrier carrier) {
+  TReader reader(carrier);
+  size_t bytes = 0;
+  reader.ForeachKey([&](string_view key, string_view value)
+                        -> expected<void> {
+    bytes += key.size() + value.size();
+    return {};
+  });
+  return bytes;
+}
+
+template<class TCarrier, class TWriter, class TReader>
+void runBenchmark(const std::string &name, int fan_out, int iterations) {
+  size_t bytes = 0;
+  long allocs_before = num_allocs.load();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    TCarrier carrier;
+    TWriter writer(&carrier);
+    writer.Set(TRACE_CONTEXT_HEADER, kTraceHeader);
+    for (int j = 0; j < fan_out; j++) {
+      bytes += extractHop<TCarrier, TReader>(carrier);
+    }
+  }
+  auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+  long allocs = num_allocs.load() - allocs_before;
+
+  std::cout << name << " fan_out=" << fan_out
+            << " allocs/request=" << static_cast<double>(allocs) / iterations
+            << " ns/request=" << elapsed_ns / iterations
+            << " (" << bytes << " bytes read)" << std::endl;
+}
+
+// TextMapWriter takes a reference, TraceContextWriter a pointer; adapt the
+// former so that both run through the same benchmark loop.
+class MapWriter : public TextMapWriter {
+ public:
+  explicit MapWriter(std::map<std::string, std::string> *text_map)
+      : TextMapWriter(*text_map) {}
+};
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? std::stoi(argv[1]) : 1000000;
+
+  TraceContext trace_context;
+  TraceContextWriter(&trace_context).Set(TRACE_CONTEXT_HEADER, kTraceHeader);
+  char buf[TRACE_CONTEXT_MAX_LEN];
+  std::string round_trip(buf, trace_context.Format(buf));
+  if (round_trip != kTraceHeader) {
+    std::cerr << "TraceContext round trip mismatch: " << round_trip
+              << std::endl;
+    return EXIT_FAILURE;
+  }
+
+  for (int fan_out : {1, 4, 7}) {
+    runBenchmark<std::map<std::string, std::string>, MapWriter,
+                 TextMapReader>("std::map", fan_out, iterations);
+    runBenchmark<TraceContext, TraceContextWriter, TraceContextReader>(
+        "TraceContext", fan_out, iterations);
+  }
+  return EXIT_SUCCESS;
+}
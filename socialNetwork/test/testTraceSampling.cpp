@@ -0,0 +1,112 @@
+#include "../src/tracing.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <string>
+
+using namespace social_network;
+
+// One service hop as the handlers do it: extract the caller's context,
+// start the server span, and start and inject three client spans.
+void runHop(const opentracing::Tracer &tracer,
+            const std::map<std::string, std::string> &carrier) {
+  TextMapReader reader(carrier);
+  auto parent_span = tracer.Extract(reader);
+  auto span = tracer.StartSpan(
+      "benchmark_server", {opentracing::ChildOf(parent_span->get())});
+  for (int i = 0; i < 3; i++) {
+    auto client_span = tracer.StartSpan(
+        "benchmark_client", {opentracing::ChildOf(&span->context())});
+    std::map<std::string, std::string> writer_text_map;
+    TextMapWriter writer(writer_text_map);
+    tracer.Inject(client_span->context(), writer);
+    client_span->SetTag("hop", i);
+    client_span->Finish();
+  }
+  span->Finish();
+}
+
+// Checks that the sampler decides for root spans only, and that an
+// unsampled decision reaches the next hop and its children.
+bool checkDecisions(const std::shared_ptr<opentracing::Tracer> &jaeger_tracer) {
+  SamplingTracer never(
+      jaeger_tracer, std::unique_ptr<Sampler>(new ProbabilisticSampler(0.0)));
+  SamplingTracer always(
+      jaeger_tracer, std::unique_ptr<Sampler>(new ProbabilisticSampler(1.0)));
+
+  auto root = never.StartSpan("unsampled_root");
+  if (!dynamic_cast<UnsampledSpan *>(root.get())) {
+    std::cerr << "A root span sampled at 0% was recorded" << std::endl;
+    return false;
+  }
+  std::map<std::string, std::string> carrier;
+  TextMapWriter writer(carrier);
+  never.Inject(root->context(), writer);
+  TextMapReader reader(carrier);
+  auto parent = always.Extract(reader);
+  auto child = always.StartSpan(
+      "unsampled_child", {opentracing::ChildOf(parent->get())});
+  if (!dynamic_cast<UnsampledSpan *>(child.get())) {
+    std::cerr << "The child of an unsampled span was recorded" << std::endl;
+    return false;
+  }
+  child->Finish();
+  root->Finish();
+
+  auto sampled = always.StartSpan("sampled_root");
+  if (dynamic_cast<UnsampledSpan *>(sampled.get())) {
+    std::cerr << "A root span sampled at 100% was dropped" << std::endl;
+    return false;
+  }
+  sampled->Finish();
+  return true;
+}
+
+void runBenchmark(const std::shared_ptr<opentracing::Tracer> &jaeger_tracer,
+                  double rate, int iterations) {
+  SamplingTracer tracer(
+      jaeger_tracer,
+      std::unique_ptr<Sampler>(new ProbabilisticSampler(rate)));
+
+  // Requests start in this process, so the sampler makes the decision.
+  std::map<std::string, std::string> empty_carrier;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    runHop(tracer, empty_carrier);
+  }
+  auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start).count();
+
+  std::cout << "sampling=" << rate * 100 << "% iterations=" << iterations
+            << " ns/hop=" << elapsed_ns / iterations << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  int iterations = argc > 1 ? std::stoi(argv[1]) : 100000;
+
+  // Spans are reported over UDP to a local agent; nothing needs to listen.
+  auto config = jaegertracing::Config::parse(YAML::Load(
+      "disabled: false\n"
+      "reporter:\n"
+      "  localAgentHostPort: \"127.0.0.1:6831\"\n"
+      "  queueSize: 1000000\n"
+      "sampler:\n"
+      "  type: \"const\"\n"
+      "  param: 1\n"));
+  auto jaeger_tracer = std::static_pointer_cast<opentracing::Tracer>(
+      jaegertracing::Tracer::make("benchmark", config,
+                                  jaegertracing::logging::nullLogger()));
+
+  if (!checkDecisions(jaeger_tracer)) {
+    jaeger_tracer->Close();
+    return EXIT_FAILURE;
+  }
+
+  for (double rate : {0.0, 0.01, 1.0}) {
+    runBenchmark(jaeger_tracer, rate, iterations);
+  }
+  jaeger_tracer->Close();
+  return EXIT_SUCCESS;
+}